@@ -78,6 +78,39 @@ static void gpt_partitions_dump()
     }
 }
 
+/*
+ * Number of requests a client should keep in flight at most. The driver's
+ * queue depth is shared evenly between clients so that one client cannot
+ * starve the others of driver request slots. This is advisory only, the
+ * virtualiser does not reject requests from clients that go over it.
+ */
+static uint16_t client_queue_depth(int cli_id)
+{
+    blk_storage_info_t *driver_storage_info = config.driver.conn.storage_info.vaddr;
+
+    uint32_t driver_depth = MIN(config.driver.conn.num_buffers, DRIVER_MAX_NUM_BUFFERS);
+    if (driver_storage_info->queue_depth != 0) {
+        driver_depth = MIN(driver_depth, driver_storage_info->queue_depth);
+    }
+
+    uint32_t quota = MAX(driver_depth / config.num_clients, 1);
+    return MIN(quota, config.clients[cli_id].conn.num_buffers);
+}
+
+/* Publish the storage info of a client's partition, once the partition has been assigned */
+static void client_storage_info_init(int cli_id, bool read_only)
+{
+    blk_storage_info_t *client_storage_info = config.clients[cli_id].conn.storage_info.vaddr;
+    blk_storage_info_t *driver_storage_info = config.driver.conn.storage_info.vaddr;
+
+    client_storage_info->sector_size = driver_storage_info->sector_size;
+    client_storage_info->capacity = clients[cli_id].sectors / (BLK_TRANSFER_SIZE / MSDOS_MBR_SECTOR_SIZE);
+    client_storage_info->read_only = read_only;
+    client_storage_info->block_size = MAX(driver_storage_info->block_size, 1);
+    client_storage_info->queue_depth = client_queue_depth(cli_id);
+    __atomic_store_n(&client_storage_info->ready, true, __ATOMIC_RELEASE);
+}
+
 static bool gpt_partitions_init()
 {
     for (int i = 0; i < config.num_clients; i++) {
@@ -94,12 +127,7 @@ static bool gpt_partitions_init()
         clients[i].start_sector = gpt_meta.table[client_partition].lba_start;
         clients[i].sectors = gpt_meta.table[client_partition].lba_end - gpt_meta.table[client_partition].lba_start + 1;
 
-        blk_storage_info_t *client_storage_info = client->conn.storage_info.vaddr;
-        blk_storage_info_t *driver_storage_info = config.driver.conn.storage_info.vaddr;
-        client_storage_info->sector_size = driver_storage_info->sector_size;
-        client_storage_info->capacity = clients[i].sectors / (BLK_TRANSFER_SIZE / MSDOS_MBR_SECTOR_SIZE);
-        client_storage_info->read_only = false;
-        __atomic_store_n(&client_storage_info->ready, true, __ATOMIC_RELEASE);
+        client_storage_info_init(i, false);
     }
 
     return true;
@@ -269,12 +297,8 @@ static bool mbr_partitions_init(void)
         clients[i].start_sector = msdos_mbr.partitions[client_partition].lba_start;
         clients[i].sectors = msdos_mbr.partitions[client_partition].sectors;
 
-        blk_storage_info_t *client_storage_info = client->conn.storage_info.vaddr;
         blk_storage_info_t *driver_storage_info = config.driver.conn.storage_info.vaddr;
-        client_storage_info->sector_size = driver_storage_info->sector_size;
-        client_storage_info->capacity = clients[i].sectors / (BLK_TRANSFER_SIZE / MSDOS_MBR_SECTOR_SIZE);
-        client_storage_info->read_only = driver_storage_info->read_only;
-        __atomic_store_n(&client_storage_info->ready, true, __ATOMIC_RELEASE);
+        client_storage_info_init(i, driver_storage_info->read_only);
     }
     return true;
 }
@@ -4,12 +4,14 @@
  */
 
 #include <microkit.h>
+#include <os/sddf.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <sddf/util/cache.h>
 #include <sddf/util/printf.h>
 #include <sddf/util/string.h>
 #include <sddf/util/util.h>
+#include <sddf/util/boot_trace.h>
 
 #include "virt.h"
 
@@ -51,14 +53,28 @@ static reqbk_t reqsbk[DRIVER_MAX_NUM_BUFFERS];
 ialloc_t ialloc;
 static uint32_t ialloc_idxlist[DRIVER_MAX_NUM_BUFFERS];
 
+/* Whether the driver has populated its storage info and we have started probing partitions */
+bool driver_ready = false;
 bool initialised = false;
 
+/* Clients and driver to notify once the current event has been handled */
+static sddf_notify_set_t notify_set;
+
+static void driver_ready_init(void)
+{
+    driver_ready = true;
+    LOG_BLK_VIRT("driver is ready\n");
+
+    /* Start probing the partitions, this finishes as the driver responds */
+    boot_trace_begin("partition probe");
+    virt_partition_init();
+}
+
 void init(void)
 {
     assert(blk_config_check_magic(&config));
 
-    blk_storage_info_t *driver_storage_info = config.driver.conn.storage_info.vaddr;
-    while (!blk_storage_is_ready(driver_storage_info));
+    boot_trace_begin("init");
 
     /* Initialise client queues */
     for (int i = 0; i < config.num_clients; i++) {
@@ -75,16 +91,22 @@ void init(void)
     blk_queue_init(&drv_h, config.driver.conn.req_queue.vaddr, config.driver.conn.resp_queue.vaddr, driver_num_buffers);
 
     /* Initialise index allocator */
-    ialloc_init(&ialloc, ialloc_idxlist, DRIVER_MAX_NUM_BUFFERS);
+    ialloc_init_lifo(&ialloc, ialloc_idxlist, DRIVER_MAX_NUM_BUFFERS);
 
-    virt_partition_init();
+    /*
+     * The driver may still be bringing up the device. Rather than waiting for it here,
+     * the driver notifies us once its storage info is ready.
+     */
+    blk_storage_info_t *driver_storage_info = config.driver.conn.storage_info.vaddr;
+    if (blk_storage_is_ready(driver_storage_info)) {
+        driver_ready_init();
+    }
+
+    boot_trace_end("init");
 }
 
 static void handle_driver()
 {
-    bool client_notify[SDDF_BLK_MAX_CLIENTS];
-    sddf_memset(client_notify, 0, SDDF_BLK_MAX_CLIENTS);
-
     blk_resp_status_t drv_status = 0;
     uint16_t drv_success_count = 0;
     uint32_t drv_resp_id = 0;
@@ -125,14 +147,8 @@ static void handle_driver()
          */
         err = blk_enqueue_resp(&h, drv_status, drv_success_count, reqbk.cli_req_id);
         assert(!err);
-        client_notify[reqbk.cli_id] = true;
-    }
-
-    /* Notify corresponding client if a response was enqueued */
-    for (int i = 0; i < config.num_clients; i++) {
-        if (client_notify[i]) {
-            microkit_notify(config.clients[i].conn.id);
-        }
+        /* Notify corresponding client since a response was enqueued */
+        sddf_notify_set_add(&notify_set, config.clients[reqbk.cli_id].conn.id);
     }
 }
 
@@ -151,7 +167,6 @@ static bool handle_client(int cli_id)
     uint32_t cli_req_id = 0;
 
     bool driver_notify = false;
-    bool client_notify = false;
     /*
      * In addition to checking the client actually has a request, we check that the
      * we can enqueue the request into the driver as well as that our index state tracking
@@ -230,11 +245,7 @@ static bool handle_client(int cli_id)
          */
         err = blk_enqueue_resp(&h, resp_status, 0, cli_req_id);
         assert(!err);
-        client_notify = true;
-    }
-
-    if (client_notify) {
-        microkit_notify(config.clients[cli_id].conn.id);
+        sddf_notify_set_add(&notify_set, config.clients[cli_id].conn.id);
     }
 
     return driver_notify;
@@ -250,15 +261,33 @@ static void handle_clients()
     }
 
     if (driver_notify) {
-        microkit_notify(config.driver.conn.id);
+        sddf_notify_set_add(&notify_set, config.driver.conn.id);
     }
 }
 
 void notified(microkit_channel ch)
 {
+    if (!driver_ready) {
+        blk_storage_info_t *driver_storage_info = config.driver.conn.storage_info.vaddr;
+        if (ch == config.driver.conn.id && blk_storage_is_ready(driver_storage_info)) {
+            driver_ready_init();
+        }
+        /* Clients cannot have made requests yet as none of their storage info is ready */
+        return;
+    }
+
     if (!initialised) {
         /* Continue processing partitions until initialisation has finished. */
         initialised = virt_partition_init();
+        if (initialised) {
+            boot_trace_end("partition probe");
+            LOG_BLK_VIRT("partitions probed\n");
+
+            /* Let clients know their storage info is now ready */
+            for (int i = 0; i < config.num_clients; i++) {
+                sddf_notify_set_add(&notify_set, config.clients[i].conn.id);
+            }
+        }
     }
 
     if (ch == config.driver.conn.id) {
@@ -267,4 +296,6 @@ void notified(microkit_channel ch)
     } else {
         handle_clients();
     }
+
+    sddf_notify_set_flush(&notify_set);
 }
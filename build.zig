@@ -35,6 +35,7 @@ const DriverClass = struct {
 
     const Block = enum {
         virtio,
+        nvme,
     };
 
     const Mmc = enum {
@@ -56,6 +57,8 @@ const util_src = [_][]const u8{
     "util/cache.c",
     "util/fsmalloc.c",
     "util/bitarray.c",
+    "util/boot_trace.c",
+    "util/binlog.c",
     "util/assert.c",
 };
 
@@ -197,7 +200,11 @@ fn addBlockDriver(
         .optimize = optimize,
         .strip = false,
     });
-    const source = b.fmt("drivers/blk/{s}/block.c", .{ @tagName(class) });
+    const source_name = switch (class) {
+        .nvme => "nvme.c",
+        else => "block.c",
+    };
+    const source = b.fmt("drivers/blk/{s}/{s}", .{ @tagName(class), source_name });
     driver.addCSourceFile(.{
         .file = b.path(source),
     });
@@ -432,8 +439,8 @@ pub fn build(b: *std.Build) void {
         .optimize = optimize,
         .strip = false,
     });
-    gpu_virt.addCSourceFile(.{
-        .file = b.path("gpu/components/virt.c"),
+    gpu_virt.addCSourceFiles(.{
+        .files = &. { "gpu/components/virt.c", "gpu/components/compositor.c" },
     });
     gpu_virt.addIncludePath(gpu_config_include);
     gpu_virt.addIncludePath(b.path("include"));
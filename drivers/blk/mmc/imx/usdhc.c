@@ -10,6 +10,8 @@
 #include <sddf/blk/queue.h>
 #include <sddf/blk/storage_info.h>
 #include <sddf/util/printf.h>
+#include <sddf/util/timestamp.h>
+#include <sddf/util/boot_trace.h>
 #include <sddf/timer/config.h>
 #include <sddf/timer/client.h>
 
@@ -53,6 +55,9 @@ __attribute__((__section__(".device_resources"))) device_resources_t device_reso
 __attribute__((__section__(".blk_driver_config"))) blk_driver_config_t blk_config;
 __attribute__((__section__(".timer_client_config"))) timer_client_config_t timer_config;
 
+/* When bring-up started, for reporting how long card identification takes */
+static uint64_t bringup_start;
+
 /* Make sure to update drv_to_blk_status() as well */
 typedef enum {
     DrvSuccess,
@@ -1030,7 +1035,10 @@ void setup_blk_storage_info()
     LOG_DRIVER("Card size (blocks): %lu\n", storage_info->capacity);
 
     __atomic_store_n(&storage_info->ready, true, __ATOMIC_RELEASE);
-    LOG_DRIVER("Driver initialisation complete\n");
+    /* The virtualiser waits for this notification before using the device */
+    microkit_notify(blk_config.virt.id);
+    boot_trace_end("card bringup");
+    LOG_DRIVER("Driver initialisation complete after %luus\n", sddf_timestamp_to_us(sddf_timestamp() - bringup_start));
 }
 
 drv_status_t usdhc_init(void)
@@ -1255,6 +1263,8 @@ void init()
 
     usdhc_regs = device_resources.regions[0].region.vaddr;
 
+    bringup_start = sddf_timestamp();
+    boot_trace_begin("card bringup");
     LOG_DRIVER("Beginning driver initialisation...\n");
     stop_operations_and_clear_card_state();
 
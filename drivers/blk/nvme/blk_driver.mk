@@ -0,0 +1,26 @@
+#
+# Copyright 2025, UNSW
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Include this snippet in your project Makefile to build the NVMe block driver.
+# Assumes libsddf_util_debug.a is in ${LIBS}.
+
+NVME_BLK_DRIVER_DIR := $(realpath $(dir $(lastword $(MAKEFILE_LIST))))
+
+blk_driver.elf: blk/nvme/blk_driver.o
+	$(LD) $(LDFLAGS) $^ $(LIBS) -o $@
+
+blk/nvme/blk_driver.o: ${NVME_BLK_DRIVER_DIR}/nvme.c |blk/nvme
+	$(CC) -c $(CFLAGS) -I${NVME_BLK_DRIVER_DIR} -o $@ $<
+
+-include blk_driver.d
+
+blk/nvme:
+	mkdir -p $@
+
+clean::
+	rm -f blk/nvme/blk_driver.[do]
+
+clobber::
+	rm -rf blk
@@ -0,0 +1,693 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * This is a driver for NVMe controllers attached via PCIe, written against
+ * QEMU's emulated 'nvme' device behind the 'pci-host-ecam-generic' host bridge.
+ *
+ * The driver maps sDDF block requests directly onto one or more I/O submission
+ * and completion queue pairs. Requests that exceed the maximum transfer size of
+ * the controller are split into multiple NVMe commands and a single response is
+ * given once all of them have completed.
+ *
+ * Completions are signalled with the legacy INTx interrupt. Completion queues are
+ * also polled whenever the virtualiser notifies us, so that responses are delivered
+ * as early as possible under load.
+ *
+ * Like the virtIO drivers, this driver assumes that DMA is cache coherent
+ * for the queue memory (as it is on QEMU).
+ */
+
+#include <microkit.h>
+#include <sddf/util/util.h>
+#include <sddf/util/boot_trace.h>
+#include <sddf/util/ialloc.h>
+#include <sddf/util/fence.h>
+#include <sddf/util/string.h>
+#include <sddf/blk/queue.h>
+#include <sddf/blk/config.h>
+#include <sddf/blk/storage_info.h>
+#include <sddf/resources/device.h>
+#include <sddf/pci/pci.h>
+#include "nvme.h"
+
+/* Number of I/O queue pairs to create */
+#ifndef NVME_NUM_IO_QUEUES
+#define NVME_NUM_IO_QUEUES 1
+#endif
+
+/* Number of entries in each I/O queue, clamped to what the controller supports */
+#ifndef NVME_IO_QUEUE_DEPTH
+#define NVME_IO_QUEUE_DEPTH 1024
+#endif
+
+#define NVME_ADMIN_QUEUE_DEPTH 32
+
+/* A submission queue of depth N can only hold N - 1 commands */
+#define NVME_MAX_COMMANDS (NVME_NUM_IO_QUEUES * (NVME_IO_QUEUE_DEPTH - 1))
+_Static_assert(NVME_MAX_COMMANDS <= 0xffff, "NVMe command identifiers are 16-bit");
+
+/* Each command has one page of PRP entries, this bounds the size of a single command */
+#define NVME_PRP_LIST_ENTRIES (NVME_PAGE_SIZE / sizeof(uint64_t))
+#define NVME_MAX_TRANSFER_PAGES NVME_PRP_LIST_ENTRIES
+
+/* Maximum number of sDDF requests in-flight at once */
+#define NVME_MAX_REQUESTS NVME_MAX_COMMANDS
+
+#define REGION_ECAM 0
+#define REGION_BAR 1
+#define REGION_QUEUES 2
+#define REGION_PRP_LISTS 3
+
+__attribute__((__section__(".device_resources"))) device_resources_t device_resources;
+__attribute__((__section__(".blk_driver_config"))) blk_driver_config_t config;
+
+static blk_queue_handle_t blk_queue;
+
+static pci_function_t pci_fn;
+static nvme_regs_t *regs;
+static uint32_t doorbell_stride;
+
+typedef struct nvme_queue {
+    uint16_t id;
+    uint16_t depth;
+    nvme_sqe_t *sq;
+    volatile nvme_cqe_t *cq;
+    volatile uint32_t *sq_tail_db;
+    volatile uint32_t *cq_head_db;
+    uint16_t sq_tail;
+    uint16_t cq_head;
+    /* Expected value of the phase tag for new completion entries */
+    uint16_t cq_phase;
+    /* Whether the SQ tail doorbell needs to be rung */
+    bool sq_dirty;
+} nvme_queue_t;
+
+static nvme_queue_t admin_queue;
+static nvme_queue_t io_queues[NVME_NUM_IO_QUEUES];
+static uint16_t io_queue_depth;
+
+/* Scratch page used for identify data */
+static void *identify_vaddr;
+static uintptr_t identify_paddr;
+
+static uintptr_t prp_lists_vaddr;
+static uintptr_t prp_lists_paddr;
+
+/* sDDF request being tracked by the driver, may be split into multiple NVMe commands */
+typedef struct nvme_request {
+    uint32_t id;
+    blk_req_code_t code;
+    uint16_t count;
+    /* Number of sDDF blocks not yet submitted to the controller */
+    uint16_t remaining;
+    /* Number of NVMe commands submitted and not yet completed */
+    uint16_t outstanding;
+    blk_resp_status_t status;
+    uintptr_t paddr;
+    uint64_t block_number;
+} nvme_request_t;
+
+static nvme_request_t requests[NVME_MAX_REQUESTS];
+static ialloc_t request_ialloc;
+static uint32_t request_idxlist[NVME_MAX_REQUESTS];
+
+/* Map from NVMe command identifier to the index of the sDDF request it belongs to */
+static uint32_t command_to_request[NVME_MAX_COMMANDS];
+static ialloc_t command_ialloc;
+static uint32_t command_idxlist[NVME_MAX_COMMANDS];
+static uint32_t inflight_commands;
+
+/* Whether a response has been enqueued for the virtualiser during this notification */
+static bool virt_notify;
+
+/* Request that has been dequeued from the virtualiser but not fully submitted */
+static struct {
+    bool active;
+    uint32_t req_idx;
+} pending;
+
+/* Namespace geometry */
+static uint32_t lba_shift;
+static uint64_t lbas_per_transfer;
+/* Maximum number of sDDF blocks in a single NVMe command */
+static uint16_t max_transfer_blocks;
+
+static volatile uint32_t *doorbell(uint16_t qid, bool completion)
+{
+    uintptr_t base = (uintptr_t)regs + NVME_DOORBELL_OFFSET;
+    return (volatile uint32_t *)(base + (2 * qid + (completion ? 1 : 0)) * doorbell_stride);
+}
+
+static void nvme_queue_init(nvme_queue_t *q, uint16_t id, uint16_t depth, void *sq, void *cq)
+{
+    q->id = id;
+    q->depth = depth;
+    q->sq = sq;
+    q->cq = cq;
+    q->sq_tail_db = doorbell(id, false);
+    q->cq_head_db = doorbell(id, true);
+    q->sq_tail = 0;
+    q->cq_head = 0;
+    q->cq_phase = 1;
+    q->sq_dirty = false;
+
+    sddf_memset(sq, 0, depth * sizeof(nvme_sqe_t));
+    sddf_memset(cq, 0, depth * sizeof(nvme_cqe_t));
+}
+
+static void nvme_queue_submit(nvme_queue_t *q, nvme_sqe_t *sqe)
+{
+    q->sq[q->sq_tail] = *sqe;
+    q->sq_tail = (q->sq_tail + 1) % q->depth;
+    q->sq_dirty = true;
+}
+
+static void nvme_queue_ring(nvme_queue_t *q)
+{
+    if (!q->sq_dirty) {
+        return;
+    }
+    /* Make sure the entries are visible to the controller before the doorbell write */
+    THREAD_MEMORY_RELEASE();
+    *q->sq_tail_db = q->sq_tail;
+    q->sq_dirty = false;
+}
+
+static bool nvme_queue_completion(nvme_queue_t *q, nvme_cqe_t *cqe)
+{
+    volatile nvme_cqe_t *entry = &q->cq[q->cq_head];
+    if ((entry->status & NVME_CQE_PHASE) != q->cq_phase) {
+        return false;
+    }
+    THREAD_MEMORY_ACQUIRE();
+    *cqe = *entry;
+
+    q->cq_head++;
+    if (q->cq_head == q->depth) {
+        q->cq_head = 0;
+        q->cq_phase ^= 1;
+    }
+
+    return true;
+}
+
+/*
+ * Submit an admin command and wait for it to complete. This is only
+ * used during initialisation.
+ */
+static uint16_t nvme_admin_sync(nvme_sqe_t *sqe)
+{
+    static uint16_t admin_cid = 0;
+    sqe->cid = admin_cid++;
+
+    nvme_queue_submit(&admin_queue, sqe);
+    nvme_queue_ring(&admin_queue);
+
+    nvme_cqe_t cqe;
+    while (!nvme_queue_completion(&admin_queue, &cqe));
+    *admin_queue.cq_head_db = admin_queue.cq_head;
+
+    assert(cqe.cid == sqe->cid);
+    return NVME_CQE_STATUS(cqe.status);
+}
+
+static bool pci_match_nvme(uint16_t vendor, uint16_t device, uint32_t class_code, void *arg)
+{
+    return class_code == PCI_CLASS_STORAGE_NVME;
+}
+
+static void nvme_pci_init(void)
+{
+    device_region_resource_t *ecam = &device_resources.regions[REGION_ECAM];
+    device_region_resource_t *bar = &device_resources.regions[REGION_BAR];
+
+    if (!pci_find_function((uintptr_t)ecam->region.vaddr, ecam->region.size, pci_match_nvme, NULL, &pci_fn)) {
+        LOG_DRIVER_ERR("could not find NVMe controller on PCI bus\n");
+        assert(false);
+    }
+    LOG_DRIVER("found NVMe controller at %02x:%02x.%x\n", pci_fn.bus, pci_fn.device, pci_fn.function);
+
+    uint64_t bar_size = pci_bar_assign(&pci_fn, 0, bar->io_addr);
+    if (bar_size == 0 || bar_size > bar->region.size) {
+        LOG_DRIVER_ERR("BAR0 of size 0x%lx does not fit in region of size 0x%lx\n", bar_size, bar->region.size);
+        assert(false);
+    }
+
+    pci_enable(&pci_fn, true);
+
+    regs = (nvme_regs_t *)bar->region.vaddr;
+}
+
+static bool nvme_wait_ready(bool ready)
+{
+    /* CAP.TO is given in 500ms units. The controller is expected to be ready quickly,
+     * so rather than use a timer we bound the number of polls. */
+    for (uint64_t i = 0; i < NVME_CAP_TO(regs->cap) * 0x100000ULL + 0x100000ULL; i++) {
+        uint32_t csts = regs->csts;
+        if (csts & NVME_CSTS_CFS) {
+            LOG_DRIVER_ERR("controller fatal status\n");
+            return false;
+        }
+        if (!!(csts & NVME_CSTS_RDY) == ready) {
+            return true;
+        }
+    }
+
+    LOG_DRIVER_ERR("timed out waiting for controller to become %s\n", ready ? "ready" : "disabled");
+    return false;
+}
+
+static void nvme_identify(void)
+{
+    nvme_sqe_t sqe = {
+        .opcode = NVME_ADMIN_IDENTIFY,
+        .prp1 = identify_paddr,
+        .cdw10 = NVME_IDENTIFY_CNS_CONTROLLER,
+    };
+    uint16_t status = nvme_admin_sync(&sqe);
+    if (status != NVME_CQE_STATUS_SUCCESS) {
+        LOG_DRIVER_ERR("identify controller failed with status 0x%x\n", status);
+        assert(false);
+    }
+
+    uint8_t *id_ctrl = identify_vaddr;
+    blk_storage_info_t *storage_info = config.virt.storage_info.vaddr;
+    sddf_memset(storage_info->serial_number, 0, BLK_MAX_SERIAL_NUMBER + 1);
+    sddf_memcpy(storage_info->serial_number, &id_ctrl[NVME_ID_CTRL_SN_OFFSET], NVME_ID_CTRL_SN_LEN);
+    /* The serial number is padded with spaces */
+    for (int i = NVME_ID_CTRL_SN_LEN - 1; i >= 0 && storage_info->serial_number[i] == ' '; i--) {
+        storage_info->serial_number[i] = '\0';
+    }
+
+    /* MDTS is a power of two in units of the minimum page size, 0 means no limit. */
+    uint8_t mdts = id_ctrl[NVME_ID_CTRL_MDTS_OFFSET];
+    uint64_t max_pages = NVME_MAX_TRANSFER_PAGES;
+    if (mdts != 0 && (1ULL << mdts) < max_pages) {
+        max_pages = 1ULL << mdts;
+    }
+    max_transfer_blocks = max_pages * NVME_PAGE_SIZE / BLK_TRANSFER_SIZE;
+
+    uint32_t nn = *(uint32_t *)&id_ctrl[NVME_ID_CTRL_NN_OFFSET];
+    if (nn < NVME_NAMESPACE_ID) {
+        LOG_DRIVER_ERR("controller has no namespaces\n");
+        assert(false);
+    }
+
+    sqe = (nvme_sqe_t) {
+        .opcode = NVME_ADMIN_IDENTIFY,
+        .nsid = NVME_NAMESPACE_ID,
+        .prp1 = identify_paddr,
+        .cdw10 = NVME_IDENTIFY_CNS_NAMESPACE,
+    };
+    status = nvme_admin_sync(&sqe);
+    if (status != NVME_CQE_STATUS_SUCCESS) {
+        LOG_DRIVER_ERR("identify namespace failed with status 0x%x\n", status);
+        assert(false);
+    }
+
+    nvme_id_ns_t *id_ns = identify_vaddr;
+    lba_shift = NVME_LBAF_LBADS(id_ns->lbaf[NVME_FLBAS_INDEX(id_ns->flbas)]);
+    if (lba_shift < 9 || lba_shift > NVME_PAGE_SHIFT) {
+        LOG_DRIVER_ERR("unsupported LBA size of 2^%u bytes\n", lba_shift);
+        assert(false);
+    }
+    lbas_per_transfer = BLK_TRANSFER_SIZE >> lba_shift;
+
+    storage_info->sector_size = 1 << lba_shift;
+    storage_info->capacity = (id_ns->nsze << lba_shift) / BLK_TRANSFER_SIZE;
+    storage_info->read_only = false;
+    storage_info->block_size = 1;
+    if ((id_ns->nsfeat & NVME_NSFEAT_OPTPERF) && id_ns->npwg != 0) {
+        /* NPWG is a 0's based value in logical blocks */
+        uint64_t npwg_bytes = ((uint64_t)id_ns->npwg + 1) << lba_shift;
+        if (npwg_bytes > BLK_TRANSFER_SIZE) {
+            storage_info->block_size = npwg_bytes / BLK_TRANSFER_SIZE;
+        }
+    }
+}
+
+static void nvme_create_io_queues(uintptr_t queues_vaddr, uintptr_t queues_paddr, uint64_t offset, uint64_t size)
+{
+    nvme_sqe_t sqe = {
+        .opcode = NVME_ADMIN_SET_FEATURES,
+        .cdw10 = NVME_FEATURE_NUM_QUEUES,
+        .cdw11 = ((NVME_NUM_IO_QUEUES - 1) << 16) | (NVME_NUM_IO_QUEUES - 1),
+    };
+    uint16_t status = nvme_admin_sync(&sqe);
+    if (status != NVME_CQE_STATUS_SUCCESS) {
+        LOG_DRIVER_ERR("failed to set number of queues, status 0x%x\n", status);
+        assert(false);
+    }
+
+    uint64_t sq_size = ALIGN(io_queue_depth * sizeof(nvme_sqe_t), NVME_PAGE_SIZE);
+    uint64_t cq_size = ALIGN(io_queue_depth * sizeof(nvme_cqe_t), NVME_PAGE_SIZE);
+    if (offset + NVME_NUM_IO_QUEUES * (sq_size + cq_size) > size) {
+        LOG_DRIVER_ERR("queue region of size 0x%lx is too small for %d queues of depth %u\n", size,
+                       NVME_NUM_IO_QUEUES, io_queue_depth);
+        assert(false);
+    }
+
+    for (uint16_t i = 0; i < NVME_NUM_IO_QUEUES; i++) {
+        uint16_t qid = i + 1;
+        uint64_t sq_off = offset;
+        uint64_t cq_off = offset + sq_size;
+        offset += sq_size + cq_size;
+
+        nvme_queue_init(&io_queues[i], qid, io_queue_depth, (void *)(queues_vaddr + sq_off),
+                        (void *)(queues_vaddr + cq_off));
+
+        /* The completion queue must exist before the submission queue that uses it */
+        sqe = (nvme_sqe_t) {
+            .opcode = NVME_ADMIN_CREATE_IO_CQ,
+            .prp1 = queues_paddr + cq_off,
+            .cdw10 = ((uint32_t)(io_queue_depth - 1) << 16) | qid,
+            /* All completion queues share interrupt vector 0, which is INTx */
+            .cdw11 = NVME_CQ_IRQ_ENABLED | NVME_QUEUE_PHYS_CONTIG,
+        };
+        status = nvme_admin_sync(&sqe);
+        if (status != NVME_CQE_STATUS_SUCCESS) {
+            LOG_DRIVER_ERR("failed to create I/O completion queue %u, status 0x%x\n", qid, status);
+            assert(false);
+        }
+
+        sqe = (nvme_sqe_t) {
+            .opcode = NVME_ADMIN_CREATE_IO_SQ,
+            .prp1 = queues_paddr + sq_off,
+            .cdw10 = ((uint32_t)(io_queue_depth - 1) << 16) | qid,
+            .cdw11 = ((uint32_t)qid << 16) | NVME_QUEUE_PHYS_CONTIG,
+        };
+        status = nvme_admin_sync(&sqe);
+        if (status != NVME_CQE_STATUS_SUCCESS) {
+            LOG_DRIVER_ERR("failed to create I/O submission queue %u, status 0x%x\n", qid, status);
+            assert(false);
+        }
+    }
+}
+
+static void nvme_init(void)
+{
+    uintptr_t queues_vaddr = (uintptr_t)device_resources.regions[REGION_QUEUES].region.vaddr;
+    uintptr_t queues_paddr = device_resources.regions[REGION_QUEUES].io_addr;
+    uint64_t queues_size = device_resources.regions[REGION_QUEUES].region.size;
+
+    uint64_t cap = regs->cap;
+    LOG_DRIVER("CAP: 0x%lx, VS: 0x%x\n", cap, regs->vs);
+
+    if (!NVME_CAP_CSS_NVM(cap)) {
+        LOG_DRIVER_ERR("controller does not support the NVM command set\n");
+        assert(false);
+    }
+    if (NVME_CAP_MPSMIN(cap) != 0) {
+        LOG_DRIVER_ERR("controller does not support 4KiB pages\n");
+        assert(false);
+    }
+
+    doorbell_stride = 4 << NVME_CAP_DSTRD(cap);
+    io_queue_depth = MIN(NVME_IO_QUEUE_DEPTH, NVME_CAP_MQES(cap) + 1);
+
+    /* [NVMe-Base] 3.5.1 Memory-based Controller Initialization */
+    if (regs->cc & NVME_CC_EN) {
+        regs->cc &= ~NVME_CC_EN;
+    }
+    if (!nvme_wait_ready(false)) {
+        assert(false);
+    }
+
+    /* Queue region layout: admin SQ, admin CQ, identify page, then the I/O queue pairs */
+    uint64_t asq_off = 0;
+    uint64_t acq_off = asq_off + NVME_PAGE_SIZE;
+    uint64_t identify_off = acq_off + NVME_PAGE_SIZE;
+    uint64_t io_off = identify_off + NVME_PAGE_SIZE;
+    assert(NVME_ADMIN_QUEUE_DEPTH * sizeof(nvme_sqe_t) <= NVME_PAGE_SIZE);
+    assert(io_off <= queues_size);
+
+    identify_vaddr = (void *)(queues_vaddr + identify_off);
+    identify_paddr = queues_paddr + identify_off;
+
+    nvme_queue_init(&admin_queue, 0, NVME_ADMIN_QUEUE_DEPTH, (void *)(queues_vaddr + asq_off),
+                    (void *)(queues_vaddr + acq_off));
+
+    regs->aqa = ((NVME_ADMIN_QUEUE_DEPTH - 1) << NVME_AQA_ACQS_SHIFT) | (NVME_ADMIN_QUEUE_DEPTH - 1);
+    regs->asq = queues_paddr + asq_off;
+    regs->acq = queues_paddr + acq_off;
+
+    /* Mask the interrupt while we poll for admin completions */
+    regs->intms = 1;
+
+    regs->cc = NVME_CC_CSS_NVM | (0 << NVME_CC_MPS_SHIFT) | NVME_CC_AMS_RR | (NVME_SQE_SIZE_SHIFT << NVME_CC_IOSQES_SHIFT)
+             | (NVME_CQE_SIZE_SHIFT << NVME_CC_IOCQES_SHIFT);
+    regs->cc |= NVME_CC_EN;
+    if (!nvme_wait_ready(true)) {
+        assert(false);
+    }
+
+    nvme_identify();
+    nvme_create_io_queues(queues_vaddr, queues_paddr, io_off, queues_size);
+
+    regs->intmc = 1;
+}
+
+static void nvme_request_complete(uint32_t req_idx)
+{
+    nvme_request_t *req = &requests[req_idx];
+    uint16_t success_count = (req->status == BLK_RESP_OK) ? req->count : 0;
+    int err = blk_enqueue_resp(&blk_queue, req->status, success_count, req->id);
+    assert(!err);
+    LOG_DRIVER("response: status=%d, success_count=%u, id=%u\n", req->status, success_count, req->id);
+
+    err = ialloc_free(&request_ialloc, req_idx);
+    assert(!err);
+    virt_notify = true;
+}
+
+/*
+ * Submit as much of the pending request as we have command slots for.
+ * Returns true if the request has been fully submitted.
+ */
+static bool nvme_request_submit(uint32_t req_idx)
+{
+    nvme_request_t *req = &requests[req_idx];
+
+    if (req->code == BLK_REQ_BARRIER) {
+        /* NVMe does not order commands, so a barrier waits for everything
+         * before it to complete before anything after it is submitted. */
+        if (inflight_commands != 0) {
+            return false;
+        }
+        req->status = BLK_RESP_OK;
+        nvme_request_complete(req_idx);
+        return true;
+    }
+
+    if (req->code == BLK_REQ_FLUSH) {
+        uint32_t cid;
+        if (ialloc_alloc(&command_ialloc, &cid)) {
+            return false;
+        }
+        nvme_sqe_t sqe = {
+            .opcode = NVME_IO_FLUSH,
+            .cid = cid,
+            .nsid = NVME_NAMESPACE_ID,
+        };
+        command_to_request[cid] = req_idx;
+        nvme_queue_submit(&io_queues[cid % NVME_NUM_IO_QUEUES], &sqe);
+        inflight_commands++;
+        req->outstanding++;
+        req->remaining = 0;
+        return true;
+    }
+
+    while (req->remaining > 0) {
+        uint32_t cid;
+        if (ialloc_alloc(&command_ialloc, &cid)) {
+            return false;
+        }
+
+        uint16_t blocks = MIN(req->remaining, max_transfer_blocks);
+        uint64_t done = req->count - req->remaining;
+        uintptr_t paddr = req->paddr + done * BLK_TRANSFER_SIZE;
+        uint64_t slba = (req->block_number + done) * lbas_per_transfer;
+        uint64_t nlb = blocks * lbas_per_transfer;
+
+        /* [NVMe-Base] 4.1.1 Physical Region Page Entry and List. sDDF buffers are page aligned,
+         * so PRP1 is the first page and PRP2 is either the second page or a list of the rest. */
+        uint64_t npages = (uint64_t)blocks * BLK_TRANSFER_SIZE / NVME_PAGE_SIZE;
+        uint64_t prp2 = 0;
+        if (npages == 2) {
+            prp2 = paddr + NVME_PAGE_SIZE;
+        } else if (npages > 2) {
+            uint64_t *prp_list = (uint64_t *)(prp_lists_vaddr + (uintptr_t)cid * NVME_PAGE_SIZE);
+            for (uint64_t i = 1; i < npages; i++) {
+                prp_list[i - 1] = paddr + i * NVME_PAGE_SIZE;
+            }
+            prp2 = prp_lists_paddr + (uintptr_t)cid * NVME_PAGE_SIZE;
+        }
+
+        nvme_sqe_t sqe = {
+            .opcode = (req->code == BLK_REQ_READ) ? NVME_IO_READ : NVME_IO_WRITE,
+            .cid = cid,
+            .nsid = NVME_NAMESPACE_ID,
+            .prp1 = paddr,
+            .prp2 = prp2,
+            .cdw10 = (uint32_t)slba,
+            .cdw11 = (uint32_t)(slba >> 32),
+            .cdw12 = (uint32_t)(nlb - 1),
+        };
+
+        command_to_request[cid] = req_idx;
+        nvme_queue_submit(&io_queues[cid % NVME_NUM_IO_QUEUES], &sqe);
+        inflight_commands++;
+        req->outstanding++;
+        req->remaining -= blocks;
+    }
+
+    return true;
+}
+
+static void handle_request(void)
+{
+    while (true) {
+        if (!pending.active) {
+            if (blk_queue_empty_req(&blk_queue) || ialloc_full(&request_ialloc)) {
+                break;
+            }
+
+            uint32_t req_idx;
+            int err = ialloc_alloc(&request_ialloc, &req_idx);
+            assert(!err);
+
+            nvme_request_t *req = &requests[req_idx];
+            err = blk_dequeue_req(&blk_queue, &req->code, &req->paddr, &req->block_number, &req->count, &req->id);
+            assert(!err);
+            LOG_DRIVER("request: code=%d, paddr=0x%lx, block_number=%lu, count=%u, id=%u\n", req->code, req->paddr,
+                       req->block_number, req->count, req->id);
+
+            req->remaining = req->count;
+            req->outstanding = 0;
+            req->status = BLK_RESP_OK;
+
+            switch (req->code) {
+            case BLK_REQ_READ:
+            case BLK_REQ_WRITE:
+                /* It is the responsibility of the virtualiser to check that the request is valid */
+                assert(req->count != 0);
+                assert(req->paddr % NVME_PAGE_SIZE == 0);
+                break;
+            case BLK_REQ_FLUSH:
+            case BLK_REQ_BARRIER:
+                break;
+            default:
+                LOG_DRIVER_ERR("unsupported request code: 0x%x\n", req->code);
+                req->status = BLK_RESP_ERR_INVALID_PARAM;
+                nvme_request_complete(req_idx);
+                continue;
+            }
+
+            pending.active = true;
+            pending.req_idx = req_idx;
+        }
+
+        if (!nvme_request_submit(pending.req_idx)) {
+            /* Out of command slots, or waiting on a barrier. Continue once commands complete. */
+            break;
+        }
+        pending.active = false;
+    }
+
+    for (int i = 0; i < NVME_NUM_IO_QUEUES; i++) {
+        nvme_queue_ring(&io_queues[i]);
+    }
+}
+
+static void handle_completions(void)
+{
+    for (int i = 0; i < NVME_NUM_IO_QUEUES; i++) {
+        nvme_queue_t *q = &io_queues[i];
+        uint16_t head = q->cq_head;
+
+        nvme_cqe_t cqe;
+        while (nvme_queue_completion(q, &cqe)) {
+            assert(cqe.cid < NVME_MAX_COMMANDS);
+            uint32_t req_idx = command_to_request[cqe.cid];
+            nvme_request_t *req = &requests[req_idx];
+
+            uint16_t status = NVME_CQE_STATUS(cqe.status);
+            if (status != NVME_CQE_STATUS_SUCCESS) {
+                LOG_DRIVER_ERR("command %u for request %u failed with status 0x%x\n", cqe.cid, req->id, status);
+                req->status = BLK_RESP_ERR_IO;
+            }
+
+            int err = ialloc_free(&command_ialloc, cqe.cid);
+            assert(!err);
+            inflight_commands--;
+
+            assert(req->outstanding > 0);
+            req->outstanding--;
+            if (req->outstanding == 0 && req->remaining == 0) {
+                nvme_request_complete(req_idx);
+            }
+        }
+
+        if (q->cq_head != head) {
+            *q->cq_head_db = q->cq_head;
+        }
+    }
+}
+
+void init(void)
+{
+    assert(blk_config_check_magic(&config));
+    assert(device_resources_check_magic(&device_resources));
+    assert(device_resources.num_irqs == 1);
+    assert(device_resources.num_regions == 4);
+
+    prp_lists_vaddr = (uintptr_t)device_resources.regions[REGION_PRP_LISTS].region.vaddr;
+    prp_lists_paddr = device_resources.regions[REGION_PRP_LISTS].io_addr;
+    assert(device_resources.regions[REGION_PRP_LISTS].region.size >= (uint64_t)NVME_MAX_COMMANDS * NVME_PAGE_SIZE);
+
+    blk_queue_init(&blk_queue, config.virt.req_queue.vaddr, config.virt.resp_queue.vaddr, config.virt.num_buffers);
+
+    nvme_pci_init();
+    boot_trace_begin("nvme init");
+    nvme_init();
+    boot_trace_end("nvme init");
+
+    /* Command identifiers are assigned to I/O queues round-robin (cid % NVME_NUM_IO_QUEUES),
+     * so limiting the number of identifiers guarantees no submission queue overflows. */
+    ialloc_init(&request_ialloc, request_idxlist, NVME_MAX_REQUESTS);
+    ialloc_init(&command_ialloc, command_idxlist, NVME_NUM_IO_QUEUES * (io_queue_depth - 1));
+
+    blk_storage_info_t *storage_info = config.virt.storage_info.vaddr;
+    storage_info->queue_depth = NVME_NUM_IO_QUEUES * (io_queue_depth - 1);
+    LOG_DRIVER("capacity: 0x%lx blocks, sector size: %u, max transfer: %u blocks, queue depth: %u\n",
+               storage_info->capacity, storage_info->sector_size, max_transfer_blocks, storage_info->queue_depth);
+
+    /* Finished populating configuration, the virtualiser waits for this notification before using the device */
+    __atomic_store_n(&storage_info->ready, true, __ATOMIC_RELEASE);
+    microkit_notify(config.virt.id);
+}
+
+void notified(microkit_channel ch)
+{
+    if (ch == device_resources.irqs[0].id) {
+        handle_completions();
+        microkit_deferred_irq_ack(ch);
+        /* Completions free up command slots, so try submitting anything left over */
+        handle_request();
+    } else if (ch == config.virt.id) {
+        handle_request();
+        /* Opportunistically poll for completions to avoid waiting on the interrupt */
+        handle_completions();
+        handle_request();
+    } else {
+        LOG_DRIVER_ERR("received notification from unknown channel: 0x%x\n", ch);
+    }
+
+    if (virt_notify) {
+        microkit_notify(config.virt.id);
+        virt_notify = false;
+    }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sddf/util/util.h>
+#include <sddf/util/printf.h>
+
+/* The driver is based on:
+
+    [NVMe-Base]: NVM Express Base Specification, Revision 2.0c, October 2022.
+                 https://nvmexpress.org/specifications/
+    [NVMe-NVM]:  NVM Express NVM Command Set Specification, Revision 1.0c, October 2022.
+                 https://nvmexpress.org/specifications/
+*/
+
+// #define DEBUG_DRIVER
+
+#ifdef DEBUG_DRIVER
+#define LOG_DRIVER(...) do{ sddf_dprintf("NVME DRIVER|INFO: "); sddf_dprintf(__VA_ARGS__); }while(0)
+#else
+#define LOG_DRIVER(...) do{}while(0)
+#endif
+
+#define LOG_DRIVER_ERR(...) do{ sddf_printf("NVME DRIVER|ERROR: "); sddf_printf(__VA_ARGS__); }while(0)
+
+/* The driver always uses 4KiB memory pages, same as BLK_TRANSFER_SIZE */
+#define NVME_PAGE_SIZE 0x1000
+#define NVME_PAGE_SHIFT 12
+
+/* [NVMe-Base] 3.1.4 Controller Properties */
+typedef volatile struct nvme_regs {
+    uint64_t cap;     /* Controller Capabilities          (RO) */
+    uint32_t vs;      /* Version                          (RO) */
+    uint32_t intms;   /* Interrupt Mask Set               (RW1S) */
+    uint32_t intmc;   /* Interrupt Mask Clear             (RW1C) */
+    uint32_t cc;      /* Controller Configuration         (RW) */
+    uint32_t _reserved0;
+    uint32_t csts;    /* Controller Status                (RO) */
+    uint32_t nssr;    /* NVM Subsystem Reset              (RW) */
+    uint32_t aqa;     /* Admin Queue Attributes           (RW) */
+    uint64_t asq;     /* Admin Submission Queue Base      (RW) */
+    uint64_t acq;     /* Admin Completion Queue Base      (RW) */
+} nvme_regs_t;
+
+/* Doorbells start at this offset from the controller registers */
+#define NVME_DOORBELL_OFFSET 0x1000
+
+#define NVME_CAP_MQES(cap) ((cap) & 0xffff)
+#define NVME_CAP_TO(cap) (((cap) >> 24) & 0xff)
+#define NVME_CAP_DSTRD(cap) (((cap) >> 32) & 0xf)
+#define NVME_CAP_CSS_NVM(cap) (((cap) >> 37) & 0x1)
+#define NVME_CAP_MPSMIN(cap) (((cap) >> 48) & 0xf)
+#define NVME_CAP_MPSMAX(cap) (((cap) >> 52) & 0xf)
+
+#define NVME_CC_EN BIT(0)
+#define NVME_CC_CSS_NVM (0 << 4)
+#define NVME_CC_MPS_SHIFT 7
+#define NVME_CC_AMS_RR (0 << 11)
+#define NVME_CC_SHN_NORMAL (1 << 14)
+#define NVME_CC_IOSQES_SHIFT 16
+#define NVME_CC_IOCQES_SHIFT 20
+
+#define NVME_CSTS_RDY BIT(0)
+#define NVME_CSTS_CFS BIT(1)
+
+#define NVME_AQA_ACQS_SHIFT 16
+
+/* [NVMe-Base] 4.2 Submission Queue Entry */
+typedef struct nvme_sqe {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t cid;
+    uint32_t nsid;
+    uint32_t cdw2;
+    uint32_t cdw3;
+    uint64_t mptr;
+    uint64_t prp1;
+    uint64_t prp2;
+    uint32_t cdw10;
+    uint32_t cdw11;
+    uint32_t cdw12;
+    uint32_t cdw13;
+    uint32_t cdw14;
+    uint32_t cdw15;
+} nvme_sqe_t;
+_Static_assert(sizeof(nvme_sqe_t) == 64, "NVMe submission queue entries must be 64 bytes");
+
+/* [NVMe-Base] 4.6 Completion Queue Entry */
+typedef struct nvme_cqe {
+    uint32_t dw0;
+    uint32_t dw1;
+    uint16_t sq_head;
+    uint16_t sq_id;
+    uint16_t cid;
+    /* Bit 0 is the phase tag, bits 15:1 are the status field */
+    uint16_t status;
+} nvme_cqe_t;
+_Static_assert(sizeof(nvme_cqe_t) == 16, "NVMe completion queue entries must be 16 bytes");
+
+/* log2 of the entry sizes, as programmed into CC.IOSQES and CC.IOCQES */
+#define NVME_SQE_SIZE_SHIFT 6
+#define NVME_CQE_SIZE_SHIFT 4
+
+#define NVME_CQE_PHASE BIT(0)
+#define NVME_CQE_STATUS(status) ((status) >> 1)
+#define NVME_CQE_STATUS_SUCCESS 0
+
+/* [NVMe-Base] 5 Admin Command Set */
+#define NVME_ADMIN_DELETE_IO_SQ 0x00
+#define NVME_ADMIN_CREATE_IO_SQ 0x01
+#define NVME_ADMIN_DELETE_IO_CQ 0x04
+#define NVME_ADMIN_CREATE_IO_CQ 0x05
+#define NVME_ADMIN_IDENTIFY 0x06
+#define NVME_ADMIN_SET_FEATURES 0x09
+
+/* [NVMe-NVM] 3 I/O Commands for the NVM Command Set */
+#define NVME_IO_FLUSH 0x00
+#define NVME_IO_WRITE 0x01
+#define NVME_IO_READ 0x02
+
+#define NVME_QUEUE_PHYS_CONTIG BIT(0)
+#define NVME_CQ_IRQ_ENABLED BIT(1)
+
+#define NVME_IDENTIFY_CNS_NAMESPACE 0x00
+#define NVME_IDENTIFY_CNS_CONTROLLER 0x01
+
+#define NVME_FEATURE_NUM_QUEUES 0x07
+
+/* [NVMe-Base] 5.17.2.1 Identify Controller Data Structure, only the fields we use */
+#define NVME_ID_CTRL_SN_OFFSET 4
+#define NVME_ID_CTRL_SN_LEN 20
+#define NVME_ID_CTRL_MDTS_OFFSET 77
+#define NVME_ID_CTRL_NN_OFFSET 516
+
+/* [NVMe-NVM] 4.1.5.1 Identify Namespace Data Structure, only the fields we use */
+typedef struct nvme_id_ns {
+    uint64_t nsze;
+    uint64_t ncap;
+    uint64_t nuse;
+    uint8_t nsfeat;
+    uint8_t nlbaf;
+    uint8_t flbas;
+    uint8_t _reserved0[37];
+    uint16_t npwg;
+    uint16_t npwa;
+    uint8_t _reserved1[60];
+    uint32_t lbaf[64];
+} nvme_id_ns_t;
+_Static_assert(sizeof(nvme_id_ns_t) <= NVME_PAGE_SIZE, "identify namespace data must fit in a page");
+
+#define NVME_NSFEAT_OPTPERF BIT(4)
+#define NVME_FLBAS_INDEX(flbas) ((flbas) & 0xf)
+#define NVME_LBAF_LBADS(lbaf) (((lbaf) >> 16) & 0xff)
+
+/* The namespace this driver exposes */
+#define NVME_NAMESPACE_ID 1
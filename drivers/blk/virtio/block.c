@@ -5,7 +5,7 @@
 
 /*
  * This driver follows the non-legacy virtIO 1.2 specification for the block device.
- * It assumes that the transport method is MMIO.
+ * It supports both the MMIO and PCI transport methods, see sddf/virtio/transport.h.
  * This driver is very minimal and was written for the goal of building systems that
  * use virtIO block devices in a simulator like QEMU. It is *not* written with
  * performance in mind.
@@ -17,9 +17,11 @@
 
 #include <microkit.h>
 #include <sddf/util/util.h>
+#include <sddf/util/boot_trace.h>
 #include <sddf/util/ialloc.h>
 #include <sddf/virtio/virtio.h>
 #include <sddf/virtio/virtio_queue.h>
+#include <sddf/virtio/transport.h>
 #include <sddf/blk/queue.h>
 #include <sddf/blk/config.h>
 #include <sddf/blk/storage_info.h>
@@ -29,10 +31,13 @@
 #define QUEUE_SIZE 1024
 #define VIRTQ_NUM_REQUESTS QUEUE_SIZE
 
+/* When using the PCI transport, region 0 is the ECAM window and the BAR is placed here */
+#define PCI_BAR_REGION 3
+
 uintptr_t requests_paddr;
 uintptr_t requests_vaddr;
 
-static volatile virtio_mmio_regs_t *regs;
+static virtio_transport_t transport;
 
 static volatile struct virtq virtq;
 static blk_queue_handle_t blk_queue;
@@ -99,11 +104,8 @@ void handle_response(void)
         assert(!err);
 
         /* Free up the descriptors we used */
-        err = ialloc_free(&ialloc_desc, hdr_used.id);
-        assert(!err);
-        err = ialloc_free(&ialloc_desc, data_desc_idx);
-        assert(!err);
-        err = ialloc_free(&ialloc_desc, footer_desc_idx);
+        uint32_t desc_idxs[3] = { hdr_used.id, data_desc_idx, footer_desc_idx };
+        err = ialloc_free_n(&ialloc_desc, desc_idxs, 3);
         assert(!err);
 
         i += 1;
@@ -173,17 +175,12 @@ void handle_request()
                            phys_addr, block_number, count, id);
             }
 
-            uint32_t hdr_desc_idx = -1;
-            uint32_t data_desc_idx = -1;
-            uint32_t footer_desc_idx = -1;
-
-            int err;
-            err = ialloc_alloc(&ialloc_desc, &hdr_desc_idx);
-            assert(!err && hdr_desc_idx != -1);
-            err = ialloc_alloc(&ialloc_desc, &data_desc_idx);
-            assert(!err && data_desc_idx != -1);
-            err = ialloc_alloc(&ialloc_desc, &footer_desc_idx);
-            assert(!err && footer_desc_idx != -1);
+            uint32_t desc_idxs[3];
+            int err = ialloc_alloc_n(&ialloc_desc, desc_idxs, 3);
+            assert(!err);
+            uint32_t hdr_desc_idx = desc_idxs[0];
+            uint32_t data_desc_idx = desc_idxs[1];
+            uint32_t footer_desc_idx = desc_idxs[2];
 
             uint16_t data_flags = VIRTQ_DESC_F_NEXT;
             uint16_t type;
@@ -247,56 +244,36 @@ void handle_request()
     }
 
     if (virtio_queue_notify) {
-        regs->QueueNotify = 0;
+        virtio_transport_queue_notify(&transport, 0);
     }
 }
 
 void handle_irq(void)
 {
-    uint32_t irq_status = regs->InterruptStatus;
-    if (irq_status & VIRTIO_MMIO_IRQ_VQUEUE) {
+    uint32_t irq_status = virtio_transport_irq_status(&transport);
+    if (irq_status & VIRTIO_IRQ_VQUEUE) {
         handle_response();
-        regs->InterruptACK = VIRTIO_MMIO_IRQ_VQUEUE;
+        virtio_transport_irq_ack(&transport, VIRTIO_IRQ_VQUEUE);
     }
 
-    if (irq_status & VIRTIO_MMIO_IRQ_CONFIG) {
+    if (irq_status & VIRTIO_IRQ_CONFIG) {
         LOG_DRIVER_ERR("unexpected change in configuration\n");
     }
 }
 
 void virtio_blk_init(void)
 {
-    // Do MMIO device init (section 4.2.3.1)
-    if (!virtio_mmio_check_magic(regs)) {
-        LOG_DRIVER_ERR("invalid virtIO magic value!\n");
+    if (virtio_transport_init(&transport, &device_resources, PCI_BAR_REGION, VIRTIO_DEVICE_ID_BLK)) {
+        LOG_DRIVER_ERR("could not find virtIO block device!\n");
         assert(false);
     }
 
-    if (virtio_mmio_version(regs) != VIRTIO_VERSION) {
-        LOG_DRIVER_ERR("not correct virtIO version!\n");
-        assert(false);
-    }
+    ialloc_init_lifo(&ialloc_desc, descriptors, QUEUE_SIZE);
 
-    if (!virtio_mmio_check_device_id(regs, VIRTIO_DEVICE_ID_BLK)) {
-        LOG_DRIVER_ERR("not a virtIO block device!\n");
-        assert(false);
-    }
-
-    if (virtio_mmio_version(regs) != VIRTIO_BLK_DRIVER_VERSION) {
-        LOG_DRIVER_ERR("driver does not support given virtIO version: 0x%x\n", virtio_mmio_version(regs));
-        assert(false);
-    }
+    /* Reset the device, then set the ACKNOWLEDGE and DRIVER status bits */
+    virtio_transport_reset(&transport);
 
-    ialloc_init(&ialloc_desc, descriptors, QUEUE_SIZE);
-
-    /* First reset the device */
-    regs->Status = 0;
-    /* Set the ACKNOWLEDGE bit to say we have noticed the device */
-    regs->Status = VIRTIO_DEVICE_STATUS_ACKNOWLEDGE;
-    /* Set the DRIVER bit to say we know how to drive the device */
-    regs->Status = VIRTIO_DEVICE_STATUS_DRIVER;
-
-    virtio_config = (volatile struct virtio_blk_config *)regs->Config;
+    virtio_config = (volatile struct virtio_blk_config *)virtio_transport_config(&transport);
 #ifdef DEBUG_DRIVER
     virtio_blk_print_config(virtio_config);
 #endif
@@ -318,23 +295,18 @@ void virtio_blk_init(void)
     storage_info->block_size = 1;
     storage_info->sector_size = VIRTIO_BLK_SECTOR_SIZE;
 
-    /* Finished populating configuration */
+    /* Finished populating configuration, the virtualiser waits for this notification before using the device */
     __atomic_store_n(&storage_info->ready, true, __ATOMIC_RELEASE);
+    microkit_notify(config.virt.id);
 
 #ifdef DEBUG_DRIVER
-    uint32_t features_low = regs->DeviceFeatures;
-    regs->DeviceFeaturesSel = 1;
-    uint32_t features_high = regs->DeviceFeatures;
-    uint64_t features = features_low | ((uint64_t)features_high << 32);
-    virtio_blk_print_features(features);
+    virtio_blk_print_features(virtio_transport_device_features(&transport));
 #endif
-    /* Select features we want from the device */
-    regs->DriverFeatures = 0;
-    regs->DriverFeaturesSel = 1;
-    regs->DriverFeatures = 0;
-
-    regs->Status |= VIRTIO_DEVICE_STATUS_FEATURES_OK;
-    if (!(regs->Status & VIRTIO_DEVICE_STATUS_FEATURES_OK)) {
+    /*
+     * Select features we want from the device. VIRTIO_F_VERSION_1 is required
+     * by the PCI transport to use the non-legacy interface.
+     */
+    if (virtio_transport_set_driver_features(&transport, BIT(VIRTIO_F_VERSION_1))) {
         LOG_DRIVER_ERR("device status features is not OK!\n");
         return;
     }
@@ -354,20 +326,13 @@ void virtio_blk_init(void)
     virtq.avail = (struct virtq_avail *)(requests_vaddr + avail_off);
     virtq.used = (struct virtq_used *)(requests_vaddr + used_off);
 
-    assert(regs->QueueNumMax >= VIRTQ_NUM_REQUESTS);
-    regs->QueueSel = 0;
-    regs->QueueNum = VIRTQ_NUM_REQUESTS;
-    regs->QueueDescLow = (requests_paddr + desc_off) & 0xFFFFFFFF;
-    regs->QueueDescHigh = (requests_paddr + desc_off) >> 32;
-    regs->QueueDriverLow = (requests_paddr + avail_off) & 0xFFFFFFFF;
-    regs->QueueDriverHigh = (requests_paddr + avail_off) >> 32;
-    regs->QueueDeviceLow = (requests_paddr + used_off) & 0xFFFFFFFF;
-    regs->QueueDeviceHigh = (requests_paddr + used_off) >> 32;
-    regs->QueueReady = 1;
+    int err = virtio_transport_queue_setup(&transport, 0, VIRTQ_NUM_REQUESTS, requests_paddr + desc_off,
+                                           requests_paddr + avail_off, requests_paddr + used_off, VIRTIO_MSI_NO_VECTOR);
+    assert(!err);
 
     /* Finish initialisation */
-    regs->Status |= VIRTIO_DEVICE_STATUS_DRIVER_OK;
-    regs->InterruptACK = VIRTIO_MMIO_IRQ_VQUEUE;
+    virtio_transport_driver_ok(&transport);
+    virtio_transport_irq_ack(&transport, VIRTIO_IRQ_VQUEUE);
 }
 
 void init(void)
@@ -375,9 +340,9 @@ void init(void)
     assert(blk_config_check_magic(&config));
     assert(device_resources_check_magic(&device_resources));
     assert(device_resources.num_irqs == 1);
-    assert(device_resources.num_regions == 3);
+    /* The PCI transport has an extra region for the BAR */
+    assert(device_resources.num_regions == 3 || device_resources.num_regions == PCI_BAR_REGION + 1);
 
-    regs = (volatile virtio_mmio_regs_t *)device_resources.regions[0].region.vaddr;
     requests_paddr = device_resources.regions[2].io_addr;
     requests_vaddr = (uintptr_t)device_resources.regions[2].region.vaddr;
     virtio_headers_paddr = (uintptr_t)device_resources.regions[1].io_addr;
@@ -388,7 +353,9 @@ void init(void)
     assert(requests_paddr);
     assert(requests_vaddr);
 
+    boot_trace_begin("virtio init");
     virtio_blk_init();
+    boot_trace_end("virtio init");
 
     blk_queue_init(&blk_queue, config.virt.req_queue.vaddr, config.virt.resp_queue.vaddr, config.virt.num_buffers);
 }
@@ -5,8 +5,13 @@
 
 /*
  * This driver follows the non-legacy virtIO 1.2 specification for the gpu device.
- * It assumes that the transport method is MMIO.
- * This driver implements unaccelerated 2D commands in the control queue.
+ * It supports both the MMIO and PCI transport methods, see sddf/virtio/transport.h.
+ * This driver implements unaccelerated 2D commands in the control queue, and cursor
+ * commands in the cursor queue.
+ *
+ * All pending sDDF requests are turned into descriptor chains before any of them are
+ * made available to the device, so that a batch of requests costs a single queue
+ * notification per virtqueue.
  *
  * It should also be noted that because this driver is intended to be used with a
  * simulator such as QEMU, things like memory fences when touching device registers
@@ -17,9 +22,13 @@
 #include <stdint.h>
 #include <sddf/util/printf.h>
 #include <sddf/util/util.h>
+#include <sddf/util/fence.h>
+#include <sddf/util/timestamp.h>
+#include <sddf/util/boot_trace.h>
 #include <sddf/util/ialloc.h>
 #include <sddf/virtio/virtio.h>
 #include <sddf/virtio/virtio_queue.h>
+#include <sddf/virtio/transport.h>
 #include <sddf/gpu/queue.h>
 #include <sddf/gpu/events.h>
 #include <gpu.h>
@@ -47,6 +56,18 @@
 #define VIRTIO_MMIO_GPU_OFFSET (0xe00)
 #endif
 
+/*
+ * When using the PCI transport, virtio_regs is instead the ECAM window of the
+ * PCI host bridge and the BAR holding the virtIO structures is placed at
+ * virtio_pci_bar.
+ */
+#ifndef VIRTIO_PCI_ECAM_SIZE
+#define VIRTIO_PCI_ECAM_SIZE (0x100000)
+#endif
+#ifndef VIRTIO_PCI_BAR_SIZE
+#define VIRTIO_PCI_BAR_SIZE (0x4000)
+#endif
+
 #define VIRTQ_QUEUE_SIZE GPU_QUEUE_CAPACITY_DRV
 
 /* Size of data contained in a single descriptor */
@@ -60,7 +81,21 @@ _Static_assert((uint64_t)VIRTIO_DATA_ENTRY_SIZE *(uint64_t)VIRTQ_QUEUE_SIZE <= G
 
 #define VIRTIO_DATA_PADDR_TO_VADDR(paddr) ((uintptr_t)(paddr) + virtio_data - virtio_data_paddr)
 
-#define VIRTIO_MAX_DESC_PER_REQ 3
+/* A page flip is two commands of two descriptors each */
+#define VIRTIO_MAX_DESC_PER_REQ 4
+
+/* Number of descriptors in the cursor queue, each cursor command takes one */
+#ifndef VIRTQ_CURSOR_QUEUE_SIZE
+#define VIRTQ_CURSOR_QUEUE_SIZE 64
+#endif
+
+/* Cursor commands are small, so they are placed in the metadata region after the virtqueues */
+#define VIRTIO_CURSOR_ENTRY_SIZE 64
+_Static_assert(sizeof(struct virtio_gpu_update_cursor) <= VIRTIO_CURSOR_ENTRY_SIZE,
+               "A cursor command must fit in VIRTIO_CURSOR_ENTRY_SIZE");
+
+#define VIRTIO_CURSOR_CMD(idx) ((idx) * VIRTIO_CURSOR_ENTRY_SIZE + cursor_cmds)
+#define VIRTIO_CURSOR_CMD_PADDR(idx) ((idx) * VIRTIO_CURSOR_ENTRY_SIZE + cursor_cmds_paddr)
 
 #define BIT_LOW(n)  (1ul<<(n))
 #define BIT_HIGH(n) (1ul<<(n - 32 ))
@@ -76,8 +111,11 @@ gpu_resp_queue_t *gpu_resp_queue;
 gpu_events_t *gpu_events;
 uintptr_t gpu_driver_data;
 uintptr_t gpu_client_data_paddr;
+/* Only set when using the PCI transport */
+uintptr_t virtio_pci_bar;
+uintptr_t virtio_pci_bar_paddr;
 
-static volatile virtio_mmio_regs_t *regs;
+static virtio_transport_t transport;
 static volatile struct virtio_gpu_config
     *virtio_config; /* gpu device configuration, populated by device during initialisation. */
 static struct virtq virtq;
@@ -93,6 +131,11 @@ typedef struct reqbk {
      * imply data written in the data region, which would need to be stored.
      */
     uint64_t mem_offset;
+    /* A page flip is a SET_SCANOUT_BLOB followed by a RESOURCE_FLUSH, of which virtio_code is the latter */
+    bool page_flip;
+    /* Status of the SET_SCANOUT_BLOB of a page flip */
+    gpu_resp_status_t flip_status;
+    uint32_t flip_scanout_id;
 } reqbk_t;
 static reqbk_t reqsbk[GPU_QUEUE_CAPACITY_DRV];
 
@@ -103,6 +146,19 @@ static uint32_t virtio_desc_to_id[VIRTQ_QUEUE_SIZE];
 
 static uint16_t last_handled_used_idx = 0;
 
+/* Fence id of the last batch of commands made available on the control queue */
+static uint64_t last_fence_id = 0;
+
+static struct virtq cursor_virtq;
+static uintptr_t cursor_cmds;
+static uintptr_t cursor_cmds_paddr;
+static ialloc_t ialloc_cursor_desc;
+static uint32_t ialloc_cursor_desc_idxlist[VIRTQ_CURSOR_QUEUE_SIZE];
+/* Mapping from virtIO cursor queue descriptor idx to sDDF id */
+static uint32_t cursor_desc_to_id[VIRTQ_CURSOR_QUEUE_SIZE];
+
+static uint16_t last_handled_cursor_used_idx = 0;
+
 static void virtio_gpu_init();
 static void handle_request();
 static void handle_irq();
@@ -110,13 +166,14 @@ static void handle_irq();
 void init(void)
 {
     LOG_GPU_VIRTIO_DRIVER("Initialising GPU virtio driver!\n");
-    ialloc_init(&ialloc_desc, ialloc_desc_idxlist, VIRTQ_QUEUE_SIZE);
+    ialloc_init_lifo(&ialloc_desc, ialloc_desc_idxlist, VIRTQ_QUEUE_SIZE);
+    ialloc_init_lifo(&ialloc_cursor_desc, ialloc_cursor_desc_idxlist, VIRTQ_CURSOR_QUEUE_SIZE);
 
     gpu_queue_init(&gpu_queue_h, gpu_req_queue, gpu_resp_queue, GPU_QUEUE_CAPACITY_DRV);
 
-    regs = (volatile virtio_mmio_regs_t *)(virtio_regs + VIRTIO_MMIO_GPU_OFFSET);
-    virtio_config = (volatile struct virtio_gpu_config *)regs->Config;
+    boot_trace_begin("virtio init");
     virtio_gpu_init();
+    boot_trace_end("virtio init");
 }
 
 void notified(microkit_channel ch)
@@ -143,34 +200,22 @@ void notified(microkit_channel ch)
 
 static void virtio_gpu_init(void)
 {
-    /* Do MMIO device init (section 4.2.3.1) */
-    if (!virtio_mmio_check_magic(regs)) {
-        LOG_GPU_VIRTIO_DRIVER_ERR("Invalid virtIO magic value!\n");
-        assert(false);
+    int err;
+    if (virtio_pci_bar) {
+        err = virtio_transport_pci_init(&transport, virtio_regs, VIRTIO_PCI_ECAM_SIZE, virtio_pci_bar,
+                                        virtio_pci_bar_paddr, VIRTIO_PCI_BAR_SIZE, VIRTIO_DEVICE_ID_GPU);
+    } else {
+        err = virtio_transport_mmio_init(&transport, virtio_regs + VIRTIO_MMIO_GPU_OFFSET, VIRTIO_DEVICE_ID_GPU);
     }
-
-    if (virtio_mmio_version(regs) != VIRTIO_VERSION) {
-        LOG_GPU_VIRTIO_DRIVER_ERR("Incorrect virtIO version!\n");
+    if (err) {
+        LOG_GPU_VIRTIO_DRIVER_ERR("Could not find virtIO gpu device!\n");
         assert(false);
     }
 
-    if (!virtio_mmio_check_device_id(regs, VIRTIO_DEVICE_ID_GPU)) {
-        LOG_GPU_VIRTIO_DRIVER_ERR("Not a virtIO gpu device!\n");
-        assert(false);
-    }
-
-    if (virtio_mmio_version(regs) != VIRTIO_GPU_DRIVER_VERSION) {
-        LOG_GPU_VIRTIO_DRIVER_ERR("Driver does not support given virtIO version: 0x%x\n", virtio_mmio_version(regs));
-        LOG_GPU_VIRTIO_DRIVER_ERR("Driver supports virtIO version: 0x%x\n", VIRTIO_GPU_DRIVER_VERSION);
-        assert(false);
-    }
+    /* Reset the device, then set the ACKNOWLEDGE and DRIVER status bits */
+    virtio_transport_reset(&transport);
 
-    /* First reset the device */
-    regs->Status = 0;
-    /* Set the ACKNOWLEDGE bit to say we have noticed the device */
-    regs->Status = VIRTIO_DEVICE_STATUS_ACKNOWLEDGE;
-    /* Set the DRIVER bit to say we know how to drive the device */
-    regs->Status = VIRTIO_DEVICE_STATUS_DRIVER;
+    virtio_config = (volatile struct virtio_gpu_config *)virtio_transport_config(&transport);
 
     /* Now we can read configuration space to validate its fields */
     if (virtio_config->num_scanouts == 0) {
@@ -178,14 +223,13 @@ static void virtio_gpu_init(void)
         assert(false);
     }
 
-    uint32_t dev_features_low = regs->DeviceFeatures;
+    uint64_t dev_features = virtio_transport_device_features(&transport);
+    uint32_t dev_features_low = dev_features & 0xFFFFFFFF;
     (void)(dev_features_low); /* Silence unused warnings */
-    regs->DeviceFeaturesSel = 1;
-    uint32_t dev_features_high = regs->DeviceFeatures;
+    uint32_t dev_features_high = dev_features >> 32;
 
 #ifdef DEBUG_GPU_VIRTIO_DRIVER
     LOG_GPU_VIRTIO_DRIVER("Device is offering the following features:\n");
-    uint64_t dev_features = dev_features_low | ((uint64_t)dev_features_high << 32);
     virtio_print_reserved_feature_bits(dev_features);
     virtio_gpu_print_features(dev_features);
 #endif
@@ -210,19 +254,15 @@ static void virtio_gpu_init(void)
     uint32_t drv_features_low = 0;
 #endif
     uint32_t drv_features_high = BIT_HIGH(VIRTIO_F_VERSION_1);
-    regs->DriverFeatures = drv_features_low;
-    regs->DriverFeaturesSel = 1;
-    regs->DriverFeatures = drv_features_high;
+    uint64_t drv_features = drv_features_low | ((uint64_t)drv_features_high << 32);
 
 #ifdef DEBUG_GPU_VIRTIO_DRIVER
-    uint64_t drv_features = drv_features_low | ((uint64_t)drv_features_high << 32);
     LOG_GPU_VIRTIO_DRIVER("Driver is selecting the following features:\n");
     virtio_print_reserved_feature_bits(drv_features);
     virtio_gpu_print_features(drv_features);
 #endif
 
-    regs->Status |= VIRTIO_DEVICE_STATUS_FEATURES_OK;
-    if (!(regs->Status & VIRTIO_DEVICE_STATUS_FEATURES_OK)) {
+    if (virtio_transport_set_driver_features(&transport, drv_features)) {
         LOG_GPU_VIRTIO_DRIVER_ERR("Device status features is not OK!\n");
         assert(false);
     }
@@ -231,7 +271,11 @@ static void virtio_gpu_init(void)
     size_t desc_off = 0;
     size_t avail_off = ALIGN(desc_off + (16 * VIRTQ_QUEUE_SIZE), 2);
     size_t used_off = ALIGN(avail_off + (6 + 2 * VIRTQ_QUEUE_SIZE), 4);
-    size_t size = used_off + (6 + 8 * VIRTQ_QUEUE_SIZE);
+    size_t cursor_desc_off = ALIGN(used_off + (6 + 8 * VIRTQ_QUEUE_SIZE), 16);
+    size_t cursor_avail_off = ALIGN(cursor_desc_off + (16 * VIRTQ_CURSOR_QUEUE_SIZE), 2);
+    size_t cursor_used_off = ALIGN(cursor_avail_off + (6 + 2 * VIRTQ_CURSOR_QUEUE_SIZE), 4);
+    size_t cursor_cmds_off = ALIGN(cursor_used_off + (6 + 8 * VIRTQ_CURSOR_QUEUE_SIZE), VIRTIO_CURSOR_ENTRY_SIZE);
+    size_t size = cursor_cmds_off + (VIRTIO_CURSOR_ENTRY_SIZE * VIRTQ_CURSOR_QUEUE_SIZE);
     assert(size <= GPU_VIRTIO_METADATA_REGION_SIZE);
 
     virtq.num = VIRTQ_QUEUE_SIZE;
@@ -239,19 +283,26 @@ static void virtio_gpu_init(void)
     virtq.avail = (struct virtq_avail *)(virtio_metadata + avail_off);
     virtq.used = (struct virtq_used *)(virtio_metadata + used_off);
 
-    assert(regs->QueueNumMax >= VIRTQ_QUEUE_SIZE);
-    regs->QueueSel = VIRTIO_GPU_CONTROL_QUEUE;
-    regs->QueueNum = VIRTQ_QUEUE_SIZE;
-    regs->QueueDescLow = (virtio_metadata_paddr + desc_off) & 0xFFFFFFFFUL;
-    regs->QueueDescHigh = (virtio_metadata_paddr + desc_off) >> 32;
-    regs->QueueDriverLow = (virtio_metadata_paddr + avail_off) & 0xFFFFFFFFUL;
-    regs->QueueDriverHigh = (virtio_metadata_paddr + avail_off) >> 32;
-    regs->QueueDeviceLow = (virtio_metadata_paddr + used_off) & 0xFFFFFFFFUL;
-    regs->QueueDeviceHigh = (virtio_metadata_paddr + used_off) >> 32;
-    regs->QueueReady = 1;
+    err = virtio_transport_queue_setup(&transport, VIRTIO_GPU_CONTROL_QUEUE, VIRTQ_QUEUE_SIZE,
+                                       virtio_metadata_paddr + desc_off, virtio_metadata_paddr + avail_off,
+                                       virtio_metadata_paddr + used_off, VIRTIO_MSI_NO_VECTOR);
+    assert(!err);
+
+    cursor_virtq.num = VIRTQ_CURSOR_QUEUE_SIZE;
+    cursor_virtq.desc = (struct virtq_desc *)(virtio_metadata + cursor_desc_off);
+    cursor_virtq.avail = (struct virtq_avail *)(virtio_metadata + cursor_avail_off);
+    cursor_virtq.used = (struct virtq_used *)(virtio_metadata + cursor_used_off);
+    cursor_cmds = virtio_metadata + cursor_cmds_off;
+    cursor_cmds_paddr = virtio_metadata_paddr + cursor_cmds_off;
+
+    err = virtio_transport_queue_setup(&transport, VIRTIO_GPU_CURSOR_QUEUE, VIRTQ_CURSOR_QUEUE_SIZE,
+                                       virtio_metadata_paddr + cursor_desc_off,
+                                       virtio_metadata_paddr + cursor_avail_off,
+                                       virtio_metadata_paddr + cursor_used_off, VIRTIO_MSI_NO_VECTOR);
+    assert(!err);
 
     /* Finish initialisation */
-    regs->Status |= VIRTIO_DEVICE_STATUS_DRIVER_OK;
+    virtio_transport_driver_ok(&transport);
 }
 
 static gpu_resp_status_t virtio_gpu_to_sddf_resp_status(enum virtio_gpu_ctrl_type type)
@@ -312,6 +363,7 @@ static bool handle_response()
     bool sddf_notify = false;
     uint16_t i = last_handled_used_idx;
     uint16_t curr_idx = virtq.used->idx;
+    THREAD_MEMORY_ACQUIRE();
     while (i != curr_idx) {
         struct virtq_used_elem used = virtq.used->ring[i % virtq.num];
         assert(used.id < VIRTQ_QUEUE_SIZE);
@@ -328,7 +380,8 @@ static bool handle_response()
         resp.status = GPU_RESP_ERR_UNSPEC;
 
         struct virtio_gpu_ctrl_hdr *req_hdr = (struct virtio_gpu_ctrl_hdr *)VIRTIO_DATA_PADDR_TO_VADDR(desc_head.addr);
-        assert(req_hdr->type == reqsbk[resp.id].virtio_code);
+        assert(req_hdr->type == reqsbk[resp.id].virtio_code
+               || (reqsbk[resp.id].page_flip && req_hdr->type == VIRTIO_GPU_CMD_SET_SCANOUT_BLOB));
         switch (req_hdr->type) {
         case VIRTIO_GPU_CMD_GET_DISPLAY_INFO: {
             struct virtq_desc desc_footer = virtq.desc[desc_head.next];
@@ -429,11 +482,24 @@ static bool handle_response()
             break;
         }
 
-        err = ialloc_free(&ialloc_desc, used.id);
-        assert(!err);
-        err = ialloc_free(&ialloc_desc, desc_head.next);
+        uint32_t desc_idxs[2] = { used.id, desc_head.next };
+        err = ialloc_free_n(&ialloc_desc, desc_idxs, 2);
         assert(!err);
 
+        if (reqsbk[resp.id].page_flip) {
+            if (req_hdr->type == VIRTIO_GPU_CMD_SET_SCANOUT_BLOB) {
+                /* The flip is responded to once its flush has completed */
+                reqsbk[resp.id].flip_status = resp.status;
+                i++;
+                continue;
+            }
+            if (reqsbk[resp.id].flip_status != GPU_RESP_OK) {
+                resp.status = reqsbk[resp.id].flip_status;
+            } else if (resp.status == GPU_RESP_OK) {
+                gpu_events_set_flip(gpu_events, reqsbk[resp.id].flip_scanout_id, sddf_timestamp());
+            }
+        }
+
         if (gpu_queue_full_resp(&gpu_queue_h)) {
             LOG_GPU_VIRTIO_DRIVER_ERR("Response queue is full, dropping response\n");
             continue;
@@ -451,14 +517,124 @@ static bool handle_response()
     return sddf_notify;
 }
 
+static bool handle_cursor_response()
+{
+    int err = 0;
+    bool sddf_notify = false;
+    uint16_t i = last_handled_cursor_used_idx;
+    uint16_t curr_idx = cursor_virtq.used->idx;
+    THREAD_MEMORY_ACQUIRE();
+    while (i != curr_idx) {
+        struct virtq_used_elem used = cursor_virtq.used->ring[i % cursor_virtq.num];
+        assert(used.id < VIRTQ_CURSOR_QUEUE_SIZE);
+
+        if (gpu_queue_full_resp(&gpu_queue_h)) {
+            LOG_GPU_VIRTIO_DRIVER_ERR("Response queue is full, deferring cursor responses\n");
+            break;
+        }
+
+        LOG_GPU_VIRTIO_DRIVER("Handling cursor response %d\n", cursor_desc_to_id[used.id]);
+
+        /* The device does not write a response for cursor commands, they cannot fail */
+        err = gpu_enqueue_resp(&gpu_queue_h, (gpu_resp_t) {
+                                                 .id = cursor_desc_to_id[used.id],
+                                                 .status = GPU_RESP_OK,
+                                             });
+        assert(!err);
+        sddf_notify = true;
+
+        err = ialloc_free(&ialloc_cursor_desc, used.id);
+        assert(!err);
+
+        i++;
+    }
+
+    last_handled_cursor_used_idx = i;
+
+    return sddf_notify;
+}
+
+/**
+ * Make the descriptor chains posted up to avail_idx available to the device, and notify
+ * the device unless it has asked not to be.
+ *
+ * @param q virtqueue the chains were posted to.
+ * @param queue index of the virtqueue.
+ * @param avail_idx index of the avail ring after the last chain posted.
+ */
+static void virtq_publish(struct virtq *q, uint16_t queue, uint16_t avail_idx)
+{
+    if (avail_idx == q->avail->idx) {
+        return;
+    }
+
+    THREAD_MEMORY_RELEASE();
+    q->avail->idx = avail_idx;
+    /* The device must see the new idx before we read whether it wants a notification */
+    THREAD_MEMORY_FENCE();
+    if (q->used->flags & VIRTQ_USED_F_NO_NOTIFY) {
+        return;
+    }
+
+    LOG_GPU_VIRTIO_DRIVER("Notifying device about new entries in queue %d\n", queue);
+    /* This assumes VIRTIO_F_NOTIFICATION_DATA has not been negotiated */
+    virtio_transport_queue_notify(&transport, queue);
+}
+
+/* Post a cursor command for an sDDF cursor request to the cursor queue */
+static void handle_cursor_request(gpu_req_t *req, uint16_t *avail_idx)
+{
+    uint32_t desc_idx = 0;
+    int err = ialloc_alloc(&ialloc_cursor_desc, &desc_idx);
+    assert(!err);
+    assert(desc_idx < VIRTQ_CURSOR_QUEUE_SIZE);
+
+    cursor_desc_to_id[desc_idx] = req->id;
+
+    struct virtio_gpu_update_cursor *update_cursor = (struct virtio_gpu_update_cursor *)VIRTIO_CURSOR_CMD(desc_idx);
+    sddf_memset(update_cursor, 0, sizeof(struct virtio_gpu_update_cursor));
+    if (req->code == GPU_REQ_UPDATE_CURSOR) {
+        update_cursor->hdr.type = VIRTIO_GPU_CMD_UPDATE_CURSOR;
+        update_cursor->pos.scanout_id = req->update_cursor.scanout_id;
+        update_cursor->pos.x = req->update_cursor.x;
+        update_cursor->pos.y = req->update_cursor.y;
+        update_cursor->resource_id = req->update_cursor.resource_id;
+        update_cursor->hot_x = req->update_cursor.hot_x;
+        update_cursor->hot_y = req->update_cursor.hot_y;
+    } else {
+        update_cursor->hdr.type = VIRTIO_GPU_CMD_MOVE_CURSOR;
+        update_cursor->pos.scanout_id = req->move_cursor.scanout_id;
+        update_cursor->pos.x = req->move_cursor.x;
+        update_cursor->pos.y = req->move_cursor.y;
+    }
+
+    cursor_virtq.desc[desc_idx].addr = (uint64_t)VIRTIO_CURSOR_CMD_PADDR(desc_idx);
+    cursor_virtq.desc[desc_idx].len = sizeof(struct virtio_gpu_update_cursor);
+    cursor_virtq.desc[desc_idx].flags = 0;
+
+    cursor_virtq.avail->ring[*avail_idx % cursor_virtq.num] = desc_idx;
+    (*avail_idx)++;
+}
+
 static void handle_request()
 {
     int err = 0;
-    bool virtio_queue_notify = false;
     bool sddf_notify = false;
+    uint16_t avail_idx = virtq.avail->idx;
+    uint16_t cursor_avail_idx = cursor_virtq.avail->idx;
+    /* Header of the last command posted to the control queue */
+    struct virtio_gpu_ctrl_hdr *last_hdr = NULL;
     gpu_req_t req = { 0 };
     while (!gpu_queue_empty_req(&gpu_queue_h)) {
-        if (ialloc_num_free(&ialloc_desc) < VIRTIO_MAX_DESC_PER_REQ) {
+        /* Each queue only holds up requests bound for it, a full cursor queue does not stop control
+         * commands ahead of the next cursor request */
+        gpu_req_code_t code = gpu_queue_peek_code_req(&gpu_queue_h);
+        if (code == GPU_REQ_UPDATE_CURSOR || code == GPU_REQ_MOVE_CURSOR) {
+            if (ialloc_full(&ialloc_cursor_desc)) {
+                LOG_GPU_VIRTIO_DRIVER("Not enough free cursor descriptors\n");
+                break;
+            }
+        } else if (ialloc_num_free(&ialloc_desc) < VIRTIO_MAX_DESC_PER_REQ) {
             LOG_GPU_VIRTIO_DRIVER("Not enough free descriptors\n");
             break;
         }
@@ -468,31 +644,32 @@ static void handle_request()
 
         LOG_GPU_VIRTIO_DRIVER("Handling request %d\n", req.id);
 
+        if (req.code == GPU_REQ_UPDATE_CURSOR || req.code == GPU_REQ_MOVE_CURSOR) {
+            handle_cursor_request(&req, &cursor_avail_idx);
+            continue;
+        }
+
         /* VirtIO gpu requests contain a header for request metadata, and a footer for the response.
          * We allocate one descriptor for each. Some requests may require additional descriptors for
          * data. Here we allocate the necessary descriptors and convert the sDDF request into a virtIO
          * request.
          */
 
-        uint32_t desc_head_idx = 0;
-        err = ialloc_alloc(&ialloc_desc, &desc_head_idx);
+        uint32_t desc_idxs[2];
+        err = ialloc_alloc_n(&ialloc_desc, desc_idxs, 2);
         assert(!err);
+        uint32_t desc_head_idx = desc_idxs[0];
+        uint32_t desc_footer_idx = desc_idxs[1];
         assert(desc_head_idx < VIRTQ_QUEUE_SIZE);
+        assert(desc_footer_idx < VIRTQ_QUEUE_SIZE);
 
         virtio_desc_to_id[desc_head_idx] = req.id;
+        reqsbk[req.id].page_flip = false;
 
         virtq.desc[desc_head_idx].addr = (uint64_t)VIRTIO_DATA_PADDR(desc_head_idx);
         virtq.desc[desc_head_idx].len = 0;
         virtq.desc[desc_head_idx].flags = 0;
 
-        virtq.avail->ring[virtq.avail->idx % virtq.num] = desc_head_idx;
-        virtq.avail->idx++;
-
-        uint32_t desc_footer_idx = 0;
-        err = ialloc_alloc(&ialloc_desc, &desc_footer_idx);
-        assert(!err);
-        assert(desc_footer_idx < VIRTQ_QUEUE_SIZE);
-
         virtq.desc[desc_footer_idx].addr = (uint64_t)VIRTIO_DATA_PADDR(desc_footer_idx);
         virtq.desc[desc_footer_idx].len = 0;
         virtq.desc[desc_footer_idx].flags = VIRTQ_DESC_F_WRITE;
@@ -503,7 +680,7 @@ static void handle_request()
             struct virtio_gpu_ctrl_hdr *hdr = (struct virtio_gpu_ctrl_hdr *)VIRTIO_DATA(desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_ctrl_hdr);
             hdr->type = VIRTIO_GPU_CMD_GET_DISPLAY_INFO;
-            hdr->flags = VIRTIO_GPU_FLAG_FENCE;
+            hdr->flags = 0;
             hdr->fence_id = 0;
 
             virtq.desc[desc_head_idx].next = desc_footer_idx;
@@ -521,7 +698,7 @@ static void handle_request()
                 (struct virtio_gpu_resource_create_blob *)VIRTIO_DATA(desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_resource_create_blob);
             resource_create_blob->hdr.type = VIRTIO_GPU_CMD_RESOURCE_CREATE_BLOB;
-            resource_create_blob->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            resource_create_blob->hdr.flags = 0;
             resource_create_blob->hdr.fence_id = 0;
             resource_create_blob->resource_id = req.resource_create_blob.resource_id;
             /* Type of blob resource memory: Guest only, Guest + Host, Host only. We use guest only */
@@ -564,13 +741,16 @@ static void handle_request()
             virtq.desc[desc_footer_idx].len = sizeof(struct virtio_gpu_ctrl_hdr);
             break;
         }
+        case GPU_REQ_PAGE_FLIP:
+        /* FALLTHROUGH */
         case GPU_REQ_SET_SCANOUT_BLOB: {
+            /* A page flip has the same arguments as a SET_SCANOUT_BLOB */
             reqsbk[req.id].virtio_code = VIRTIO_GPU_CMD_SET_SCANOUT_BLOB;
             struct virtio_gpu_set_scanout_blob *set_scanout_blob = (struct virtio_gpu_set_scanout_blob *)VIRTIO_DATA(
                 desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_set_scanout_blob);
             set_scanout_blob->hdr.type = VIRTIO_GPU_CMD_SET_SCANOUT_BLOB;
-            set_scanout_blob->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            set_scanout_blob->hdr.flags = 0;
             set_scanout_blob->hdr.fence_id = 0;
             set_scanout_blob->r.x = req.set_scanout_blob.rect.x;
             set_scanout_blob->r.y = req.set_scanout_blob.rect.y;
@@ -592,6 +772,51 @@ static void handle_request()
             virtq.desc[desc_head_idx].flags = VIRTQ_DESC_F_NEXT;
 
             virtq.desc[desc_footer_idx].len = sizeof(struct virtio_gpu_ctrl_hdr);
+
+            if (req.code != GPU_REQ_PAGE_FLIP) {
+                break;
+            }
+
+            /* The device shows the new resource once it is flushed, so the flip is followed by a
+             * flush of the scanout rectangle. The flip completes with the flush, which is fenced
+             * so that it is only signalled once the host is done with it.
+             */
+            reqsbk[req.id].virtio_code = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
+            reqsbk[req.id].page_flip = true;
+            reqsbk[req.id].flip_status = GPU_RESP_OK;
+            reqsbk[req.id].flip_scanout_id = req.page_flip.scanout_id;
+
+            virtq.avail->ring[avail_idx % virtq.num] = desc_head_idx;
+            avail_idx++;
+
+            err = ialloc_alloc_n(&ialloc_desc, desc_idxs, 2);
+            assert(!err);
+            desc_head_idx = desc_idxs[0];
+            desc_footer_idx = desc_idxs[1];
+            assert(desc_head_idx < VIRTQ_QUEUE_SIZE);
+            assert(desc_footer_idx < VIRTQ_QUEUE_SIZE);
+
+            virtio_desc_to_id[desc_head_idx] = req.id;
+
+            struct virtio_gpu_resource_flush *resource_flush = (struct virtio_gpu_resource_flush *)VIRTIO_DATA(
+                desc_head_idx);
+            resource_flush->hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
+            resource_flush->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            resource_flush->hdr.fence_id = ++last_fence_id;
+            resource_flush->resource_id = req.page_flip.resource_id;
+            resource_flush->r.x = req.page_flip.rect.x;
+            resource_flush->r.y = req.page_flip.rect.y;
+            resource_flush->r.width = req.page_flip.rect.width;
+            resource_flush->r.height = req.page_flip.rect.height;
+
+            virtq.desc[desc_head_idx].addr = (uint64_t)VIRTIO_DATA_PADDR(desc_head_idx);
+            virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_resource_flush);
+            virtq.desc[desc_head_idx].next = desc_footer_idx;
+            virtq.desc[desc_head_idx].flags = VIRTQ_DESC_F_NEXT;
+
+            virtq.desc[desc_footer_idx].addr = (uint64_t)VIRTIO_DATA_PADDR(desc_footer_idx);
+            virtq.desc[desc_footer_idx].len = sizeof(struct virtio_gpu_ctrl_hdr);
+            virtq.desc[desc_footer_idx].flags = VIRTQ_DESC_F_WRITE;
             break;
         }
 #endif
@@ -601,7 +826,7 @@ static void handle_request()
                 (struct virtio_gpu_resource_create_2d *)VIRTIO_DATA(desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_resource_create_2d);
             resource_create_2d->hdr.type = VIRTIO_GPU_CMD_RESOURCE_CREATE_2D;
-            resource_create_2d->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            resource_create_2d->hdr.flags = 0;
             resource_create_2d->hdr.fence_id = 0;
             resource_create_2d->width = req.resource_create_2d.width;
             resource_create_2d->height = req.resource_create_2d.height;
@@ -622,7 +847,7 @@ static void handle_request()
                 desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_resource_unref);
             resource_unref->hdr.type = VIRTIO_GPU_CMD_RESOURCE_UNREF;
-            resource_unref->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            resource_unref->hdr.flags = 0;
             resource_unref->hdr.fence_id = 0;
             resource_unref->resource_id = req.resource_unref.resource_id;
 
@@ -638,7 +863,7 @@ static void handle_request()
                 (struct virtio_gpu_resource_attach_backing *)VIRTIO_DATA(desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_resource_attach_backing);
             resource_attach_backing->hdr.type = VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING;
-            resource_attach_backing->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            resource_attach_backing->hdr.flags = 0;
             resource_attach_backing->hdr.fence_id = 0;
             resource_attach_backing->resource_id = req.resource_attach_backing.resource_id;
             resource_attach_backing->nr_entries = 1;
@@ -670,7 +895,7 @@ static void handle_request()
                 (struct virtio_gpu_resource_detach_backing *)VIRTIO_DATA(desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_resource_detach_backing);
             resource_detach_backing->hdr.type = VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING;
-            resource_detach_backing->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            resource_detach_backing->hdr.flags = 0;
             resource_detach_backing->hdr.fence_id = 0;
             resource_detach_backing->resource_id = req.resource_detach_backing.resource_id;
 
@@ -685,7 +910,7 @@ static void handle_request()
             struct virtio_gpu_set_scanout *set_scanout = (struct virtio_gpu_set_scanout *)VIRTIO_DATA(desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_set_scanout);
             set_scanout->hdr.type = VIRTIO_GPU_CMD_SET_SCANOUT;
-            set_scanout->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            set_scanout->hdr.flags = 0;
             set_scanout->hdr.fence_id = 0;
             set_scanout->resource_id = req.set_scanout.resource_id;
             set_scanout->scanout_id = req.set_scanout.scanout_id;
@@ -705,7 +930,7 @@ static void handle_request()
                 (struct virtio_gpu_transfer_to_host_2d *)VIRTIO_DATA(desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_transfer_to_host_2d);
             transfer_to_2d->hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D;
-            transfer_to_2d->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            transfer_to_2d->hdr.flags = 0;
             transfer_to_2d->hdr.fence_id = 0;
             transfer_to_2d->offset = req.transfer_to_2d.mem_offset;
             transfer_to_2d->resource_id = req.transfer_to_2d.resource_id;
@@ -726,7 +951,7 @@ static void handle_request()
                 desc_head_idx);
             virtq.desc[desc_head_idx].len = sizeof(struct virtio_gpu_resource_flush);
             resource_flush->hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
-            resource_flush->hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+            resource_flush->hdr.flags = 0;
             resource_flush->hdr.fence_id = 0;
             resource_flush->resource_id = req.resource_flush.resource_id;
             resource_flush->r.x = req.resource_flush.rect.x;
@@ -748,11 +973,8 @@ static void handle_request()
              * free all allocated resources.
              */
             LOG_GPU_VIRTIO_DRIVER_ERR("Unsupported sddf request code %d, failing request\n", req.code);
-            err = ialloc_free(&ialloc_desc, desc_head_idx);
-            assert(!err);
-            err = ialloc_free(&ialloc_desc, desc_footer_idx);
+            err = ialloc_free_n(&ialloc_desc, desc_idxs, 2);
             assert(!err);
-            virtq.avail->idx--;
 
             if (gpu_queue_full_resp(&gpu_queue_h)) {
                 LOG_GPU_VIRTIO_DRIVER_ERR("Response queue is full, dropping response\n");
@@ -762,30 +984,43 @@ static void handle_request()
             err = gpu_enqueue_resp(&gpu_queue_h, (gpu_resp_t) { req.id, GPU_RESP_ERR_UNSPEC });
             assert(!err);
             sddf_notify = true;
-            break;
+            continue;
         }
         }
-        virtio_queue_notify = true;
+
+        last_hdr = (struct virtio_gpu_ctrl_hdr *)VIRTIO_DATA(desc_head_idx);
+        virtq.avail->ring[avail_idx % virtq.num] = desc_head_idx;
+        avail_idx++;
     }
 
-    if (sddf_notify) {
-        microkit_notify(VIRT_CH);
+    /* The device has to synchronise with the host for every fenced command. Commands on the
+     * control queue are processed in order, so fencing only the last command of the batch is
+     * enough to know when the whole batch has completed.
+     */
+    if (last_hdr != NULL && !(last_hdr->flags & VIRTIO_GPU_FLAG_FENCE)) {
+        last_hdr->flags = VIRTIO_GPU_FLAG_FENCE;
+        last_hdr->fence_id = ++last_fence_id;
     }
 
-    if (virtio_queue_notify) {
-        LOG_GPU_VIRTIO_DRIVER("Notifying device about new queue entries\n");
-        regs->QueueNotify = 0;
+    virtq_publish(&virtq, VIRTIO_GPU_CONTROL_QUEUE, avail_idx);
+    virtq_publish(&cursor_virtq, VIRTIO_GPU_CURSOR_QUEUE, cursor_avail_idx);
+
+    if (sddf_notify) {
+        microkit_notify(VIRT_CH);
     }
 }
 
 static void handle_irq()
 {
     bool notify = false;
-    uint32_t irq_status = regs->InterruptStatus;
-    if (irq_status & VIRTIO_MMIO_IRQ_VQUEUE) {
+    uint32_t irq_status = virtio_transport_irq_status(&transport);
+    if (irq_status & VIRTIO_IRQ_VQUEUE) {
         LOG_GPU_VIRTIO_DRIVER("Received virtqueue used buffer notification\n");
         notify = handle_response();
-        regs->InterruptACK = VIRTIO_MMIO_IRQ_VQUEUE;
+        if (handle_cursor_response()) {
+            notify = true;
+        }
+        virtio_transport_irq_ack(&transport, VIRTIO_IRQ_VQUEUE);
         /* Now that there are (maybe) some free descriptors, we want to handle any remaining
          * requests that we may have left in the queue before due to being
          * out of free descriptors.
@@ -793,12 +1028,12 @@ static void handle_irq()
         handle_request();
     }
 
-    if (irq_status & VIRTIO_MMIO_IRQ_CONFIG) {
+    if (irq_status & VIRTIO_IRQ_CONFIG) {
         if (virtio_config->events_read & VIRTIO_GPU_EVENT_DISPLAY) {
             LOG_GPU_VIRTIO_DRIVER("Received display info event\n");
             gpu_events_set_display_info(gpu_events);
             virtio_config->events_clear = VIRTIO_GPU_EVENT_DISPLAY;
-            regs->InterruptACK = VIRTIO_MMIO_IRQ_CONFIG;
+            virtio_transport_irq_ack(&transport, VIRTIO_IRQ_CONFIG);
             notify = true;
         } else {
             LOG_GPU_VIRTIO_DRIVER_ERR("Unknown event: 0x%x\n", virtio_config->events_read);
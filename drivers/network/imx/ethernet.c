@@ -10,6 +10,7 @@
 #include <sddf/network/queue.h>
 #include <sddf/network/config.h>
 #include <sddf/util/util.h>
+#include <sddf/util/boot_trace.h>
 #include <sddf/util/fence.h>
 #include <sddf/util/printf.h>
 
@@ -306,7 +307,9 @@ void init(void)
     assert(RX_COUNT * sizeof(struct descriptor) <= device_resources.regions[1].region.size);
     assert(TX_COUNT * sizeof(struct descriptor) <= device_resources.regions[2].region.size);
 
+    boot_trace_begin("eth setup");
     eth_setup();
+    boot_trace_end("eth setup");
 
     net_queue_init(&rx_queue, config.virt_rx.free_queue.vaddr, config.virt_rx.active_queue.vaddr,
                    config.virt_rx.num_buffers);
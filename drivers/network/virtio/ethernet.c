@@ -5,7 +5,7 @@
 
 /*
  * This driver follows the non-legacy virtIO 1.2 specification for the network device.
- * It assumes that the transport method is MMIO.
+ * It supports both the MMIO and PCI transport methods, see sddf/virtio/transport.h.
  * This driver is very minimal and was written for the goal of building systems that
  * use networking on a simulator like QEMU. It is *not* intended to be performant.
  *
@@ -21,10 +21,12 @@
 #include <sddf/network/config.h>
 #include <sddf/util/fence.h>
 #include <sddf/util/util.h>
+#include <sddf/util/boot_trace.h>
 #include <sddf/util/printf.h>
 #include <sddf/util/ialloc.h>
 #include <sddf/virtio/virtio.h>
 #include <sddf/virtio/virtio_queue.h>
+#include <sddf/virtio/transport.h>
 #include <sddf/resources/device.h>
 
 #include "ethernet.h"
@@ -51,6 +53,9 @@ net_queue_t *tx_active;
 
 #define HW_RING_SIZE (0x10000)
 
+/* When using the PCI transport, region 0 is the ECAM window and the BAR is placed here */
+#define PCI_BAR_REGION 2
+
 struct virtq rx_virtq;
 struct virtq tx_virtq;
 uint16_t rx_last_seen_used = 0;
@@ -70,7 +75,7 @@ uintptr_t virtio_net_tx_headers_paddr;
 uintptr_t virtio_net_rx_headers_paddr;
 virtio_net_hdr_t *virtio_net_tx_headers;
 
-volatile virtio_mmio_regs_t *regs;
+virtio_transport_t transport;
 
 ialloc_t rx_ialloc_desc;
 uint32_t rx_descriptors[RX_COUNT];
@@ -102,12 +107,11 @@ static void rx_provide(void)
             assert(!err);
 
             // Allocate a desc entry for the header, and one for the packet
-            uint32_t hdr_desc_idx = -1;
-            err = ialloc_alloc(&rx_ialloc_desc, &hdr_desc_idx);
-            assert(!err && hdr_desc_idx != -1);
-            uint32_t pkt_desc_idx = -1;
-            err = ialloc_alloc(&rx_ialloc_desc, &pkt_desc_idx);
-            assert(!err && pkt_desc_idx != -1);
+            uint32_t desc_idxs[2];
+            err = ialloc_alloc_n(&rx_ialloc_desc, desc_idxs, 2);
+            assert(!err);
+            uint32_t hdr_desc_idx = desc_idxs[0];
+            uint32_t pkt_desc_idx = desc_idxs[1];
 
             assert(hdr_desc_idx < rx_virtq.num);
             assert(pkt_desc_idx < rx_virtq.num);
@@ -143,7 +147,7 @@ static void rx_provide(void)
 
     if (transferred) {
         /* We have added more avail buffers, so notify the device */
-        regs->QueueNotify = VIRTIO_NET_RX_QUEUE;
+        virtio_transport_queue_notify(&transport, VIRTIO_NET_RX_QUEUE);
     }
 }
 
@@ -168,9 +172,8 @@ static void rx_return(void)
         int err = net_enqueue_active(&rx_queue, buffer);
         assert(!err);
 
-        err = ialloc_free(&rx_ialloc_desc, hdr_used.id);
-        assert(!err);
-        err = ialloc_free(&rx_ialloc_desc, rx_virtq.desc[hdr_used.id].next);
+        uint32_t desc_idxs[2] = { hdr_used.id, rx_virtq.desc[hdr_used.id].next };
+        err = ialloc_free_n(&rx_ialloc_desc, desc_idxs, 2);
         assert(!err);
 
         rx_last_desc_idx -= 2;
@@ -198,12 +201,11 @@ static void tx_provide(void)
             assert(!err);
 
             /* Now we need to put our buffer into the virtIO ring */
-            uint32_t hdr_desc_idx = -1;
-            err = ialloc_alloc(&tx_ialloc_desc, &hdr_desc_idx);
-            assert(!err && hdr_desc_idx != -1);
-            uint32_t pkt_desc_idx = -1;
-            err = ialloc_alloc(&tx_ialloc_desc, &pkt_desc_idx);
-            assert(!err && pkt_desc_idx != -1);
+            uint32_t desc_idxs[2];
+            err = ialloc_alloc_n(&tx_ialloc_desc, desc_idxs, 2);
+            assert(!err);
+            uint32_t hdr_desc_idx = desc_idxs[0];
+            uint32_t pkt_desc_idx = desc_idxs[1];
             /* We should not run out of descriptors assuming that the avail ring is not full. */
             assert(hdr_desc_idx < tx_virtq.num);
             assert(pkt_desc_idx < tx_virtq.num);
@@ -241,8 +243,7 @@ static void tx_provide(void)
 
     if (packets_transferred) {
         /* Finally, need to notify the queue if we have transferred data */
-        /* This assumes VIRTIO_F_NOTIFICATION_DATA has not been negotiated */
-        regs->QueueNotify = VIRTIO_NET_TX_QUEUE;
+        virtio_transport_queue_notify(&transport, VIRTIO_NET_TX_QUEUE);
     }
 }
 
@@ -268,9 +269,8 @@ static void tx_return(void)
         int err = net_enqueue_free(&tx_queue, buffer);
         assert(!err);
 
-        err = ialloc_free(&tx_ialloc_desc, hdr_used.id);
-        assert(!err);
-        err = ialloc_free(&tx_ialloc_desc, tx_virtq.desc[hdr_used.id].next);
+        uint32_t desc_idxs[2] = { hdr_used.id, tx_virtq.desc[hdr_used.id].next };
+        err = ialloc_free_n(&tx_ialloc_desc, desc_idxs, 2);
         assert(!err);
         tx_last_desc_idx -= 2;
         assert(tx_last_desc_idx >= 0);
@@ -289,72 +289,42 @@ static void tx_return(void)
 
 static void handle_irq()
 {
-    uint32_t irq_status = regs->InterruptStatus;
-    if (irq_status & VIRTIO_MMIO_IRQ_VQUEUE) {
+    uint32_t irq_status = virtio_transport_irq_status(&transport);
+    if (irq_status & VIRTIO_IRQ_VQUEUE) {
         // We don't know whether the IRQ is related to a change to the RX queue
         // or TX queue, so we check both.
         rx_return();
         tx_return();
         tx_provide();
         // We have handled the used buffer notification
-        regs->InterruptACK = VIRTIO_MMIO_IRQ_VQUEUE;
+        virtio_transport_irq_ack(&transport, VIRTIO_IRQ_VQUEUE);
     }
 
-    if (irq_status & VIRTIO_MMIO_IRQ_CONFIG) {
+    if (irq_status & VIRTIO_IRQ_CONFIG) {
         LOG_DRIVER_ERR("ETH|ERROR: unexpected change in configuration %u\n", irq_status);
     }
 }
 
 static void eth_setup(void)
 {
-    // Do MMIO device init (section 4.2.3.1)
-    if (!virtio_mmio_check_magic(regs)) {
-        LOG_DRIVER_ERR("invalid virtIO magic value!\n");
-        assert(false);
-    }
-
-    if (virtio_mmio_version(regs) != VIRTIO_VERSION) {
-        LOG_DRIVER_ERR("not correct virtIO version!\n");
+    if (virtio_transport_init(&transport, &device_resources, PCI_BAR_REGION, VIRTIO_DEVICE_ID_NET)) {
+        LOG_DRIVER_ERR("could not find virtIO network device!\n");
         assert(false);
     }
 
-    if (!virtio_mmio_check_device_id(regs, VIRTIO_DEVICE_ID_NET)) {
-        LOG_DRIVER_ERR("not a virtIO network device!\n");
-        assert(false);
-    }
-
-    LOG_DRIVER("version: 0x%x\n", virtio_mmio_version(regs));
-
     // Do normal device initialisation (section 3.2)
-
-    // First reset the device
-    regs->Status = 0;
-
-    // Set the ACKNOWLEDGE bit to say we have noticed the device
-    regs->Status = VIRTIO_DEVICE_STATUS_ACKNOWLEDGE;
-    // Set the DRIVER bit to say we know how to drive the device
-    regs->Status = VIRTIO_DEVICE_STATUS_DRIVER;
+    virtio_transport_reset(&transport);
 
 #ifdef DEBUG_DRIVER
-    uint32_t feature_low = regs->DeviceFeatures;
-    regs->DeviceFeaturesSel = 1;
-    uint32_t feature_high = regs->DeviceFeatures;
-    uint64_t feature = feature_low | ((uint64_t)feature_high << 32);
-    virtio_net_print_features(feature);
+    virtio_net_print_features(virtio_transport_device_features(&transport));
 #endif
 
-    regs->DriverFeatures = VIRTIO_NET_F_MAC;
-    regs->DriverFeaturesSel = 1;
-    regs->DriverFeatures = VIRTIO_F_VERSION_1;
-
-    regs->Status = VIRTIO_DEVICE_STATUS_FEATURES_OK;
-
-    if (!(regs->Status & VIRTIO_DEVICE_STATUS_FEATURES_OK)) {
+    if (virtio_transport_set_driver_features(&transport, BIT(VIRTIO_NET_F_MAC) | BIT(VIRTIO_F_VERSION_1))) {
         LOG_DRIVER_ERR("device status features is not OK!\n");
         return;
     }
 
-    volatile virtio_net_config_t *config = (virtio_net_config_t *)regs->Config;
+    volatile virtio_net_config_t *config = (volatile virtio_net_config_t *)virtio_transport_config(&transport);
 #ifdef DEBUG_DRIVER
     virtio_net_print_config(config);
 #endif
@@ -401,28 +371,16 @@ static void eth_setup(void)
     tx_provide();
 
     // Setup RX queue first
-    assert(regs->QueueNumMax >= RX_COUNT);
-    regs->QueueSel = VIRTIO_NET_RX_QUEUE;
-    regs->QueueNum = RX_COUNT;
-    regs->QueueDescLow = (hw_ring_buffer_paddr + rx_desc_off) & 0xFFFFFFFF;
-    regs->QueueDescHigh = (hw_ring_buffer_paddr + rx_desc_off) >> 32;
-    regs->QueueDriverLow = (hw_ring_buffer_paddr + rx_avail_off) & 0xFFFFFFFF;
-    regs->QueueDriverHigh = (hw_ring_buffer_paddr + rx_avail_off) >> 32;
-    regs->QueueDeviceLow = (hw_ring_buffer_paddr + rx_used_off) & 0xFFFFFFFF;
-    regs->QueueDeviceHigh = (hw_ring_buffer_paddr + rx_used_off) >> 32;
-    regs->QueueReady = 1;
+    int err = virtio_transport_queue_setup(&transport, VIRTIO_NET_RX_QUEUE, RX_COUNT, hw_ring_buffer_paddr + rx_desc_off,
+                                           hw_ring_buffer_paddr + rx_avail_off, hw_ring_buffer_paddr + rx_used_off,
+                                           VIRTIO_MSI_NO_VECTOR);
+    assert(!err);
 
     // Setup TX queue
-    assert(regs->QueueNumMax >= TX_COUNT);
-    regs->QueueSel = VIRTIO_NET_TX_QUEUE;
-    regs->QueueNum = TX_COUNT;
-    regs->QueueDescLow = (hw_ring_buffer_paddr + tx_desc_off) & 0xFFFFFFFF;
-    regs->QueueDescHigh = (hw_ring_buffer_paddr + tx_desc_off) >> 32;
-    regs->QueueDriverLow = (hw_ring_buffer_paddr + tx_avail_off) & 0xFFFFFFFF;
-    regs->QueueDriverHigh = (hw_ring_buffer_paddr + tx_avail_off) >> 32;
-    regs->QueueDeviceLow = (hw_ring_buffer_paddr + tx_used_off) & 0xFFFFFFFF;
-    regs->QueueDeviceHigh = (hw_ring_buffer_paddr + tx_used_off) >> 32;
-    regs->QueueReady = 1;
+    err = virtio_transport_queue_setup(&transport, VIRTIO_NET_TX_QUEUE, TX_COUNT, hw_ring_buffer_paddr + tx_desc_off,
+                                       hw_ring_buffer_paddr + tx_avail_off, hw_ring_buffer_paddr + tx_used_off,
+                                       VIRTIO_MSI_NO_VECTOR);
+    assert(!err);
 
     // Set the MAC address
     config->mac[0] = 0x52;
@@ -433,8 +391,8 @@ static void eth_setup(void)
     config->mac[5] = 0x07;
 
     // Set the DRIVER_OK status bit
-    regs->Status = VIRTIO_DEVICE_STATUS_DRIVER_OK;
-    regs->InterruptACK = VIRTIO_MMIO_IRQ_VQUEUE;
+    virtio_transport_driver_ok(&transport);
+    virtio_transport_irq_ack(&transport, VIRTIO_IRQ_VQUEUE);
 }
 
 void init(void)
@@ -442,21 +400,23 @@ void init(void)
     assert(net_config_check_magic(&config));
     assert(device_resources_check_magic(&device_resources));
     assert(device_resources.num_irqs == 1);
-    assert(device_resources.num_regions == 2);
+    /* The PCI transport has an extra region for the BAR */
+    assert(device_resources.num_regions == 2 || device_resources.num_regions == PCI_BAR_REGION + 1);
 
-    regs = (volatile virtio_mmio_regs_t *)device_resources.regions[0].region.vaddr;
     hw_ring_buffer_vaddr = (uintptr_t)device_resources.regions[1].region.vaddr;
     hw_ring_buffer_paddr = device_resources.regions[1].io_addr;
 
-    ialloc_init(&rx_ialloc_desc, rx_descriptors, RX_COUNT);
-    ialloc_init(&tx_ialloc_desc, tx_descriptors, TX_COUNT);
+    ialloc_init_lifo(&rx_ialloc_desc, rx_descriptors, RX_COUNT);
+    ialloc_init_lifo(&tx_ialloc_desc, tx_descriptors, TX_COUNT);
 
     net_queue_init(&rx_queue, config.virt_rx.free_queue.vaddr, config.virt_rx.active_queue.vaddr,
                    config.virt_rx.num_buffers);
     net_queue_init(&tx_queue, config.virt_tx.free_queue.vaddr, config.virt_tx.active_queue.vaddr,
                    config.virt_tx.num_buffers);
 
+    boot_trace_begin("eth setup");
     eth_setup();
+    boot_trace_end("eth setup");
 
     sddf_irq_ack(device_resources.irqs[0].id);
 }
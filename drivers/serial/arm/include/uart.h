@@ -58,6 +58,8 @@ typedef volatile struct pl011_uart_regs pl011_uart_regs_t;
 
 #define PL011_UART_REF_CLOCK        0x16E3600
 
+#define PL011_FIFO_DEPTH            32              /* Depth of the tx and rx FIFOs in characters. */
+
 /* Line Control Register bits */
 #define PL011_LCR_WLEN_MASK         0x3             /* Word length. b00 = 5, b01 = 6, b10 = 7, b11 = 8. */
 #define PL011_LCR_WLEN_SHFT         5
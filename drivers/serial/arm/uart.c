@@ -39,6 +39,23 @@ static void set_baud(long bps)
     uart_regs->fbrd = baud_div_frac;
 }
 
+/* Closest interrupt FIFO level select value to a threshold in characters */
+static uint32_t fifo_level_select(uint32_t threshold)
+{
+    /* Levels are 1/8, 1/4, 1/2, 3/4 and 7/8 of the FIFO */
+    uint32_t eighths = (threshold * 8 + PL011_FIFO_DEPTH / 2) / PL011_FIFO_DEPTH;
+    if (eighths <= 1) {
+        return 0;
+    } else if (eighths == 2) {
+        return 1;
+    } else if (eighths <= 4) {
+        return 2;
+    } else if (eighths <= 6) {
+        return 3;
+    }
+    return 4;
+}
+
 static void tx_provide(void)
 {
     bool transferred = false;
@@ -48,8 +65,8 @@ static void tx_provide(void)
         transferred = true;
     }
 
-    /* If transmit fifo is full and there is data remaining to be sent, enable interrupt when fifo is no longer full */
-    if (uart_regs->fr & PL011_FR_TXFF && !serial_queue_empty(&tx_queue_handle, tx_queue_handle.queue->head)) {
+    /* If there is data remaining to be sent, the fifo is full. Enable interrupt when it drains to the threshold */
+    if (!serial_queue_empty(&tx_queue_handle, tx_queue_handle.queue->head)) {
         uart_regs->imsc |= PL011_IMSC_TX_INT;
     } else {
         uart_regs->imsc &= ~PL011_IMSC_TX_INT;
@@ -128,14 +145,20 @@ static void uart_setup(void)
     /* Disable parity checking */
     uart_regs->lcr_h |= PL011_LCR_PARTY_EN;
 
-    /* Enable receive interrupts when FIFO level exceeds 1/8 or after 32 ticks */
+    /* Enable receive interrupts when FIFO level reaches the threshold or after 32 ticks without data */
     if (config.rx_enabled) {
+        uint32_t rx_threshold = serial_fifo_threshold(config.rx_fifo_threshold, SDDF_SERIAL_RX_FIFO_THRESHOLD_DEFAULT,
+                                                      PL011_FIFO_DEPTH);
         uart_regs->ifls &= ~(PL011_IFLS_RX_MASK << PL011_IFLS_RX_SHFT);
+        uart_regs->ifls |= fifo_level_select(rx_threshold) << PL011_IFLS_RX_SHFT;
         uart_regs->imsc |= (PL011_IMSC_RX_TIMEOUT | PL011_IMSC_RX_INT);
     }
 
-    /* Enable transmit interrupts if the FIFO drops below 1/8 - used when the write fifo becomes full */
+    /* Enable transmit interrupts if the FIFO drains to the threshold - used when the write fifo becomes full */
+    uint32_t tx_threshold = serial_fifo_threshold(config.tx_fifo_threshold, SDDF_SERIAL_TX_FIFO_THRESHOLD_DEFAULT,
+                                                  PL011_FIFO_DEPTH);
     uart_regs->ifls &= ~(PL011_IFLS_TX_MASK << PL011_IFLS_TX_SHFT);
+    uart_regs->ifls |= fifo_level_select(tx_threshold) << PL011_IFLS_TX_SHFT;
     uart_regs->imsc |= PL011_IMSC_TX_INT;
 
     /* Enable the UART */
@@ -77,6 +77,7 @@ typedef volatile struct imx_uart_regs imx_uart_regs_t;
 #define UART_FCR_REF_FRQ_DIV_MSK    (0x7 << UART_FCR_REF_FRQ_DIV_SHFT)
 #define UART_FCR_TXTL_SHFT          (10)            /* Controls the threshold at which an interrupt is generated by the tx FIFO. Interrupt generated when the FIFO falls below this value. Possible values 0-32. */
 #define UART_FCR_TXTL_MASK          (0x3F << UART_FCR_TXTL_SHFT)
+#define UART_FCR_TXTL_MIN           (2)             /* Smallest valid tx threshold. */
 
 #define UART_FCR_REF_CLK_DIV_1      (0b101 << UART_FCR_REF_FRQ_DIV_SHFT)
 #define UART_FCR_REF_CLK_DIV_2      (0b100 << UART_FCR_REF_FRQ_DIV_SHFT)
@@ -88,7 +89,10 @@ typedef volatile struct imx_uart_regs imx_uart_regs_t;
 
 #define UART_MOD_CLK 24192000
 
+#define UART_FIFO_DEPTH             32              /* Depth of the tx and rx FIFOs in characters. */
+
 /* Status Register 1 bits */
+#define UART_SR1_AGTIM              BIT(8)          /* Aging timer expired with data in the rx FIFO below the threshold. Write 1 to it to clear. */
 #define UART_SR1_RX_RDY             BIT(9)          /* Rx FIFO is above the threshold. Automatically cleared when FIFO goes below the set threshold. */
 #define UART_SR1_FRM_ERR            BIT(10)         /* Frame error is detected. Write 1 to it to clear. */
 #define UART_SR1_ESC                BIT(11)         /* Escape sequence was detected. Write 1 to it to clear. */
@@ -40,6 +40,19 @@ static void set_baud(long bps)
     uart_regs->bmr = bmr;
 }
 
+/* Receive interrupts are raised at the FIFO threshold, or by the aging timer for data below it */
+static void rx_irq_enable(void)
+{
+    uart_regs->cr1 |= UART_CR1_RX_READY_INT;
+    uart_regs->cr2 |= UART_CR2_AGE_EN;
+}
+
+static void rx_irq_disable(void)
+{
+    uart_regs->cr1 &= ~UART_CR1_RX_READY_INT;
+    uart_regs->cr2 &= ~UART_CR2_AGE_EN;
+}
+
 static void tx_provide(void)
 {
     bool transferred = false;
@@ -75,14 +88,14 @@ static void rx_return(void)
 
         if (!(uart_regs->ts & UART_TST_RX_FIFO_EMPTY) && serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
             /* Disable rx interrupts until virtualisers queue is no longer full. */
-            uart_regs->cr1 &= ~UART_CR1_RX_READY_INT;
+            rx_irq_disable();
             serial_request_consumer_signal(&rx_queue_handle);
         }
         reprocess = false;
 
         if (!(uart_regs->ts & UART_TST_RX_FIFO_EMPTY) && !serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
             serial_cancel_consumer_signal(&rx_queue_handle);
-            uart_regs->cr1 |= UART_CR1_RX_READY_INT;
+            rx_irq_enable();
             reprocess = true;
         }
     }
@@ -96,9 +109,10 @@ static void handle_irq(void)
 {
     uint32_t uart_sr1 = uart_regs->sr1;
     uint32_t uart_cr1 = uart_regs->cr1;
-    while (uart_sr1 & UART_SR1_ABNORMAL || uart_sr1 & UART_SR1_RX_RDY
+    while (uart_sr1 & UART_SR1_ABNORMAL || uart_sr1 & (UART_SR1_RX_RDY | UART_SR1_AGTIM)
            || (uart_cr1 & UART_CR1_TX_READY_INT && uart_sr1 & UART_SR1_TX_RDY)) {
-        if (uart_sr1 & UART_SR1_RX_RDY) {
+        if (uart_sr1 & (UART_SR1_RX_RDY | UART_SR1_AGTIM)) {
+            uart_regs->sr1 = UART_SR1_AGTIM;
             rx_return();
         }
         if (uart_cr1 & UART_CR1_TX_READY_INT && uart_sr1 & UART_SR1_TX_RDY) {
@@ -135,25 +149,30 @@ static void uart_setup(void)
     /* Configure the reference clock and baud rate. Difficult to use automatic detection here as it requires the next incoming character to be 'a' or 'A'. */
     set_baud(config.default_baud);
 
-    /* Disable escape sequence, parity checking and aging rx data interrupts. */
+    /* Disable escape sequence and parity checking. */
     uart_regs->cr2 &= ~UART_CR2_PARITY_EN;
     uart_regs->cr2 &= ~(UART_CR2_ESCAPE_EN | UART_CR2_ESCAPE_INT);
-    uart_regs->cr2 &= ~UART_CR2_AGE_EN;
 
     uint32_t fcr = uart_regs->fcr;
-    /* Enable receive interrupts every byte */
+    /* Enable receive interrupts when the read fifo reaches the threshold */
     if (config.rx_enabled) {
+        uint32_t rx_threshold = serial_fifo_threshold(config.rx_fifo_threshold, SDDF_SERIAL_RX_FIFO_THRESHOLD_DEFAULT,
+                                                      UART_FIFO_DEPTH);
         fcr &= ~UART_FCR_RXTL_MASK;
-        fcr |= (1 << UART_FCR_RXTL_SHFT);
+        fcr |= (rx_threshold << UART_FCR_RXTL_SHFT);
     }
 
-    /* Enable transmit interrupts if the write fifo drops below one byte - used when the write fifo becomes full */
+    /* Enable transmit interrupts if the write fifo drops below the threshold - used when the write fifo becomes full */
+    uint32_t tx_threshold = serial_fifo_threshold(config.tx_fifo_threshold, SDDF_SERIAL_TX_FIFO_THRESHOLD_DEFAULT,
+                                                  UART_FIFO_DEPTH);
     fcr &= ~UART_FCR_TXTL_MASK;
-    fcr |= (2 << UART_FCR_TXTL_SHFT);
+    fcr |= (MAX(tx_threshold, UART_FCR_TXTL_MIN) << UART_FCR_TXTL_SHFT);
 
     uart_regs->fcr = fcr;
     if (config.rx_enabled) {
-        uart_regs->cr1 |= UART_CR1_RX_READY_INT;
+        rx_irq_enable();
+    } else {
+        uart_regs->cr2 &= ~UART_CR2_AGE_EN;
     }
 }
 
@@ -180,7 +199,7 @@ void notified(microkit_channel ch)
     } else if (ch == config.tx.id) {
         tx_provide();
     } else if (ch == config.rx.id) {
-        uart_regs->cr1 |= UART_CR1_RX_READY_INT;
+        rx_irq_enable();
         rx_return();
     } else {
         sddf_dprintf("UART|LOG: received notification on unexpected channel: %u\n", ch);
@@ -84,6 +84,8 @@ typedef volatile struct meson_uart_regs meson_uart_regs_t;
 
 #define UART_XTAL_REF_CLK 24000000
 
+#define AML_UART_FIFO_DEPTH         64                  /* Depth of the tx and rx FIFOs of the AO UART in characters. */
+
 struct uart_clock_state {
     bool crystal_clock;                                 /* True if crystal clock is in use. */
     uint64_t reference_clock_frequency;                 /* Frequency of the reference clock. Either crystal clock of system clock. */
@@ -174,16 +174,22 @@ static void uart_setup(void)
     set_baud(config.default_baud);
 
     uint32_t irqc = uart_regs->irqc;
-    /* Enable receive interrupts every byte */
+    /*
+     * Enable receive interrupts when the read fifo reaches the threshold. The UART has no receive timeout, so
+     * by default this is every byte to not hold back input that stops short of the threshold.
+     */
     if (config.rx_enabled) {
+        uint32_t rx_threshold = serial_fifo_threshold(config.rx_fifo_threshold, 0, AML_UART_FIFO_DEPTH);
         irqc &= ~AML_UART_RECV_IRQ_MASK;
-        irqc |= AML_UART_RECV_IRQ(1);
+        irqc |= AML_UART_RECV_IRQ(rx_threshold);
         cr |= (AML_UART_RX_INT_EN | AML_UART_RX_EN);
     }
 
-    /* Enable transmit interrupts if the write fifo drops below one byte - used when the write fifo becomes full */
+    /* Enable transmit interrupts if the write fifo drops below the threshold - used when the write fifo becomes full */
+    uint32_t tx_threshold = serial_fifo_threshold(config.tx_fifo_threshold, SDDF_SERIAL_TX_FIFO_THRESHOLD_DEFAULT,
+                                                  AML_UART_FIFO_DEPTH);
     irqc &= ~AML_UART_XMIT_IRQ_MASK;
-    irqc |= AML_UART_XMIT_IRQ(1);
+    irqc |= AML_UART_XMIT_IRQ(tx_threshold);
     cr |= AML_UART_TX_EN;
 
     uart_regs->irqc = irqc;
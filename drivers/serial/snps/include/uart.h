@@ -79,6 +79,14 @@ the IIR, but the IIR is read-only, and the FCR is write-only. */
 #define UART_FCR_FIFOE (1 << 0)
 /* FIFO Clear and Enable */
 #define UART_FCR_CE (UART_FCR_XFIFOR | UART_FCR_RFIFOR | UART_FCR_FIFOE)
+/* RCVR Trigger - 1 character in the FIFO */
+#define UART_FCR_RT_1 (0 << 6)
+/* RCVR Trigger - FIFO 1/4 full */
+#define UART_FCR_RT_QUARTER (1 << 6)
+/* RCVR Trigger - FIFO 1/2 full */
+#define UART_FCR_RT_HALF (2 << 6)
+/* RCVR Trigger - FIFO 2 less than full */
+#define UART_FCR_RT_FULL_2 (3 << 6)
 /* UART Line Control Register */
 #define UART_LCR 0x0C
 /* Default for LCR. 8 bit data length and 2 stop bits*/
@@ -90,4 +98,10 @@ the IIR, but the IIR is read-only, and the FCR is write-only. */
 /* UART Divisor Low Latch */
 #define UART_DLL 0x00
 /* Divisor Latch Mask */
-#define DL_MASK 0xff
\ No newline at end of file
+#define DL_MASK 0xff
+/* UART Component Parameter Register */
+#define UART_CPR 0xF4
+/* FIFO depth in multiples of 16, zero if the FIFOs are not present */
+#define UART_CPR_FIFO_MODE(cpr) (((cpr) >> 16) & 0xff)
+/* FIFO depth if not reported by the Component Parameter Register */
+#define UART_FIFO_DEPTH_DEFAULT 16
\ No newline at end of file
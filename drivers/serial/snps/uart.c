@@ -23,6 +23,9 @@ serial_queue_handle_t tx_queue_handle;
 /* UART device registers */
 volatile uintptr_t uart_base;
 
+/* Depth of the FIFOs in characters */
+uint32_t fifo_depth;
+
 #define REG_PTR(off)     ((volatile uint32_t *)((uart_base) + (off)))
 
 static void set_baud(unsigned long baud)
@@ -49,14 +52,21 @@ static void tx_provide(void)
 {
     bool transferred = false;
     char c;
-    while ((*REG_PTR(UART_LSR) & UART_LSR_THRE) && !serial_dequeue(&tx_queue_handle, &c)) {
-        *REG_PTR(UART_THR) = c;
-        transferred = true;
+    /*
+     * The transmit holding register empty flag is set once the whole FIFO has
+     * drained, so fill it in one go. Programmable THRE mode, which would
+     * raise the interrupt at a threshold instead, is an optional feature of
+     * the IP, so the transmit threshold of the config is not used.
+     */
+    if (*REG_PTR(UART_LSR) & UART_LSR_THRE) {
+        for (uint32_t i = 0; i < fifo_depth && !serial_dequeue(&tx_queue_handle, &c); i++) {
+            *REG_PTR(UART_THR) = c;
+            transferred = true;
+        }
     }
 
-    /* If transmit FIFO is full and we still have data to be sent, enable TX IRQ */
-    if ((*REG_PTR(UART_LSR) & UART_LSR_THRE) == 0
-        && !serial_queue_empty(&tx_queue_handle, tx_queue_handle.queue->head)) {
+    /* If we still have data to be sent, enable TX IRQ for when the FIFO has drained */
+    if (!serial_queue_empty(&tx_queue_handle, tx_queue_handle.queue->head)) {
         *REG_PTR(UART_IER) |= UART_IER_ETBEI;
     } else {
         *REG_PTR(UART_IER) &= ~UART_IER_ETBEI;
@@ -92,7 +102,7 @@ static void rx_return(void)
         /* While RX data is still available, we enable the RX IRQ and continue processing */
         if ((*REG_PTR(UART_LSR) & UART_LSR_DR) && !serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
             serial_cancel_consumer_signal(&rx_queue_handle);
-            *REG_PTR(UART_LSR) |= UART_IER_ERBFI;
+            *REG_PTR(UART_IER) |= UART_IER_ERBFI;
             reprocess = true;
         }
     }
@@ -106,6 +116,7 @@ static void handle_irq(void)
 {
     uint32_t irq_status = *REG_PTR(UART_IIR);
     uint32_t line_status = *REG_PTR(UART_LSR);
+    /* Also set for the character timeout interrupt */
     if (irq_status & UART_IIR_RX) {
         rx_return();
     }
@@ -141,8 +152,27 @@ void init(void)
     /* Setup the Modem Control Register */
     *REG_PTR(UART_MCR) |= (UART_MCR_DTR | UART_MCR_RTS);
 
-    /* Clear and enable the FIFO's*/
-    *REG_PTR(UART_FCR) = UART_FCR_CE;
+    /* The FIFO depth is only reported if the component parameter register is present */
+    fifo_depth = UART_CPR_FIFO_MODE(*REG_PTR(UART_CPR)) * 16;
+    if (fifo_depth == 0) {
+        fifo_depth = UART_FIFO_DEPTH_DEFAULT;
+    }
+
+    /*
+     * Clear and enable the FIFO's. Receive interrupts are raised at the closest trigger level to the threshold, or
+     * by the character timeout for data below it.
+     */
+    uint32_t rx_threshold = serial_fifo_threshold(config.rx_fifo_threshold, SDDF_SERIAL_RX_FIFO_THRESHOLD_DEFAULT,
+                                                  fifo_depth);
+    uint32_t rx_trigger = UART_FCR_RT_1;
+    if (rx_threshold >= fifo_depth - 2) {
+        rx_trigger = UART_FCR_RT_FULL_2;
+    } else if (rx_threshold >= fifo_depth / 2) {
+        rx_trigger = UART_FCR_RT_HALF;
+    } else if (rx_threshold >= fifo_depth / 4) {
+        rx_trigger = UART_FCR_RT_QUARTER;
+    }
+    *REG_PTR(UART_FCR) = UART_FCR_CE | rx_trigger;
 
     /* Set defaults for the UART Line control register */
     *REG_PTR(UART_LCR) |= UART_LCR_DEFAULT;
@@ -5,11 +5,18 @@
 
 /*
  * This driver follows the non-legacy virtIO 1.2 specification for the console device.
- * It assumes that the transport method is MMIO.
- * This driver is very minimal and was written for the goal of building systems that
- * use virtIO block devices in a simulator like QEMU. It is *not* written with
- * performance in mind. It makes use of no console device features and hence only has
- * a single set of receive/transmit virtqs and does not use control queues.
+ * It supports both the MMIO and PCI transport methods, see sddf/virtio/transport.h.
+ * This driver was written for the goal of building systems that use virtIO console
+ * devices in a simulator like QEMU.
+ *
+ * If the device offers VIRTIO_CONSOLE_F_MULTIPORT and the driver config has more
+ * than one port, each port of the driver config is connected to the port of the
+ * device with the same number, so clients can each have their own port on the host
+ * side without going through the serial virtualisers. Otherwise, only port 0 is used.
+ *
+ * Each virtqueue entry refers to a fixed buffer. Transmit buffers are filled with as
+ * much of the client's queue as fits, and all free receive buffers are posted at once,
+ * so the device is notified once per batch rather than once per character.
  *
  * It should also be noted that because this driver is intended to be used with a
  * simulator such as QEMU, things like memory fences when touching device registers
@@ -18,8 +25,11 @@
 
 #include <os/sddf.h>
 #include <sddf/util/ialloc.h>
+#include <sddf/util/fence.h>
+#include <sddf/util/boot_trace.h>
 #include <sddf/virtio/virtio.h>
 #include <sddf/virtio/virtio_queue.h>
+#include <sddf/virtio/transport.h>
 #include <sddf/resources/device.h>
 #include <sddf/serial/config.h>
 #include "console.h"
@@ -33,380 +43,456 @@ __attribute__((__section__(".serial_driver_config"))) serial_driver_config_t con
 uintptr_t hw_ring_buffer_vaddr;
 uintptr_t hw_ring_buffer_paddr;
 
-/* The number of entries in each virtqueue */
-#define RX_COUNT 512
-#define TX_COUNT 512
-
-#define VIRTIO_SERIAL_RX_QUEUE 0
-#define VIRTIO_SERIAL_TX_QUEUE 1
-
-/* Queues for communicating with the virtualizers */
-serial_queue_handle_t rx_queue_handle;
-serial_queue_handle_t tx_queue_handle;
-
-serial_queue_t *rx_queue;
-serial_queue_t *tx_queue;
-
-char *rx_data;
-char *tx_data;
-
-/* Used for storing characters to/from VirtIO */
-char *virtio_rx_char;
-char *virtio_tx_char;
-
-struct virtq rx_virtq;
-struct virtq tx_virtq;
-uint16_t rx_last_seen_used = 0;
-uint16_t tx_last_seen_used = 0;
-
-uintptr_t virtio_rx_char_paddr;
-uintptr_t virtio_tx_char_paddr;
-
-/* Allocator for Rx descriptors */
-ialloc_t rx_ialloc_desc;
-uint32_t rx_descriptors[RX_COUNT];
-
-/* Allocator for storing Tx characters */
-ialloc_t tx_char_ialloc_desc;
-uint32_t tx_char_desc[TX_COUNT];
-
-/* Allocator for Tx descriptors */
-ialloc_t tx_ialloc_desc;
-uint32_t tx_descriptors[TX_COUNT];
-
-/* Allocator for storing Rx characters */
-ialloc_t rx_char_ialloc_desc;
-uint32_t rx_char_desc[RX_COUNT];
-
-int rx_last_desc_idx = 0;
-int tx_last_desc_idx = 0;
-
-static inline bool virtio_avail_full_rx(struct virtq *virtq)
+/* The number of entries, and buffers, in each virtqueue */
+#define QUEUE_SIZE 16
+
+/* Size of each control receive buffer, enough for a control message and a port name */
+#define CTRL_RX_BUF_SIZE 64
+
+/* When using the PCI transport, region 0 is the ECAM window and the BAR is placed here */
+#define PCI_BAR_REGION 4
+
+#define MAX_PORTS (SDDF_SERIAL_MAX_PORTS + 1)
+
+/* A virtqueue where descriptor i always refers to buffer i */
+typedef struct console_virtq {
+    uint16_t index;
+    struct virtq virtq;
+    uint16_t last_seen_used;
+    /* Allocator for descriptors, and so buffers */
+    ialloc_t desc_ialloc;
+    uint32_t descriptors[QUEUE_SIZE];
+    char *bufs;
+    uintptr_t bufs_paddr;
+    uint32_t buf_size;
+} console_virtq_t;
+
+typedef struct console_port {
+    bool rx_enabled;
+    sddf_channel rx_ch;
+    sddf_channel tx_ch;
+    /* Queues for communicating with the client */
+    serial_queue_handle_t rx_queue_handle;
+    serial_queue_handle_t tx_queue_handle;
+    console_virtq_t rx_virtq;
+    console_virtq_t tx_virtq;
+    /* Bytes of the oldest used receive buffer already passed to the client */
+    uint32_t rx_used_offset;
+} console_port_t;
+
+console_port_t ports[MAX_PORTS];
+uint32_t num_ports;
+
+bool multiport;
+console_virtq_t ctrl_rx_virtq;
+console_virtq_t ctrl_tx_virtq;
+
+virtio_transport_t transport;
+
+static void virtq_post(console_virtq_t *q, uint16_t *avail_idx, uint32_t desc_idx, uint32_t len, uint16_t flags)
 {
-    return rx_last_desc_idx >= rx_virtq.num;
+    assert(desc_idx < q->virtq.num);
+    q->virtq.desc[desc_idx].addr = q->bufs_paddr + desc_idx * q->buf_size;
+    q->virtq.desc[desc_idx].len = len;
+    q->virtq.desc[desc_idx].flags = flags;
+    q->virtq.avail->ring[*avail_idx % q->virtq.num] = desc_idx;
+    (*avail_idx)++;
 }
 
-static inline bool virtio_avail_full_tx(struct virtq *virtq)
+/* Make the entries posted up to avail_idx visible to the device and notify it */
+static void virtq_publish(console_virtq_t *q, uint16_t avail_idx)
 {
-    return tx_last_desc_idx >= tx_virtq.num;
-}
+    if (avail_idx == q->virtq.avail->idx) {
+        return;
+    }
 
-volatile virtio_mmio_regs_t *uart_regs;
+    THREAD_MEMORY_RELEASE();
+    q->virtq.avail->idx = avail_idx;
+    /* This assumes VIRTIO_F_NOTIFICATION_DATA has not been negotiated */
+    virtio_transport_queue_notify(&transport, q->index);
+}
 
-static void tx_provide(void)
+static void tx_provide(console_port_t *port)
 {
+    console_virtq_t *q = &port->tx_virtq;
+    serial_queue_handle_t *handle = &port->tx_queue_handle;
+    uint16_t avail_idx = q->virtq.avail->idx;
     bool transferred = false;
-    char c;
-    while (!virtio_avail_full_tx(&tx_virtq) && !serial_dequeue(&tx_queue_handle, &c)) {
-
-        /* First, allocate somewhere to put the character */
-        uint32_t char_idx = -1;
-        int err = ialloc_alloc(&tx_char_ialloc_desc, &char_idx);
-        assert(!err && char_idx != -1);
-
-        /* Now we need to a descriptor to put into the virtIO ring */
-        uint32_t pkt_desc_idx = -1;
-        err = ialloc_alloc(&tx_ialloc_desc, &pkt_desc_idx);
-        assert(!err && pkt_desc_idx != -1);
 
-        /* We should not run out of descriptors assuming that the avail ring is not full. */
-        assert(pkt_desc_idx < tx_virtq.num);
-
-        /* Put the character into the data region */
-        virtio_tx_char[char_idx] = c;
-
-        /* Set up the packet */
-        tx_virtq.desc[pkt_desc_idx].addr = virtio_tx_char_paddr + char_idx;
-        tx_virtq.desc[pkt_desc_idx].len = 1;
-        tx_virtq.desc[pkt_desc_idx].flags = 0;
-
-        /* Enqueue the packet */
-        tx_virtq.avail->ring[tx_virtq.avail->idx % tx_virtq.num] = pkt_desc_idx;
-
-        tx_virtq.avail->idx++;
-        tx_last_desc_idx += 1;
+    while (!serial_queue_empty(handle, handle->queue->head) && !ialloc_full(&q->desc_ialloc)) {
+        uint32_t desc_idx = -1;
+        int err = ialloc_alloc(&q->desc_ialloc, &desc_idx);
+        assert(!err && desc_idx != -1);
+
+        /* Fill the buffer with up to two contiguous spans, in case the data wraps around the queue */
+        char *buf = q->bufs + desc_idx * q->buf_size;
+        uint32_t len = 0;
+        while (len < q->buf_size && !serial_queue_empty(handle, handle->queue->head)) {
+            uint32_t num = MIN(serial_queue_contiguous_length(handle), q->buf_size - len);
+            sddf_memcpy(buf + len, handle->data_region + (handle->queue->head % handle->capacity), num);
+            serial_update_shared_head(handle, handle->queue->head + num);
+            len += num;
+        }
 
+        virtq_post(q, &avail_idx, desc_idx, len, 0);
         transferred = true;
     }
 
     if (transferred) {
-        /* Finally, need to notify the queue if we have transferred data */
-        /* This assumes VIRTIO_F_NOTIFICATION_DATA has not been negotiated */
-        uart_regs->QueueNotify = VIRTIO_SERIAL_TX_QUEUE;
-        if (serial_require_consumer_signal(&tx_queue_handle)) {
-            serial_cancel_consumer_signal(&tx_queue_handle);
-            sddf_notify(config.tx.id);
+        virtq_publish(q, avail_idx);
+        if (serial_require_consumer_signal(handle)) {
+            serial_cancel_consumer_signal(handle);
+            sddf_notify(port->tx_ch);
         }
     }
 }
 
-static void tx_return(void)
+/* Free the descriptors the device has finished with */
+static void virtq_reclaim(console_virtq_t *q)
 {
-    /* After the tx has been processed, we need to free the packet/character allocation */
-    uint16_t enqueued = 0;
-    uint16_t i = tx_last_seen_used;
-    uint16_t curr_idx = tx_virtq.used->idx;
-
-    while (i != curr_idx) {
-        struct virtq_used_elem pkt_used = tx_virtq.used->ring[i % tx_virtq.num];
-        struct virtq_desc pkt = tx_virtq.desc[pkt_used.id];
+    uint16_t curr_idx = q->virtq.used->idx;
+    THREAD_MEMORY_ACQUIRE();
 
-        uint64_t addr = pkt.addr;
-
-        /* Free the packet */
-        int err = ialloc_free(&tx_ialloc_desc, pkt_used.id);
-        assert(!err);
-
-        /* Free the character */
-        int char_idx = addr - virtio_tx_char_paddr;
-        err = ialloc_free(&tx_char_ialloc_desc, char_idx);
+    while (q->last_seen_used != curr_idx) {
+        struct virtq_used_elem used = q->virtq.used->ring[q->last_seen_used % q->virtq.num];
+        int err = ialloc_free(&q->desc_ialloc, used.id);
         assert(!err);
-
-        tx_last_desc_idx -= 1;
-        assert(tx_last_desc_idx >= 0);
-        i++;
-
-        enqueued++;
+        q->last_seen_used++;
     }
-
-    tx_last_seen_used += enqueued;
 }
 
-static void rx_provide(void)
+static void tx_return(console_port_t *port)
 {
-    /* Fill up the virtio available ring buffer */
-    bool transferred = false;
-    while (!virtio_avail_full_rx(&rx_virtq)) {
-        // Allocate a desc entry for the packet and the character
-        uint32_t pkt_desc_idx = -1;
-        int err = ialloc_alloc(&rx_ialloc_desc, &pkt_desc_idx);
-        assert(!err && pkt_desc_idx != -1);
-
-        uint32_t char_idx = -1;
-        err = ialloc_alloc(&rx_char_ialloc_desc, &char_idx);
-        assert(!err && char_idx != -1);
-
-        assert(pkt_desc_idx < rx_virtq.num);
-        assert(char_idx < rx_virtq.num);
-
-        /* The packet will point to the memory we have reserved for the character */
-        rx_virtq.desc[pkt_desc_idx].addr = virtio_rx_char_paddr + char_idx;
-        rx_virtq.desc[pkt_desc_idx].len = 1;
-        rx_virtq.desc[pkt_desc_idx].flags = VIRTQ_DESC_F_WRITE;
-
-        // Set the entry in the available ring to point to the descriptor entry fort he packet
-        rx_virtq.avail->ring[rx_virtq.avail->idx % rx_virtq.num] = pkt_desc_idx;
-        rx_virtq.avail->idx++;
-        rx_last_desc_idx += 1;
+    virtq_reclaim(&port->tx_virtq);
+}
 
-        transferred = true;
+static void rx_provide(console_port_t *port)
+{
+    /* Post every free buffer at once */
+    console_virtq_t *q = &port->rx_virtq;
+    uint16_t avail_idx = q->virtq.avail->idx;
+    uint32_t desc_idx;
+    while (!ialloc_alloc(&q->desc_ialloc, &desc_idx)) {
+        virtq_post(q, &avail_idx, desc_idx, q->buf_size, VIRTQ_DESC_F_WRITE);
     }
 
-    if (transferred) {
-        /* We have added more avail buffers, so notify the device */
-        uart_regs->QueueNotify = VIRTIO_SERIAL_RX_QUEUE;
-    }
+    virtq_publish(q, avail_idx);
 }
 
-static void rx_return(void)
+static void rx_return(console_port_t *port)
 {
     /* Extract RX buffers from the 'used' and pass them up to the client by putting them
      * in the sDDF receive queue. */
-    uint16_t transferred = 0;
-    uint16_t i = rx_last_seen_used;
-    uint16_t curr_idx = rx_virtq.used->idx;
+    console_virtq_t *q = &port->rx_virtq;
+    serial_queue_handle_t *handle = &port->rx_queue_handle;
+    bool transferred = false;
+    bool freed = false;
+    uint16_t curr_idx = q->virtq.used->idx;
+    THREAD_MEMORY_ACQUIRE();
     bool reprocess = true;
 
     while (reprocess) {
-        while (i != curr_idx && !serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
-            struct virtq_used_elem pkt_used = rx_virtq.used->ring[i % rx_virtq.num];
-            struct virtq_desc pkt = rx_virtq.desc[pkt_used.id];
-
-            uint64_t addr = pkt.addr;
-            assert(!(pkt.flags & VIRTQ_DESC_F_NEXT));
-
-            uint32_t char_idx = addr - virtio_rx_char_paddr;
-            serial_enqueue(&rx_queue_handle, virtio_rx_char[char_idx]);
-
-                /* Free the packet descriptor */
-            int err = ialloc_free(&rx_ialloc_desc, pkt_used.id);
+        while (q->last_seen_used != curr_idx && !serial_queue_full(handle, handle->queue->tail)) {
+            struct virtq_used_elem used = q->virtq.used->ring[q->last_seen_used % q->virtq.num];
+            assert(used.len <= q->buf_size);
+
+            char *buf = q->bufs + used.id * q->buf_size;
+            uint32_t remaining = used.len - port->rx_used_offset;
+            uint32_t num = serial_enqueue_batch(handle, remaining, buf + port->rx_used_offset);
+            transferred |= num > 0;
+            if (num < remaining) {
+                /* The client's queue is full, continue from here once it has room */
+                port->rx_used_offset += num;
+                break;
+            }
+
+            port->rx_used_offset = 0;
+            int err = ialloc_free(&q->desc_ialloc, used.id);
             assert(!err);
-
-                /* Free the character */
-            err = ialloc_free(&rx_char_ialloc_desc, char_idx);
-            assert(!err);
-
-            rx_last_desc_idx -= 1;
-            assert(rx_last_desc_idx >= 0);
-            i++;
-            transferred++;
+            q->last_seen_used++;
+            freed = true;
         }
 
-        if (i != curr_idx && serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
-            serial_request_consumer_signal(&rx_queue_handle);
+        if (q->last_seen_used != curr_idx && serial_queue_full(handle, handle->queue->tail)) {
+            serial_request_consumer_signal(handle);
         }
         reprocess = false;
 
-        if (i != curr_idx && !serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
-            serial_cancel_consumer_signal(&rx_queue_handle);
+        if (q->last_seen_used != curr_idx && !serial_queue_full(handle, handle->queue->tail)) {
+            serial_cancel_consumer_signal(handle);
             reprocess = true;
         }
     }
 
-    rx_last_seen_used += transferred;
+    if (transferred) {
+        sddf_notify(port->rx_ch);
+    }
 
-    if (transferred > 0) {
-        sddf_notify(config.rx.id);
+    if (freed) {
+        rx_provide(port);
     }
 }
 
-void console_setup()
+static void ctrl_send(uint32_t id, uint16_t event, uint16_t value)
 {
-    if (!virtio_mmio_check_magic(uart_regs)) {
-        LOG_DRIVER_ERR("invalid virtIO magic value!\n");
+    console_virtq_t *q = &ctrl_tx_virtq;
+    virtq_reclaim(q);
+
+    uint32_t desc_idx;
+    if (ialloc_alloc(&q->desc_ialloc, &desc_idx)) {
+        LOG_DRIVER_ERR("no control buffer to send event %u for port %u\n", event, id);
         return;
     }
 
-    if (!virtio_mmio_check_device_id(uart_regs, VIRTIO_DEVICE_ID_CONSOLE)) {
-        LOG_DRIVER_ERR("Not a virtIO console device!\n");
-        return;
+    virtio_console_control_t *msg = (virtio_console_control_t *)(q->bufs + desc_idx * q->buf_size);
+    msg->id = id;
+    msg->event = event;
+    msg->value = value;
+
+    uint16_t avail_idx = q->virtq.avail->idx;
+    virtq_post(q, &avail_idx, desc_idx, sizeof(virtio_console_control_t), 0);
+    virtq_publish(q, avail_idx);
+}
+
+static void ctrl_handle(virtio_console_control_t *msg)
+{
+    switch (msg->event) {
+    case VIRTIO_CONSOLE_DEVICE_ADD:
+        if (msg->id < num_ports) {
+            ctrl_send(msg->id, VIRTIO_CONSOLE_PORT_READY, 1);
+            ctrl_send(msg->id, VIRTIO_CONSOLE_PORT_OPEN, 1);
+        } else {
+            /* No client for this port */
+            ctrl_send(msg->id, VIRTIO_CONSOLE_PORT_READY, 0);
+        }
+        break;
+    case VIRTIO_CONSOLE_CONSOLE_PORT:
+        if (msg->id < num_ports) {
+            ctrl_send(msg->id, VIRTIO_CONSOLE_PORT_OPEN, 1);
+        }
+        break;
+    case VIRTIO_CONSOLE_DEVICE_REMOVE:
+    case VIRTIO_CONSOLE_PORT_OPEN:
+    case VIRTIO_CONSOLE_PORT_NAME:
+    case VIRTIO_CONSOLE_RESIZE:
+        LOG_DRIVER("port %u event %u value %u\n", msg->id, msg->event, msg->value);
+        break;
+    default:
+        LOG_DRIVER_ERR("unexpected control event %u for port %u\n", msg->event, msg->id);
+        break;
     }
+}
 
-    if (virtio_mmio_version(uart_regs) != VIRTIO_VERSION) {
-        LOG_DRIVER_ERR("not correct virtIO version!\n");
-        return;
+static void ctrl_rx_return(void)
+{
+    console_virtq_t *q = &ctrl_rx_virtq;
+    uint16_t curr_idx = q->virtq.used->idx;
+    THREAD_MEMORY_ACQUIRE();
+
+    uint16_t avail_idx = q->virtq.avail->idx;
+    while (q->last_seen_used != curr_idx) {
+        struct virtq_used_elem used = q->virtq.used->ring[q->last_seen_used % q->virtq.num];
+        if (used.len >= sizeof(virtio_console_control_t)) {
+            ctrl_handle((virtio_console_control_t *)(q->bufs + used.id * q->buf_size));
+        }
+
+        /* Give the buffer straight back to the device */
+        virtq_post(q, &avail_idx, used.id, q->buf_size, VIRTQ_DESC_F_WRITE);
+        q->last_seen_used++;
     }
 
-    LOG_DRIVER("version: 0x%x\n", virtio_mmio_version(uart_regs));
+    virtq_publish(q, avail_idx);
+}
 
-    // Do normal device initialisation (section 3.2)
-    // First reset the device
-    uart_regs->Status = 0;
+/* Lay out a virtqueue in the hardware ring buffer region at *offset and give it to the device */
+static int virtq_setup(console_virtq_t *q, uint16_t index, size_t *offset, char *bufs, uintptr_t bufs_paddr,
+                       uint32_t buf_size)
+{
+    size_t desc_off = ALIGN(*offset, 16);
+    size_t avail_off = ALIGN(desc_off + (16 * QUEUE_SIZE), 2);
+    size_t used_off = ALIGN(avail_off + (6 + 2 * QUEUE_SIZE), 4);
+    *offset = used_off + (6 + 8 * QUEUE_SIZE);
+    if (*offset > device_resources.regions[1].region.size) {
+        LOG_DRIVER_ERR("hardware ring buffer region is too small for virtqueue %u\n", index);
+        return -1;
+    }
 
-    // Set the ACKNOWLEDGE bit to say we have noticed the device
-    uart_regs->Status = VIRTIO_DEVICE_STATUS_ACKNOWLEDGE;
+    q->index = index;
+    q->virtq.num = QUEUE_SIZE;
+    q->virtq.desc = (struct virtq_desc *)(hw_ring_buffer_vaddr + desc_off);
+    q->virtq.avail = (struct virtq_avail *)(hw_ring_buffer_vaddr + avail_off);
+    q->virtq.used = (struct virtq_used *)(hw_ring_buffer_vaddr + used_off);
+    q->last_seen_used = 0;
+    q->bufs = bufs;
+    q->bufs_paddr = bufs_paddr;
+    q->buf_size = buf_size;
+    ialloc_init(&q->desc_ialloc, q->descriptors, QUEUE_SIZE);
+
+    return virtio_transport_queue_setup(&transport, index, QUEUE_SIZE, hw_ring_buffer_paddr + desc_off,
+                                        hw_ring_buffer_paddr + avail_off, hw_ring_buffer_paddr + used_off,
+                                        VIRTIO_MSI_NO_VECTOR);
+}
 
-        // Set the DRIVER bit to say we know how to drive the device
-    uart_regs->Status = VIRTIO_DEVICE_STATUS_DRIVER;
+void console_setup()
+{
+    if (virtio_transport_init(&transport, &device_resources, PCI_BAR_REGION, VIRTIO_DEVICE_ID_CONSOLE)) {
+        LOG_DRIVER_ERR("could not find virtIO console device!\n");
+        return;
+    }
+
+    // Do normal device initialisation (section 3.2)
+    virtio_transport_reset(&transport);
 
+    uint64_t device_features = virtio_transport_device_features(&transport);
 #ifdef DEBUG_DRIVER
-    uint32_t features_low = uart_regs->DeviceFeatures;
-    uart_regs->DeviceFeaturesSel = 1;
-    uint32_t features_high = uart_regs->DeviceFeatures;
-    uint64_t features = features_low | ((uint64_t)features_high << 32);
-    virtio_console_print_features(features);
+    virtio_console_print_features(device_features);
 #endif /* DEBUG_DRIVER */
 
-    uart_regs->Status = VIRTIO_DEVICE_STATUS_FEATURES_OK;
+    /* VIRTIO_F_VERSION_1 is required by the PCI transport to use the non-legacy interface */
+    uint64_t driver_features = BIT(VIRTIO_F_VERSION_1);
+    multiport = config.num_ports > 0 && (device_features & BIT(VIRTIO_CONSOLE_F_MULTIPORT));
+    if (multiport) {
+        driver_features |= BIT(VIRTIO_CONSOLE_F_MULTIPORT);
+    } else if (config.num_ports > 0) {
+        LOG_DRIVER_ERR("device does not support multiple ports, only using port 0\n");
+    }
 
-    if (!(uart_regs->Status & VIRTIO_DEVICE_STATUS_FEATURES_OK)) {
+    if (virtio_transport_set_driver_features(&transport, driver_features)) {
         LOG_DRIVER_ERR("device status features is not OK!\n");
         return;
     }
 
-    // Setup the virtqueues
-    size_t rx_desc_off = 0;
-    size_t rx_avail_off = ALIGN(rx_desc_off + (16 * RX_COUNT), 2);
-    size_t rx_used_off = ALIGN(rx_avail_off + (6 + 2 * RX_COUNT), 4);
-    size_t tx_desc_off = ALIGN(rx_used_off + (6 + 8 * RX_COUNT), 16);
-    size_t tx_avail_off = ALIGN(tx_desc_off + (16 * TX_COUNT), 2);
-    size_t tx_used_off = ALIGN(tx_avail_off + (6 + 2 * TX_COUNT), 4);
-
-    rx_virtq.num = RX_COUNT;
-    rx_virtq.desc = (struct virtq_desc *)(hw_ring_buffer_vaddr + rx_desc_off);
-    rx_virtq.avail = (struct virtq_avail *)(hw_ring_buffer_vaddr + rx_avail_off);
-    rx_virtq.used = (struct virtq_used *)(hw_ring_buffer_vaddr + rx_used_off);
-
-    assert((uintptr_t)rx_virtq.desc % 16 == 0);
-    assert((uintptr_t)rx_virtq.avail % 2 == 0);
-    assert((uintptr_t)rx_virtq.used % 4 == 0);
-
-    tx_virtq.num = TX_COUNT;
-    tx_virtq.desc = (struct virtq_desc *)(hw_ring_buffer_vaddr + tx_desc_off);
-    tx_virtq.avail = (struct virtq_avail *)(hw_ring_buffer_vaddr + tx_avail_off);
-    tx_virtq.used = (struct virtq_used *)(hw_ring_buffer_vaddr + tx_used_off);
-
-    assert((uintptr_t)tx_virtq.desc % 16 == 0);
-    assert((uintptr_t)tx_virtq.avail % 2 == 0);
-    assert((uintptr_t)tx_virtq.used % 4 == 0);
-
-    /* Load the Rx queue with free buffers */
-    rx_provide();
-
-    // Setup RX queue first
-    assert(uart_regs->QueueNumMax >= RX_COUNT);
-    uart_regs->QueueSel = VIRTIO_SERIAL_RX_QUEUE;
-    uart_regs->QueueNum = RX_COUNT;
-    uart_regs->QueueDescLow = (hw_ring_buffer_paddr + rx_desc_off) & 0xFFFFFFFF;
-    uart_regs->QueueDescHigh = (hw_ring_buffer_paddr + rx_desc_off) >> 32;
-    uart_regs->QueueDriverLow = (hw_ring_buffer_paddr + rx_avail_off) & 0xFFFFFFFF;
-    uart_regs->QueueDriverHigh = (hw_ring_buffer_paddr + rx_avail_off) >> 32;
-    uart_regs->QueueDeviceLow = (hw_ring_buffer_paddr + rx_used_off) & 0xFFFFFFFF;
-    uart_regs->QueueDeviceHigh = (hw_ring_buffer_paddr + rx_used_off) >> 32;
-    uart_regs->QueueReady = 1;
-
-    // Setup TX queue
-    assert(uart_regs->QueueNumMax >= TX_COUNT);
-    uart_regs->QueueSel = VIRTIO_SERIAL_TX_QUEUE;
-    uart_regs->QueueNum = TX_COUNT;
-    uart_regs->QueueDescLow = (hw_ring_buffer_paddr + tx_desc_off) & 0xFFFFFFFF;
-    uart_regs->QueueDescHigh = (hw_ring_buffer_paddr + tx_desc_off) >> 32;
-    uart_regs->QueueDriverLow = (hw_ring_buffer_paddr + tx_avail_off) & 0xFFFFFFFF;
-    uart_regs->QueueDriverHigh = (hw_ring_buffer_paddr + tx_avail_off) >> 32;
-    uart_regs->QueueDeviceLow = (hw_ring_buffer_paddr + tx_used_off) & 0xFFFFFFFF;
-    uart_regs->QueueDeviceHigh = (hw_ring_buffer_paddr + tx_used_off) >> 32;
-    uart_regs->QueueReady = 1;
+    num_ports = 1;
+    if (multiport) {
+        virtio_console_config_t *console_config = (virtio_console_config_t *)virtio_transport_config(&transport);
+        num_ports = MIN(1 + config.num_ports, console_config->max_nr_ports);
+    }
+
+    /* Split the buffer regions between the control queues and the ports */
+    char *rx_bufs = device_resources.regions[2].region.vaddr;
+    uintptr_t rx_bufs_paddr = device_resources.regions[2].io_addr;
+    uint64_t rx_bufs_size = device_resources.regions[2].region.size;
+    char *tx_bufs = device_resources.regions[3].region.vaddr;
+    uintptr_t tx_bufs_paddr = device_resources.regions[3].io_addr;
+    uint64_t tx_bufs_size = device_resources.regions[3].region.size;
+
+    size_t ring_offset = 0;
+    if (multiport) {
+        uint32_t ctrl_rx_size = QUEUE_SIZE * CTRL_RX_BUF_SIZE;
+        uint32_t ctrl_tx_size = QUEUE_SIZE * sizeof(virtio_console_control_t);
+        if (virtq_setup(&ctrl_rx_virtq, VIRTIO_CONSOLE_CTRL_RX_QUEUE, &ring_offset, rx_bufs, rx_bufs_paddr,
+                        CTRL_RX_BUF_SIZE)
+            || virtq_setup(&ctrl_tx_virtq, VIRTIO_CONSOLE_CTRL_TX_QUEUE, &ring_offset, tx_bufs, tx_bufs_paddr,
+                           sizeof(virtio_console_control_t))) {
+            LOG_DRIVER_ERR("could not set up control queues\n");
+            return;
+        }
+        rx_bufs += ctrl_rx_size;
+        rx_bufs_paddr += ctrl_rx_size;
+        rx_bufs_size -= ctrl_rx_size;
+        tx_bufs += ctrl_tx_size;
+        tx_bufs_paddr += ctrl_tx_size;
+        tx_bufs_size -= ctrl_tx_size;
+    }
+
+    uint32_t rx_buf_size = rx_bufs_size / num_ports / QUEUE_SIZE;
+    uint32_t tx_buf_size = tx_bufs_size / num_ports / QUEUE_SIZE;
+    assert(rx_buf_size > 0 && tx_buf_size > 0);
+
+    for (uint32_t i = 0; i < num_ports; i++) {
+        console_port_t *port = &ports[i];
+        uint32_t rx_offset = i * QUEUE_SIZE * rx_buf_size;
+        uint32_t tx_offset = i * QUEUE_SIZE * tx_buf_size;
+        if (virtq_setup(&port->rx_virtq, VIRTIO_CONSOLE_PORT_RX_QUEUE(i), &ring_offset, rx_bufs + rx_offset,
+                        rx_bufs_paddr + rx_offset, rx_buf_size)
+            || virtq_setup(&port->tx_virtq, VIRTIO_CONSOLE_PORT_TX_QUEUE(i), &ring_offset, tx_bufs + tx_offset,
+                           tx_bufs_paddr + tx_offset, tx_buf_size)) {
+            LOG_DRIVER_ERR("could not set up queues of port %u\n", i);
+            return;
+        }
+    }
 
     // Set the DRIVER_OK status bit
-    uart_regs->Status = VIRTIO_DEVICE_STATUS_DRIVER_OK;
-    uart_regs->InterruptACK = VIRTIO_MMIO_IRQ_VQUEUE;
+    virtio_transport_driver_ok(&transport);
+    virtio_transport_irq_ack(&transport, VIRTIO_IRQ_VQUEUE);
+
+    /* Load the Rx queues with free buffers */
+    for (uint32_t i = 0; i < num_ports; i++) {
+        if (ports[i].rx_enabled) {
+            rx_provide(&ports[i]);
+        }
+    }
+
+    if (multiport) {
+        uint16_t avail_idx = ctrl_rx_virtq.virtq.avail->idx;
+        uint32_t desc_idx;
+        while (!ialloc_alloc(&ctrl_rx_virtq.desc_ialloc, &desc_idx)) {
+            virtq_post(&ctrl_rx_virtq, &avail_idx, desc_idx, CTRL_RX_BUF_SIZE, VIRTQ_DESC_F_WRITE);
+        }
+        virtq_publish(&ctrl_rx_virtq, avail_idx);
+
+        /* The device now announces its ports with DEVICE_ADD */
+        ctrl_send(0, VIRTIO_CONSOLE_DEVICE_READY, 1);
+    }
 }
 
 static void handle_irq()
 {
-    uint32_t irq_status = uart_regs->InterruptStatus;
-    if (irq_status & VIRTIO_MMIO_IRQ_VQUEUE) {
-        // We don't know whether the IRQ is related to a change to the RX queue
-        // or TX queue, so we check both.
-        rx_return();
-        rx_provide(); // Refill the virtio Rx queue
-        tx_return();
-        tx_provide();
+    uint32_t irq_status = virtio_transport_irq_status(&transport);
+    if (irq_status & VIRTIO_IRQ_VQUEUE) {
+        // We don't know which queue the IRQ is related to, so we check all of them.
+        if (multiport) {
+            ctrl_rx_return();
+            virtq_reclaim(&ctrl_tx_virtq);
+        }
+        for (uint32_t i = 0; i < num_ports; i++) {
+            if (ports[i].rx_enabled) {
+                rx_return(&ports[i]);
+            }
+            tx_return(&ports[i]);
+            tx_provide(&ports[i]);
+        }
         // We have handled the used buffer notification
-        uart_regs->InterruptACK = VIRTIO_MMIO_IRQ_VQUEUE;
+        virtio_transport_irq_ack(&transport, VIRTIO_IRQ_VQUEUE);
     }
 
-    if (irq_status & VIRTIO_MMIO_IRQ_CONFIG) {
-        LOG_DRIVER_ERR("unexpected change in configuration %u\n", irq_status);
+    if (irq_status & VIRTIO_IRQ_CONFIG) {
+        LOG_DRIVER("configuration change %u\n", irq_status);
     }
 }
 
+static void port_init(console_port_t *port, serial_connection_resource_t *rx, serial_connection_resource_t *tx,
+                      bool rx_enabled)
+{
+    port->rx_enabled = rx_enabled;
+    port->rx_ch = rx->id;
+    port->tx_ch = tx->id;
+    if (rx_enabled) {
+        serial_queue_init(&port->rx_queue_handle, rx->queue.vaddr, rx->data.size, rx->data.vaddr);
+    }
+    serial_queue_init(&port->tx_queue_handle, tx->queue.vaddr, tx->data.size, tx->data.vaddr);
+}
+
 void init()
 {
     assert(serial_config_check_magic(&config));
     assert(device_resources_check_magic(&device_resources));
     assert(device_resources.num_irqs == 1);
-    assert(device_resources.num_regions == 4);
+    /* The PCI transport has an extra region for the BAR */
+    assert(device_resources.num_regions == 4 || device_resources.num_regions == PCI_BAR_REGION + 1);
+    assert(config.num_ports <= SDDF_SERIAL_MAX_PORTS);
 
-    uart_regs = (volatile virtio_mmio_regs_t *)device_resources.regions[0].region.vaddr;
     hw_ring_buffer_vaddr = (uintptr_t)device_resources.regions[1].region.vaddr;
     hw_ring_buffer_paddr = device_resources.regions[1].io_addr;
-    virtio_rx_char = device_resources.regions[2].region.vaddr;
-    virtio_rx_char_paddr = device_resources.regions[2].io_addr;
-    virtio_tx_char = device_resources.regions[3].region.vaddr;
-    virtio_tx_char_paddr = device_resources.regions[3].io_addr;
 
-    ialloc_init(&rx_ialloc_desc, rx_descriptors, RX_COUNT);
-    ialloc_init(&tx_ialloc_desc, tx_descriptors, TX_COUNT);
-    ialloc_init(&tx_char_ialloc_desc, tx_char_desc, TX_COUNT);
-    ialloc_init(&rx_char_ialloc_desc, rx_char_desc, RX_COUNT);
+    port_init(&ports[0], &config.rx, &config.tx, config.rx_enabled);
+    for (uint32_t i = 0; i < config.num_ports; i++) {
+        port_init(&ports[i + 1], &config.ports[i].rx, &config.ports[i].tx, config.ports[i].rx_enabled);
+    }
 
+    boot_trace_begin("console setup");
     console_setup();
-
-    if (config.rx_enabled) {
-        serial_queue_init(&rx_queue_handle, config.rx.queue.vaddr, config.rx.data.size, config.rx.data.vaddr);
-    }
-    serial_queue_init(&tx_queue_handle, config.tx.queue.vaddr, config.tx.data.size, config.tx.data.vaddr);
+    boot_trace_end("console setup");
 
     sddf_irq_ack(device_resources.irqs[0].id);
 }
@@ -416,11 +502,18 @@ void notified(sddf_channel ch)
     if (ch == device_resources.irqs[0].id) {
         handle_irq();
         sddf_deferred_irq_ack(ch);
-    } else if (ch == config.tx.id) {
-        tx_provide();
-    } else if (ch == config.rx.id) {
-        rx_return();
-    } else {
-        LOG_DRIVER_ERR("received notification on unexpected channel: %u\n", ch);
+        return;
+    }
+
+    for (uint32_t i = 0; i < num_ports; i++) {
+        if (ch == ports[i].tx_ch) {
+            tx_provide(&ports[i]);
+            return;
+        } else if (ports[i].rx_enabled && ch == ports[i].rx_ch) {
+            rx_return(&ports[i]);
+            return;
+        }
     }
+
+    LOG_DRIVER_ERR("received notification on unexpected channel: %u\n", ch);
 }
@@ -19,6 +19,36 @@
 #define VIRTIO_CONSOLE_F_MULTIPORT 1
 #define VIRTIO_CONSOLE_F_EMERG_WRITE 2
 
+/* 5.3.4 Device configuration layout */
+typedef volatile struct __attribute__((packed)) virtio_console_config {
+    uint16_t cols;
+    uint16_t rows;
+    uint32_t max_nr_ports;
+    uint32_t emerg_wr;
+} virtio_console_config_t;
+
+/* 5.3.6.2 Multiport Device Operation, sent on the control queues */
+typedef struct __attribute__((packed)) virtio_console_control {
+    uint32_t id;
+    uint16_t event;
+    uint16_t value;
+} virtio_console_control_t;
+
+#define VIRTIO_CONSOLE_DEVICE_READY 0
+#define VIRTIO_CONSOLE_DEVICE_ADD 1
+#define VIRTIO_CONSOLE_DEVICE_REMOVE 2
+#define VIRTIO_CONSOLE_PORT_READY 3
+#define VIRTIO_CONSOLE_CONSOLE_PORT 4
+#define VIRTIO_CONSOLE_RESIZE 5
+#define VIRTIO_CONSOLE_PORT_OPEN 6
+#define VIRTIO_CONSOLE_PORT_NAME 7
+
+/* Port 0 uses queues 0 and 1, the control queues are 2 and 3, port n > 0 uses 2(n + 1) and 2(n + 1) + 1 */
+#define VIRTIO_CONSOLE_CTRL_RX_QUEUE 2
+#define VIRTIO_CONSOLE_CTRL_TX_QUEUE 3
+#define VIRTIO_CONSOLE_PORT_RX_QUEUE(port) ((port) == 0 ? 0 : 2 * ((port) + 1))
+#define VIRTIO_CONSOLE_PORT_TX_QUEUE(port) (VIRTIO_CONSOLE_PORT_RX_QUEUE(port) + 1)
+
 static void virtio_console_print_features(uint64_t features)
 {
     if (features & ((uint64_t)1 << VIRTIO_CONSOLE_F_SIZE)) {
@@ -52,6 +52,9 @@ typedef volatile struct zynqmp_uart_regs zynqmp_uart_regs_t;
 #define UART_CR_RX_EN       (1 << 2)
 #define UART_CR_RX_DIS      (1 << 3)
 
+#define UART_FIFO_DEPTH     64          /* Depth of the tx and rx FIFOs in characters. */
+#define UART_RX_TIMEOUT     10          /* Rx timeout in units of 4 bit periods. */
+
 #define XUARTPS_MR_CCLK				0x00000400U /**< Input clock selection */
 #define XUARTPS_MR_CHMODE_R_LOOP	0x00000300U /**< Remote loopback mode */
 #define XUARTPS_MR_CHMODE_L_LOOP	0x00000200U /**< Local loopback mode */
@@ -94,6 +97,9 @@ typedef volatile struct zynqmp_uart_regs zynqmp_uart_regs_t;
 #define XUARTPS_IXR_RXOVR  	0x00000001U /**< RX FIFO trigger interrupt. */
 #define XUARTPS_IXR_MASK	0x00003FFFU /**< Valid bit mask */
 
+/* Rx FIFO trigger and timeout interrupts */
+#define UART_RX_IRQS        (XUARTPS_IXR_RXOVR | XUARTPS_IXR_TOUT)
+
 // FIXME: BELOW SHOULD BE UNUSED, ABOVE SHOULD USE ZYNQMP PREFIX.
 
 /* Data Register bits */
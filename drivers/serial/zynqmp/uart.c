@@ -54,15 +54,17 @@ static void tx_provide(void)
         transferred = true;
     }
 
-    /* If transmit fifo is full and there is data remaining to be sent, enable interrupt when fifo is no longer full */
-    if (uart_regs->sr & UART_CHANNEL_STS_TXFULL && !serial_queue_empty(&tx_queue_handle, tx_queue_handle.queue->head)) {
-        // sddf_dprintf("UART|LOG: Inside tx_provide and TX FIFO is full.\n");
-        uart_regs->cr &= ~UART_CR_TX_EN;
-        uart_regs->cr |= UART_CR_TX_DIS;
+    /*
+     * If there is data remaining to be sent, the fifo is full. Enable interrupt when it is empty to refill all of
+     * it. The tx trigger interrupt is raised when the fifo fills up to the trigger level rather than when it
+     * drains to it, so the transmit threshold of the config is not used. The TXEMPTY status is sticky, clear any
+     * stale status from before the refill so the interrupt is only raised once the fifo has actually drained.
+     */
+    if (!serial_queue_empty(&tx_queue_handle, tx_queue_handle.queue->head)) {
+        uart_regs->isr = XUARTPS_IXR_TXEMPTY;
+        uart_regs->ier = XUARTPS_IXR_TXEMPTY;
     } else {
-        // sddf_dprintf("UART|LOG: Inside tx_provide and TX FIFO is NOT full but we are inside ELSE of IF.\n");
-        uart_regs->cr |= UART_CR_TX_EN;
-        uart_regs->cr &= ~UART_CR_TX_DIS;
+        uart_regs->idr = XUARTPS_IXR_TXEMPTY;
     }
 
     if (transferred && serial_require_consumer_signal(&tx_queue_handle)) {
@@ -76,32 +78,25 @@ static void tx_provide(void)
 
 static void rx_return(void)
 {
-    // sddf_dprintf("UART|LOG: Inside rx_return.\n");
-
-    // FIXME: My RX handler does NOT take TIMEOUT into account, should it?
-
     bool reprocess = true;
     bool enqueued = false;
     while (reprocess) {
         while (!(uart_regs->sr & UART_CHANNEL_STS_RXEMPTY) && !serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
             char c = (char)(uart_regs->fifo);
-            sddf_dprintf("UART|LOG: Got c: %c\n", c);
             serial_enqueue(&rx_queue_handle, c);
             enqueued = true;
         }
 
         if (!(uart_regs->sr & UART_CHANNEL_STS_RXEMPTY) && serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
             /* Disable rx interrupts until virtualisers queue is no longer full. */
-            uart_regs->cr &= ~UART_CR_RX_EN;
-            uart_regs->cr |= UART_CR_RX_DIS;
+            uart_regs->idr = UART_RX_IRQS;
             serial_request_consumer_signal(&rx_queue_handle);
         }
         reprocess = false;
 
         if (!(uart_regs->sr & UART_CHANNEL_STS_RXEMPTY) && !serial_queue_full(&rx_queue_handle, rx_queue_handle.queue->tail)) {
             serial_cancel_consumer_signal(&rx_queue_handle);
-            uart_regs->cr |= UART_CR_RX_EN;
-            uart_regs->cr &= ~UART_CR_RX_DIS;
+            uart_regs->ier = UART_RX_IRQS;
             reprocess = true;
         }
     }
@@ -130,20 +125,17 @@ void uart_put_char(int ch)
 
 static void handle_irq(void)
 {
-    // FIXME: Do I need to clear the interrupt status or not?
-    // uart_regs->isr = XUARTPS_IXR_RXOVR; 
-                        // XUARTPS_IXR_RXEMPTY |
-                        // XUARTPS_IXR_RXFULL;
-
-    uint32_t uart_cr_reg = uart_regs->cr;
-    while (uart_cr_reg & UART_CR_RX_EN || uart_cr_reg & UART_CR_TX_EN) {
-        if (uart_cr_reg & UART_CR_RX_EN) {
+    /* Interrupt status bits are sticky and cleared by writing 1 to them */
+    uint32_t uart_isr = uart_regs->isr & uart_regs->imr;
+    while (uart_isr) {
+        uart_regs->isr = uart_isr;
+        if (uart_isr & UART_RX_IRQS) {
             rx_return();
         }
-        if (uart_cr_reg & UART_CR_TX_EN) {
+        if (uart_isr & XUARTPS_IXR_TXEMPTY) {
             tx_provide();
         }
-        uart_cr_reg = uart_regs->cr;
+        uart_isr = uart_regs->isr & uart_regs->imr;
     }
 }
 
@@ -179,16 +171,16 @@ static void uart_setup(void)
 
 	uart_regs->mr = mode; 
 
-	/* Set the RX FIFO trigger at 1 data byte */
-	uart_regs->rxwm = 0x01U; 
+    /* Set the RX FIFO trigger at the threshold, data below it raises the timeout interrupt */
+    uart_regs->rxwm = serial_fifo_threshold(config.rx_fifo_threshold, SDDF_SERIAL_RX_FIFO_THRESHOLD_DEFAULT,
+                                            UART_FIFO_DEPTH - 1);
+    uart_regs->rxtout = UART_RX_TIMEOUT;
 
-	/* Set the RX timeout to 1 */
-    uart_regs->rxtout = 0x01U;
-
-    // Enable interrupt when a new character is added to RX FIFO
-    uart_regs->ier =    XUARTPS_IXR_RXOVR; 
-                        // XUARTPS_IXR_RXEMPTY |
-                        // XUARTPS_IXR_RXFULL;  
+    uart_regs->idr = XUARTPS_IXR_MASK;
+    uart_regs->isr = XUARTPS_IXR_MASK;
+    if (config.rx_enabled) {
+        uart_regs->ier = UART_RX_IRQS;
+    }
 
     uart_put_str("UART|LOG: Initialised UART!\n");
 
@@ -274,17 +266,12 @@ static void uart_setup(void)
  void notified(microkit_channel ch)
  {
      if (ch == device_resources.irqs[0].id) {
-         sddf_dprintf("UART|LOG: In NOTIFIED: handle_irq\n");
          handle_irq();
          microkit_deferred_irq_ack(ch);
      } else if (ch == config.tx.id) {
-         sddf_dprintf("UART|LOG: In NOTIFIED: tx\n");
          tx_provide();
      } else if (ch == config.rx.id) {
-         sddf_dprintf("UART|LOG: In NOTIFIED: rx\n");
-         // FIXME: Enabling RX interrupt following ARM examine for UART.
-         uart_regs->cr |= UART_CR_RX_EN;
-         uart_regs->cr &= ~UART_CR_RX_DIS;
+         uart_regs->ier = UART_RX_IRQS;
          rx_return();
      } else {
          sddf_dprintf("UART|LOG: received notification on unexpected channel: %u\n", ch);
@@ -6,24 +6,22 @@
 #include <stdint.h>
 #include <os/sddf.h>
 #include <sddf/timer/protocol.h>
+#include <sddf/timer/clock.h>
+#include <sddf/timer/clocksource.h>
+#include <sddf/timer/timeouts.h>
 #include <sddf/util/util.h>
 #include <sddf/util/printf.h>
-#include <sddf/util/udivmodti4.h>
 #include <sddf/resources/device.h>
 
 #if !(CONFIG_EXPORT_PCNT_USER && CONFIG_EXPORT_PTMR_USER)
 #error "ARM generic timer is not exported by seL4"
 #endif
 
-static uint64_t timer_freq;
-
-#define MAX_TIMEOUTS 6
+static clocksource_t clocksource;
 
 #define GENERIC_TIMER_ENABLE (1 << 0)
 #define GENERIC_TIMER_IMASK  (1 << 1)
 #define GENERIC_TIMER_STATUS (1 << 2)
-#define LOW_WORD(x) (x & 0xffffffffffffffff)
-#define HIGH_WORD(x) (x >> 64)
 
 #define COPROC_WRITE_WORD(R,W) asm volatile ("msr " R  ", %0" :: "r"(W))
 #define COPROC_READ_WORD(R,W)  asm volatile ("mrs %0, " R : "=r" (W))
@@ -41,6 +39,9 @@ static uint64_t timer_freq;
 
 __attribute__((__section__(".device_resources"))) device_resources_t device_resources;
 
+/* Patched by Microkit, zero if the clock page is not mapped */
+uintptr_t timer_clock_page;
+
 static inline uint64_t get_ticks(void)
 {
     uint64_t time;
@@ -88,65 +89,19 @@ static inline void generic_timer_disable(void)
     generic_timer_or_ctrl(~GENERIC_TIMER_ENABLE);
 }
 
-#define KHZ (1000)
-#define MHZ (1000 * KHZ)
-#define GHZ (1000 * MHZ)
-
-static inline uint64_t freq_cycles_and_hz_to_ns(uint64_t ncycles, uint64_t hz)
-{
-    if (hz % GHZ == 0) {
-        return ncycles / (hz / GHZ);
-    } else if (hz % MHZ == 0) {
-        return ncycles * MS_IN_S / (hz / MHZ);
-    } else if (hz % KHZ == 0) {
-        return ncycles * US_IN_S / (hz / KHZ);
-    }
-
-    __uint128_t ncycles_in_s = (__uint128_t)ncycles * NS_IN_S;
-    /* We can discard the remainder. */
-    uint64_t rem = 0;
-    uint64_t res = udiv128by64to64(HIGH_WORD(ncycles_in_s), LOW_WORD(ncycles_in_s), NS_IN_S, &rem);
-
-    return res;
-}
-
-static inline uint64_t freq_ns_and_hz_to_cycles(uint64_t ns, uint64_t hz)
-{
-    __uint128_t calc = ((__uint128_t)ns * (__uint128_t)hz);
-    /* We can discard the remainder. */
-    uint64_t rem = 0;
-    uint64_t res = udiv128by64to64(HIGH_WORD(calc), LOW_WORD(calc), NS_IN_S, &rem);
-
-    return res;
-}
-
 void set_timeout(uint64_t timeout)
 {
-    generic_timer_set_compare(freq_ns_and_hz_to_cycles(timeout, timer_freq));
+    generic_timer_set_compare(clocksource_ns_to_ticks(&clocksource, timeout));
 }
 
-static uint64_t timeouts[MAX_TIMEOUTS];
+static timer_timeouts_t timeouts;
 
 static void process_timeouts(uint64_t curr_time)
 {
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] <= curr_time) {
-            sddf_notify(i);
-            timeouts[i] = UINT64_MAX;
-        }
-    }
-
-    uint64_t next_timeout = UINT64_MAX;
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] < next_timeout) {
-            next_timeout = timeouts[i];
-        }
-    }
-
+    uint64_t next_timeout = timer_timeouts_process(&timeouts, curr_time);
     if (next_timeout != UINT64_MAX) {
         set_timeout(next_timeout);
     }
-
 }
 
 void init()
@@ -155,13 +110,17 @@ void init()
     assert(device_resources.num_irqs == 1);
     assert(device_resources.num_regions == 0);
 
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        timeouts[i] = UINT64_MAX;
-    }
+    timer_timeouts_init(&timeouts);
 
     generic_timer_set_compare(UINT64_MAX);
     generic_timer_enable();
-    timer_freq = generic_timer_get_freq();
+    clocksource_init(&clocksource, generic_timer_get_freq());
+
+    /* Time is the physical counter converted to nanoseconds, which clients can read themselves */
+    if (timer_clock_page) {
+        sddf_timer_clock_publish((sddf_timer_clock_t *)timer_clock_page, SDDF_TIMER_CLOCK_SOURCE_COUNTER,
+                                 &clocksource, 0);
+    }
 }
 
 void notified(sddf_channel ch)
@@ -170,7 +129,7 @@ void notified(sddf_channel ch)
     sddf_deferred_irq_ack(ch);
 
     generic_timer_set_compare(UINT64_MAX);
-    uint64_t curr_time = freq_cycles_and_hz_to_ns(get_ticks(), timer_freq);
+    uint64_t curr_time = clocksource_ticks_to_ns(&clocksource, get_ticks());
     process_timeouts(curr_time);
 }
 
@@ -178,17 +137,44 @@ seL4_MessageInfo_t protected(sddf_channel ch, seL4_MessageInfo_t msginfo)
 {
     switch (seL4_MessageInfo_get_label(msginfo)) {
     case SDDF_TIMER_GET_TIME: {
-        uint64_t time_ns = freq_cycles_and_hz_to_ns(get_ticks(), timer_freq);
+        uint64_t time_ns = clocksource_ticks_to_ns(&clocksource, get_ticks());
         sddf_set_mr(0, time_ns);
         return seL4_MessageInfo_new(0, 0, 0, 1);
     }
-    case SDDF_TIMER_SET_TIMEOUT: {
-        uint64_t curr_time = freq_cycles_and_hz_to_ns(get_ticks(), timer_freq);
-        uint64_t offset_us = (uint64_t)(sddf_get_mr(0));
-        timeouts[ch] = curr_time + offset_us;
+    case SDDF_TIMER_SET_TIMEOUT:
+    case SDDF_TIMER_SET_TIMEOUT_ID: {
+        uint64_t curr_time = clocksource_ticks_to_ns(&clocksource, get_ticks());
+        uint64_t offset_ns = sddf_get_mr(0);
+        uint64_t id = seL4_MessageInfo_get_label(msginfo) == SDDF_TIMER_SET_TIMEOUT ? 0 : sddf_get_mr(1);
+        if (timer_timeouts_set(&timeouts, ch, id, curr_time + offset_ns)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
+        process_timeouts(curr_time);
+        break;
+    }
+    case SDDF_TIMER_CANCEL_TIMEOUT:
+        timer_timeouts_cancel(&timeouts, ch, sddf_get_mr(0));
+        break;
+    case SDDF_TIMER_GET_FIRED:
+        sddf_set_mr(0, timer_timeouts_take_fired(&timeouts, ch));
+        return seL4_MessageInfo_new(0, 0, 0, 1);
+    case SDDF_TIMER_SET_PERIODIC: {
+        uint64_t curr_time = clocksource_ticks_to_ns(&clocksource, get_ticks());
+        uint64_t period_ns = sddf_get_mr(0);
+        uint64_t id = sddf_get_mr(1);
+        if (timer_timeouts_set_periodic(&timeouts, ch, id, curr_time, period_ns)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
         process_timeouts(curr_time);
         break;
     }
+    case SDDF_TIMER_SET_SLACK: {
+        uint64_t slack_ns = sddf_get_mr(0);
+        timer_timeouts_set_slack(&timeouts, ch, slack_ns);
+        break;
+    }
     default:
         sddf_dprintf("TIMER DRIVER|LOG: Unknown request %lu to timer from channel %u\n",
                      seL4_MessageInfo_get_label(msginfo), ch);
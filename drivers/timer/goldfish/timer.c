@@ -6,13 +6,11 @@
 #include <stdint.h>
 #include <microkit.h>
 #include <sddf/timer/protocol.h>
+#include <sddf/timer/timeouts.h>
 #include <sddf/util/util.h>
 #include <sddf/util/printf.h>
-#include <sddf/util/udivmodti4.h>
 #include <sddf/resources/device.h>
 
-#define MAX_TIMEOUTS 6
-
 /* taken from: https://github.com/torvalds/linux/blob/master/include/clocksource/timer-goldfish.h */
 typedef struct {
     /* Registers */
@@ -43,24 +41,11 @@ void set_timeout(uint64_t timeout)
     timer_regs->irq_enabled = 1U;
 }
 
-static uint64_t timeouts[MAX_TIMEOUTS];
+static timer_timeouts_t timeouts;
 
 static void process_timeouts(uint64_t curr_time)
 {
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] <= curr_time) {
-            microkit_notify(i);
-            timeouts[i] = UINT64_MAX;
-        }
-    }
-
-    uint64_t next_timeout = UINT64_MAX;
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] < next_timeout) {
-            next_timeout = timeouts[i];
-        }
-    }
-
+    uint64_t next_timeout = timer_timeouts_process(&timeouts, curr_time);
     if (next_timeout != UINT64_MAX) {
         set_timeout(next_timeout);
     }
@@ -73,9 +58,7 @@ void init()
     assert(device_resources.num_regions == 1);
     timer_regs = (goldfish_timer_regs_t *)device_resources.regions[0].region.vaddr;
 
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        timeouts[i] = UINT64_MAX;
-    }
+    timer_timeouts_init(&timeouts);
 }
 
 void notified(microkit_channel ch)
@@ -97,13 +80,40 @@ seL4_MessageInfo_t protected(microkit_channel ch, microkit_msginfo msginfo)
         seL4_SetMR(0, time_ns);
         return microkit_msginfo_new(0, 1);
     }
-    case SDDF_TIMER_SET_TIMEOUT: {
+    case SDDF_TIMER_SET_TIMEOUT:
+    case SDDF_TIMER_SET_TIMEOUT_ID: {
+        uint64_t curr_time = get_ticks_in_ns();
+        uint64_t offset_ns = seL4_GetMR(0);
+        uint64_t id = microkit_msginfo_get_label(msginfo) == SDDF_TIMER_SET_TIMEOUT ? 0 : seL4_GetMR(1);
+        if (timer_timeouts_set(&timeouts, ch, id, curr_time + offset_ns)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
+        process_timeouts(curr_time);
+        break;
+    }
+    case SDDF_TIMER_CANCEL_TIMEOUT:
+        timer_timeouts_cancel(&timeouts, ch, seL4_GetMR(0));
+        break;
+    case SDDF_TIMER_GET_FIRED:
+        seL4_SetMR(0, timer_timeouts_take_fired(&timeouts, ch));
+        return microkit_msginfo_new(0, 1);
+    case SDDF_TIMER_SET_PERIODIC: {
         uint64_t curr_time = get_ticks_in_ns();
-        uint64_t offset_us = (uint64_t)(seL4_GetMR(0));
-        timeouts[ch] = curr_time + offset_us;
+        uint64_t period_ns = seL4_GetMR(0);
+        uint64_t id = seL4_GetMR(1);
+        if (timer_timeouts_set_periodic(&timeouts, ch, id, curr_time, period_ns)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
         process_timeouts(curr_time);
         break;
     }
+    case SDDF_TIMER_SET_SLACK: {
+        uint64_t slack_ns = seL4_GetMR(0);
+        timer_timeouts_set_slack(&timeouts, ch, slack_ns);
+        break;
+    }
     default:
         sddf_dprintf("TIMER DRIVER|LOG: Unknown request %lu to timer from channel %u\n",
                      microkit_msginfo_get_label(msginfo), ch);
@@ -4,12 +4,10 @@
  */
 
 /*
- * Very basic timer driver. Currently only permtis
- * a maximum of a single timeout per client for simplicity.
+ * Very basic timer driver. Each client can have up to
+ * SDDF_TIMER_MAX_TIMEOUT_IDS timeouts armed at once.
  *
- * Interfaces for clients:
- * microkit_ppcall() with label 0 is a request to get the current time.
- * with a 1 is a request to set a timeout.
+ * Interfaces for clients are described in sddf/timer/protocol.h.
  */
 
 #include <stdint.h>
@@ -17,6 +15,8 @@
 #include <sddf/resources/device.h>
 #include <sddf/util/printf.h>
 #include <sddf/timer/protocol.h>
+#include <sddf/timer/timeouts.h>
+#include <sddf/timer/clocksource.h>
 
 #define GPT_STATUS_REGISTER_CLEAR 0x3F
 #define CR 0
@@ -30,15 +30,15 @@
 #define ICR2 8
 #define CNT 9
 
-#define MAX_TIMEOUTS 6
-
+/* Ticks per microsecond */
 #define GPT_FREQ   (12u)
 
 __attribute__((__section__(".device_resources"))) device_resources_t device_resources;
 
 static volatile uint32_t *gpt;
 static uint32_t overflow_count;
-static uint64_t timeouts[MAX_TIMEOUTS];
+static timer_timeouts_t timeouts;
+static clocksource_t clocksource;
 
 static uint64_t get_ticks(void)
 {
@@ -56,20 +56,7 @@ static uint64_t get_ticks(void)
 
 static void process_timeouts(uint64_t curr_time)
 {
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] <= curr_time) {
-            microkit_notify(i);
-            timeouts[i] = UINT64_MAX;
-        }
-    }
-
-    uint64_t next_timeout = UINT64_MAX;
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] < next_timeout) {
-            next_timeout = timeouts[i];
-        }
-    }
-
+    uint64_t next_timeout = timer_timeouts_process(&timeouts, curr_time);
     if (next_timeout != UINT64_MAX && overflow_count == (next_timeout >> 32)) {
         gpt[OCR1] = (uint32_t)next_timeout;
         gpt[IR] |= 1;
@@ -104,17 +91,44 @@ seL4_MessageInfo_t protected(microkit_channel ch, microkit_msginfo msginfo)
 {
     switch (microkit_msginfo_get_label(msginfo)) {
     case SDDF_TIMER_GET_TIME: {
-        uint64_t time_ns = (get_ticks() / (uint64_t)GPT_FREQ) * NS_IN_US;
+        uint64_t time_ns = clocksource_ticks_to_ns(&clocksource, get_ticks());
         seL4_SetMR(0, time_ns);
         return microkit_msginfo_new(0, 1);
     }
-    case SDDF_TIMER_SET_TIMEOUT: {
+    case SDDF_TIMER_SET_TIMEOUT:
+    case SDDF_TIMER_SET_TIMEOUT_ID: {
+        uint64_t curr_time = get_ticks();
+        uint64_t offset_ticks = clocksource_ns_to_ticks(&clocksource, seL4_GetMR(0));
+        uint64_t id = microkit_msginfo_get_label(msginfo) == SDDF_TIMER_SET_TIMEOUT ? 0 : seL4_GetMR(1);
+        if (timer_timeouts_set(&timeouts, ch, id, curr_time + offset_ticks)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
+        process_timeouts(curr_time);
+        break;
+    }
+    case SDDF_TIMER_CANCEL_TIMEOUT:
+        timer_timeouts_cancel(&timeouts, ch, seL4_GetMR(0));
+        break;
+    case SDDF_TIMER_GET_FIRED:
+        seL4_SetMR(0, timer_timeouts_take_fired(&timeouts, ch));
+        return microkit_msginfo_new(0, 1);
+    case SDDF_TIMER_SET_PERIODIC: {
         uint64_t curr_time = get_ticks();
-        uint64_t offset_ticks = (seL4_GetMR(0) / NS_IN_US) * (uint64_t)GPT_FREQ;
-        timeouts[ch] = curr_time + offset_ticks;
+        uint64_t period_ticks = clocksource_ns_to_ticks(&clocksource, seL4_GetMR(0));
+        uint64_t id = seL4_GetMR(1);
+        if (timer_timeouts_set_periodic(&timeouts, ch, id, curr_time, period_ticks)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
         process_timeouts(curr_time);
         break;
     }
+    case SDDF_TIMER_SET_SLACK: {
+        uint64_t slack_ticks = clocksource_ns_to_ticks(&clocksource, seL4_GetMR(0));
+        timer_timeouts_set_slack(&timeouts, ch, slack_ticks);
+        break;
+    }
     default:
         sddf_dprintf("TIMER DRIVER|LOG: Unknown request %lu to timer from channel %u\n", microkit_msginfo_get_label(msginfo),
                      ch);
@@ -130,9 +144,8 @@ void init(void)
     assert(device_resources.num_irqs == 1);
     assert(device_resources.num_regions == 1);
 
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        timeouts[i] = UINT64_MAX;
-    }
+    timer_timeouts_init(&timeouts);
+    clocksource_init(&clocksource, GPT_FREQ * US_IN_S);
 
     gpt = (volatile uint32_t *)device_resources.regions[0].region.vaddr;
 
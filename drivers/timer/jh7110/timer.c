@@ -9,6 +9,8 @@
 #include <sddf/util/util.h>
 #include <sddf/util/printf.h>
 #include <sddf/timer/protocol.h>
+#include <sddf/timer/timeouts.h>
+#include <sddf/timer/clocksource.h>
 
 /*
  * The JH7110 SoC contains a timer with four 32-bit counters. Each one of these
@@ -28,9 +30,6 @@
 #error "Invalid StarFive timer device channel"
 #endif
 
-#define CLIENT_CH_START 2
-#define MAX_TIMEOUTS 6
-
 #define STARFIVE_TIMER_MAX_TICKS UINT32_MAX
 #define STARFIVE_TIMER_MODE_CONTINUOUS 0
 #define STARFIVE_TIMER_MODE_SINGLE 1
@@ -73,10 +72,8 @@ microkit_channel timeout_irq;
 uint32_t counter_timer_elapses = 0;
 uint32_t timeout_timer_elapses = 0;
 
-/* Right now, we only service a single timeout per client.
- * This timeout array indicates when a timeout should occur,
- * indexed by client ID. */
-static uint64_t timeouts[MAX_TIMEOUTS];
+static timer_timeouts_t timeouts;
+static clocksource_t clocksource;
 
 static uint64_t get_ticks_in_ns(void)
 {
@@ -91,40 +88,19 @@ static uint64_t get_ticks_in_ns(void)
 
     uint64_t value_ticks = (value_h << 32) | value_l;
 
-    /* convert from ticks to nanoseconds */
-    uint64_t value_whole_seconds = value_ticks / STARFIVE_TIMER_TICKS_PER_SECOND;
-    uint64_t value_subsecond_ticks = value_ticks % STARFIVE_TIMER_TICKS_PER_SECOND;
-    uint64_t value_subsecond_ns = (value_subsecond_ticks * NS_IN_S) / STARFIVE_TIMER_TICKS_PER_SECOND;
-    uint64_t value_ns = value_whole_seconds * NS_IN_S + value_subsecond_ns;
-
-    return value_ns;
+    return clocksource_ticks_to_ns(&clocksource, value_ticks);
 }
 
 static void process_timeouts(uint64_t curr_time)
 {
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] <= curr_time) {
-            microkit_notify(CLIENT_CH_START + i);
-            timeouts[i] = UINT64_MAX;
-        }
-    }
-
-    uint64_t next_timeout = UINT64_MAX;
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] < next_timeout) {
-            next_timeout = timeouts[i];
-        }
-    }
-
+    uint64_t next_timeout = timer_timeouts_process(&timeouts, curr_time);
     if (next_timeout != UINT64_MAX) {
         uint64_t ns = next_timeout - curr_time;
         timeout_regs->enable = STARFIVE_TIMER_DISABLED;
         timeout_timer_elapses = 0;
         timeout_regs->ctrl = STARFIVE_TIMER_MODE_SINGLE;
 
-        uint64_t ticks_whole_seconds = (ns / NS_IN_S) * STARFIVE_TIMER_TICKS_PER_SECOND;
-        uint64_t ticks_remainder = (ns % NS_IN_S) * STARFIVE_TIMER_TICKS_PER_SECOND / NS_IN_S;
-        uint64_t num_ticks = ticks_whole_seconds + ticks_remainder;
+        uint64_t num_ticks = clocksource_ns_to_ticks(&clocksource, ns);
 
         assert(num_ticks <= STARFIVE_TIMER_MAX_TICKS);
         if (num_ticks > STARFIVE_TIMER_MAX_TICKS) {
@@ -175,13 +151,40 @@ seL4_MessageInfo_t protected(microkit_channel ch, microkit_msginfo msginfo)
         seL4_SetMR(0, time_ns);
         return microkit_msginfo_new(0, 1);
     }
-    case SDDF_TIMER_SET_TIMEOUT: {
+    case SDDF_TIMER_SET_TIMEOUT:
+    case SDDF_TIMER_SET_TIMEOUT_ID: {
         uint64_t curr_time = get_ticks_in_ns();
         uint64_t offset_ns = seL4_GetMR(0);
-        timeouts[ch - CLIENT_CH_START] = curr_time + offset_ns;
+        uint64_t id = microkit_msginfo_get_label(msginfo) == SDDF_TIMER_SET_TIMEOUT ? 0 : seL4_GetMR(1);
+        if (timer_timeouts_set(&timeouts, ch, id, curr_time + offset_ns)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
         process_timeouts(curr_time);
         break;
     }
+    case SDDF_TIMER_CANCEL_TIMEOUT:
+        timer_timeouts_cancel(&timeouts, ch, seL4_GetMR(0));
+        break;
+    case SDDF_TIMER_GET_FIRED:
+        seL4_SetMR(0, timer_timeouts_take_fired(&timeouts, ch));
+        return microkit_msginfo_new(0, 1);
+    case SDDF_TIMER_SET_PERIODIC: {
+        uint64_t curr_time = get_ticks_in_ns();
+        uint64_t period_ns = seL4_GetMR(0);
+        uint64_t id = seL4_GetMR(1);
+        if (timer_timeouts_set_periodic(&timeouts, ch, id, curr_time, period_ns)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
+        process_timeouts(curr_time);
+        break;
+    }
+    case SDDF_TIMER_SET_SLACK: {
+        uint64_t slack_ns = seL4_GetMR(0);
+        timer_timeouts_set_slack(&timeouts, ch, slack_ns);
+        break;
+    }
     default:
         sddf_dprintf("TIMER DRIVER|LOG: Unknown request %lu to timer from channel %u\n",
                      microkit_msginfo_get_label(msginfo), ch);
@@ -197,9 +200,8 @@ void init(void)
     assert(device_resources.num_irqs == 2);
     assert(device_resources.num_regions == 1);
 
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        timeouts[i] = UINT64_MAX;
-    }
+    timer_timeouts_init(&timeouts);
+    clocksource_init(&clocksource, STARFIVE_TIMER_TICKS_PER_SECOND);
 
     counter_irq = device_resources.irqs[0].id;
     timeout_irq = device_resources.irqs[1].id;
@@ -8,8 +8,8 @@
 #include <sddf/resources/device.h>
 #include <sddf/util/printf.h>
 #include <sddf/timer/protocol.h>
-
-#define MAX_TIMEOUTS 6
+#include <sddf/timer/timeouts.h>
+#include <sddf/timer/clocksource.h>
 
 #define TIMER_REG_START   0x70    // TIMER_MUX
 
@@ -49,10 +49,8 @@ struct timer_regs {
 
 volatile struct timer_regs *regs;
 
-/* Right now, we only service a single timeout per client.
- * This timeout array indicates when a timeout should occur,
- * indexed by client ID. */
-static uint64_t timeouts[MAX_TIMEOUTS];
+static timer_timeouts_t timeouts;
+static clocksource_t clocksource;
 
 static uint64_t get_ticks(void)
 {
@@ -69,20 +67,7 @@ static uint64_t get_ticks(void)
 
 static void process_timeouts(uint64_t curr_time)
 {
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] <= curr_time) {
-            microkit_notify(i);
-            timeouts[i] = UINT64_MAX;
-        }
-    }
-
-    uint64_t next_timeout = UINT64_MAX;
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        if (timeouts[i] < next_timeout) {
-            next_timeout = timeouts[i];
-        }
-    }
-
+    uint64_t next_timeout = timer_timeouts_process(&timeouts, curr_time);
     if (next_timeout != UINT64_MAX) {
         regs->mux &= ~TIMER_A_MODE;
         regs->timer_a = next_timeout - curr_time;
@@ -108,17 +93,44 @@ seL4_MessageInfo_t protected(microkit_channel ch, microkit_msginfo msginfo)
 {
     switch (microkit_msginfo_get_label(msginfo)) {
     case SDDF_TIMER_GET_TIME: {
-        uint64_t time_ns = get_ticks() * NS_IN_US;
+        uint64_t time_ns = clocksource_ticks_to_ns(&clocksource, get_ticks());
         seL4_SetMR(0, time_ns);
         return microkit_msginfo_new(0, 1);
     }
-    case SDDF_TIMER_SET_TIMEOUT: {
+    case SDDF_TIMER_SET_TIMEOUT:
+    case SDDF_TIMER_SET_TIMEOUT_ID: {
+        uint64_t curr_time = get_ticks();
+        uint64_t offset_ticks = clocksource_ns_to_ticks(&clocksource, seL4_GetMR(0));
+        uint64_t id = microkit_msginfo_get_label(msginfo) == SDDF_TIMER_SET_TIMEOUT ? 0 : seL4_GetMR(1);
+        if (timer_timeouts_set(&timeouts, ch, id, curr_time + offset_ticks)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
+        process_timeouts(curr_time);
+        break;
+    }
+    case SDDF_TIMER_CANCEL_TIMEOUT:
+        timer_timeouts_cancel(&timeouts, ch, seL4_GetMR(0));
+        break;
+    case SDDF_TIMER_GET_FIRED:
+        seL4_SetMR(0, timer_timeouts_take_fired(&timeouts, ch));
+        return microkit_msginfo_new(0, 1);
+    case SDDF_TIMER_SET_PERIODIC: {
         uint64_t curr_time = get_ticks();
-        uint64_t offset_us = seL4_GetMR(0) / NS_IN_US;
-        timeouts[ch] = curr_time + offset_us;
+        uint64_t period_ticks = clocksource_ns_to_ticks(&clocksource, seL4_GetMR(0));
+        uint64_t id = seL4_GetMR(1);
+        if (timer_timeouts_set_periodic(&timeouts, ch, id, curr_time, period_ticks)) {
+            sddf_dprintf("TIMER DRIVER|LOG: Invalid timeout ID %lu from channel %u\n", id, ch);
+            break;
+        }
         process_timeouts(curr_time);
         break;
     }
+    case SDDF_TIMER_SET_SLACK: {
+        uint64_t slack_ticks = clocksource_ns_to_ticks(&clocksource, seL4_GetMR(0));
+        timer_timeouts_set_slack(&timeouts, ch, slack_ticks);
+        break;
+    }
     default:
         sddf_dprintf("TIMER DRIVER|LOG: Unknown request %lu to timer from channel %u\n", microkit_msginfo_get_label(msginfo),
                      ch);
@@ -134,9 +146,9 @@ void init(void)
     assert(device_resources.num_irqs == 1);
     assert(device_resources.num_regions == 1);
 
-    for (int i = 0; i < MAX_TIMEOUTS; i++) {
-        timeouts[i] = UINT64_MAX;
-    }
+    timer_timeouts_init(&timeouts);
+    /* Timer E counts microseconds */
+    clocksource_init(&clocksource, US_IN_S);
 
     regs = (void *)((uintptr_t)device_resources.regions[0].region.vaddr + TIMER_REG_START);
 
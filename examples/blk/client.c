@@ -7,9 +7,11 @@
 #include <sddf/util/printf.h>
 #include <sddf/util/util.h>
 #include <sddf/util/string.h>
+#include <sddf/util/boot_trace.h>
 #include <sddf/blk/queue.h>
 #include <sddf/blk/storage_info.h>
 #include <sddf/blk/config.h>
+#include <sddf/blk/client.h>
 
 /*
  * This header is generated by the build system, it contains the data we want
@@ -20,127 +22,131 @@
 #define LOG_CLIENT(...) do{ sddf_dprintf("CLIENT|INFO: "); sddf_dprintf(__VA_ARGS__); }while(0)
 #define LOG_CLIENT_ERR(...) do{ sddf_printf("CLIENT|ERROR: "); sddf_printf(__VA_ARGS__); }while(0)
 
-static blk_queue_handle_t blk_queue;
-
 __attribute__((__section__(".blk_client_config"))) blk_client_config_t config;
 
 /* Use the start of the partition for testing. */
 #define REQUEST_BLK_NUMBER 0
 #define REQUEST_NUM_BLOCKS 2
 
-enum test_basic_state {
-    START,
-    READ,
-    FINISH,
-};
+#define CLIENT_MAX_REQUESTS 32
+#define CLIENT_MAX_BUFFERS 512
 
-enum test_basic_state test_basic_state = START;
+static blk_client_t blk_client;
+static blk_client_req_t client_reqs[CLIENT_MAX_REQUESTS];
+static uint32_t client_idxlist[CLIENT_MAX_REQUESTS];
+static word_t client_buf_words[roundup_bits2words64(CLIENT_MAX_BUFFERS)];
 
-bool test_basic()
+static void test_basic_read_done(blk_resp_status_t status, uint16_t success_count, void *cookie)
 {
-    switch (test_basic_state) {
-    case START: {
-        LOG_CLIENT("basic: START state\n");
-        // We assume that the data fits into two blocks
-        assert(basic_data_len <= BLK_TRANSFER_SIZE * 2);
-
-        // Copy our testing data into the block data region
-        char *data_dest = (char *)config.data.vaddr;
-        sddf_memcpy(data_dest, basic_data, basic_data_len);
-
-        int err = blk_enqueue_req(&blk_queue, BLK_REQ_WRITE, 0, REQUEST_BLK_NUMBER, REQUEST_NUM_BLOCKS, 0);
-        assert(!err);
-
-        test_basic_state = READ;
-
-        break;
-    }
-    case READ: {
-        LOG_CLIENT("basic: READ state\n");
-        /* Check that our previous write was successful */
-        blk_resp_status_t status = -1;
-        uint16_t count = -1;
-        uint32_t id = -1;
-        int err = blk_dequeue_resp(&blk_queue, &status, &count, &id);
-        assert(!err);
-        assert(status == BLK_RESP_OK);
-        assert(count == REQUEST_NUM_BLOCKS);
-        assert(id == 0);
-
-        /* We do the read at a different offset into the data region from the previous request */
-        uintptr_t offset = REQUEST_NUM_BLOCKS * BLK_TRANSFER_SIZE;
-        err = blk_enqueue_req(&blk_queue, BLK_REQ_READ, offset, REQUEST_BLK_NUMBER, REQUEST_NUM_BLOCKS, 0);
-        assert(!err);
-
-        test_basic_state = FINISH;
-
-        break;
-    }
-    case FINISH: {
-        LOG_CLIENT("basic: FINISH state\n");
-        blk_resp_status_t status = -1;
-        uint16_t count = -1;
-        uint32_t id = -1;
-        int err = blk_dequeue_resp(&blk_queue, &status, &count, &id);
-        assert(!err);
-        assert(status == BLK_RESP_OK);
-        assert(count == REQUEST_NUM_BLOCKS);
-        assert(id == 0);
-
-        // Check that the read went okay
-        char *read_data = (char *)(config.data.vaddr + (REQUEST_NUM_BLOCKS * BLK_TRANSFER_SIZE));
-        for (int i = 0; i < basic_data_len; i++) {
-            if (read_data[i] != basic_data[i]) {
-                LOG_CLIENT_ERR("basic: mismatch in bytes at position %d\n", i);
-            }
+    LOG_CLIENT("basic: read done\n");
+    assert(status == BLK_RESP_OK);
+    assert(success_count == REQUEST_NUM_BLOCKS);
+
+    // Check that the read went okay
+    char *read_data = cookie;
+    for (int i = 0; i < basic_data_len; i++) {
+        if (read_data[i] != basic_data[i]) {
+            LOG_CLIENT_ERR("basic: mismatch in bytes at position %d\n", i);
         }
+    }
 
-        for (int i = 0; i < BLK_TRANSFER_SIZE; i += 90) {
-            for (int j = 0; j < 90; j++) {
-                sddf_dprintf("%c", read_data[i + j]);
-            }
+    for (int i = 0; i < BLK_TRANSFER_SIZE; i += 90) {
+        for (int j = 0; j < 90; j++) {
+            sddf_dprintf("%c", read_data[i + j]);
         }
-        sddf_dprintf("\n");
-
-        LOG_CLIENT("basic: successfully finished!\n");
-
-        return true;
-    }
-    default:
-        LOG_CLIENT_ERR("internal error, invalid state\n");
-        assert(false);
     }
+    sddf_dprintf("\n");
+
+    blk_client_buf_free(&blk_client, read_data, REQUEST_NUM_BLOCKS);
 
-    return false;
+    LOG_CLIENT("basic: successfully finished!\n");
 }
 
-void init(void)
+static void test_basic_write_done(blk_resp_status_t status, uint16_t success_count, void *cookie)
 {
-    LOG_CLIENT("starting\n");
+    LOG_CLIENT("basic: write done\n");
+    /* Check that our previous write was successful */
+    assert(status == BLK_RESP_OK);
+    assert(success_count == REQUEST_NUM_BLOCKS);
+    blk_client_buf_free(&blk_client, cookie, REQUEST_NUM_BLOCKS);
+
+    /* Read back into a different buffer from the one we wrote from */
+    void *read_data;
+    int err = blk_client_buf_alloc(&blk_client, REQUEST_NUM_BLOCKS, &read_data);
+    assert(!err);
+    err = blk_client_submit(&blk_client, BLK_REQ_READ, read_data, REQUEST_BLK_NUMBER, REQUEST_NUM_BLOCKS,
+                            test_basic_read_done, read_data);
+    assert(!err);
+}
 
-    assert(blk_config_check_magic(&config));
+static void test_basic(void)
+{
+    LOG_CLIENT("basic: start\n");
+    // We assume that the data fits into two blocks
+    assert(basic_data_len <= BLK_TRANSFER_SIZE * REQUEST_NUM_BLOCKS);
+
+    // Write our testing data straight from the block data region
+    void *write_data;
+    int err = blk_client_buf_alloc(&blk_client, REQUEST_NUM_BLOCKS, &write_data);
+    assert(!err);
+    sddf_memcpy(write_data, basic_data, basic_data_len);
+
+    err = blk_client_submit(&blk_client, BLK_REQ_WRITE, write_data, REQUEST_BLK_NUMBER, REQUEST_NUM_BLOCKS,
+                            test_basic_write_done, write_data);
+    assert(!err);
+}
 
-    blk_queue_init(&blk_queue, config.virt.req_queue.vaddr, config.virt.resp_queue.vaddr, config.virt.num_buffers);
+static bool storage_ready = false;
 
-    /* Want to print out the storage info, so spin until the it is ready. */
+static void start(void)
+{
     blk_storage_info_t *storage_info = config.virt.storage_info.vaddr;
-    while (!blk_storage_is_ready(storage_info));
+    storage_ready = true;
     LOG_CLIENT("device config ready\n");
+    boot_trace_mark("storage ready");
+    /* Storage is the last part of this system to come up, so boot has finished */
+    boot_trace_report();
     LOG_CLIENT("device size: 0x%lx bytes\n", storage_info->capacity * BLK_TRANSFER_SIZE);
 
+    uint16_t queue_depth = blk_client_queue_depth(storage_info, config.virt.num_buffers);
+    LOG_CLIENT("queue depth: %u, request size: %u blocks\n", queue_depth,
+               blk_client_request_blocks(storage_info, queue_depth, config.data.size));
+
     /* Before proceeding, check that the offset into the device we will
      * do I/O on is sane. */
     assert(REQUEST_BLK_NUMBER < storage_info->capacity - REQUEST_NUM_BLOCKS);
 
+    int err = blk_client_init(&blk_client, &config, client_reqs, client_idxlist, CLIENT_MAX_REQUESTS,
+                              client_buf_words, roundup_bits2words64(CLIENT_MAX_BUFFERS));
+    assert(!err);
+
     test_basic();
-    microkit_notify(config.virt.id);
+    blk_client_flush(&blk_client);
+}
+
+void init(void)
+{
+    LOG_CLIENT("starting\n");
+
+    assert(blk_config_check_magic(&config));
+
+    /* Want to print out the storage info, the virtualiser notifies us once it is ready. */
+    if (blk_storage_is_ready(config.virt.storage_info.vaddr)) {
+        start();
+    }
 }
 
 void notified(microkit_channel ch)
 {
     assert(ch == config.virt.id);
 
-    if (!test_basic()) {
-        microkit_notify(config.virt.id);
+    if (!storage_ready) {
+        if (blk_storage_is_ready(config.virt.storage_info.vaddr)) {
+            start();
+        }
+        return;
     }
+
+    blk_client_process(&blk_client);
+    blk_client_flush(&blk_client);
 }
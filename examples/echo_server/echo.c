@@ -11,6 +11,9 @@
 #include <sddf/network/lib_sddf_lwip.h>
 #include <sddf/network/queue.h>
 #include <sddf/network/config.h>
+#ifdef NET_COPY_FUSED
+#include <sddf/network/copy.h>
+#endif
 #include <sddf/serial/queue.h>
 #include <sddf/serial/config.h>
 #include <sddf/timer/client.h>
@@ -36,6 +39,13 @@ net_queue_handle_t net_rx_handle;
 net_queue_handle_t net_tx_handle;
 
 #define LWIP_TICK_MS 100
+/* lwIP's timers are coarse, let the tick share an interrupt with other clients' timeouts */
+#define LWIP_TICK_SLACK_MS 10
+#define LWIP_TICK_TIMEOUT_ID 0
+
+/* Batch up debug output and publish it to the serial virtualiser at most this often */
+#define SERIAL_FLUSH_MS 10
+#define SERIAL_FLUSH_TIMEOUT_ID 1
 
 struct pbuf *head;
 struct pbuf *tail;
@@ -52,11 +62,12 @@ void netif_status_callback(char *ip_addr)
 }
 
 /**
- * Sets a timeout for the next lwip tick.
+ * Sets a periodic timeout for the lwip tick.
  */
 void set_timeout(void)
 {
-    sddf_timer_set_timeout(timer_config.driver_id, LWIP_TICK_MS * NS_IN_MS);
+    sddf_timer_set_slack(timer_config.driver_id, LWIP_TICK_SLACK_MS * NS_IN_MS);
+    sddf_timer_set_periodic(timer_config.driver_id, LWIP_TICK_TIMEOUT_ID, LWIP_TICK_MS * NS_IN_MS);
 }
 
 /**
@@ -123,12 +134,16 @@ void init(void)
     serial_queue_init(&serial_tx_queue_handle, serial_config.tx.queue.vaddr, serial_config.tx.data.size,
                       serial_config.tx.data.vaddr);
     serial_putchar_init(serial_config.tx.id, &serial_tx_queue_handle);
+    serial_putchar_set_flush_timer(timer_config.driver_id, SERIAL_FLUSH_TIMEOUT_ID, SERIAL_FLUSH_MS * NS_IN_MS);
 
     net_queue_init(&net_rx_handle, net_config.rx.free_queue.vaddr, net_config.rx.active_queue.vaddr,
                    net_config.rx.num_buffers);
     net_queue_init(&net_tx_handle, net_config.tx.free_queue.vaddr, net_config.tx.active_queue.vaddr,
                    net_config.tx.num_buffers);
     net_buffers_init(&net_tx_handle, 0);
+#ifdef NET_COPY_FUSED
+    net_copy_init();
+#endif
 
     sddf_lwip_init(&lib_sddf_lwip_config, &net_config, &timer_config, net_rx_handle, net_tx_handle, NULL,
                    netif_status_callback, enqueue_pbufs);
@@ -143,13 +158,27 @@ void init(void)
 
 void notified(sddf_channel ch)
 {
+#ifdef NET_COPY_FUSED
+    /* Our copier's channel to the RX virtualiser, copy the packets in and process them straight away */
+    if (net_copy_notified(ch)) {
+        sddf_lwip_process_rx();
+        sddf_lwip_maybe_notify();
+        return;
+    }
+#endif
+
     if (ch == net_config.rx.id) {
         sddf_lwip_process_rx();
     } else if (ch == net_config.tx.id) {
         transmit();
     } else if (ch == timer_config.driver_id) {
-        sddf_lwip_process_timeout();
-        set_timeout();
+        uint64_t fired = sddf_timer_fired(timer_config.driver_id);
+        if (fired & BIT(SERIAL_FLUSH_TIMEOUT_ID)) {
+            serial_putchar_flush();
+        }
+        if (fired & BIT(LWIP_TICK_TIMEOUT_ID)) {
+            sddf_lwip_process_timeout();
+        }
     } else if (ch == serial_config.tx.id) {
         // Nothing to do
     } else {
@@ -32,8 +32,18 @@ METAPROGRAM := $(TOP)/meta.py
 vpath %.c ${SDDF} ${ECHO_SERVER}
 
 IMAGES := eth_driver.elf echo0.elf echo1.elf benchmark.elf idle.elf network_virt_rx.elf\
-	  network_virt_tx.elf network_copy0.elf network_copy1.elf timer_driver.elf\
-	  serial_driver.elf serial_virt_tx.elf
+	  network_virt_tx.elf timer_driver.elf serial_driver.elf serial_virt_tx.elf
+
+# With FUSED_COPY, each client links in its own RX copier instead of having
+# a separate copier PD (see sddf/network/copy.h)
+ifneq ($(strip ${FUSED_COPY}), 0)
+CFLAGS_echo := -DNET_COPY_FUSED
+LIB_SDDF_LWIP_CFLAGS_echo := -DNET_COPY_FUSED
+ECHO_COPY_OBJS := network/components/network_copy_fused.o
+METAPROGRAM_FLAGS := --fused-copy
+else
+IMAGES += network_copy0.elf network_copy1.elf
+endif
 
 CFLAGS := -mcpu=$(CPU) \
 	  -mstrict-align \
@@ -53,7 +63,7 @@ CFLAGS := -mcpu=$(CPU) \
 LDFLAGS := -L$(BOARD_DIR)/lib -L${LIBC}
 LIBS := --start-group -lmicrokit -Tmicrokit.ld -lc libsddf_util_debug.a --end-group
 
-CHECK_FLAGS_BOARD_MD5 := .board_cflags-$(shell echo -- ${CFLAGS} ${BOARD} ${MICROKIT_CONFIG} | shasum | sed 's/ *-//')
+CHECK_FLAGS_BOARD_MD5 := .board_cflags-$(shell echo -- ${CFLAGS} ${CFLAGS_echo} ${BOARD} ${MICROKIT_CONFIG} | shasum | sed 's/ *-//')
 
 ${CHECK_FLAGS_BOARD_MD5}:
 	-rm -f .board_cflags-*
@@ -70,7 +80,8 @@ DEPS := $(ECHO_OBJS:.o=.d)
 all: loader.img
 
 ${ECHO_OBJS}: ${CHECK_FLAGS_BOARD_MD5}
-echo0.elf echo1.elf: $(ECHO_OBJS) libsddf_util.a lib_sddf_lwip_echo.a
+${ECHO_OBJS}: CFLAGS += ${CFLAGS_echo}
+echo0.elf echo1.elf: $(ECHO_OBJS) ${ECHO_COPY_OBJS} libsddf_util.a lib_sddf_lwip_echo.a
 	$(LD) $(LDFLAGS) $^ $(LIBS) -o $@
 
 network_copy0.elf network_copy1.elf: network_copy.elf
@@ -84,7 +95,8 @@ $(DTB): $(DTS)
 	dtc -q -I dts -O dtb $(DTS) > $(DTB)
 
 $(SYSTEM_FILE): $(METAPROGRAM) $(IMAGES) $(DTB)
-	$(PYTHON) $(METAPROGRAM) --sddf $(SDDF) --board $(MICROKIT_BOARD) --dtb $(DTB) --output . --sdf $(SYSTEM_FILE)
+	$(PYTHON) $(METAPROGRAM) --sddf $(SDDF) --board $(MICROKIT_BOARD) --dtb $(DTB) --output . --sdf $(SYSTEM_FILE) \
+		$(METAPROGRAM_FLAGS)
 	$(OBJCOPY) --update-section .device_resources=serial_driver_device_resources.data serial_driver.elf
 	$(OBJCOPY) --update-section .serial_driver_config=serial_driver_config.data serial_driver.elf
 	$(OBJCOPY) --update-section .serial_virt_tx_config=serial_virt_tx.data serial_virt_tx.elf
@@ -92,8 +104,13 @@ $(SYSTEM_FILE): $(METAPROGRAM) $(IMAGES) $(DTB)
 	$(OBJCOPY) --update-section .net_driver_config=net_driver.data eth_driver.elf
 	$(OBJCOPY) --update-section .net_virt_rx_config=net_virt_rx.data network_virt_rx.elf
 	$(OBJCOPY) --update-section .net_virt_tx_config=net_virt_tx.data network_virt_tx.elf
+ifneq ($(strip ${FUSED_COPY}), 0)
+	$(OBJCOPY) --update-section .net_copy_config=net_copy_client0.data echo0.elf
+	$(OBJCOPY) --update-section .net_copy_config=net_copy_client1.data echo1.elf
+else
 	$(OBJCOPY) --update-section .net_copy_config=net_copy_client0_net_copier.data network_copy.elf network_copy0.elf
 	$(OBJCOPY) --update-section .net_copy_config=net_copy_client1_net_copier.data network_copy.elf network_copy1.elf
+endif
 	$(OBJCOPY) --update-section .device_resources=timer_driver_device_resources.data timer_driver.elf
 	$(OBJCOPY) --update-section .timer_client_config=timer_client_client0.data echo0.elf
 	$(OBJCOPY) --update-section .net_client_config=net_client_client0.data echo0.elf
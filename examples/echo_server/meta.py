@@ -150,7 +150,63 @@ class BenchmarkConfig:
         )
 
 
-def generate(sdf_file: str, output_dir: str, dtb: DeviceTree):
+"""
+With --fused-copy, each client's RX copier is linked into the client instead of
+running as its own PD. sdfgen then connects the client straight to the RX
+virtualiser, so we give the client private RX queues and a data region for the
+copier to fill, and split the generated client config into the copier's config
+and the client's.
+"""
+NET_BUFFER_SIZE = 2048
+NET_COPY_FUSED_VADDR = 0x30_000_000
+
+
+def page_align(size: int) -> int:
+    return (size + 0xfff) & ~0xfff
+
+
+def fuse_copier(client: ProtectionDomain, output_dir: str):
+    with open(f"{output_dir}/net_client_{client.name}.data", "rb") as f:
+        client_config = f.read()
+
+    '''
+        net_client_config_t starts with the magic, padded to 8 bytes,
+        followed by the RX connection and RX data region:
+        {
+            struct { void *; uint64_t; } free_queue;
+            struct { void *; uint64_t; } active_queue;
+            uint16_t num_buffers;
+            uint8_t id;
+        } rx;
+        struct { void *; uint64_t; } rx_data;
+    '''
+    virt_rx = client_config[8:48]
+    device_data = client_config[48:64]
+    num_buffers, ch = struct.unpack_from("<HB", virt_rx, 32)
+
+    queue_size = page_align(8 + 16 * num_buffers)
+    regions = []
+    vaddr = NET_COPY_FUSED_VADDR
+    for name, size in (("free", queue_size), ("active", queue_size),
+                       ("data", page_align(NET_BUFFER_SIZE * num_buffers))):
+        mr = MemoryRegion(f"net_copy_{client.name}_rx_{name}", size)
+        sdf.add_mr(mr)
+        client.add_map(Map(mr, vaddr, perms="rw"))
+        regions.append((vaddr, size))
+        vaddr += size
+
+    free_queue, active_queue, data = regions
+    rx = struct.pack("<QQQQHB5x", *free_queue, *active_queue, num_buffers, ch)
+    rx_data = struct.pack("<QQ", *data)
+
+    with open(f"{output_dir}/net_copy_{client.name}.data", "wb+") as f:
+        f.write(client_config[:8] + virt_rx + device_data + rx + rx_data)
+
+    with open(f"{output_dir}/net_client_{client.name}.data", "wb+") as f:
+        f.write(client_config[:8] + rx + rx_data + client_config[64:])
+
+
+def generate(sdf_file: str, output_dir: str, dtb: DeviceTree, fused_copy: bool):
     uart_node = dtb.node(board.serial)
     assert uart_node is not None
     ethernet_node = dtb.node(board.ethernet)
@@ -173,20 +229,27 @@ def generate(sdf_file: str, output_dir: str, dtb: DeviceTree):
     net_system = Sddf.Net(sdf, ethernet_node, ethernet_driver, net_virt_tx, net_virt_rx)
 
     client0 = ProtectionDomain("client0", "echo0.elf", priority=97, budget=20000)
-    client0_net_copier = ProtectionDomain(
-        "client0_net_copier", "network_copy0.elf", priority=98, budget=20000
-    )
     client1 = ProtectionDomain("client1", "echo1.elf", priority=97, budget=20000)
-    client1_net_copier = ProtectionDomain(
-        "client1_net_copier", "network_copy1.elf", priority=98, budget=20000
-    )
 
     serial_system.add_client(client0)
     serial_system.add_client(client1)
     timer_system.add_client(client0)
     timer_system.add_client(client1)
-    net_system.add_client_with_copier(client0, client0_net_copier)
-    net_system.add_client_with_copier(client1, client1_net_copier)
+
+    if fused_copy:
+        net_system.add_client(client0)
+        net_system.add_client(client1)
+        copiers = []
+    else:
+        client0_net_copier = ProtectionDomain(
+            "client0_net_copier", "network_copy0.elf", priority=98, budget=20000
+        )
+        client1_net_copier = ProtectionDomain(
+            "client1_net_copier", "network_copy1.elf", priority=98, budget=20000
+        )
+        net_system.add_client_with_copier(client0, client0_net_copier)
+        net_system.add_client_with_copier(client1, client1_net_copier)
+        copiers = [client0_net_copier, client1_net_copier]
 
     client0_lib_sddf_lwip = Sddf.Lwip(sdf, net_system, client0)
     client1_lib_sddf_lwip = Sddf.Lwip(sdf, net_system, client1)
@@ -205,11 +268,9 @@ def generate(sdf_file: str, output_dir: str, dtb: DeviceTree):
         net_virt_tx,
         net_virt_rx,
         client0,
-        client0_net_copier,
         client1,
-        client1_net_copier,
         timer_driver,
-    ]
+    ] + copiers
     pds = [
         bench_idle,
         bench,
@@ -255,6 +316,9 @@ def generate(sdf_file: str, output_dir: str, dtb: DeviceTree):
     assert serial_system.serialise_config(output_dir)
     assert net_system.connect()
     assert net_system.serialise_config(output_dir)
+    if fused_copy:
+        fuse_copier(client0, output_dir)
+        fuse_copier(client1, output_dir)
     assert timer_system.connect()
     assert timer_system.serialise_config(output_dir)
     assert client0_lib_sddf_lwip.connect()
@@ -282,6 +346,7 @@ if __name__ == '__main__':
     parser.add_argument("--board", required=True, choices=[b.name for b in BOARDS])
     parser.add_argument("--output", required=True)
     parser.add_argument("--sdf", required=True)
+    parser.add_argument("--fused-copy", action="store_true")
 
     args = parser.parse_args()
 
@@ -293,4 +358,4 @@ if __name__ == '__main__':
     with open(args.dtb, "rb") as f:
         dtb = DeviceTree(f.read())
 
-    generate(args.sdf, args.output, dtb)
+    generate(args.sdf, args.output, dtb, args.fused_copy)
@@ -28,6 +28,11 @@
 
 #define DISPLAY_INFO_DATA_OFFSET 0x1000
 
+/* Alpha to draw the image with, set when the client is built to draw a translucent window over another one */
+#ifndef GPU_CLIENT_ALPHA
+#define GPU_CLIENT_ALPHA 0xff
+#endif
+
 #ifndef FB_IMG_WIDTH
 #error "FB_IMG_WIDTH not defined"
 #endif
@@ -50,6 +55,7 @@ extern char _fb_img_end[];
 static gpu_queue_handle_t gpu_queue_handle;
 static uint32_t req_id = 0;
 static uint32_t display_info_req_id = -1;
+static uint32_t page_flip_req_id = -1;
 static gpu_resp_get_display_info_t display_info = { 0 };
 static bool display_info_init = false;
 static bool pending_display_info_request = false;
@@ -61,6 +67,7 @@ enum draw_state {
 #ifdef GPU_BLOB_SUPPORT
     DRAW_FULL_BLOB,
     DRAW_QUADRANT_BLOB,
+    DRAW_FLIP_BLOB,
     DRAW_DISABLE_BLOB,
 #endif
 } draw_state = DRAW_FULL;
@@ -128,6 +135,31 @@ static void draw_image_blob(int resource_id, int res_width, int res_height, gpu_
                    rect.height, 0, GPU_FORMAT_B8G8R8A8_UNORM, res_width, res_height, 0, res_width * GPU_BPP_2D, rect.x,
                    rect.y, rect.width, rect.height);
 }
+
+static void flip_blob(int resource_id, int res_width, int res_height, gpu_rect_t rect)
+{
+    int err = 0;
+    page_flip_req_id = get_and_inc_req_id();
+    err = gpu_enqueue_req(&gpu_queue_handle, (gpu_req_t) {
+        .code = GPU_REQ_PAGE_FLIP,
+        .id = page_flip_req_id,
+        .page_flip = {
+            .resource_id = resource_id,
+            .scanout_id = 0,
+            .rect = rect,
+            .format = GPU_FORMAT_B8G8R8A8_UNORM,
+            .width = res_width,
+            .height = res_height,
+            .offset = 0,
+            .stride = res_width * GPU_BPP_2D,
+        },
+    });
+    assert(!err);
+
+    LOG_GPU_CLIENT("Flipping to blob image! Making the following requests:\n\
+    page_flip: resource_id: %d rect.x: %d rect.y: %d rect.width: %d rect.height: %d scanout_id: %d\n",
+                   resource_id, rect.x, rect.y, rect.width, rect.height, 0);
+}
 #endif
 
 static void draw_image(int resource_id, int res_width, int res_height, int xfer_offset, gpu_rect_t rect)
@@ -180,6 +212,7 @@ static void draw_image(int resource_id, int res_width, int res_height, int xfer_
             .rect.width = rect.width,
             .rect.height = rect.height,
             .mem_offset = xfer_offset,
+            .stride = res_width * GPU_BPP_2D,
         },
     });
     assert(!err);
@@ -352,6 +385,21 @@ static void do_draw_state(void)
                             .height = FB_IMG_HEIGHT / 2,
                         });
         sddf_timer_set_timeout(TIMER_CH, NS_IN_S);
+        draw_state = DRAW_FLIP_BLOB;
+        microkit_notify(VIRT_CH);
+        break;
+    case DRAW_FLIP_BLOB:
+        /* This will make the following requests:
+         * 1. Flip the scanout back to the full first blob, which is responded to once it is shown
+         */
+        flip_blob(1, FB_IMG_WIDTH, FB_IMG_HEIGHT,
+                  (gpu_rect_t) {
+                      .x = 0,
+                      .y = 0,
+                      .width = FB_IMG_WIDTH,
+                      .height = FB_IMG_HEIGHT,
+                  });
+        sddf_timer_set_timeout(TIMER_CH, NS_IN_S);
         draw_state = DRAW_DISABLE_BLOB;
         microkit_notify(VIRT_CH);
         break;
@@ -403,6 +451,13 @@ void init(void)
     assert(FB_IMG_WIDTH * FB_IMG_HEIGHT * GPU_BPP_2D + DISPLAY_INFO_DATA_OFFSET <= GPU_DATA_REGION_SIZE_CLI0);
     gpu_queue_init(&gpu_queue_handle, gpu_req_queue, gpu_resp_queue, GPU_QUEUE_CAPACITY_CLI0);
     sddf_memcpy((void *)(gpu_data + 0x1000), (void *)_fb_img, (size_t)(_fb_img_end - _fb_img));
+    if (GPU_CLIENT_ALPHA != 0xff) {
+        /* Pixels are B8G8R8A8, replace the alpha of each one */
+        uint8_t *pixels = (uint8_t *)(gpu_data + 0x1000);
+        for (size_t i = 0; i < (size_t)(_fb_img_end - _fb_img); i += GPU_BPP_2D) {
+            pixels[i + 3] = GPU_CLIENT_ALPHA;
+        }
+    }
 
     /* As part of initialisation, request for display info before sending anything else */
     LOG_GPU_CLIENT("Requesting initial display info\n");
@@ -461,5 +516,12 @@ void notified(microkit_channel ch)
             handle_display_info_response();
             pending_display_info_request = false;
         }
+#ifdef GPU_BLOB_SUPPORT
+        if (resp.id == page_flip_req_id) {
+            uint64_t timestamp = 0;
+            uint64_t flips = gpu_events_check_flip(gpu_events, 0, &timestamp);
+            LOG_GPU_CLIENT("Page flip %lu took effect at timestamp %lu\n", flips, timestamp);
+        }
+#endif
     }
 }
@@ -28,6 +28,10 @@ ifeq ($(strip ${BLOB}),)
 $(error BLOB must be specified)
 endif
 
+ifeq ($(strip ${COMPOSITOR}),)
+$(error COMPOSITOR must be specified)
+endif
+
 ifeq (, $(shell which convert))
 $(error "convert is not available. Please install imagemagick")
 endif
@@ -84,12 +88,21 @@ CFLAGS_gpu := -DGPU_BLOB_SUPPORT
 else
 CFLAGS_gpu :=
 endif
+ifneq ($(strip ${COMPOSITOR}), 0)
+CFLAGS_gpu += -DGPU_VIRT_COMPOSITOR
+# A second client, drawing the image translucent in a window overlapping the first client's
+IMAGES += client_overlay.elf
+endif
 LDFLAGS := -L${BOARD_DIR}/lib
 LIBS := --start-group -lmicrokit -Tmicrokit.ld libsddf_util_debug.a --end-group
 
 IMAGE_FILE   := loader.img
 REPORT_FILE  := report.txt
+ifneq ($(strip ${COMPOSITOR}), 0)
+SYSTEM_FILE  := ${TOP}/board/${MICROKIT_BOARD}/gpu_compositor.system
+else
 SYSTEM_FILE  := ${TOP}/board/${MICROKIT_BOARD}/gpu.system
+endif
 
 GPU_DRIVER   := ${SDDF}/drivers/gpu/${GPU_DRIVER_DIR}
 GPU_COMPONENTS := ${SDDF}/gpu/components
@@ -140,9 +153,18 @@ client.o: ${TOP}/client.c ${FB_IMG} ${CHECK_GPU_CLI_FLAGS_MD5}
 fb_img.o: ${TOP}/fb_img.S fb_img.bgra
 	${CC} -c -DFB_IMG_PATH=\"fb_img.bgra\" $< -o $@
 
+client_overlay.o: ${TOP}/client.c ${FB_IMG} ${CHECK_GPU_CLI_FLAGS_MD5}
+	${CC} -c ${CFLAGS} ${CFLAGS_gpu} -DGPU_CLIENT_ALPHA=0x80 \
+		-DFB_IMG_WIDTH=$(shell convert ${FB_IMG} -auto-orient -print "%w" /dev/null) \
+		-DFB_IMG_HEIGHT=$(shell convert ${FB_IMG} -auto-orient -print "%h" /dev/null) \
+		$< -o $@
+
 client.elf: client.o fb_img.o
 	${LD} ${LDFLAGS} $^ ${LIBS} -o $@
 
+client_overlay.elf: client_overlay.o fb_img.o
+	${LD} ${LDFLAGS} $^ ${LIBS} -o $@
+
 ${IMAGE_FILE} ${REPORT_FILE}: ${IMAGES} ${SYSTEM_FILE}
 	${MICROKIT_TOOL} ${SYSTEM_FILE} --search-path ${BUILD_DIR} --board ${MICROKIT_BOARD} --config ${MICROKIT_CONFIG} -o ${IMAGE_FILE} -r ${REPORT_FILE}
 
@@ -150,6 +172,6 @@ qemu: ${IMAGE_FILE}
 	${QEMU_CMD}
 
 clean::
-	rm -f client.o fb_img.o fb_img.bgra
+	rm -f client.o client_overlay.o fb_img.o fb_img.bgra
 clobber:: clean
-	rm -f client.elf ${IMAGE_FILE} ${REPORT_FILE}
+	rm -f client.elf client_overlay.elf ${IMAGE_FILE} ${REPORT_FILE}
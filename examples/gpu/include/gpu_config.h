@@ -10,16 +10,25 @@
 #include <sddf/gpu/queue.h>
 #include <sddf/gpu/events.h>
 
+/* In compositor mode, a second client draws a translucent window over part of the first one's */
+#ifdef GPU_VIRT_COMPOSITOR
+#define GPU_NUM_CLIENTS                     2
+#else
 #define GPU_NUM_CLIENTS                     1
+#endif
 
 #define GPU_NAME_CLI0                       "client"
+#define GPU_NAME_CLI1                       "client_overlay"
 
 #define GPU_QUEUE_CAPACITY_CLI0             1024
+#define GPU_QUEUE_CAPACITY_CLI1             1024
 #define GPU_QUEUE_CAPACITY_DRV              1024
 
 #define GPU_DATA_REGION_SIZE_CLI0           0x200000
+#define GPU_DATA_REGION_SIZE_CLI1           0x200000
 #define GPU_DATA_REGION_SIZE_DRV            0x1000
 #define GPU_QUEUE_REGION_SIZE_CLI0          0x200000
+#define GPU_QUEUE_REGION_SIZE_CLI1          0x200000
 #define GPU_QUEUE_REGION_SIZE_DRV           0x200000
 
 /*
@@ -29,11 +38,17 @@
 #define GPU_VIRTIO_METADATA_REGION_SIZE     0x200000
 #define GPU_VIRTIO_DATA_REGION_SIZE         0x200000
 
+/* Size of the region the virtualiser composites scanouts into, when built with GPU_VIRT_COMPOSITOR */
+#define GPU_VIRT_FB_REGION_SIZE             0x800000
+
+/* The virtualiser maps the regions of each kind for all clients one after another */
 static inline gpu_events_t *gpu_virt_cli_events_region(gpu_events_t *events, unsigned int id)
 {
     switch (id) {
     case 0:
         return events;
+    case 1:
+        return (gpu_events_t *)((uintptr_t)events + GPU_EVENTS_REGION_SIZE);
     default:
         return NULL;
     }
@@ -44,6 +59,8 @@ static inline gpu_req_queue_t *gpu_virt_cli_req_queue(gpu_req_queue_t *req, unsi
     switch (id) {
     case 0:
         return req;
+    case 1:
+        return (gpu_req_queue_t *)((uintptr_t)req + GPU_QUEUE_REGION_SIZE_CLI0);
     default:
         return NULL;
     }
@@ -54,6 +71,8 @@ static inline gpu_resp_queue_t *gpu_virt_cli_resp_queue(gpu_resp_queue_t *resp,
     switch (id) {
     case 0:
         return resp;
+    case 1:
+        return (gpu_resp_queue_t *)((uintptr_t)resp + GPU_QUEUE_REGION_SIZE_CLI0);
     default:
         return NULL;
     }
@@ -64,6 +83,8 @@ static inline uintptr_t gpu_virt_cli_data_region(uintptr_t data, unsigned int id
     switch (id) {
     case 0:
         return data;
+    case 1:
+        return data + GPU_DATA_REGION_SIZE_CLI0;
     default:
         return 0;
     }
@@ -74,6 +95,8 @@ static inline uint64_t gpu_virt_cli_data_region_size(unsigned int id)
     switch (id) {
     case 0:
         return GPU_DATA_REGION_SIZE_CLI0;
+    case 1:
+        return GPU_DATA_REGION_SIZE_CLI1;
     default:
         return 0;
     }
@@ -84,15 +107,39 @@ static inline uint32_t gpu_virt_cli_queue_capacity(unsigned int id)
     switch (id) {
     case 0:
         return GPU_QUEUE_CAPACITY_CLI0;
+    case 1:
+        return GPU_QUEUE_CAPACITY_CLI1;
     default:
         return 0;
     }
 }
 
+static inline gpu_window_t gpu_virt_cli_window(unsigned int id)
+{
+    switch (id) {
+    case 0:
+        return (gpu_window_t) {
+            .scanout_id = 0,
+            .rect = { .x = 0, .y = 0, .width = 1280, .height = 800 },
+            .z = 0,
+        };
+    case 1:
+        return (gpu_window_t) {
+            .scanout_id = 0,
+            .rect = { .x = 320, .y = 200, .width = 960, .height = 600 },
+            .z = 1,
+        };
+    default:
+        return (gpu_window_t) { 0 };
+    }
+}
+
 static inline uint32_t gpu_cli_queue_capacity(char *pd_name)
 {
     if (!sddf_strcmp(pd_name, GPU_NAME_CLI0)) {
         return GPU_QUEUE_CAPACITY_CLI0;
+    } else if (!sddf_strcmp(pd_name, GPU_NAME_CLI1)) {
+        return GPU_QUEUE_CAPACITY_CLI1;
     } else {
         return 0;
     }
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sddf/util/string.h>
+#include "compositor.h"
+
+/*
+ * The blit kernels are portable C, as components are built freestanding
+ * without vector intrinsics. Opaque rows are copied with sddf_memcpy, and
+ * blending works on the red and blue channels of a pixel together with a
+ * single multiply, the channels being far enough apart that the products
+ * cannot carry into each other.
+ */
+
+#define ALPHA_SHIFT 24
+#define RB_MASK 0x00ff00ffu
+#define G_MASK 0x0000ff00u
+
+static inline bool rect_contains(gpu_rect_t outer, gpu_rect_t inner)
+{
+    return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width
+        && inner.y + inner.height <= outer.y + outer.height;
+}
+
+/* Blend src over an opaque dst, dividing each channel by 255 exactly with (x + 1 + (x >> 8)) >> 8 */
+static inline uint32_t blend_pixel(uint32_t src, uint32_t dst, uint32_t alpha)
+{
+    uint32_t inv_alpha = 0xff - alpha;
+    uint32_t rb = (src & RB_MASK) * alpha + (dst & RB_MASK) * inv_alpha;
+    uint32_t g = (src & G_MASK) * alpha + (dst & G_MASK) * inv_alpha;
+    rb = ((rb + 0x00010001u + ((rb >> 8) & RB_MASK)) >> 8) & RB_MASK;
+    g = ((g >> 8) + 1 + (g >> 16)) & G_MASK;
+    return (0xffu << ALPHA_SHIFT) | rb | g;
+}
+
+static void blend_row(uint32_t *dst, const uint32_t *src, uint32_t width)
+{
+    for (uint32_t i = 0; i < width; i++) {
+        uint32_t pixel = src[i];
+        uint32_t alpha = pixel >> ALPHA_SHIFT;
+        if (alpha == 0xff) {
+            dst[i] = pixel;
+        } else if (alpha != 0) {
+            dst[i] = blend_pixel(pixel, dst[i], alpha);
+        }
+    }
+}
+
+static void fill_row(uint32_t *dst, uint32_t pixel, uint32_t width)
+{
+    for (uint32_t i = 0; i < width; i++) {
+        dst[i] = pixel;
+    }
+}
+
+void compositor_compose(uintptr_t fb, uint32_t fb_stride, const compositor_layer_t *layers, uint32_t num_layers,
+                        gpu_rect_t rect)
+{
+    if (rect.width == 0 || rect.height == 0) {
+        return;
+    }
+
+    /* Nothing below an opaque layer covering the whole rectangle can be seen */
+    uint32_t bottom = 0;
+    bool covered = false;
+    for (uint32_t i = num_layers; i-- > 0;) {
+        if (layers[i].opaque && rect_contains(layers[i].rect, rect)) {
+            bottom = i;
+            covered = true;
+            break;
+        }
+    }
+
+    uintptr_t fb_base = fb + (uintptr_t)rect.y * fb_stride + (uintptr_t)rect.x * GPU_BPP_2D;
+    if (!covered) {
+        for (uint32_t row = 0; row < rect.height; row++) {
+            fill_row((uint32_t *)(fb_base + (uintptr_t)row * fb_stride), COMPOSITOR_BACKGROUND, rect.width);
+        }
+    }
+
+    for (uint32_t i = bottom; i < num_layers; i++) {
+        const compositor_layer_t *layer = &layers[i];
+        gpu_rect_t clip = gpu_rect_intersect(layer->rect, rect);
+        if (clip.width == 0) {
+            continue;
+        }
+
+        uintptr_t src = layer->pixels + (uintptr_t)(clip.y - layer->rect.y) * layer->stride
+                      + (uintptr_t)(clip.x - layer->rect.x) * GPU_BPP_2D;
+        uintptr_t dst = fb + (uintptr_t)clip.y * fb_stride + (uintptr_t)clip.x * GPU_BPP_2D;
+        for (uint32_t row = 0; row < clip.height; row++) {
+            if (layer->opaque) {
+                sddf_memcpy((void *)dst, (void *)src, clip.width * GPU_BPP_2D);
+            } else {
+                blend_row((uint32_t *)dst, (const uint32_t *)src, clip.width);
+            }
+            src += layer->stride;
+            dst += fb_stride;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sddf/gpu/gpu.h>
+
+/*
+ * Software compositing of client windows into a scanout framebuffer, used by
+ * the GPU virtualiser when built with GPU_VIRT_COMPOSITOR.
+ *
+ * Pixels are 32-bit B8G8R8A8 or B8G8R8X8. Layers with an alpha channel are
+ * blended with straight (non-premultiplied) alpha, the framebuffer is always
+ * left opaque.
+ */
+
+/* Colour of the framebuffer where no layer is drawn */
+#ifndef COMPOSITOR_BACKGROUND
+#define COMPOSITOR_BACKGROUND 0xff000000
+#endif
+
+typedef struct compositor_layer {
+    /* Rectangle of the framebuffer covered by the layer */
+    gpu_rect_t rect;
+    /* Address of the pixel drawn at the top left of rect */
+    uintptr_t pixels;
+    /* Bytes from one row of pixels to the next */
+    uint32_t stride;
+    /* Layer has no alpha channel and hides whatever is below it */
+    bool opaque;
+} compositor_layer_t;
+
+/**
+ * Intersection of two rectangles.
+ *
+ * @param a first rectangle.
+ * @param b second rectangle.
+ *
+ * @return the intersection, which has zero width and height if a and b do not overlap.
+ */
+static inline gpu_rect_t gpu_rect_intersect(gpu_rect_t a, gpu_rect_t b)
+{
+    uint32_t x0 = a.x > b.x ? a.x : b.x;
+    uint32_t y0 = a.y > b.y ? a.y : b.y;
+    uint32_t x1 = a.x + a.width < b.x + b.width ? a.x + a.width : b.x + b.width;
+    uint32_t y1 = a.y + a.height < b.y + b.height ? a.y + a.height : b.y + b.height;
+    if (x1 <= x0 || y1 <= y0) {
+        return (gpu_rect_t) { 0 };
+    }
+    return (gpu_rect_t) {
+        .x = x0,
+        .y = y0,
+        .width = x1 - x0,
+        .height = y1 - y0,
+    };
+}
+
+/**
+ * Redraw a rectangle of the framebuffer from a stack of layers.
+ *
+ * @param fb address of the top left pixel of the framebuffer.
+ * @param fb_stride bytes from one row of framebuffer pixels to the next.
+ * @param layers layers ordered from bottom to top.
+ * @param num_layers number of layers.
+ * @param rect rectangle of the framebuffer to redraw.
+ */
+void compositor_compose(uintptr_t fb, uint32_t fb_stride, const compositor_layer_t *layers, uint32_t num_layers,
+                        gpu_rect_t rect);
@@ -18,15 +18,19 @@ ${CHECK_GPU_VIRT_FLAGS_MD5}:
 	-rm -f .gpu_virt_cflags-*
 	touch $@
 
-gpu_virt.elf: gpu_virt.o
+gpu_virt.elf: gpu_virt.o gpu_compositor.o
 	$(LD) $(LDFLAGS) $^ $(LIBS) -o $@
 
 gpu_virt.o: ${SDDF}/gpu/components/virt.c ${CHECK_GPU_VIRT_FLAGS_MD5}
+	${CC} ${CFLAGS} -I${SDDF}/gpu/components ${CFLAGS_gpu} -o $@ -c $<
+
+gpu_compositor.o: ${SDDF}/gpu/components/compositor.c ${CHECK_GPU_VIRT_FLAGS_MD5}
 	${CC} ${CFLAGS} ${CFLAGS_gpu} -o $@ -c $<
 
 -include gpu_virt.d
+-include gpu_compositor.d
 
 clean::
-	rm -f gpu_virt.[od] .gpu_virt_cflags-*
+	rm -f gpu_virt.[od] gpu_compositor.[od] .gpu_virt_cflags-*
 clobber:: clean
 	rm -f gpu_virt.elf
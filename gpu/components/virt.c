@@ -10,8 +10,10 @@
 #include <sddf/gpu/events.h>
 #include <sddf/util/ialloc.h>
 #include <sddf/util/printf.h>
+#include <sddf/util/util.h>
 #include <sddf/util/cache.h>
 #include <gpu_config.h>
+#include "compositor.h"
 
 /* Uncomment this to enable debug logging */
 // #define DEBUG_GPU_VIRT
@@ -36,6 +38,80 @@ the largest value reserved for unmapped resources");
 _Static_assert(GPU_NUM_CLIENTS <= UINT32_MAX - 1, "Client ids can only occupy 32 bits of memory, with the largest "
                                                   "value reserved for virtualiser id itself");
 
+/*
+ * Transfers and flushes from a client are not forwarded one-to-one. Their rectangles are
+ * accumulated per resource in a frame, merged, and issued to the driver as the smallest
+ * set of requests covering the damage. A frame is issued at the end of the client's batch
+ * of requests, unless a previous frame of the client is still with the driver, in which
+ * case it keeps accumulating damage until that one completes. Any other request from the
+ * client issues the open frame first, so the driver sees requests in the client's order.
+ * The client requests coalesced into a frame are responded to once the driver has
+ * completed the requests they were merged into.
+ */
+
+/* Rectangles of each kind kept per resource in a frame, further damage is merged into these */
+#ifndef GPU_VIRT_DAMAGE_RECTS
+#define GPU_VIRT_DAMAGE_RECTS 8
+#endif
+
+/* Resources that can be damaged in one frame */
+#ifndef GPU_VIRT_DAMAGE_RESOURCES
+#define GPU_VIRT_DAMAGE_RESOURCES 4
+#endif
+
+/* Client requests that can be coalesced into one frame */
+#ifndef GPU_VIRT_FRAME_WAITERS
+#define GPU_VIRT_FRAME_WAITERS 64
+#endif
+
+/* Frames open or in flight across all clients */
+#ifndef GPU_VIRT_MAX_FRAMES
+#define GPU_VIRT_MAX_FRAMES (4 * GPU_NUM_CLIENTS)
+#endif
+
+/*
+ * Pixels that merging two touching rectangles may add beyond their combined area, trading
+ * the cost of copying some undamaged pixels against the cost of another request.
+ */
+#ifndef GPU_VIRT_DAMAGE_MERGE_SLACK
+#define GPU_VIRT_DAMAGE_MERGE_SLACK (64 * 64)
+#endif
+
+#define NO_FRAME UINT32_MAX
+
+/*
+ * Page flips of a scanout that each client may have in flight at once. A flip completes once
+ * the new resource is shown, so this bounds how far a client can render ahead of the display.
+ * Two is enough for triple buffering. Further flips are failed with GPU_RESP_ERR_BUSY.
+ */
+#ifndef GPU_VIRT_MAX_FLIPS
+#define GPU_VIRT_MAX_FLIPS 2
+#endif
+
+#ifdef GPU_VIRT_COMPOSITOR
+/*
+ * In compositor mode, client resources are never created on the driver. Each client instead
+ * has a window, placed on a scanout by gpu_virt_cli_window() in the GPU config. A client's
+ * SET_SCANOUT on the scanout of its window chooses the resource shown in the window, and its
+ * flushes composite the damaged part of the window, blended with any overlapping windows of
+ * other clients in z order, into a framebuffer owned by the virtualiser. The framebuffer of
+ * each scanout backs a resource of the virtualiser's, and what has been composited is
+ * transferred and flushed to the display one frame at a time. The driver resolves backing
+ * offsets against the framebuffer region, gpu_virt_fb, rather than the client data region.
+ *
+ * Transfers are only validated, as the compositor reads pixels straight from the memory
+ * backing when a flush is composited. Only B8G8R8A8 and B8G8R8X8 resources can be created,
+ * and blob resources are not supported. The size of the scanouts is taken from the display
+ * info at initialisation, later display info events do not resize the framebuffers.
+ */
+#ifndef GPU_VIRT_FB_REGION_SIZE
+#error "GPU_VIRT_FB_REGION_SIZE must be defined by the GPU config in compositor mode"
+#endif
+#endif
+
+_Static_assert(GPU_VIRT_DAMAGE_RESOURCES * GPU_VIRT_DAMAGE_RECTS * 2 < GPU_QUEUE_CAPACITY_DRV,
+               "A frame must fit in the driver request queue");
+
 /* Microkit patched variables */
 gpu_events_t *gpu_driver_events;
 gpu_req_queue_t *gpu_driver_req_queue;
@@ -54,6 +130,10 @@ typedef struct client {
     microkit_channel ch;
     /* Mapping from virtualiser resource id to driver resource id */
     uint32_t res_map_virt_to_drv[GPU_MAX_RESOURCES + 1];
+    /* Frame accumulating damage, NO_FRAME if none */
+    uint32_t open_frame;
+    /* Frames issued to the driver that are yet to complete */
+    uint32_t frames_in_flight;
 } client_t;
 static client_t clients[GPU_NUM_CLIENTS];
 /* Driver resource id allocations */
@@ -67,6 +147,7 @@ typedef struct resource {
     bool is_blob;
     uint64_t mem_offset;
     uint32_t mem_size;
+    gpu_formats_t format;
 } resource_t;
 /* Indexed by driver resource id */
 static resource_t drv_resources[GPU_MAX_RESOURCES + 1];
@@ -78,6 +159,8 @@ typedef struct blob_scanout {
 } blob_scanout_t;
 /* Indexed by resource id and scanout id */
 static blob_scanout_t blob_scanouts[GPU_MAX_SCANOUTS][GPU_MAX_RESOURCES + 1];
+/* Page flips in flight, indexed by client id and scanout id */
+static uint32_t flips_in_flight[GPU_NUM_CLIENTS][GPU_MAX_SCANOUTS];
 
 /* This bookkeeping exists to store information between a request/response pair. */
 typedef struct reqbk {
@@ -86,6 +169,8 @@ typedef struct reqbk {
     gpu_req_code_t code;
     uint32_t res_virt;
     uint32_t res_scanout;
+    /* Frame this request was merged for, NO_FRAME if it was forwarded from a single client request */
+    uint32_t frame;
 } reqbk_t;
 /* Indexed by virt-to-drv request id */
 static reqbk_t reqsbk[GPU_QUEUE_CAPACITY_DRV];
@@ -93,6 +178,38 @@ static reqbk_t reqsbk[GPU_QUEUE_CAPACITY_DRV];
 static ialloc_t req_ialloc;
 static uint32_t req_ialloc_idxlist[GPU_QUEUE_CAPACITY_DRV];
 
+/* Damage to one resource in a frame */
+typedef struct damage {
+    uint32_t res_virt;
+    uint32_t res_drv;
+    uint32_t num_transfers;
+    gpu_rect_t transfers[GPU_VIRT_DAMAGE_RECTS];
+    uint32_t num_flushes;
+    gpu_rect_t flushes[GPU_VIRT_DAMAGE_RECTS];
+    /* First failure of the driver requests for this resource */
+    gpu_resp_status_t status;
+} damage_t;
+
+/* Client request coalesced into a frame */
+typedef struct waiter {
+    uint32_t cli_req_id;
+    /* Index of the damage the request was merged into */
+    uint32_t damage;
+} waiter_t;
+
+typedef struct frame {
+    uint32_t cli_id;
+    uint32_t num_damaged;
+    damage_t damaged[GPU_VIRT_DAMAGE_RESOURCES];
+    uint32_t num_waiters;
+    waiter_t waiters[GPU_VIRT_FRAME_WAITERS];
+    /* Driver requests issued for this frame that are yet to complete */
+    uint32_t outstanding;
+} frame_t;
+static frame_t frames[GPU_VIRT_MAX_FRAMES];
+static ialloc_t frame_ialloc;
+static uint32_t frame_ialloc_idxlist[GPU_VIRT_MAX_FRAMES];
+
 /* Display info populated during initialisation and any display_info event */
 static gpu_resp_get_display_info_t get_display_info = { 0 };
 
@@ -100,6 +217,46 @@ static bool pending_display_info_request = false;
 static bool try_again_display_info_req = false;
 static bool display_info_init = false;
 
+#ifdef GPU_VIRT_COMPOSITOR
+/* Patched by Microkit */
+uintptr_t gpu_virt_fb;
+
+typedef struct window {
+    gpu_window_t config;
+    /* Driver resource id shown in the window, GPU_DISABLE_SCANOUT_RESOURCE_ID if none */
+    uint32_t res_drv;
+    /* Rectangle within the resource shown in the window */
+    gpu_rect_t src;
+} window_t;
+/* Indexed by client id */
+static window_t windows[GPU_NUM_CLIENTS];
+/* Client ids from the bottom window to the top */
+static uint32_t window_order[GPU_NUM_CLIENTS];
+
+typedef struct comp_scanout {
+    bool active;
+    /* Driver resource id of the framebuffer */
+    uint32_t res_drv;
+    /* Offset of the framebuffer within the framebuffer region */
+    uint64_t fb_offset;
+    uint32_t width;
+    uint32_t height;
+    /* Rectangles yet to be composited */
+    uint32_t num_damage;
+    gpu_rect_t damage[GPU_VIRT_DAMAGE_RECTS];
+    /* Rectangles composited but yet to be transferred and flushed */
+    uint32_t num_dirty;
+    gpu_rect_t dirty[GPU_VIRT_DAMAGE_RECTS];
+    /* Transfers and flushes issued to the driver that are yet to complete */
+    uint32_t in_flight;
+} comp_scanout_t;
+/* Indexed by scanout id */
+static comp_scanout_t comp_scanouts[GPU_MAX_SCANOUTS];
+
+static void compositor_init(void);
+static bool compositor_issue(void);
+#endif
+
 static void handle_clients(void);
 static void handle_driver(void);
 static void init_request_get_display_info(void);
@@ -110,6 +267,7 @@ void init(void)
     LOG_GPU_VIRT("Initialising GPU virtualiser!\n");
     ialloc_init(&req_ialloc, req_ialloc_idxlist, GPU_QUEUE_CAPACITY_DRV);
     ialloc_init_with_offset(&res_ialloc, res_ialloc_idxlist, GPU_MAX_RESOURCES, 1);
+    ialloc_init(&frame_ialloc, frame_ialloc_idxlist, GPU_VIRT_MAX_FRAMES);
 
     /* Initialise client queues */
     for (int i = 0; i < GPU_NUM_CLIENTS; i++) {
@@ -120,9 +278,24 @@ void init(void)
         gpu_events_t *curr_events = gpu_virt_cli_events_region(gpu_client_events, i);
         clients[i].events = curr_events;
         clients[i].ch = CLI_CH_OFFSET + i;
+        clients[i].open_frame = NO_FRAME;
+        clients[i].frames_in_flight = 0;
         for (int j = 1; j < GPU_MAX_RESOURCES + 1; j++) {
             clients[i].res_map_virt_to_drv[j] = UNMAPPED_RESOURCE_ID;
         }
+
+#ifdef GPU_VIRT_COMPOSITOR
+        windows[i].config = gpu_virt_cli_window(i);
+        assert(windows[i].config.scanout_id < GPU_MAX_SCANOUTS);
+        windows[i].res_drv = GPU_DISABLE_SCANOUT_RESOURCE_ID;
+        /* Insert into the z order, clients with equal z are drawn in order of id */
+        int pos = i;
+        while (pos > 0 && windows[window_order[pos - 1]].config.z > windows[i].config.z) {
+            window_order[pos] = window_order[pos - 1];
+            pos--;
+        }
+        window_order[pos] = i;
+#endif
     }
 
     gpu_queue_init(&drv_h, gpu_driver_req_queue, gpu_driver_resp_queue, GPU_QUEUE_CAPACITY_DRV);
@@ -144,6 +317,9 @@ void notified(microkit_channel ch)
         if (ch == DRIVER_CH && handle_init_get_display_info_response()) {
             display_info_init = true;
             LOG_GPU_VIRT("Initialised display info\n");
+#ifdef GPU_VIRT_COMPOSITOR
+            compositor_init();
+#endif
         } else {
             return;
         }
@@ -297,11 +473,15 @@ static inline bool gpu_set_scanout_blob(int cli_id, gpu_req_t *req, gpu_req_t *d
         return false;
     }
 
-    blob_scanouts[req->set_scanout_blob.scanout_id][req->set_scanout_blob.resource_id].active = true;
-    blob_scanouts[req->set_scanout_blob.scanout_id][req->set_scanout_blob.resource_id].width =
-        req->set_scanout_blob.width;
-    blob_scanouts[req->set_scanout_blob.scanout_id][req->set_scanout_blob.resource_id].height =
-        req->set_scanout_blob.height;
+    /* The scanout shows one resource at a time, so the one replaced, such as the back buffer after a
+     * page flip, is no longer checked against the scanout */
+    uint32_t res_drv = clients[cli_id].res_map_virt_to_drv[req->set_scanout_blob.resource_id];
+    for (int i = 0; i < GPU_MAX_RESOURCES + 1; i++) {
+        blob_scanouts[req->set_scanout_blob.scanout_id][i].active = false;
+    }
+    blob_scanouts[req->set_scanout_blob.scanout_id][res_drv].active = true;
+    blob_scanouts[req->set_scanout_blob.scanout_id][res_drv].width = req->set_scanout_blob.width;
+    blob_scanouts[req->set_scanout_blob.scanout_id][res_drv].height = req->set_scanout_blob.height;
 
     reqsbk[drv_req->id].res_virt = req->set_scanout_blob.resource_id;
 
@@ -310,12 +490,45 @@ static inline bool gpu_set_scanout_blob(int cli_id, gpu_req_t *req, gpu_req_t *d
     /* Give each client the same view of scanouts as virtualiser */
     drv_req->set_scanout_blob.scanout_id = req->set_scanout_blob.scanout_id;
     drv_req->set_scanout_blob.rect = req->set_scanout_blob.rect;
+    drv_req->set_scanout_blob.format = req->set_scanout_blob.format;
     drv_req->set_scanout_blob.offset = req->set_scanout_blob.offset;
     drv_req->set_scanout_blob.stride = req->set_scanout_blob.stride;
     drv_req->set_scanout_blob.width = req->set_scanout_blob.width;
     drv_req->set_scanout_blob.height = req->set_scanout_blob.height;
     return true;
 }
+
+static inline bool gpu_page_flip(int cli_id, gpu_req_t *req, gpu_req_t *drv_req, gpu_resp_t *fail_resp)
+{
+    if (req->page_flip.scanout_id >= GPU_MAX_SCANOUTS) {
+        LOG_GPU_VIRT_ERR("PAGE_FLIP: Scanout id invalid, failing request\n");
+        fail_resp->status = GPU_RESP_ERR_INVALID_SCANOUT_ID;
+        return false;
+    }
+
+    if (req->page_flip.resource_id == GPU_DISABLE_SCANOUT_RESOURCE_ID) {
+        LOG_GPU_VIRT_ERR("PAGE_FLIP: Cannot flip to the reserved resource id, failing request\n");
+        fail_resp->status = GPU_RESP_ERR_INVALID_RESOURCE_ID;
+        return false;
+    }
+
+    if (flips_in_flight[cli_id][req->page_flip.scanout_id] == GPU_VIRT_MAX_FLIPS) {
+        LOG_GPU_VIRT_ERR("PAGE_FLIP: Too many page flips in flight on scanout, failing request\n");
+        fail_resp->status = GPU_RESP_ERR_BUSY;
+        return false;
+    }
+
+    /* A page flip is validated and translated like setting the scanout to the blob */
+    if (!gpu_set_scanout_blob(cli_id, req, drv_req, fail_resp)) {
+        return false;
+    }
+
+    flips_in_flight[cli_id][req->page_flip.scanout_id]++;
+    reqsbk[drv_req->id].res_scanout = req->page_flip.scanout_id;
+
+    drv_req->code = GPU_REQ_PAGE_FLIP;
+    return true;
+}
 #endif
 
 static inline bool gpu_resource_create_2d(int cli_id, gpu_req_t *req, gpu_req_t *drv_req, gpu_resp_t *fail_resp)
@@ -348,6 +561,7 @@ static inline bool gpu_resource_create_2d(int cli_id, gpu_req_t *req, gpu_req_t
     drv_resources[drv_res_id].height = req->resource_create_2d.height;
     drv_resources[drv_res_id].has_backing = false;
     drv_resources[drv_res_id].is_blob = false;
+    drv_resources[drv_res_id].format = req->resource_create_2d.format;
     /* Not used for 2D resources */
     drv_resources[drv_res_id].mem_offset = 0;
     drv_resources[drv_res_id].mem_size = 0;
@@ -540,7 +754,22 @@ static inline bool gpu_transfer_to_2d(int cli_id, gpu_req_t *req, gpu_req_t *drv
         return false;
     }
 
-    if (req->transfer_to_2d.mem_offset + req->transfer_to_2d.rect.width * req->transfer_to_2d.rect.height * GPU_BPP_2D
+    /* The device reads each row of the rectangle from the backing at the resource's row size apart */
+    uint64_t stride = drv_resources[clients[cli_id].res_map_virt_to_drv[req->transfer_to_2d.resource_id]].width
+                    * GPU_BPP_2D;
+    if (req->transfer_to_2d.stride != 0 && req->transfer_to_2d.stride != stride) {
+        LOG_GPU_VIRT_ERR("TRANSFER_TO_2D: Stride differs from the row size of the "
+                         "resource, failing request\n");
+        fail_resp->status = GPU_RESP_ERR_INVALID_PARAMETER;
+        return false;
+    }
+
+    uint64_t row_len = (uint64_t)req->transfer_to_2d.rect.width * GPU_BPP_2D;
+    uint64_t transfer_len = 0;
+    if (req->transfer_to_2d.rect.height) {
+        transfer_len = stride * (req->transfer_to_2d.rect.height - 1) + row_len;
+    }
+    if (req->transfer_to_2d.mem_offset + transfer_len
         > drv_resources[clients[cli_id].res_map_virt_to_drv[req->transfer_to_2d.resource_id]].mem_size) {
         LOG_GPU_VIRT_ERR("TRANSFER_TO_2D: Transfer region out of bounds from "
                          "memory backing, failing request\n");
@@ -548,13 +777,6 @@ static inline bool gpu_transfer_to_2d(int cli_id, gpu_req_t *req, gpu_req_t *drv
         return false;
     }
 
-    unsigned long transfer_base =
-        (unsigned long)(gpu_virt_cli_data_region(gpu_client_data, cli_id)
-                        + drv_resources[clients[cli_id].res_map_virt_to_drv[req->transfer_to_2d.resource_id]].mem_offset
-                        + req->transfer_to_2d.mem_offset);
-    cache_clean(transfer_base,
-                transfer_base + req->transfer_to_2d.rect.width * req->transfer_to_2d.rect.height * GPU_BPP_2D);
-
     reqsbk[drv_req->id].res_virt = req->transfer_to_2d.resource_id;
 
     drv_req->code = GPU_REQ_TRANSFER_TO_2D;
@@ -564,9 +786,25 @@ static inline bool gpu_transfer_to_2d(int cli_id, gpu_req_t *req, gpu_req_t *drv
     drv_req->transfer_to_2d.rect.width = req->transfer_to_2d.rect.width;
     drv_req->transfer_to_2d.rect.height = req->transfer_to_2d.rect.height;
     drv_req->transfer_to_2d.mem_offset = req->transfer_to_2d.mem_offset;
+    drv_req->transfer_to_2d.stride = stride;
     return true;
 }
 
+/*
+ * Clean the rows of a transfer's rectangle from the client's backing, not the rest of the rows in
+ * between. Done when the transfer is issued to the driver rather than when it is validated, so that
+ * merged transfers clean the pixels the merge added. The compositor reads backings through the cache
+ * and issues no client transfers, so it never needs this.
+ */
+static void transfer_clean(int cli_id, gpu_req_t *drv_req)
+{
+    unsigned long transfer_base = (unsigned long)(gpu_virt_cli_data_region(gpu_client_data, cli_id)
+                                                  + drv_resources[drv_req->transfer_to_2d.resource_id].mem_offset
+                                                  + drv_req->transfer_to_2d.mem_offset);
+    cache_clean_rows(transfer_base, (unsigned long)drv_req->transfer_to_2d.rect.width * GPU_BPP_2D,
+                     drv_req->transfer_to_2d.stride, drv_req->transfer_to_2d.rect.height);
+}
+
 static inline bool gpu_resource_flush(int cli_id, gpu_req_t *req, gpu_req_t *drv_req, gpu_resp_t *fail_resp)
 {
     if (req->resource_flush.resource_id == GPU_DISABLE_SCANOUT_RESOURCE_ID
@@ -618,6 +856,674 @@ static inline bool gpu_resource_flush(int cli_id, gpu_req_t *req, gpu_req_t *drv
     return true;
 }
 
+static inline bool gpu_update_cursor(int cli_id, gpu_req_t *req, gpu_req_t *drv_req, gpu_resp_t *fail_resp)
+{
+    if (req->update_cursor.scanout_id >= GPU_MAX_SCANOUTS) {
+        LOG_GPU_VIRT_ERR("UPDATE_CURSOR: Scanout id invalid, failing request\n");
+        fail_resp->status = GPU_RESP_ERR_INVALID_SCANOUT_ID;
+        return false;
+    }
+
+    uint32_t drv_res_id = GPU_DISABLE_SCANOUT_RESOURCE_ID;
+    /* Hide cursor case */
+    if (req->update_cursor.resource_id != GPU_DISABLE_SCANOUT_RESOURCE_ID) {
+        drv_res_id = clients[cli_id].res_map_virt_to_drv[req->update_cursor.resource_id];
+        if (drv_res_id == UNMAPPED_RESOURCE_ID || drv_resources[drv_res_id].is_blob) {
+            LOG_GPU_VIRT_ERR("UPDATE_CURSOR: Resource id invalid, failing request\n");
+            fail_resp->status = GPU_RESP_ERR_INVALID_RESOURCE_ID;
+            return false;
+        }
+
+        if (drv_resources[drv_res_id].width != GPU_CURSOR_SIZE || drv_resources[drv_res_id].height != GPU_CURSOR_SIZE
+            || req->update_cursor.hot_x >= GPU_CURSOR_SIZE || req->update_cursor.hot_y >= GPU_CURSOR_SIZE) {
+            LOG_GPU_VIRT_ERR("UPDATE_CURSOR: Resource is not a cursor image or hotspot is "
+                             "outside of it, failing request\n");
+            fail_resp->status = GPU_RESP_ERR_INVALID_PARAMETER;
+            return false;
+        }
+    }
+
+    reqsbk[drv_req->id].res_virt = req->update_cursor.resource_id;
+
+    drv_req->code = GPU_REQ_UPDATE_CURSOR;
+    drv_req->update_cursor.scanout_id = req->update_cursor.scanout_id;
+    drv_req->update_cursor.x = req->update_cursor.x;
+    drv_req->update_cursor.y = req->update_cursor.y;
+    drv_req->update_cursor.resource_id = drv_res_id;
+    drv_req->update_cursor.hot_x = req->update_cursor.hot_x;
+    drv_req->update_cursor.hot_y = req->update_cursor.hot_y;
+    return true;
+}
+
+static inline bool gpu_move_cursor(int cli_id, gpu_req_t *req, gpu_req_t *drv_req, gpu_resp_t *fail_resp)
+{
+    if (req->move_cursor.scanout_id >= GPU_MAX_SCANOUTS) {
+        LOG_GPU_VIRT_ERR("MOVE_CURSOR: Scanout id invalid, failing request\n");
+        fail_resp->status = GPU_RESP_ERR_INVALID_SCANOUT_ID;
+        return false;
+    }
+
+    reqsbk[drv_req->id].res_virt = GPU_DISABLE_SCANOUT_RESOURCE_ID;
+
+    drv_req->code = GPU_REQ_MOVE_CURSOR;
+    drv_req->move_cursor.scanout_id = req->move_cursor.scanout_id;
+    drv_req->move_cursor.x = req->move_cursor.x;
+    drv_req->move_cursor.y = req->move_cursor.y;
+    return true;
+}
+
+static inline uint64_t rect_area(gpu_rect_t rect)
+{
+    return (uint64_t)rect.width * rect.height;
+}
+
+/* Smallest rectangle containing both a and b */
+static inline gpu_rect_t rect_union(gpu_rect_t a, gpu_rect_t b)
+{
+    uint32_t x = MIN(a.x, b.x);
+    uint32_t y = MIN(a.y, b.y);
+    return (gpu_rect_t) {
+        .x = x,
+        .y = y,
+        .width = MAX(a.x + a.width, b.x + b.width) - x,
+        .height = MAX(a.y + a.height, b.y + b.height) - y,
+    };
+}
+
+/* True if a and b overlap or share part of an edge */
+static inline bool rect_touches(gpu_rect_t a, gpu_rect_t b)
+{
+    return a.x <= b.x + b.width && b.x <= a.x + a.width && a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+/* True if transferring a rectangle in place only reads within the backing of a resource, NULL for no limit */
+static inline bool rect_fits_backing(resource_t *res, gpu_rect_t rect)
+{
+    if (res == NULL || rect.height == 0) {
+        return true;
+    }
+    uint64_t stride = (uint64_t)res->width * GPU_BPP_2D;
+    return (uint64_t)rect.y * stride + (uint64_t)rect.x * GPU_BPP_2D + stride * (rect.height - 1)
+             + (uint64_t)rect.width * GPU_BPP_2D
+        <= res->mem_size;
+}
+
+/**
+ * Add a rectangle to a set of damage rectangles, merging it with those it touches.
+ *
+ * @param rects set of rectangles.
+ * @param num number of rectangles in the set.
+ * @param rect rectangle to add.
+ * @param backing resource whose backing merged rectangles must be transferable from, NULL for no limit.
+ *
+ * @return false if the set is full and rect cannot be merged with any of its rectangles, leaving
+ *         the set unchanged. true otherwise.
+ */
+static bool damage_add_rect(gpu_rect_t *rects, uint32_t *num, gpu_rect_t rect, resource_t *backing)
+{
+    while (true) {
+        uint32_t i = 0;
+        for (; i < *num; i++) {
+            if (rect_touches(rects[i], rect)
+                && rect_area(rect_union(rects[i], rect))
+                       <= rect_area(rects[i]) + rect_area(rect) + GPU_VIRT_DAMAGE_MERGE_SLACK
+                && rect_fits_backing(backing, rect_union(rects[i], rect))) {
+                break;
+            }
+        }
+
+        if (i == *num) {
+            if (*num < GPU_VIRT_DAMAGE_RECTS) {
+                break;
+            }
+            /* Out of rectangles, merge with whichever grows the least. This can only happen before
+             * any merge, as a merge frees a rectangle, so failing leaves the set as it was. */
+            uint64_t best_growth = UINT64_MAX;
+            for (uint32_t j = 0; j < *num; j++) {
+                gpu_rect_t merged = rect_union(rects[j], rect);
+                uint64_t growth = rect_area(merged) - rect_area(rects[j]);
+                if (growth < best_growth && rect_fits_backing(backing, merged)) {
+                    best_growth = growth;
+                    i = j;
+                }
+            }
+            if (i == *num) {
+                return false;
+            }
+        }
+
+        /* The merged rectangle may now touch others, so take it out and try again */
+        rect = rect_union(rects[i], rect);
+        rects[i] = rects[--(*num)];
+    }
+    rects[(*num)++] = rect;
+    return true;
+}
+
+/* Number of driver requests a frame is issued as */
+static inline uint32_t frame_num_reqs(uint32_t frame_id)
+{
+    if (frame_id == NO_FRAME) {
+        return 0;
+    }
+    uint32_t num = 0;
+    for (uint32_t i = 0; i < frames[frame_id].num_damaged; i++) {
+        num += frames[frame_id].damaged[i].num_transfers + frames[frame_id].damaged[i].num_flushes;
+    }
+    return num;
+}
+
+/* Number of requests that can currently be forwarded to the driver */
+static inline uint32_t drv_req_space(void)
+{
+    return MIN(ialloc_num_free(&req_ialloc), drv_h.capacity - gpu_queue_length_req(&drv_h));
+}
+
+static void frame_enqueue(uint32_t frame_id, damage_t *damage, gpu_req_code_t code, gpu_rect_t rect)
+{
+    uint32_t drv_req_id = 0;
+    int err = ialloc_alloc(&req_ialloc, &drv_req_id);
+    assert(!err);
+    reqsbk[drv_req_id].cli_id = frames[frame_id].cli_id;
+    reqsbk[drv_req_id].cli_req_id = 0;
+    reqsbk[drv_req_id].code = code;
+    reqsbk[drv_req_id].res_virt = damage->res_virt;
+    reqsbk[drv_req_id].frame = frame_id;
+
+    gpu_req_t drv_req = {
+        .code = code,
+        .id = drv_req_id,
+    };
+    if (code == GPU_REQ_TRANSFER_TO_2D) {
+        drv_req.transfer_to_2d.resource_id = damage->res_drv;
+        drv_req.transfer_to_2d.rect = rect;
+        drv_req.transfer_to_2d.stride = drv_resources[damage->res_drv].width * GPU_BPP_2D;
+        drv_req.transfer_to_2d.mem_offset = (uint64_t)rect.y * drv_req.transfer_to_2d.stride + rect.x * GPU_BPP_2D;
+        transfer_clean(frames[frame_id].cli_id, &drv_req);
+    } else {
+        drv_req.resource_flush.resource_id = damage->res_drv;
+        drv_req.resource_flush.rect = rect;
+    }
+    err = gpu_enqueue_req(&drv_h, drv_req);
+    assert(!err);
+}
+
+/**
+ * Issue the open frame of a client to the driver. Transfers to a resource are issued
+ * before its flushes.
+ *
+ * @param cli_id client whose open frame to issue.
+ *
+ * @return true if the frame was issued, false if there is no room in the driver queue.
+ */
+static bool frame_issue(int cli_id)
+{
+    uint32_t frame_id = clients[cli_id].open_frame;
+    uint32_t num_reqs = frame_num_reqs(frame_id);
+    if (num_reqs > drv_req_space()) {
+        return false;
+    }
+
+    frame_t *frame = &frames[frame_id];
+    for (uint32_t i = 0; i < frame->num_damaged; i++) {
+        damage_t *damage = &frame->damaged[i];
+        for (uint32_t j = 0; j < damage->num_transfers; j++) {
+            frame_enqueue(frame_id, damage, GPU_REQ_TRANSFER_TO_2D, damage->transfers[j]);
+        }
+        for (uint32_t j = 0; j < damage->num_flushes; j++) {
+            frame_enqueue(frame_id, damage, GPU_REQ_RESOURCE_FLUSH, damage->flushes[j]);
+        }
+    }
+    LOG_GPU_VIRT("Issued frame of %d client requests as %d requests for client %d\n", frame->num_waiters, num_reqs,
+                 cli_id);
+
+    frame->outstanding = num_reqs;
+    clients[cli_id].open_frame = NO_FRAME;
+    clients[cli_id].frames_in_flight++;
+    return true;
+}
+
+/* True if a transfer reads the backing with the same layout as the resource, which is what lets transfers merge */
+static inline bool transfer_in_place(gpu_req_t *drv_req)
+{
+    gpu_rect_t rect = drv_req->transfer_to_2d.rect;
+    return drv_req->transfer_to_2d.mem_offset
+        == (uint64_t)rect.y * drv_req->transfer_to_2d.stride + rect.x * GPU_BPP_2D;
+}
+
+/**
+ * Try to coalesce a validated transfer or flush into the client's open frame, opening
+ * one if needed. The caller must have room in the driver queue to issue the open frame.
+ *
+ * @param cli_id client the request is from.
+ * @param req client request.
+ * @param drv_req driver request the client request was translated to.
+ *
+ * @return true if the request was coalesced, false if it must be forwarded on its own.
+ */
+static bool frame_coalesce(int cli_id, gpu_req_t *req, gpu_req_t *drv_req)
+{
+    bool transfer = drv_req->code == GPU_REQ_TRANSFER_TO_2D;
+    if (!transfer && drv_req->code != GPU_REQ_RESOURCE_FLUSH) {
+        return false;
+    }
+    if (transfer && !transfer_in_place(drv_req)) {
+        return false;
+    }
+
+    uint32_t res_virt = transfer ? req->transfer_to_2d.resource_id : req->resource_flush.resource_id;
+    uint32_t res_drv = transfer ? drv_req->transfer_to_2d.resource_id : drv_req->resource_flush.resource_id;
+    gpu_rect_t rect = transfer ? drv_req->transfer_to_2d.rect : drv_req->resource_flush.rect;
+
+    frame_t *frame = NULL;
+    uint32_t d = 0;
+    if (clients[cli_id].open_frame != NO_FRAME) {
+        frame = &frames[clients[cli_id].open_frame];
+        while (d < frame->num_damaged && frame->damaged[d].res_drv != res_drv) {
+            d++;
+        }
+        if (frame->num_waiters == GPU_VIRT_FRAME_WAITERS || d == GPU_VIRT_DAMAGE_RESOURCES) {
+            bool issued = frame_issue(cli_id);
+            assert(issued);
+            frame = NULL;
+        }
+    }
+
+    if (frame == NULL) {
+        uint32_t frame_id = 0;
+        if (ialloc_alloc(&frame_ialloc, &frame_id)) {
+            return false;
+        }
+        frame = &frames[frame_id];
+        frame->cli_id = cli_id;
+        frame->num_damaged = 0;
+        frame->num_waiters = 0;
+        frame->outstanding = 0;
+        clients[cli_id].open_frame = frame_id;
+        d = 0;
+    }
+
+    damage_t *damage = &frame->damaged[d];
+    if (d == frame->num_damaged) {
+        frame->num_damaged++;
+        damage->res_virt = res_virt;
+        damage->res_drv = res_drv;
+        damage->num_transfers = 0;
+        damage->num_flushes = 0;
+        damage->status = GPU_RESP_OK;
+    }
+
+    /* A merged transfer may not read past the end of the backing, even though each transfer in it is
+     * within it. If it cannot be merged, the caller issues the open frame and forwards it on its own. */
+    bool added = transfer ? damage_add_rect(damage->transfers, &damage->num_transfers, rect, &drv_resources[res_drv])
+                          : damage_add_rect(damage->flushes, &damage->num_flushes, rect, NULL);
+    if (!added) {
+        return false;
+    }
+
+    frame->waiters[frame->num_waiters].cli_req_id = req->id;
+    frame->waiters[frame->num_waiters].damage = d;
+    frame->num_waiters++;
+    return true;
+}
+
+/**
+ * Account for the completion of a driver request issued for a frame, and respond to the
+ * client requests coalesced into the frame once all of them have completed.
+ *
+ * @param frame_id frame the driver request was issued for.
+ * @param res_virt client resource id the request was for.
+ * @param status status of the driver response.
+ *
+ * @return true if the frame completed and the client has responses.
+ */
+static bool frame_complete(uint32_t frame_id, uint32_t res_virt, gpu_resp_status_t status)
+{
+    frame_t *frame = &frames[frame_id];
+    for (uint32_t i = 0; i < frame->num_damaged; i++) {
+        if (frame->damaged[i].res_virt == res_virt && frame->damaged[i].status == GPU_RESP_OK) {
+            frame->damaged[i].status = status;
+        }
+    }
+
+    frame->outstanding--;
+    if (frame->outstanding) {
+        return false;
+    }
+
+    int err = 0;
+    for (uint32_t i = 0; i < frame->num_waiters; i++) {
+        waiter_t *waiter = &frame->waiters[i];
+        err = gpu_enqueue_resp(&clients[frame->cli_id].queue_h, (gpu_resp_t) {
+                                                                    .id = waiter->cli_req_id,
+                                                                    .status = frame->damaged[waiter->damage].status,
+                                                                });
+        assert(!err);
+    }
+    clients[frame->cli_id].frames_in_flight--;
+    err = ialloc_free(&frame_ialloc, frame_id);
+    assert(!err);
+    return true;
+}
+
+#ifdef GPU_VIRT_COMPOSITOR
+/* Rectangle of the scanout covered by a client's window, zero sized if the window shows nothing */
+static gpu_rect_t window_rect(int cli_id)
+{
+    window_t *window = &windows[cli_id];
+    comp_scanout_t *scanout = &comp_scanouts[window->config.scanout_id];
+    if (!scanout->active || window->res_drv == GPU_DISABLE_SCANOUT_RESOURCE_ID) {
+        return (gpu_rect_t) { 0 };
+    }
+
+    gpu_rect_t rect = window->config.rect;
+    rect.width = MIN(rect.width, window->src.width);
+    rect.height = MIN(rect.height, window->src.height);
+    return gpu_rect_intersect(rect, (gpu_rect_t) {
+                                        .width = scanout->width,
+                                        .height = scanout->height,
+                                    });
+}
+
+static void damage_window(int cli_id)
+{
+    gpu_rect_t rect = window_rect(cli_id);
+    if (rect.width) {
+        comp_scanout_t *scanout = &comp_scanouts[windows[cli_id].config.scanout_id];
+        damage_add_rect(scanout->damage, &scanout->num_damage, rect, NULL);
+    }
+}
+
+/* Layers of the windows shown on a scanout, from bottom to top */
+static uint32_t scanout_layers(uint32_t scanout_id, compositor_layer_t *layers)
+{
+    uint32_t num_layers = 0;
+    for (int i = 0; i < GPU_NUM_CLIENTS; i++) {
+        uint32_t cli_id = window_order[i];
+        window_t *window = &windows[cli_id];
+        gpu_rect_t rect = window_rect(cli_id);
+        if (window->config.scanout_id != scanout_id || rect.width == 0) {
+            continue;
+        }
+
+        resource_t *res = &drv_resources[window->res_drv];
+        uint64_t stride = (uint64_t)res->width * GPU_BPP_2D;
+        uint64_t src_offset = window->src.y * stride + (uint64_t)window->src.x * GPU_BPP_2D;
+        if (!res->has_backing
+            || src_offset + stride * (rect.height - 1) + (uint64_t)rect.width * GPU_BPP_2D > res->mem_size) {
+            /* Nothing to show until the client attaches a large enough backing */
+            continue;
+        }
+
+        layers[num_layers++] = (compositor_layer_t) {
+            .rect = rect,
+            .pixels = gpu_virt_cli_data_region(gpu_client_data, cli_id) + res->mem_offset + src_offset,
+            .stride = stride,
+            .opaque = res->format == GPU_FORMAT_B8G8R8X8_UNORM,
+        };
+    }
+    return num_layers;
+}
+
+/* Composite all damage into the framebuffers, leaving it to be transferred and flushed */
+static void composite(void)
+{
+    compositor_layer_t layers[GPU_NUM_CLIENTS];
+    for (int i = 0; i < GPU_MAX_SCANOUTS; i++) {
+        comp_scanout_t *scanout = &comp_scanouts[i];
+        if (scanout->num_damage == 0) {
+            continue;
+        }
+
+        uint32_t num_layers = scanout_layers(i, layers);
+        uintptr_t fb = gpu_virt_fb + scanout->fb_offset;
+        uint32_t stride = scanout->width * GPU_BPP_2D;
+        for (uint32_t j = 0; j < scanout->num_damage; j++) {
+            gpu_rect_t rect = scanout->damage[j];
+            compositor_compose(fb, stride, layers, num_layers, rect);
+            cache_clean_rows(fb + (uintptr_t)rect.y * stride + (uintptr_t)rect.x * GPU_BPP_2D,
+                             rect.width * GPU_BPP_2D, stride, rect.height);
+            damage_add_rect(scanout->dirty, &scanout->num_dirty, rect, NULL);
+        }
+        scanout->num_damage = 0;
+    }
+}
+
+static void compositor_enqueue(uint32_t scanout_id, gpu_req_t drv_req)
+{
+    uint32_t drv_req_id = 0;
+    int err = ialloc_alloc(&req_ialloc, &drv_req_id);
+    assert(!err);
+    reqsbk[drv_req_id].cli_id = VIRTUALISER_ID;
+    reqsbk[drv_req_id].cli_req_id = drv_req_id;
+    reqsbk[drv_req_id].code = drv_req.code;
+    reqsbk[drv_req_id].res_scanout = scanout_id;
+    reqsbk[drv_req_id].frame = NO_FRAME;
+
+    drv_req.id = drv_req_id;
+    err = gpu_enqueue_req(&drv_h, drv_req);
+    assert(!err);
+}
+
+/**
+ * Transfer and flush what has been composited. While the previous frame of a scanout is
+ * with the driver, composited damage keeps accumulating for the next one.
+ *
+ * @return true if requests were issued to the driver.
+ */
+static bool compositor_issue(void)
+{
+    bool issued = false;
+    for (int i = 0; i < GPU_MAX_SCANOUTS; i++) {
+        comp_scanout_t *scanout = &comp_scanouts[i];
+        if (scanout->num_dirty == 0 || scanout->in_flight || 2 * scanout->num_dirty > drv_req_space()) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < scanout->num_dirty; j++) {
+            gpu_rect_t rect = scanout->dirty[j];
+            compositor_enqueue(i, (gpu_req_t) {
+                .code = GPU_REQ_TRANSFER_TO_2D,
+                .transfer_to_2d = {
+                    .resource_id = scanout->res_drv,
+                    .rect = rect,
+                    .mem_offset = ((uint64_t)rect.y * scanout->width + rect.x) * GPU_BPP_2D,
+                    .stride = scanout->width * GPU_BPP_2D,
+                },
+            });
+            compositor_enqueue(i, (gpu_req_t) {
+                .code = GPU_REQ_RESOURCE_FLUSH,
+                .resource_flush = {
+                    .resource_id = scanout->res_drv,
+                    .rect = rect,
+                },
+            });
+        }
+        scanout->in_flight = 2 * scanout->num_dirty;
+        scanout->num_dirty = 0;
+        issued = true;
+    }
+    return issued;
+}
+
+/* Create a framebuffer resource for each enabled scanout and clear it to the background */
+static void compositor_init(void)
+{
+    uint64_t fb_offset = 0;
+    for (int i = 0; i < get_display_info.num_scanouts && i < GPU_MAX_SCANOUTS; i++) {
+        gpu_scanout_t *info = &get_display_info.scanouts[i];
+        if (!info->enabled) {
+            continue;
+        }
+
+        uint64_t fb_size = (uint64_t)info->rect.width * info->rect.height * GPU_BPP_2D;
+        if (fb_offset + fb_size > GPU_VIRT_FB_REGION_SIZE) {
+            LOG_GPU_VIRT_ERR("Framebuffer region too small for scanout %d, not compositing to it\n", i);
+            continue;
+        }
+
+        uint32_t res_drv = 0;
+        int err = ialloc_alloc(&res_ialloc, &res_drv);
+        assert(!err);
+        drv_resources[res_drv] = (resource_t) {
+            .has_backing = true,
+            .width = info->rect.width,
+            .height = info->rect.height,
+            .is_blob = false,
+            .mem_offset = fb_offset,
+            .mem_size = fb_size,
+            .format = GPU_FORMAT_B8G8R8X8_UNORM,
+        };
+
+        comp_scanout_t *scanout = &comp_scanouts[i];
+        scanout->active = true;
+        scanout->res_drv = res_drv;
+        scanout->fb_offset = fb_offset;
+        scanout->width = info->rect.width;
+        scanout->height = info->rect.height;
+        fb_offset += fb_size;
+
+        compositor_enqueue(i, (gpu_req_t) {
+            .code = GPU_REQ_RESOURCE_CREATE_2D,
+            .resource_create_2d = {
+                .resource_id = res_drv,
+                .width = scanout->width,
+                .height = scanout->height,
+                .format = GPU_FORMAT_B8G8R8X8_UNORM,
+            },
+        });
+        compositor_enqueue(i, (gpu_req_t) {
+            .code = GPU_REQ_RESOURCE_ATTACH_BACKING,
+            .resource_attach_backing = {
+                .resource_id = res_drv,
+                .mem_offset = scanout->fb_offset,
+                .mem_size = fb_size,
+            },
+        });
+        compositor_enqueue(i, (gpu_req_t) {
+            .code = GPU_REQ_SET_SCANOUT,
+            .set_scanout = {
+                .resource_id = res_drv,
+                .scanout_id = i,
+                .rect = {
+                    .width = scanout->width,
+                    .height = scanout->height,
+                },
+            },
+        });
+
+        damage_add_rect(scanout->damage, &scanout->num_damage, (gpu_rect_t) {
+                                                                     .width = scanout->width,
+                                                                     .height = scanout->height,
+                                                                 }, NULL);
+        LOG_GPU_VIRT("Compositing scanout %d of %dx%d\n", i, scanout->width, scanout->height);
+    }
+
+    composite();
+    compositor_issue();
+    microkit_notify(DRIVER_CH);
+}
+
+/* Display info as seen by a client, with its window as the only scanout */
+static void compositor_display_info(int cli_id, gpu_resp_get_display_info_t *info)
+{
+    window_t *window = &windows[cli_id];
+    comp_scanout_t *scanout = &comp_scanouts[window->config.scanout_id];
+    sddf_memset(info, 0, sizeof(gpu_resp_get_display_info_t));
+    info->num_scanouts = MAX(get_display_info.num_scanouts, window->config.scanout_id + 1);
+    if (scanout->active) {
+        gpu_rect_t rect = gpu_rect_intersect(window->config.rect, (gpu_rect_t) {
+                                                                      .width = scanout->width,
+                                                                      .height = scanout->height,
+                                                                  });
+        info->scanouts[window->config.scanout_id].rect.width = rect.width;
+        info->scanouts[window->config.scanout_id].rect.height = rect.height;
+        info->scanouts[window->config.scanout_id].enabled = rect.width != 0;
+    }
+}
+
+/**
+ * Apply a validated client request to the client's window. Nothing from clients is
+ * forwarded to the driver in compositor mode.
+ *
+ * @param cli_id client the request is from.
+ * @param req client request.
+ * @param drv_req driver request the client request was translated to.
+ *
+ * @return status to respond to the client with.
+ */
+static gpu_resp_status_t compositor_handle(int cli_id, gpu_req_t *req, gpu_req_t *drv_req)
+{
+    int err = 0;
+    window_t *window = &windows[cli_id];
+    switch (drv_req->code) {
+    case GPU_REQ_RESOURCE_CREATE_2D:
+        if (drv_req->resource_create_2d.format != GPU_FORMAT_B8G8R8A8_UNORM
+            && drv_req->resource_create_2d.format != GPU_FORMAT_B8G8R8X8_UNORM) {
+            LOG_GPU_VIRT_ERR("RESOURCE_CREATE_2D: Format cannot be composited, failing request\n");
+            err = ialloc_free(&res_ialloc, drv_req->resource_create_2d.resource_id);
+            assert(!err);
+            clients[cli_id].res_map_virt_to_drv[req->resource_create_2d.resource_id] = UNMAPPED_RESOURCE_ID;
+            return GPU_RESP_ERR_INVALID_PARAMETER;
+        }
+        break;
+    case GPU_REQ_SET_SCANOUT:
+        if (drv_req->set_scanout.scanout_id != window->config.scanout_id) {
+            LOG_GPU_VIRT_ERR("SET_SCANOUT: Scanout is not the one of the client's window, "
+                             "failing request\n");
+            return GPU_RESP_ERR_INVALID_SCANOUT_ID;
+        }
+        damage_window(cli_id);
+        window->res_drv = drv_req->set_scanout.resource_id;
+        window->src = drv_req->set_scanout.rect;
+        damage_window(cli_id);
+        break;
+    case GPU_REQ_RESOURCE_DETACH_BACKING:
+        if (window->res_drv == drv_req->resource_detach_backing.resource_id) {
+            damage_window(cli_id);
+        }
+        break;
+    case GPU_REQ_RESOURCE_UNREF:
+        if (window->res_drv == drv_req->resource_unref.resource_id) {
+            damage_window(cli_id);
+            window->res_drv = GPU_DISABLE_SCANOUT_RESOURCE_ID;
+        }
+        break;
+    case GPU_REQ_RESOURCE_FLUSH: {
+        gpu_rect_t rect = window_rect(cli_id);
+        if (window->res_drv == drv_req->resource_flush.resource_id && rect.width) {
+            gpu_rect_t shown = gpu_rect_intersect(drv_req->resource_flush.rect, (gpu_rect_t) {
+                                                                                    .x = window->src.x,
+                                                                                    .y = window->src.y,
+                                                                                    .width = rect.width,
+                                                                                    .height = rect.height,
+                                                                                });
+            if (shown.width) {
+                comp_scanout_t *scanout = &comp_scanouts[window->config.scanout_id];
+                damage_add_rect(scanout->damage, &scanout->num_damage, (gpu_rect_t) {
+                                                                             .x = rect.x + shown.x - window->src.x,
+                                                                             .y = rect.y + shown.y - window->src.y,
+                                                                             .width = shown.width,
+                                                                             .height = shown.height,
+                                                                         }, NULL);
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    /*
+     * Composite now, as the client may reuse its memory once it has the response. This also
+     * takes down a window whose resource was detached or destroyed straight away, as windows
+     * without a backing are left out of the layers.
+     */
+    composite();
+    return GPU_RESP_OK;
+}
+#endif
+
 static bool handle_client(int cli_id)
 {
     int err = 0;
@@ -625,7 +1531,8 @@ static bool handle_client(int cli_id)
     bool client_notify = false;
     gpu_queue_handle_t *h = &clients[cli_id].queue_h;
     gpu_req_t req = { 0 };
-    while (!gpu_queue_empty_req(h) && !ialloc_full(&req_ialloc) && !gpu_queue_full_req(&drv_h)) {
+    /* Keep room to issue the open frame before any request that cannot join it */
+    while (!gpu_queue_empty_req(h) && drv_req_space() > frame_num_reqs(clients[cli_id].open_frame)) {
         err = gpu_dequeue_req(h, &req);
         assert(!err);
 
@@ -647,8 +1554,15 @@ static bool handle_client(int cli_id)
                 assert(!err);
                 continue;
             }
+#ifdef GPU_VIRT_COMPOSITOR
+            compositor_display_info(
+                cli_id,
+                (gpu_resp_get_display_info_t *)(gpu_virt_cli_data_region(gpu_client_data, cli_id)
+                                                + req.get_display_info.mem_offset));
+#else
             sddf_memcpy((void *)(gpu_virt_cli_data_region(gpu_client_data, cli_id) + req.get_display_info.mem_offset),
                         &get_display_info, sizeof(gpu_resp_get_display_info_t));
+#endif
             err = gpu_enqueue_resp(h, (gpu_resp_t) {
                                           .id = req.id,
                                           .status = GPU_RESP_OK,
@@ -671,10 +1585,11 @@ static bool handle_client(int cli_id)
         reqsbk[drv_req_id].cli_id = cli_id;
         reqsbk[drv_req_id].cli_req_id = req.id;
         reqsbk[drv_req_id].code = req.code;
+        reqsbk[drv_req_id].frame = NO_FRAME;
 
         bool success = false;
         switch (req.code) {
-#ifdef GPU_BLOB_SUPPORT
+#if defined(GPU_BLOB_SUPPORT) && !defined(GPU_VIRT_COMPOSITOR)
         case GPU_REQ_RESOURCE_CREATE_BLOB: {
             success = gpu_resource_create_blob(cli_id, &req, &drv_req, &fail_resp);
             break;
@@ -683,6 +1598,10 @@ static bool handle_client(int cli_id)
             success = gpu_set_scanout_blob(cli_id, &req, &drv_req, &fail_resp);
             break;
         }
+        case GPU_REQ_PAGE_FLIP: {
+            success = gpu_page_flip(cli_id, &req, &drv_req, &fail_resp);
+            break;
+        }
 #endif
         case GPU_REQ_RESOURCE_CREATE_2D: {
             success = gpu_resource_create_2d(cli_id, &req, &drv_req, &fail_resp);
@@ -712,6 +1631,16 @@ static bool handle_client(int cli_id)
             success = gpu_resource_flush(cli_id, &req, &drv_req, &fail_resp);
             break;
         }
+#ifndef GPU_VIRT_COMPOSITOR
+        case GPU_REQ_UPDATE_CURSOR: {
+            success = gpu_update_cursor(cli_id, &req, &drv_req, &fail_resp);
+            break;
+        }
+        case GPU_REQ_MOVE_CURSOR: {
+            success = gpu_move_cursor(cli_id, &req, &drv_req, &fail_resp);
+            break;
+        }
+#endif
         default: {
             LOG_GPU_VIRT_ERR("Unrecognised request code, failing request\n");
             fail_resp.status = GPU_RESP_ERR_UNSPEC;
@@ -730,11 +1659,44 @@ static bool handle_client(int cli_id)
             continue;
         }
 
+#ifdef GPU_VIRT_COMPOSITOR
+        err = ialloc_free(&req_ialloc, drv_req_id);
+        assert(!err);
+        err = gpu_enqueue_resp(h, (gpu_resp_t) {
+                                      .id = req.id,
+                                      .status = compositor_handle(cli_id, &req, &drv_req),
+                                  });
+        assert(!err);
+        client_notify = true;
+        continue;
+#endif
+
+        if (frame_coalesce(cli_id, &req, &drv_req)) {
+            err = ialloc_free(&req_ialloc, drv_req_id);
+            assert(!err);
+            continue;
+        }
+
+        if (clients[cli_id].open_frame != NO_FRAME) {
+            bool issued = frame_issue(cli_id);
+            assert(issued);
+        }
+
+        if (drv_req.code == GPU_REQ_TRANSFER_TO_2D) {
+            transfer_clean(cli_id, &drv_req);
+        }
         err = gpu_enqueue_req(&drv_h, drv_req);
         assert(!err);
         driver_notify = true;
     }
 
+    /* Let damage keep accumulating while the previous frame is with the driver */
+    if (clients[cli_id].open_frame != NO_FRAME && clients[cli_id].frames_in_flight == 0) {
+        if (frame_issue(cli_id)) {
+            driver_notify = true;
+        }
+    }
+
     if (client_notify) {
         microkit_notify(clients[cli_id].ch);
     }
@@ -750,6 +1712,11 @@ static void handle_clients()
             notify = true;
         }
     }
+#ifdef GPU_VIRT_COMPOSITOR
+    if (compositor_issue()) {
+        notify = true;
+    }
+#endif
     if (notify) {
         microkit_notify(DRIVER_CH);
     }
@@ -768,6 +1735,7 @@ static inline bool request_display_info()
     reqsbk[drv_req_id].cli_id = VIRTUALISER_ID;
     reqsbk[drv_req_id].cli_req_id = drv_req_id;
     reqsbk[drv_req_id].code = GPU_REQ_GET_DISPLAY_INFO;
+    reqsbk[drv_req_id].frame = NO_FRAME;
 
     gpu_req_t drv_req = { 0 };
     drv_req.id = drv_req_id;
@@ -822,6 +1790,18 @@ static void handle_driver()
 
         reqbk_t *reqbk = &reqsbk[resp.id];
 
+        if (reqbk->frame != NO_FRAME) {
+            if (resp.status != GPU_RESP_OK) {
+                LOG_GPU_VIRT("Merged request of frame %d failed\n", reqbk->frame);
+            }
+            if (frame_complete(reqbk->frame, reqbk->res_virt, resp.status)) {
+                client_notify[reqbk->cli_id] = true;
+            }
+            err = ialloc_free(&req_ialloc, resp.id);
+            assert(!err);
+            continue;
+        }
+
         LOG_GPU_VIRT("Received response %d for client %d\n", reqbk->cli_req_id, reqbk->cli_id);
 
         if (reqbk->code == GPU_REQ_GET_DISPLAY_INFO) {
@@ -847,6 +1827,21 @@ static void handle_driver()
             continue;
         }
 
+#ifdef GPU_VIRT_COMPOSITOR
+        if (reqbk->cli_id == VIRTUALISER_ID) {
+            if (resp.status != GPU_RESP_OK) {
+                LOG_GPU_VIRT_ERR("Compositor request with code %d for scanout %d failed\n", reqbk->code,
+                                 reqbk->res_scanout);
+            }
+            if (reqbk->code == GPU_REQ_TRANSFER_TO_2D || reqbk->code == GPU_REQ_RESOURCE_FLUSH) {
+                comp_scanouts[reqbk->res_scanout].in_flight--;
+            }
+            err = ialloc_free(&req_ialloc, resp.id);
+            assert(!err);
+            continue;
+        }
+#endif
+
         gpu_resp_t cli_resp = {
             .id = reqbk->cli_req_id,
             .status = resp.status,
@@ -857,13 +1852,15 @@ static void handle_driver()
         case GPU_REQ_RESOURCE_CREATE_BLOB: {
             if (resp.status != GPU_RESP_OK) {
                 LOG_GPU_VIRT("Resource create blob response failed\n");
-                err = ialloc_free(&res_ialloc, clients[reqbk->cli_id].res_map_virt_to_drv[reqbk->res_virt]);
+                uint32_t res_drv = clients[reqbk->cli_id].res_map_virt_to_drv[reqbk->res_virt];
+                err = ialloc_free(&res_ialloc, res_drv);
                 assert(!err);
                 clients[reqbk->cli_id].res_map_virt_to_drv[reqbk->res_virt] = UNMAPPED_RESOURCE_ID;
 
-                /* Clear any previously set scanout state */
+                /* Clear any scanout state set by requests queued behind the create, so that a later
+                 * resource given the same driver id does not inherit it */
                 for (int i = 0; i < GPU_MAX_SCANOUTS; i++) {
-                    blob_scanouts[i][reqbk->res_virt].active = false;
+                    blob_scanouts[i][res_drv] = (blob_scanout_t) { 0 };
                 }
             }
             break;
@@ -899,6 +1896,18 @@ static void handle_driver()
                 LOG_GPU_VIRT("Set scanout blob response failed\n");
             }
             break;
+        case GPU_REQ_PAGE_FLIP: {
+            flips_in_flight[reqbk->cli_id][reqbk->res_scanout]--;
+            if (resp.status != GPU_RESP_OK) {
+                LOG_GPU_VIRT("Page flip response failed\n");
+                break;
+            }
+            /* The driver records when the flip took effect before responding */
+            uint64_t timestamp = 0;
+            gpu_events_check_flip(gpu_driver_events, reqbk->res_scanout, &timestamp);
+            gpu_events_set_flip(clients[reqbk->cli_id].events, reqbk->res_scanout, timestamp);
+            break;
+        }
 #endif
         case GPU_REQ_SET_SCANOUT:
             if (resp.status != GPU_RESP_OK) {
@@ -915,6 +1924,16 @@ static void handle_driver()
                 LOG_GPU_VIRT("Resource flush response failed\n");
             }
             break;
+        case GPU_REQ_UPDATE_CURSOR:
+            if (resp.status != GPU_RESP_OK) {
+                LOG_GPU_VIRT("Update cursor response failed\n");
+            }
+            break;
+        case GPU_REQ_MOVE_CURSOR:
+            if (resp.status != GPU_RESP_OK) {
+                LOG_GPU_VIRT("Move cursor response failed\n");
+            }
+            break;
         default: {
             /* This should never happen as we will have sanitised before bookkeeping an unrecognised req code */
             LOG_GPU_VIRT_ERR("Unrecognised bookkept request code, failing response\n");
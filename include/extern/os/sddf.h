@@ -12,6 +12,9 @@ typedef unsigned int sddf_channel;
 
 #define SDDF_NAME_LENGTH 64
 
+/* Set of channels to be notified, see sddf_notify_set_flush */
+typedef uint64_t sddf_notify_set_t;
+
 extern char *sddf_get_pd_name();
 extern void sddf_irq_ack(sddf_channel id);
 extern void sddf_notify(sddf_channel id);
@@ -21,3 +24,5 @@ extern seL4_MessageInfo_t sddf_ppcall(sddf_channel id, seL4_MessageInfo_t msginf
 extern uint64_t sddf_get_mr(sddf_channel n);
 extern void sddf_set_mr(sddf_channel n, uint64_t val);
 extern sddf_channel sddf_deferred_notify_curr();
+extern void sddf_notify_set_add(sddf_notify_set_t *set, sddf_channel id);
+extern void sddf_notify_set_flush(sddf_notify_set_t *set);
@@ -47,6 +47,57 @@ static inline unsigned int sddf_deferred_notify_curr()
     return microkit_signal_cap - BASE_OUTPUT_NOTIFICATION_CAP;
 }
 
+/* Set of channels to be notified, see sddf_notify_set_flush */
+typedef uint64_t sddf_notify_set_t;
+
+/**
+ * Mark a channel to be notified when the set is flushed. Marking the same
+ * channel multiple times results in a single notification.
+ *
+ * @param set set of channels to be notified.
+ * @param ch channel to notify.
+ */
+static inline void sddf_notify_set_add(sddf_notify_set_t *set, sddf_channel ch)
+{
+    *set |= 1ULL << ch;
+}
+
+/**
+ * Notify every channel in the set once and empty the set. Should be called
+ * once at the end of handling an event, so that a component signalling
+ * several peers pays for each of them only once.
+ *
+ * If nothing has been deferred yet, one of the channels is notified with a
+ * deferred notification. The Microkit event loop combines this with waiting
+ * for the next event, so it costs no extra kernel entry. A channel that is
+ * already the pending deferred notification is not notified again.
+ *
+ * @param set set of channels to be notified.
+ */
+static inline void sddf_notify_set_flush(sddf_notify_set_t *set)
+{
+    sddf_notify_set_t pending = *set;
+    *set = 0;
+    if (pending == 0) {
+        return;
+    }
+
+    unsigned int curr = sddf_deferred_notify_curr();
+    if (curr == -1) {
+        sddf_channel ch = __builtin_ctzll(pending);
+        pending &= pending - 1;
+        sddf_deferred_notify(ch);
+    } else if (curr < 64) {
+        pending &= ~(1ULL << curr);
+    }
+
+    while (pending) {
+        sddf_channel ch = __builtin_ctzll(pending);
+        pending &= pending - 1;
+        sddf_notify(ch);
+    }
+}
+
 static inline microkit_msginfo sddf_ppcall(sddf_channel ch, microkit_msginfo msginfo)
 {
     return microkit_ppcall(ch, msginfo);
@@ -0,0 +1,302 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <os/sddf.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sddf/blk/config.h>
+#include <sddf/blk/queue.h>
+#include <sddf/blk/storage_info.h>
+#include <sddf/util/util.h>
+#include <sddf/util/ialloc.h>
+#include <sddf/util/fsmalloc.h>
+
+/*
+ * Helpers for block clients to size their I/O from what the storage info
+ * advertises, rather than issuing one small request at a time.
+ *
+ * The virtualiser publishes each client's share of the driver's queue depth
+ * and the driver's optimal transfer size. A client gets the best throughput
+ * by keeping up to queue depth requests in flight, each of a multiple of the
+ * optimal transfer size.
+ *
+ * On top of these, blk_client_t is an asynchronous client library. It tracks
+ * requests in flight and matches responses to them, so a client can submit
+ * many requests, notify the virtualiser once for the whole batch, and handle
+ * completions through callbacks or by polling. Buffers are allocated directly
+ * out of the client's data region, so data does not need to be copied into
+ * the region before being written or out of it after being read.
+ */
+
+/**
+ * Number of requests to keep in flight at once.
+ *
+ * @param storage_info storage info of the device, must be ready.
+ * @param num_buffers capacity of the client's request and response queues.
+ * @return advertised queue depth, bounded by the queue capacity.
+ */
+static inline uint16_t blk_client_queue_depth(blk_storage_info_t *storage_info, uint16_t num_buffers)
+{
+    if (storage_info->queue_depth == 0) {
+        return num_buffers;
+    }
+    return MIN(storage_info->queue_depth, num_buffers);
+}
+
+/**
+ * Size of each request, such that queue_depth requests can be in flight out
+ * of the client's data region at once. The size is a multiple of the optimal
+ * block size unless the data region is too small to allow it.
+ *
+ * @param storage_info storage info of the device, must be ready.
+ * @param queue_depth number of requests in flight, from blk_client_queue_depth.
+ * @param data_size size of the client's data region in bytes.
+ * @return number of BLK_TRANSFER_SIZE blocks per request, 0 if the data region
+ *         cannot hold a single block.
+ */
+static inline uint16_t blk_client_request_blocks(blk_storage_info_t *storage_info, uint16_t queue_depth,
+                                                 uint64_t data_size)
+{
+    uint64_t region_blocks = data_size / BLK_TRANSFER_SIZE;
+    uint16_t block_size = MAX(storage_info->block_size, 1);
+
+    uint64_t blocks = MIN(region_blocks / MAX(queue_depth, 1), UINT16_MAX);
+    if (blocks >= block_size) {
+        return blocks - (blocks % block_size);
+    }
+    /* Fewer, optimally sized requests beat more, smaller ones */
+    return MIN(region_blocks, block_size);
+}
+
+/**
+ * Called when a request completes.
+ *
+ * @param status response status of the request.
+ * @param success_count number of blocks successfully read or written.
+ * @param cookie value given when the request was submitted.
+ */
+typedef void (*blk_client_callback_t)(blk_resp_status_t status, uint16_t success_count, void *cookie);
+
+/* Book-keeping of a request in flight, indexed by request ID */
+typedef struct blk_client_req {
+    blk_client_callback_t callback;
+    void *cookie;
+} blk_client_req_t;
+
+typedef struct blk_client {
+    blk_queue_handle_t queue;
+    sddf_channel virt_id;
+    uintptr_t data_vaddr;
+    /* IDs of requests in flight, at most queue depth are handed out */
+    ialloc_t ids;
+    blk_client_req_t *reqs;
+    /* BLK_TRANSFER_SIZE cells of the data region */
+    fsmalloc_t bufs;
+    bitarray_t bufs_avail;
+    /* requests have been enqueued since the virtualiser was last notified */
+    bool notify;
+} blk_client_t;
+
+/**
+ * Initialise the client library. This should be done once the storage info
+ * is ready, so that the advertised queue depth can be respected.
+ *
+ * @param client pointer to the client struct.
+ * @param config block client config of this component.
+ * @param reqs array to track requests in flight.
+ * @param idxlist array to allocate request IDs from, same length as reqs.
+ * @param num_reqs number of elements in reqs and idxlist. Requests in flight
+ *                 are further limited by the advertised queue depth.
+ * @param words array of words to track free cells of the data region.
+ * @param num_words number of elements in words. The data region is only used
+ *                  up to num_words * 64 cells.
+ *
+ * @return 0 on success, -1 if no requests could be in flight, i.e. num_reqs or
+ *         the number of buffers of the virtualiser queues is 0.
+ */
+static inline int blk_client_init(blk_client_t *client, blk_client_config_t *config, blk_client_req_t *reqs,
+                                   uint32_t *idxlist, uint32_t num_reqs, word_t *words, word_index_t num_words)
+{
+    blk_queue_init(&client->queue, config->virt.req_queue.vaddr, config->virt.resp_queue.vaddr,
+                   config->virt.num_buffers);
+    client->virt_id = config->virt.id;
+    client->data_vaddr = (uintptr_t)config->data.vaddr;
+    client->notify = false;
+
+    uint32_t depth = config->virt.num_buffers;
+    if (blk_storage_is_ready(config->virt.storage_info.vaddr)) {
+        depth = blk_client_queue_depth(config->virt.storage_info.vaddr, config->virt.num_buffers);
+    }
+    depth = MIN(depth, num_reqs);
+    if (depth == 0) {
+        return -1;
+    }
+    ialloc_init_lifo(&client->ids, idxlist, depth);
+    client->reqs = reqs;
+
+    uint64_t num_cells = MIN(config->data.size / BLK_TRANSFER_SIZE, num_words * 64);
+    fsmalloc_init(&client->bufs, client->data_vaddr, BLK_TRANSFER_SIZE, num_cells, &client->bufs_avail, words,
+                  num_words);
+    return 0;
+}
+
+/**
+ * Allocate a buffer in the data region to read into or write from.
+ *
+ * @param client pointer to the client struct.
+ * @param count size of the buffer in BLK_TRANSFER_SIZE blocks.
+ * @param buf pointer to the buffer allocated.
+ *
+ * @return 0 on success, -1 if there is no free space of this size.
+ */
+static inline int blk_client_buf_alloc(blk_client_t *client, uint16_t count, void **buf)
+{
+    uintptr_t addr;
+    int err = fsmalloc_alloc(&client->bufs, &addr, count);
+    if (err) {
+        return -1;
+    }
+    *buf = (void *)addr;
+    return 0;
+}
+
+/**
+ * Free a buffer allocated with blk_client_buf_alloc.
+ *
+ * @param client pointer to the client struct.
+ * @param buf buffer to free.
+ * @param count size of the buffer in BLK_TRANSFER_SIZE blocks.
+ */
+static inline void blk_client_buf_free(blk_client_t *client, void *buf, uint16_t count)
+{
+    fsmalloc_free(&client->bufs, (uintptr_t)buf, count);
+}
+
+/**
+ * Get the number of requests in flight.
+ *
+ * @param client pointer to the client struct.
+ *
+ * @return number of submitted requests that have not yet completed.
+ */
+static inline uint32_t blk_client_in_flight(blk_client_t *client)
+{
+    return client->ids.size - ialloc_num_free(&client->ids);
+}
+
+/**
+ * Check whether another request can be submitted.
+ *
+ * @param client pointer to the client struct.
+ *
+ * @return true if there is room for another request, false otherwise.
+ */
+static inline bool blk_client_can_submit(blk_client_t *client)
+{
+    return !ialloc_full(&client->ids) && !blk_queue_full_req(&client->queue);
+}
+
+/**
+ * Submit a request. The virtualiser is not notified until blk_client_flush
+ * is called, so that a batch of requests costs a single notification.
+ *
+ * @param client pointer to the client struct.
+ * @param code request code.
+ * @param buf buffer in the data region to read into or write from, may be
+ *            NULL for requests that do not transfer data.
+ * @param block_number block number to read/write to.
+ * @param count number of blocks to read/write.
+ * @param callback called from blk_client_process on completion, may be NULL.
+ * @param cookie passed to the callback or returned by blk_client_poll.
+ *
+ * @return 0 on success, -1 if the queue depth has been reached.
+ */
+static inline int blk_client_submit(blk_client_t *client, blk_req_code_t code, void *buf, uint64_t block_number,
+                                    uint16_t count, blk_client_callback_t callback, void *cookie)
+{
+    uint32_t id;
+    if (!blk_client_can_submit(client) || ialloc_alloc(&client->ids, &id)) {
+        return -1;
+    }
+
+    client->reqs[id].callback = callback;
+    client->reqs[id].cookie = cookie;
+
+    uintptr_t offset = buf == NULL ? 0 : (uintptr_t)buf - client->data_vaddr;
+    int err = blk_enqueue_req(&client->queue, code, offset, block_number, count, id);
+    assert(!err);
+    client->notify = true;
+
+    return 0;
+}
+
+/**
+ * Notify the virtualiser of the requests submitted since the last flush.
+ * Does nothing if no requests have been submitted.
+ *
+ * @param client pointer to the client struct.
+ */
+static inline void blk_client_flush(blk_client_t *client)
+{
+    if (client->notify) {
+        client->notify = false;
+        sddf_notify(client->virt_id);
+    }
+}
+
+/**
+ * Take the next completed request, without invoking its callback.
+ *
+ * @param client pointer to the client struct.
+ * @param status pointer to the response status of the request.
+ * @param success_count pointer to the number of blocks successfully read/written.
+ * @param cookie pointer to the cookie given when the request was submitted.
+ *
+ * @return 0 on success, -1 if no request has completed.
+ */
+static inline int blk_client_poll(blk_client_t *client, blk_resp_status_t *status, uint16_t *success_count,
+                                  void **cookie)
+{
+    uint32_t id;
+    if (blk_dequeue_resp(&client->queue, status, success_count, &id)) {
+        return -1;
+    }
+
+    *cookie = client->reqs[id].cookie;
+    int err = ialloc_free(&client->ids, id);
+    assert(!err);
+
+    return 0;
+}
+
+/**
+ * Take all completed requests and invoke their callbacks. Callbacks may
+ * submit further requests, these are notified with the next flush.
+ *
+ * @param client pointer to the client struct.
+ *
+ * @return number of requests completed.
+ */
+static inline uint32_t blk_client_process(blk_client_t *client)
+{
+    uint32_t completed = 0;
+    blk_resp_status_t status;
+    uint16_t success_count;
+    uint32_t id;
+    while (!blk_dequeue_resp(&client->queue, &status, &success_count, &id)) {
+        blk_client_req_t req = client->reqs[id];
+        int err = ialloc_free(&client->ids, id);
+        assert(!err);
+
+        if (req.callback != NULL) {
+            req.callback(status, success_count, req.cookie);
+        }
+        completed++;
+    }
+
+    return completed;
+}
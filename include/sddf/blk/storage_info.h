@@ -18,12 +18,17 @@ typedef struct blk_storage_info {
     char serial_number[BLK_MAX_SERIAL_NUMBER + 1];
     /* device does not accept write requests */
     bool read_only;
-    /* whether this configuration is populated yet */
+    /* whether this configuration is populated yet, the producer notifies the
+     * consumer over the connection's channel once it sets this */
     bool ready;
     /* size of a sector, in bytes */
     uint16_t sector_size;
-    /* optimal block size, specified in BLK_TRANSFER_SIZE sized units */
+    /* optimal block size, specified in BLK_TRANSFER_SIZE sized units. Requests
+     * should be a multiple of this size and start on a multiple of it. */
     uint16_t block_size;
+    /* number of requests the consumer should have in flight at most, 0 if
+     * unknown. For clients of the virtualiser this is their share of the
+     * driver's queue depth. */
     uint16_t queue_depth;
     /* geometry to guide FS layout */
     uint16_t cylinders, heads, blocks;
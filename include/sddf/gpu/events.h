@@ -6,14 +6,28 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <stdbool.h>
+#include <sddf/gpu/gpu.h>
 
 #define GPU_EVENTS_REGION_SIZE 0x1000
 
+/* Page flips that have taken effect on a scanout */
+typedef struct gpu_flip_event {
+    /* Number of page flips that have taken effect */
+    uint64_t count;
+    /* sddf_timestamp() when the last page flip took effect */
+    uint64_t timestamp;
+} gpu_flip_event_t;
+
 typedef struct gpu_events_t {
     bool display_info;
+    /* Indexed by scanout id */
+    gpu_flip_event_t flips[GPU_MAX_SCANOUTS];
 } gpu_events_t;
 
+_Static_assert(sizeof(gpu_events_t) <= GPU_EVENTS_REGION_SIZE, "gpu_events_t must fit in GPU_EVENTS_REGION_SIZE");
+
 /**
  * Set a display info event.
  *
@@ -45,3 +59,35 @@ static inline bool gpu_events_check_display_info(gpu_events_t *events)
 {
     return __atomic_load_n(&events->display_info, __ATOMIC_ACQUIRE);
 }
+
+/**
+ * Record that a page flip has taken effect on a scanout.
+ *
+ * @param events events region to record the flip in.
+ * @param scanout_id scanout the flip took effect on.
+ * @param timestamp sddf_timestamp() when the flip took effect.
+ */
+static inline void gpu_events_set_flip(gpu_events_t *events, uint32_t scanout_id, uint64_t timestamp)
+{
+    gpu_flip_event_t *flip = &events->flips[scanout_id];
+    __atomic_store_n(&flip->timestamp, timestamp, __ATOMIC_RELAXED);
+    __atomic_store_n(&flip->count, flip->count + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the number of page flips that have taken effect on a scanout, and when the last one
+ * did. If another flip takes effect meanwhile, the timestamp may be that of the newer flip.
+ *
+ * @param events events region containing the flips.
+ * @param scanout_id scanout to get the flips of.
+ * @param timestamp pointer to store the timestamp of the last flip.
+ *
+ * @return number of page flips that have taken effect on the scanout.
+ */
+static inline uint64_t gpu_events_check_flip(gpu_events_t *events, uint32_t scanout_id, uint64_t *timestamp)
+{
+    gpu_flip_event_t *flip = &events->flips[scanout_id];
+    uint64_t count = __atomic_load_n(&flip->count, __ATOMIC_ACQUIRE);
+    *timestamp = __atomic_load_n(&flip->timestamp, __ATOMIC_RELAXED);
+    return count;
+}
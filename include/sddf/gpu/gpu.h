@@ -16,6 +16,8 @@
 /* Bytes per pixel in 2D resources */
 #define GPU_BPP_2D 4
 #define GPU_MAX_SCANOUTS 16
+/* Width and height in pixels of cursor images */
+#define GPU_CURSOR_SIZE 64
 
 /* Defines a rectangle with position x, y and size with width, length.
  * The coordinates 0,0 is top left, larger x moves right, larger y moves down.
@@ -45,6 +47,15 @@ typedef struct gpu_scanout {
     bool enabled;
 } gpu_scanout_t;
 
+/* Placement of a client's window on a scanout, when the virtualiser composites clients */
+typedef struct gpu_window {
+    uint32_t scanout_id;
+    /* Position of the window on the scanout and its maximum size */
+    gpu_rect_t rect;
+    /* Windows with a larger z are drawn over those with a smaller z */
+    uint32_t z;
+} gpu_window_t;
+
 typedef struct gpu_req_get_display_info {
     /* Offset within data memory region */
     uint64_t mem_offset;
@@ -83,6 +94,14 @@ typedef struct gpu_req_set_scanout_blob {
     gpu_rect_t rect;
 } gpu_req_set_scanout_blob_t;
 
+/*
+ * A page flip takes the same arguments as setting the scanout of a blob resource. The
+ * scanout switches to the new resource at once, and the request only completes once the
+ * resource is being shown, after which the previously shown resource may be drawn to again.
+ * The time the flip took effect is reported through the flips of gpu_events_t.
+ */
+typedef gpu_req_set_scanout_blob_t gpu_req_page_flip_t;
+
 typedef struct gpu_req_resource_create_2d {
     /* Assign resource with id */
     uint32_t resource_id;
@@ -119,6 +138,11 @@ typedef struct gpu_req_transfer_to_2d {
     gpu_rect_t rect;
     /* Offset into resource's attached memory backing, from which data is transferred from */
     uint64_t mem_offset;
+    /*
+     * Bytes from one row of pixels to the next in the memory backing, zero for the row size
+     * of the resource (width * GPU_BPP_2D), which is currently the only stride supported.
+     */
+    uint32_t stride;
 } gpu_req_transfer_to_2d_t;
 
 typedef struct gpu_req_resource_flush {
@@ -130,3 +154,26 @@ typedef struct gpu_req_resource_flush {
 typedef struct gpu_req_resource_unref {
     uint32_t resource_id;
 } gpu_req_resource_unref_t;
+
+typedef struct gpu_req_update_cursor {
+    uint32_t scanout_id;
+    /* Position on the scanout of the cursor hotspot */
+    uint32_t x;
+    uint32_t y;
+    /*
+     * 2D resource of GPU_CURSOR_SIZE by GPU_CURSOR_SIZE pixels holding the cursor image, or
+     * GPU_DISABLE_SCANOUT_RESOURCE_ID to hide the cursor. The image is read from the resource
+     * when the request is processed, so transfers to the resource must have completed first.
+     */
+    uint32_t resource_id;
+    /* Position of the hotspot within the cursor image */
+    uint32_t hot_x;
+    uint32_t hot_y;
+} gpu_req_update_cursor_t;
+
+typedef struct gpu_req_move_cursor {
+    uint32_t scanout_id;
+    /* Position on the scanout of the cursor hotspot */
+    uint32_t x;
+    uint32_t y;
+} gpu_req_move_cursor_t;
@@ -33,6 +33,12 @@ typedef enum gpu_req_code {
     GPU_REQ_RESOURCE_FLUSH,
     /* Destroy a resource */
     GPU_REQ_RESOURCE_UNREF,
+    /* Set the cursor image and position of a scanout */
+    GPU_REQ_UPDATE_CURSOR,
+    /* Move the cursor of a scanout without changing its image */
+    GPU_REQ_MOVE_CURSOR,
+    /* Switch the scanout to another blob resource, completing once the switch is shown */
+    GPU_REQ_PAGE_FLIP,
 } gpu_req_code_t;
 
 typedef enum gpu_resp_status {
@@ -48,6 +54,8 @@ typedef enum gpu_resp_status {
     GPU_RESP_ERR_INVALID_BOUNDS,
     /* Invalid parameter in request */
     GPU_RESP_ERR_INVALID_PARAMETER,
+    /* Too many page flips of the client in flight on the scanout, retry once one has completed */
+    GPU_RESP_ERR_BUSY,
 } gpu_resp_status_t;
 
 typedef struct gpu_req {
@@ -65,6 +73,9 @@ typedef struct gpu_req {
         gpu_req_transfer_to_2d_t transfer_to_2d;
         gpu_req_resource_flush_t resource_flush;
         gpu_req_resource_unref_t resource_unref;
+        gpu_req_update_cursor_t update_cursor;
+        gpu_req_move_cursor_t move_cursor;
+        gpu_req_page_flip_t page_flip;
     };
 } gpu_req_t;
 
@@ -235,6 +246,18 @@ static inline int gpu_enqueue_resp(gpu_queue_handle_t *h, gpu_resp_t resp)
     return 0;
 }
 
+/**
+ * Get the code of the request at the head of the request queue without dequeuing it.
+ *
+ * @param h queue handle containing request queue, which must not be empty.
+ *
+ * @return code of the next request to be dequeued.
+ */
+static inline gpu_req_code_t gpu_queue_peek_code_req(gpu_queue_handle_t *h)
+{
+    return h->req_queue->buffers[h->req_queue->head % h->capacity].code;
+}
+
 /**
  * Dequeue an element from the request queue.
  *
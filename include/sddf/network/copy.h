@@ -0,0 +1,56 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <os/sddf.h>
+
+/*
+ * The copier moves received packets from the RX virtualiser's shared DMA
+ * region into a client's private data region. It normally runs as its own
+ * protection domain, with a notification and context switch to hand every
+ * batch of packets to the client.
+ *
+ * Where isolating the copier from its client is not required, it can instead
+ * be linked into the client by building copy.c with NET_COPY_FUSED defined
+ * (network_copy_fused.o). The copier's config is then patched into the client
+ * image as .net_copy_config, and the client calls into the copier directly,
+ * so that received packets are processed end to end in one activation:
+ *
+ *     if (net_copy_notified(ch)) {
+ *         sddf_lwip_process_rx();
+ *     }
+ *     ...
+ *     while (net_copy_process()) {
+ *         sddf_lwip_process_rx();
+ *     }
+ *
+ * In fused mode the copier never notifies the client and does not ask to be
+ * notified of free client buffers. The client must call net_copy_process
+ * after freeing RX buffers, so that packets waiting for them get through.
+ * lib_sddf_lwip does this in sddf_lwip_maybe_notify when it is also built with
+ * NET_COPY_FUSED. The echo server's FUSED_COPY=1 build is an example.
+ */
+
+/**
+ * Initialise the copier's queues.
+ */
+void net_copy_init(void);
+
+/**
+ * Copy as many received packets to the client as it has free buffers for.
+ *
+ * @return true if any packets were handed to the client, false otherwise.
+ */
+bool net_copy_process(void);
+
+/**
+ * Handle a notification if it is from the RX virtualiser.
+ *
+ * @param ch channel the notification was received on.
+ * @return true if the channel belonged to the copier and was handled.
+ */
+bool net_copy_notified(sddf_channel ch);
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sddf/util/util.h>
+
+/*
+ * This file provides minimal helpers for drivers of PCI(e) devices that
+ * access configuration space through an ECAM (Enhanced Configuration Access
+ * Mechanism) window, such as the 'pci-host-ecam-generic' host bridge
+ * found on QEMU's virt platforms.
+ *
+ * There is no PCI enumeration component in sDDF. A driver is given a mapping
+ * of the ECAM window and of the memory its device's BAR(s) should be placed at,
+ * and is responsible for finding its device and programming the BAR itself.
+ */
+
+/* Size of the configuration space of a single function */
+#define PCI_ECAM_FUNCTION_SIZE 0x1000
+/* Size of the configuration space of a single bus */
+#define PCI_ECAM_BUS_SIZE (PCI_ECAM_FUNCTION_SIZE * 8 * 32)
+
+#define PCI_MAX_DEVICES 32
+#define PCI_MAX_FUNCTIONS 8
+
+#define PCI_VENDOR_ID_INVALID 0xffff
+
+/* Offsets into the type 0 configuration space header */
+#define PCI_CFG_VENDOR_ID 0x00
+#define PCI_CFG_DEVICE_ID 0x02
+#define PCI_CFG_COMMAND 0x04
+#define PCI_CFG_STATUS 0x06
+#define PCI_CFG_CLASS_REVISION 0x08
+#define PCI_CFG_HEADER_TYPE 0x0e
+#define PCI_CFG_BAR0 0x10
+#define PCI_CFG_CAPABILITIES_PTR 0x34
+#define PCI_CFG_INTERRUPT_LINE 0x3c
+#define PCI_CFG_INTERRUPT_PIN 0x3d
+
+#define PCI_COMMAND_IO_SPACE BIT(0)
+#define PCI_COMMAND_MEMORY_SPACE BIT(1)
+#define PCI_COMMAND_BUS_MASTER BIT(2)
+#define PCI_COMMAND_INTX_DISABLE BIT(10)
+
+#define PCI_STATUS_CAPABILITIES_LIST BIT(4)
+
+#define PCI_HEADER_TYPE_MASK 0x7f
+#define PCI_HEADER_TYPE_MULTI_FUNCTION BIT(7)
+
+#define PCI_BAR_SPACE_IO BIT(0)
+#define PCI_BAR_TYPE_MASK (0x3 << 1)
+#define PCI_BAR_TYPE_64 (0x2 << 1)
+#define PCI_BAR_ADDR_MASK (~(uint32_t)0xf)
+
+/* Capability IDs */
+#define PCI_CAP_ID_MSI 0x05
+#define PCI_CAP_ID_VENDOR 0x09
+#define PCI_CAP_ID_PCIE 0x10
+#define PCI_CAP_ID_MSIX 0x11
+
+/* MSI-X capability layout, relative to the start of the capability */
+#define PCI_MSIX_CTRL 0x02
+#define PCI_MSIX_TABLE 0x04
+#define PCI_MSIX_PBA 0x08
+#define PCI_MSIX_CTRL_TABLE_SIZE_MASK 0x7ff
+#define PCI_MSIX_CTRL_FUNCTION_MASK BIT(14)
+#define PCI_MSIX_CTRL_ENABLE BIT(15)
+#define PCI_MSIX_BIR_MASK 0x7
+
+/* Entry in the MSI-X table that lives in one of the function's BARs */
+typedef volatile struct pci_msix_entry {
+    uint32_t addr_low;
+    uint32_t addr_high;
+    uint32_t data;
+    uint32_t vector_ctrl;
+} pci_msix_entry_t;
+
+#define PCI_MSIX_VECTOR_CTRL_MASKED BIT(0)
+
+/* Class codes, as (base class << 16 | sub-class << 8 | programming interface) */
+#define PCI_CLASS_STORAGE_NVME 0x010802
+
+typedef struct pci_function {
+    /* Virtual address of the configuration space of this function */
+    uintptr_t cfg;
+    uint8_t bus;
+    uint8_t device;
+    uint8_t function;
+} pci_function_t;
+
+static inline uintptr_t pci_ecam_function_addr(uintptr_t ecam_base, uint8_t bus, uint8_t device, uint8_t function)
+{
+    return ecam_base + ((uintptr_t)bus << 20) + ((uintptr_t)device << 15) + ((uintptr_t)function << 12);
+}
+
+static inline uint8_t pci_cfg_read8(pci_function_t *fn, uint16_t offset)
+{
+    return *(volatile uint8_t *)(fn->cfg + offset);
+}
+
+static inline uint16_t pci_cfg_read16(pci_function_t *fn, uint16_t offset)
+{
+    return *(volatile uint16_t *)(fn->cfg + offset);
+}
+
+static inline uint32_t pci_cfg_read32(pci_function_t *fn, uint16_t offset)
+{
+    return *(volatile uint32_t *)(fn->cfg + offset);
+}
+
+static inline void pci_cfg_write16(pci_function_t *fn, uint16_t offset, uint16_t val)
+{
+    *(volatile uint16_t *)(fn->cfg + offset) = val;
+}
+
+static inline void pci_cfg_write32(pci_function_t *fn, uint16_t offset, uint32_t val)
+{
+    *(volatile uint32_t *)(fn->cfg + offset) = val;
+}
+
+/**
+ * Find a function on the given bus by matching a predicate against each
+ * populated function's vendor ID, device ID and class code.
+ *
+ * @param ecam_base virtual address of the start of the ECAM window.
+ * @param ecam_size size of the ECAM mapping, only buses fully covered are scanned.
+ * @param match predicate called on each present function.
+ * @param arg opaque argument passed through to the predicate.
+ * @param fn function that is filled in when a match is found.
+ *
+ * @return true if a matching function was found, false otherwise.
+ */
+static inline bool pci_find_function(uintptr_t ecam_base, uint64_t ecam_size,
+                                     bool (*match)(uint16_t vendor, uint16_t device, uint32_t class_code, void *arg),
+                                     void *arg, pci_function_t *fn)
+{
+    uint64_t num_buses = MAX(ecam_size / PCI_ECAM_BUS_SIZE, 1);
+    for (uint64_t bus = 0; bus < num_buses && bus < 256; bus++) {
+        for (uint8_t dev = 0; dev < PCI_MAX_DEVICES; dev++) {
+            for (uint8_t func = 0; func < PCI_MAX_FUNCTIONS; func++) {
+                pci_function_t candidate = {
+                    .cfg = pci_ecam_function_addr(ecam_base, bus, dev, func),
+                    .bus = bus,
+                    .device = dev,
+                    .function = func,
+                };
+                if (candidate.cfg + PCI_ECAM_FUNCTION_SIZE > ecam_base + ecam_size) {
+                    return false;
+                }
+
+                uint16_t vendor = pci_cfg_read16(&candidate, PCI_CFG_VENDOR_ID);
+                if (vendor == PCI_VENDOR_ID_INVALID) {
+                    /* A device without function 0 has no other functions either */
+                    if (func == 0) {
+                        break;
+                    }
+                    continue;
+                }
+
+                uint16_t device = pci_cfg_read16(&candidate, PCI_CFG_DEVICE_ID);
+                uint32_t class_code = pci_cfg_read32(&candidate, PCI_CFG_CLASS_REVISION) >> 8;
+                if (match(vendor, device, class_code, arg)) {
+                    *fn = candidate;
+                    return true;
+                }
+
+                if (func == 0 && !(pci_cfg_read8(&candidate, PCI_CFG_HEADER_TYPE) & PCI_HEADER_TYPE_MULTI_FUNCTION)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Place a memory BAR at the given bus address. Handles both 32-bit and 64-bit BARs.
+ *
+ * @param fn PCI function.
+ * @param bar index of the BAR, 0 to 5.
+ * @param bus_addr bus address to place the BAR at, must be aligned to the BAR size.
+ *
+ * @return size of the BAR in bytes, 0 if the BAR is not implemented or is an I/O BAR.
+ */
+static inline uint64_t pci_bar_assign(pci_function_t *fn, uint8_t bar, uint64_t bus_addr)
+{
+    uint16_t offset = PCI_CFG_BAR0 + bar * 4;
+    uint32_t orig = pci_cfg_read32(fn, offset);
+    if (orig & PCI_BAR_SPACE_IO) {
+        return 0;
+    }
+    bool is_64 = (orig & PCI_BAR_TYPE_MASK) == PCI_BAR_TYPE_64;
+
+    /* Disable decoding while sizing the BAR */
+    uint16_t command = pci_cfg_read16(fn, PCI_CFG_COMMAND);
+    pci_cfg_write16(fn, PCI_CFG_COMMAND, command & ~(PCI_COMMAND_MEMORY_SPACE | PCI_COMMAND_IO_SPACE));
+
+    pci_cfg_write32(fn, offset, ~(uint32_t)0);
+    uint64_t mask = pci_cfg_read32(fn, offset) & PCI_BAR_ADDR_MASK;
+    if (is_64) {
+        pci_cfg_write32(fn, offset + 4, ~(uint32_t)0);
+        mask |= (uint64_t)pci_cfg_read32(fn, offset + 4) << 32;
+    } else {
+        mask |= 0xffffffff00000000ULL;
+    }
+    uint64_t size = mask ? (~mask + 1) : 0;
+
+    assert(size == 0 || bus_addr % size == 0);
+    pci_cfg_write32(fn, offset, (uint32_t)bus_addr);
+    if (is_64) {
+        pci_cfg_write32(fn, offset + 4, (uint32_t)(bus_addr >> 32));
+    } else {
+        assert(bus_addr >> 32 == 0);
+    }
+
+    pci_cfg_write16(fn, PCI_CFG_COMMAND, command);
+
+    return size;
+}
+
+/**
+ * Enable memory decoding and bus mastering (DMA) for a function.
+ *
+ * @param fn PCI function.
+ * @param intx whether to leave legacy INTx interrupts enabled.
+ */
+static inline void pci_enable(pci_function_t *fn, bool intx)
+{
+    uint16_t command = pci_cfg_read16(fn, PCI_CFG_COMMAND);
+    command |= PCI_COMMAND_MEMORY_SPACE | PCI_COMMAND_BUS_MASTER;
+    if (intx) {
+        command &= ~PCI_COMMAND_INTX_DISABLE;
+    } else {
+        command |= PCI_COMMAND_INTX_DISABLE;
+    }
+    pci_cfg_write16(fn, PCI_CFG_COMMAND, command);
+}
+
+/**
+ * Find the next capability with the given ID in the function's capability list.
+ *
+ * @param fn PCI function.
+ * @param cap_id capability ID to look for.
+ * @param start offset of the capability to continue searching from, 0 to start from the beginning.
+ *
+ * @return offset of the capability in configuration space, 0 if not found.
+ */
+static inline uint8_t pci_find_capability(pci_function_t *fn, uint8_t cap_id, uint8_t start)
+{
+    if (!(pci_cfg_read16(fn, PCI_CFG_STATUS) & PCI_STATUS_CAPABILITIES_LIST)) {
+        return 0;
+    }
+
+    uint8_t offset;
+    if (start == 0) {
+        offset = pci_cfg_read8(fn, PCI_CFG_CAPABILITIES_PTR) & ~0x3;
+    } else {
+        offset = pci_cfg_read8(fn, start + 1) & ~0x3;
+    }
+
+    /* Bound the walk in case of a malformed (cyclic) list */
+    for (int i = 0; offset != 0 && i < 48; i++) {
+        if (pci_cfg_read8(fn, offset) == cap_id) {
+            return offset;
+        }
+        offset = pci_cfg_read8(fn, offset + 1) & ~0x3;
+    }
+
+    return 0;
+}
@@ -13,6 +13,15 @@
 #define SDDF_SERIAL_MAX_CLIENTS 64
 #define SDDF_SERIAL_BEGIN_STR_MAX_LEN 128
 
+/*
+ * FIFO interrupt thresholds of the drivers, as a percentage of the FIFO depth.
+ * The receive threshold is the fill level at which an interrupt is raised,
+ * the transmit threshold the level the FIFO drains to before an interrupt to
+ * refill it is raised. These are used when the driver config leaves them zero.
+ */
+#define SDDF_SERIAL_RX_FIFO_THRESHOLD_DEFAULT 50
+#define SDDF_SERIAL_TX_FIFO_THRESHOLD_DEFAULT 25
+
 #define SDDF_SERIAL_MAGIC_LEN 5
 static char SDDF_SERIAL_MAGIC[SDDF_SERIAL_MAGIC_LEN] = { 's', 'D', 'D', 'F', 0x3 };
 
@@ -22,12 +31,31 @@ typedef struct serial_connection_resource {
     uint8_t id;
 } serial_connection_resource_t;
 
+/* Maximum number of ports of a driver in addition to the first, see serial_driver_config_t */
+#define SDDF_SERIAL_MAX_PORTS 7
+
+typedef struct serial_driver_port_config {
+    serial_connection_resource_t rx;
+    serial_connection_resource_t tx;
+    bool rx_enabled;
+} serial_driver_port_config_t;
+
 typedef struct serial_driver_config {
     char magic[SDDF_SERIAL_MAGIC_LEN];
     serial_connection_resource_t rx;
     serial_connection_resource_t tx;
     uint64_t default_baud;
     bool rx_enabled;
+    /* Percentage of the FIFO depth, zero for the default */
+    uint8_t rx_fifo_threshold;
+    uint8_t tx_fifo_threshold;
+    /*
+     * Further ports of devices with more than one, each connected to its own
+     * client. rx and tx above are port 0, ports[i] is port i + 1. Only used by
+     * the virtIO console driver.
+     */
+    serial_driver_port_config_t ports[SDDF_SERIAL_MAX_PORTS];
+    uint8_t num_ports;
 } serial_driver_config_t;
 
 typedef struct serial_virt_rx_config {
@@ -72,3 +100,28 @@ static bool serial_config_check_magic(void *config)
 
     return true;
 }
+
+/**
+ * Convert a FIFO threshold from the driver config into a number of characters.
+ *
+ * @param percent threshold from the driver config.
+ * @param default_percent threshold used if the config leaves it zero.
+ * @param depth depth of the FIFO in characters.
+ *
+ * @return threshold in characters, between 1 and depth.
+ */
+static inline uint32_t serial_fifo_threshold(uint8_t percent, uint8_t default_percent, uint32_t depth)
+{
+    if (percent == 0) {
+        percent = default_percent;
+    }
+
+    uint32_t threshold = (percent * depth + 50) / 100;
+    if (threshold < 1) {
+        return 1;
+    }
+    if (threshold > depth) {
+        return depth;
+    }
+    return threshold;
+}
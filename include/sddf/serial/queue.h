@@ -245,48 +245,72 @@ static inline uint32_t serial_queue_contiguous_free(serial_queue_handle_t *queue
 }
 
 /**
- * Enqueue a buffer of contiguous characters into a queue.
+ * Enqueue a buffer of contiguous characters into a queue locally. Update a
+ * local tail variable so the characters are not visible to the consumer.
  *
  * @param queue_handle queue to be filled with data.
+ * @param local_tail address of the tail to be used and incremented.
  * @param num number of characters to enqueue.
  * @param src pointer to characters to be transferred.
  *
  * @return Number of characters actually enqueued.
  */
-static inline uint32_t serial_enqueue_batch(serial_queue_handle_t *queue_handle, uint32_t num, const char *src)
+static inline uint32_t serial_enqueue_batch_local(serial_queue_handle_t *queue_handle, uint32_t *local_tail,
+                                                  uint32_t num, const char *src)
 {
-    char *dst = queue_handle->data_region + (queue_handle->queue->tail % queue_handle->capacity);
-    uint32_t avail = serial_queue_free(queue_handle);
+    uint32_t offset = *local_tail % queue_handle->capacity;
+    uint32_t avail = queue_handle->capacity - (*local_tail - queue_handle->queue->head);
     uint32_t num_prewrap;
     uint32_t num_postwrap;
 
     num = MIN(num, avail);
-    num_prewrap = serial_queue_contiguous_free(queue_handle);
-    num_prewrap = MIN(num, num_prewrap);
+    num_prewrap = MIN(num, queue_handle->capacity - offset);
     num_postwrap = num - num_prewrap;
 
-    sddf_memcpy(dst, src, num_prewrap);
+    sddf_memcpy(queue_handle->data_region + offset, src, num_prewrap);
     if (num_postwrap) {
         sddf_memcpy(queue_handle->data_region, src + num_prewrap, num_postwrap);
     }
 
-    serial_update_shared_tail(queue_handle, queue_handle->queue->tail + num);
+    *local_tail += num;
 
     return num;
 }
 
 /**
- * Transfer all data from a consumer queue to a producer queue. Assumes there
- * is enough free space in the free queue to fit all data in the active
- * queue.
+ * Enqueue a buffer of contiguous characters into a queue.
+ *
+ * @param queue_handle queue to be filled with data.
+ * @param num number of characters to enqueue.
+ * @param src pointer to characters to be transferred.
+ *
+ * @return Number of characters actually enqueued.
+ */
+static inline uint32_t serial_enqueue_batch(serial_queue_handle_t *queue_handle, uint32_t num, const char *src)
+{
+    uint32_t local_tail = queue_handle->queue->tail;
+    num = serial_enqueue_batch_local(queue_handle, &local_tail, num, src);
+    serial_update_shared_tail(queue_handle, local_tail);
+
+    return num;
+}
+
+/**
+ * Transfer all data from a consumer queue to a producer queue locally. The
+ * data is consumed from the active queue, but only enqueued at a local tail
+ * of the free queue, so several transfers can be made visible to its
+ * consumer at once. Assumes there is enough free space in the free queue to
+ * fit all data in the active queue.
  *
  * @param free_queue_handle queue to produce into.
+ * @param local_tail address of the tail of the free queue to be used and incremented.
  * @param active_queue_handle queue to consume.
  */
-static inline void serial_transfer_all(serial_queue_handle_t *free_queue_handle,
-                                       serial_queue_handle_t *active_queue_handle)
+static inline void serial_transfer_all_local(serial_queue_handle_t *free_queue_handle, uint32_t *local_tail,
+                                             serial_queue_handle_t *active_queue_handle)
 {
-    assert(serial_queue_length(active_queue_handle) <= serial_queue_free(free_queue_handle));
+    assert(serial_queue_length(active_queue_handle)
+           <= free_queue_handle->capacity - (*local_tail - free_queue_handle->queue->head));
 
     /* Copy in contiguous chunks */
     while (serial_queue_length(active_queue_handle)) {
@@ -294,7 +318,7 @@ static inline void serial_transfer_all(serial_queue_handle_t *free_queue_handle,
         char *src = active_queue_handle->data_region
                   + (active_queue_handle->queue->head % active_queue_handle->capacity);
 
-        uint32_t transferred = serial_enqueue_batch(free_queue_handle, num_active, src);
+        uint32_t transferred = serial_enqueue_batch_local(free_queue_handle, local_tail, num_active, src);
         assert(transferred == num_active);
 
         serial_update_shared_head(active_queue_handle, active_queue_handle->queue->head + num_active);
@@ -302,36 +326,77 @@ static inline void serial_transfer_all(serial_queue_handle_t *free_queue_handle,
 }
 
 /**
- * Transfer all data from a consumer queue to a producer queue, adding colour codes
- * before and after. Assumes there is enough free space in the free queue to fit
- * all data in the active.
+ * Transfer all data from a consumer queue to a producer queue. Assumes there
+ * is enough free space in the free queue to fit all data in the active
+ * queue.
+ *
+ * @param free_queue_handle queue to produce into.
+ * @param active_queue_handle queue to consume.
+ */
+static inline void serial_transfer_all(serial_queue_handle_t *free_queue_handle,
+                                       serial_queue_handle_t *active_queue_handle)
+{
+    uint32_t local_tail = free_queue_handle->queue->tail;
+    serial_transfer_all_local(free_queue_handle, &local_tail, active_queue_handle);
+    serial_update_shared_tail(free_queue_handle, local_tail);
+}
+
+/**
+ * Transfer all data from a consumer queue to a producer queue locally, adding
+ * colour codes before and after. See serial_transfer_all_local. Assumes there
+ * is enough free space in the free queue to fit all data in the active queue
+ * and the colour codes.
  *
  * @param free_queue_handle queue to produce into.
+ * @param local_tail address of the tail of the free queue to be used and incremented.
  * @param active_queue_handle queue to consume.
  * @param col_start colour code start string.
  * @param col_start_len length of start string.
  * @param col_end colour code end string.
  * @param col_end_len length of end string.
  */
-static inline void serial_transfer_all_colour(serial_queue_handle_t *free_queue_handle,
-                                              serial_queue_handle_t *active_queue_handle, const char *col_start,
-                                              uint16_t col_start_len, const char *col_end, uint16_t col_end_len)
+static inline void serial_transfer_all_colour_local(serial_queue_handle_t *free_queue_handle, uint32_t *local_tail,
+                                                    serial_queue_handle_t *active_queue_handle,
+                                                    const char *col_start, uint16_t col_start_len,
+                                                    const char *col_end, uint16_t col_end_len)
 {
     assert(serial_queue_length(active_queue_handle) + col_start_len + col_end_len
-           <= serial_queue_free(free_queue_handle));
+           <= free_queue_handle->capacity - (*local_tail - free_queue_handle->queue->head));
 
     /* Transfer col_start string */
-    uint32_t transferred = serial_enqueue_batch(free_queue_handle, col_start_len, col_start);
+    uint32_t transferred = serial_enqueue_batch_local(free_queue_handle, local_tail, col_start_len, col_start);
     assert(transferred == col_start_len);
 
     /* Transfer active data */
-    serial_transfer_all(free_queue_handle, active_queue_handle);
+    serial_transfer_all_local(free_queue_handle, local_tail, active_queue_handle);
 
     /* Transfer col_end string */
-    transferred = serial_enqueue_batch(free_queue_handle, col_end_len, col_end);
+    transferred = serial_enqueue_batch_local(free_queue_handle, local_tail, col_end_len, col_end);
     assert(transferred == col_end_len);
 }
 
+/**
+ * Transfer all data from a consumer queue to a producer queue, adding colour codes
+ * before and after. Assumes there is enough free space in the free queue to fit
+ * all data in the active.
+ *
+ * @param free_queue_handle queue to produce into.
+ * @param active_queue_handle queue to consume.
+ * @param col_start colour code start string.
+ * @param col_start_len length of start string.
+ * @param col_end colour code end string.
+ * @param col_end_len length of end string.
+ */
+static inline void serial_transfer_all_colour(serial_queue_handle_t *free_queue_handle,
+                                              serial_queue_handle_t *active_queue_handle, const char *col_start,
+                                              uint16_t col_start_len, const char *col_end, uint16_t col_end_len)
+{
+    uint32_t local_tail = free_queue_handle->queue->tail;
+    serial_transfer_all_colour_local(free_queue_handle, &local_tail, active_queue_handle, col_start, col_start_len,
+                                     col_end, col_end_len);
+    serial_update_shared_tail(free_queue_handle, local_tail);
+}
+
 /**
  * Initialise the queue handle data structure with the shared queue.
  *
@@ -8,6 +8,7 @@
 #include <os/sddf.h>
 #include <stdint.h>
 #include <sddf/timer/protocol.h>
+#include <sddf/timer/clock.h>
 
 /**
  * Request a timeout via PPC into the passive timer driver.
@@ -21,6 +22,73 @@ static inline void sddf_timer_set_timeout(unsigned int channel, uint64_t timeout
     sddf_ppcall(channel, seL4_MessageInfo_new(SDDF_TIMER_SET_TIMEOUT, 0, 0, 1));
 }
 
+/**
+ * Request one of several timeouts via PPC into the passive timer driver.
+ * Setting a timeout that is already armed replaces its deadline.
+ * @param microkit channel of timer driver.
+ * @param id ID of the timeout, less than SDDF_TIMER_MAX_TIMEOUT_IDS.
+ * @param timeout relative timeout in nanoseconds.
+ */
+static inline void sddf_timer_set_timeout_id(unsigned int channel, uint64_t id, uint64_t timeout)
+{
+    sddf_set_mr(0, timeout);
+    sddf_set_mr(1, id);
+    sddf_ppcall(channel, seL4_MessageInfo_new(SDDF_TIMER_SET_TIMEOUT_ID, 0, 0, 2));
+}
+
+/**
+ * Request a periodic timeout via PPC into the passive timer driver. The
+ * client is notified every period until the timeout is cancelled, without
+ * needing to re-arm it.
+ * @param microkit channel of timer driver.
+ * @param id ID of the timeout, less than SDDF_TIMER_MAX_TIMEOUT_IDS.
+ * @param period period in nanoseconds.
+ */
+static inline void sddf_timer_set_periodic(unsigned int channel, uint64_t id, uint64_t period)
+{
+    sddf_set_mr(0, period);
+    sddf_set_mr(1, id);
+    sddf_ppcall(channel, seL4_MessageInfo_new(SDDF_TIMER_SET_PERIODIC, 0, 0, 2));
+}
+
+/**
+ * Allow the client's timeouts to expire up to slack nanoseconds late, so the
+ * timer driver can serve timeouts of several clients with one interrupt.
+ * Applies to timeouts set from now on.
+ * @param microkit channel of timer driver.
+ * @param slack slack in nanoseconds.
+ */
+static inline void sddf_timer_set_slack(unsigned int channel, uint64_t slack)
+{
+    sddf_set_mr(0, slack);
+    sddf_ppcall(channel, seL4_MessageInfo_new(SDDF_TIMER_SET_SLACK, 0, 0, 1));
+}
+
+/**
+ * Cancel a timeout via PPC into the passive timer driver. A cancelled timeout
+ * is not reported as expired, even if it expired before being cancelled.
+ * @param microkit channel of timer driver.
+ * @param id ID of the timeout, 0 for the one set with sddf_timer_set_timeout.
+ */
+static inline void sddf_timer_cancel_timeout(unsigned int channel, uint64_t id)
+{
+    sddf_set_mr(0, id);
+    sddf_ppcall(channel, seL4_MessageInfo_new(SDDF_TIMER_CANCEL_TIMEOUT, 0, 0, 1));
+}
+
+/**
+ * Find out which timeouts have expired via PPC into the passive timer driver.
+ * Only needed by clients with several timeouts armed, to tell which of them
+ * caused a notification.
+ * @param microkit channel of timer driver.
+ * @return bit mask of the timeout IDs that have expired since last asked.
+ */
+static inline uint64_t sddf_timer_fired(unsigned int channel)
+{
+    sddf_ppcall(channel, seL4_MessageInfo_new(SDDF_TIMER_GET_FIRED, 0, 0, 0));
+    return sddf_get_mr(0);
+}
+
 /**
  * Request the time since start up via PPC into the passive timer driver.
  * Use the label to indicate this request.
@@ -33,3 +101,20 @@ static inline uint64_t sddf_timer_time_now(unsigned int channel)
     uint64_t time_now = sddf_get_mr(0);
     return time_now;
 }
+
+/**
+ * Get the time since start up, reading the timer driver's clock page if it
+ * is mapped and published, and falling back to a PPC into the passive timer
+ * driver otherwise. See sddf/timer/clock.h.
+ * @param microkit channel of timer driver.
+ * @param clock pointer to the clock page, NULL if it is not mapped.
+ * @return the time in nanoseconds since start up.
+ */
+static inline uint64_t sddf_timer_clock_now(unsigned int channel, sddf_timer_clock_t *clock)
+{
+    uint64_t time_now;
+    if (sddf_timer_clock_read(clock, &time_now)) {
+        time_now = sddf_timer_time_now(channel);
+    }
+    return time_now;
+}
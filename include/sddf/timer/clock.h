@@ -0,0 +1,118 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sddf/timer/protocol.h>
+#include <sddf/timer/clocksource.h>
+#include <sddf/util/timestamp.h>
+
+/*
+ * Clock page, letting clients read the time without a PPC into the timer
+ * driver.
+ *
+ * On platforms where the timer driver keeps time with the architectural
+ * counter, which clients can read directly, the driver publishes the
+ * counter's frequency, conversion to nanoseconds (see sddf/timer/clocksource.h)
+ * and offset in a page shared read-only with its clients. Clients read the
+ * counter and convert to nanoseconds locally, getting the same time as
+ * SDDF_TIMER_GET_TIME would. The page is protected by a sequence
+ * lock, so the driver can update it while clients are reading.
+ *
+ * The page is opt-in per system. To enable it, create a memory region of
+ * SDDF_TIMER_CLOCK_PAGE_SIZE bytes, map it read-write into the timer driver
+ * with setvar_vaddr="timer_clock_page" and read-only into clients. Drivers
+ * without a counter clients can read leave the page unpublished, in which
+ * case clients fall back to SDDF_TIMER_GET_TIME.
+ */
+
+#define SDDF_TIMER_CLOCK_PAGE_SIZE 0x1000
+
+typedef enum sddf_timer_clock_source {
+    /* Time can only be read via SDDF_TIMER_GET_TIME */
+    SDDF_TIMER_CLOCK_SOURCE_NONE = 0,
+    /* Time is read from the architectural counter, see sddf/util/timestamp.h */
+    SDDF_TIMER_CLOCK_SOURCE_COUNTER,
+} sddf_timer_clock_source_t;
+
+typedef struct sddf_timer_clock {
+    /* Odd while the driver is updating the page */
+    uint32_t seq;
+    uint32_t source;
+    /* Frequency of the counter in Hz */
+    uint64_t freq;
+    /* Conversion of counter ticks to nanoseconds */
+    uint64_t mult;
+    uint32_t shift;
+    /* Time in nanoseconds when the counter read zero */
+    uint64_t offset;
+} sddf_timer_clock_t;
+
+/**
+ * Publish the clock, called by the timer driver whenever the frequency or
+ * offset of its counter changes.
+ *
+ * @param clock pointer to the clock page.
+ * @param source source of the time.
+ * @param cs clocksource of the counter.
+ * @param offset time in nanoseconds when the counter read zero.
+ */
+static inline void sddf_timer_clock_publish(sddf_timer_clock_t *clock, sddf_timer_clock_source_t source,
+                                            clocksource_t *cs, uint64_t offset)
+{
+    uint32_t seq = clock->seq;
+    __atomic_store_n(&clock->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    clock->source = source;
+    clock->freq = cs->freq;
+    clock->mult = cs->ns_mult;
+    clock->shift = cs->ns_shift;
+    clock->offset = offset;
+
+    __atomic_store_n(&clock->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Read the current time from the clock page.
+ *
+ * @param clock pointer to the clock page, may be NULL if it is not mapped.
+ * @param time_ns pointer to the time in nanoseconds since start up.
+ *
+ * @return 0 on success, -1 if the driver has not published a clock that can
+ *         be read locally.
+ */
+static inline int sddf_timer_clock_read(sddf_timer_clock_t *clock, uint64_t *time_ns)
+{
+    if (clock == NULL) {
+        return -1;
+    }
+
+    uint32_t seq;
+    uint32_t source;
+    uint64_t mult;
+    uint32_t shift;
+    uint64_t offset;
+    uint64_t ticks;
+    do {
+        seq = __atomic_load_n(&clock->seq, __ATOMIC_ACQUIRE);
+        source = clock->source;
+        mult = clock->mult;
+        shift = clock->shift;
+        offset = clock->offset;
+        ticks = sddf_timestamp();
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&clock->seq, __ATOMIC_RELAXED));
+
+    if (source != SDDF_TIMER_CLOCK_SOURCE_COUNTER) {
+        return -1;
+    }
+
+    *time_ns = offset + clocksource_cyc2ns(ticks, mult, shift);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sddf/timer/protocol.h>
+#include <sddf/util/udivmodti4.h>
+
+/*
+ * Conversion between counter ticks and nanoseconds for timer drivers.
+ *
+ * Dividing by the counter frequency on every conversion is slow, and needs a
+ * 128-bit division to avoid overflow. Instead, a multiplier and shift are
+ * computed once for the counter frequency when the driver starts, so each
+ * conversion is a single 64x64->128-bit multiply and a shift.
+ *
+ * The shift is the largest that keeps the multiplier within 64 bits, which is
+ * at least 32 for counters between 1 Hz and 4 GHz. Converting ticks to
+ * nanoseconds rounds down and is less than 1 + ticks / 2^shift nanoseconds
+ * below the exact result. Converting nanoseconds to ticks rounds up, so that
+ * a deadline is never programmed early, and is less than 1 + ns / 2^shift
+ * ticks above the exact result.
+ */
+
+typedef struct clocksource {
+    /* Frequency of the counter in Hz */
+    uint64_t freq;
+    /* ticks to nanoseconds */
+    uint64_t ns_mult;
+    uint32_t ns_shift;
+    /* nanoseconds to ticks */
+    uint64_t ticks_mult;
+    uint32_t ticks_shift;
+} clocksource_t;
+
+/* Compute mult and shift such that value * to / from is (value * mult) >> shift */
+static inline void clocksource_calc_mult_shift(uint64_t from, uint64_t to, bool round_up, uint64_t *mult,
+                                               uint32_t *shift)
+{
+    uint32_t s = 63;
+    while (s > 0 && (to >> (64 - s)) >= from) {
+        s--;
+    }
+
+    uint64_t hi = s == 0 ? 0 : to >> (64 - s);
+    uint64_t lo = to << s;
+    uint64_t rem = 0;
+    *mult = udiv128by64to64(hi, lo, from, &rem);
+    if (round_up && rem != 0) {
+        *mult += 1;
+    }
+    *shift = s;
+}
+
+/**
+ * Initialise the conversions for a counter.
+ *
+ * @param cs pointer to the clocksource struct.
+ * @param freq frequency of the counter in Hz, must be non-zero.
+ */
+static inline void clocksource_init(clocksource_t *cs, uint64_t freq)
+{
+    cs->freq = freq;
+    clocksource_calc_mult_shift(freq, NS_IN_S, false, &cs->ns_mult, &cs->ns_shift);
+    clocksource_calc_mult_shift(NS_IN_S, freq, true, &cs->ticks_mult, &cs->ticks_shift);
+}
+
+/**
+ * Convert ticks to nanoseconds with a precomputed multiplier and shift.
+ *
+ * @param ticks number of counter ticks.
+ * @param mult multiplier from clocksource_init.
+ * @param shift shift from clocksource_init.
+ *
+ * @return ticks in nanoseconds, rounded down.
+ */
+static inline uint64_t clocksource_cyc2ns(uint64_t ticks, uint64_t mult, uint32_t shift)
+{
+    return ((__uint128_t)ticks * mult) >> shift;
+}
+
+/**
+ * @param cs pointer to the clocksource struct.
+ * @param ticks number of counter ticks.
+ *
+ * @return ticks in nanoseconds, rounded down.
+ */
+static inline uint64_t clocksource_ticks_to_ns(clocksource_t *cs, uint64_t ticks)
+{
+    return clocksource_cyc2ns(ticks, cs->ns_mult, cs->ns_shift);
+}
+
+/**
+ * @param cs pointer to the clocksource struct.
+ * @param ns number of nanoseconds.
+ *
+ * @return nanoseconds in counter ticks, rounded up.
+ */
+static inline uint64_t clocksource_ns_to_ticks(clocksource_t *cs, uint64_t ns)
+{
+    __uint128_t product = (__uint128_t)ns * cs->ticks_mult;
+    uint64_t ticks = product >> cs->ticks_shift;
+    if (product & (((__uint128_t)1 << cs->ticks_shift) - 1)) {
+        ticks++;
+    }
+    return ticks;
+}
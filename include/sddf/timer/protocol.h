@@ -8,7 +8,21 @@
 /* Shared functionality/definitions between timer drivers and clients */
 
 #define SDDF_TIMER_GET_TIME 0
+/* Sets timeout ID 0, MR0 holds the relative timeout in nanoseconds */
 #define SDDF_TIMER_SET_TIMEOUT 1
+/* MR0 holds the relative timeout in nanoseconds, MR1 the timeout ID */
+#define SDDF_TIMER_SET_TIMEOUT_ID 2
+/* MR0 holds the timeout ID */
+#define SDDF_TIMER_CANCEL_TIMEOUT 3
+/* Replies with a bit mask in MR0 of the timeout IDs that have expired since last asked */
+#define SDDF_TIMER_GET_FIRED 4
+/* MR0 holds the period in nanoseconds, MR1 the timeout ID */
+#define SDDF_TIMER_SET_PERIODIC 5
+/* MR0 holds how late in nanoseconds the client's timeouts may expire */
+#define SDDF_TIMER_SET_SLACK 6
+
+/* Number of timeouts each client can have armed at once */
+#define SDDF_TIMER_MAX_TIMEOUT_IDS 16
 
 /* Number of nanoseconds in a second */
 #define NS_IN_S  1000000000ULL
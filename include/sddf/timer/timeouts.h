@@ -0,0 +1,315 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/sddf.h>
+#include <sddf/timer/config.h>
+#include <sddf/timer/protocol.h>
+#include <sddf/util/util.h>
+
+/*
+ * Timeout bookkeeping shared by all timer drivers.
+ *
+ * Every client of a timer driver, identified by the channel it calls in on,
+ * can have up to SDDF_TIMER_MAX_TIMEOUT_IDS timeouts armed at once. Pending
+ * timeouts are kept in a binary min-heap ordered by when they must expire, so
+ * arming and cancelling a timeout is O(log n) and finding the next time to
+ * program into the hardware is O(1).
+ *
+ * Timeouts can be periodic, in which case they are re-armed one period after
+ * their previous deadline each time they expire.
+ *
+ * Each client can also allow its timeouts some slack. A timeout never expires
+ * before its deadline, but may expire up to the client's slack after it, so
+ * that deadlines close together can be served by a single interrupt. The heap
+ * is ordered by the latest time each timeout may expire, which is what the
+ * hardware is programmed with. When it fires, every timeout at the front of
+ * the heap whose deadline has passed expires with it.
+ *
+ * Deadlines, periods and slack are in whatever unit the driver keeps time in,
+ * the bookkeeping only ever compares and adds them.
+ */
+
+typedef struct timer_timeout {
+    /* latest time the timeout may expire, deadline plus slack */
+    uint64_t latest;
+    /* earliest time the timeout may expire */
+    uint64_t deadline;
+    uint8_t ch;
+    uint8_t id;
+} timer_timeout_t;
+
+#define TIMER_TIMEOUTS_MAX (SDDF_TIMER_MAX_CLIENTS * SDDF_TIMER_MAX_TIMEOUT_IDS)
+
+typedef struct timer_timeouts {
+    /* min-heap of armed timeouts */
+    timer_timeout_t heap[TIMER_TIMEOUTS_MAX];
+    uint32_t num_armed;
+    /* heap index + 1 of each client's timeouts, 0 if not armed */
+    uint16_t heap_pos[SDDF_TIMER_MAX_CLIENTS][SDDF_TIMER_MAX_TIMEOUT_IDS];
+    /* period of each client's timeouts, 0 if not periodic */
+    uint64_t period[SDDF_TIMER_MAX_CLIENTS][SDDF_TIMER_MAX_TIMEOUT_IDS];
+    /* slack each client allows its timeouts */
+    uint64_t slack[SDDF_TIMER_MAX_CLIENTS];
+    /* timeouts that have expired since each client last asked */
+    uint64_t fired[SDDF_TIMER_MAX_CLIENTS];
+} timer_timeouts_t;
+
+static inline void timer_timeouts_heap_put(timer_timeouts_t *t, uint32_t idx, timer_timeout_t timeout)
+{
+    t->heap[idx] = timeout;
+    t->heap_pos[timeout.ch][timeout.id] = idx + 1;
+}
+
+static inline void timer_timeouts_sift_up(timer_timeouts_t *t, uint32_t idx)
+{
+    timer_timeout_t timeout = t->heap[idx];
+    while (idx > 0) {
+        uint32_t parent = (idx - 1) / 2;
+        if (t->heap[parent].latest <= timeout.latest) {
+            break;
+        }
+        timer_timeouts_heap_put(t, idx, t->heap[parent]);
+        idx = parent;
+    }
+    timer_timeouts_heap_put(t, idx, timeout);
+}
+
+static inline void timer_timeouts_sift_down(timer_timeouts_t *t, uint32_t idx)
+{
+    timer_timeout_t timeout = t->heap[idx];
+    while (true) {
+        uint32_t child = 2 * idx + 1;
+        if (child >= t->num_armed) {
+            break;
+        }
+        if (child + 1 < t->num_armed && t->heap[child + 1].latest < t->heap[child].latest) {
+            child++;
+        }
+        if (timeout.latest <= t->heap[child].latest) {
+            break;
+        }
+        timer_timeouts_heap_put(t, idx, t->heap[child]);
+        idx = child;
+    }
+    timer_timeouts_heap_put(t, idx, timeout);
+}
+
+static inline void timer_timeouts_remove_at(timer_timeouts_t *t, uint32_t idx)
+{
+    timer_timeout_t removed = t->heap[idx];
+    t->heap_pos[removed.ch][removed.id] = 0;
+
+    t->num_armed--;
+    if (idx == t->num_armed) {
+        return;
+    }
+
+    /* Fill the hole with the last timeout, which may need to move either way */
+    timer_timeouts_heap_put(t, idx, t->heap[t->num_armed]);
+    if (idx > 0 && t->heap[idx].latest < t->heap[(idx - 1) / 2].latest) {
+        timer_timeouts_sift_up(t, idx);
+    } else {
+        timer_timeouts_sift_down(t, idx);
+    }
+}
+
+static inline void timer_timeouts_arm(timer_timeouts_t *t, sddf_channel ch, uint64_t id, uint64_t deadline)
+{
+    uint64_t latest = deadline + t->slack[ch];
+    if (latest < deadline) {
+        latest = UINT64_MAX;
+    }
+
+    uint32_t pos = t->heap_pos[ch][id];
+    if (pos == 0) {
+        pos = ++t->num_armed;
+    } else if (latest >= t->heap[pos - 1].latest) {
+        t->heap[pos - 1].latest = latest;
+        t->heap[pos - 1].deadline = deadline;
+        timer_timeouts_sift_down(t, pos - 1);
+        return;
+    }
+
+    t->heap[pos - 1] = (timer_timeout_t) { latest, deadline, ch, id };
+    timer_timeouts_sift_up(t, pos - 1);
+}
+
+/**
+ * Initialise the timeout bookkeeping with no timeouts armed.
+ *
+ * @param t pointer to the timeouts struct.
+ */
+static inline void timer_timeouts_init(timer_timeouts_t *t)
+{
+    t->num_armed = 0;
+    for (int ch = 0; ch < SDDF_TIMER_MAX_CLIENTS; ch++) {
+        for (int id = 0; id < SDDF_TIMER_MAX_TIMEOUT_IDS; id++) {
+            t->heap_pos[ch][id] = 0;
+            t->period[ch][id] = 0;
+        }
+        t->slack[ch] = 0;
+        t->fired[ch] = 0;
+    }
+}
+
+/**
+ * Arm a client's timeout, replacing its deadline if it is already armed.
+ *
+ * @param t pointer to the timeouts struct.
+ * @param ch channel of the client.
+ * @param id ID of the timeout.
+ * @param deadline absolute deadline of the timeout.
+ *
+ * @return 0 on success, -1 if the channel or timeout ID is invalid.
+ */
+static inline int timer_timeouts_set(timer_timeouts_t *t, sddf_channel ch, uint64_t id, uint64_t deadline)
+{
+    if (ch >= SDDF_TIMER_MAX_CLIENTS || id >= SDDF_TIMER_MAX_TIMEOUT_IDS) {
+        return -1;
+    }
+
+    t->period[ch][id] = 0;
+    timer_timeouts_arm(t, ch, id, deadline);
+    return 0;
+}
+
+/**
+ * Arm a client's periodic timeout, replacing the timeout if it is already
+ * armed. The first deadline is one period from the current time.
+ *
+ * @param t pointer to the timeouts struct.
+ * @param ch channel of the client.
+ * @param id ID of the timeout.
+ * @param curr_time current time.
+ * @param period period of the timeout, rounded up to 1.
+ *
+ * @return 0 on success, -1 if the channel or timeout ID is invalid.
+ */
+static inline int timer_timeouts_set_periodic(timer_timeouts_t *t, sddf_channel ch, uint64_t id, uint64_t curr_time,
+                                              uint64_t period)
+{
+    if (ch >= SDDF_TIMER_MAX_CLIENTS || id >= SDDF_TIMER_MAX_TIMEOUT_IDS) {
+        return -1;
+    }
+
+    t->period[ch][id] = MAX(period, 1);
+    timer_timeouts_arm(t, ch, id, curr_time + t->period[ch][id]);
+    return 0;
+}
+
+/**
+ * Set how late a client's timeouts may expire, so that they can share an
+ * interrupt with other timeouts. Applies to timeouts armed from now on.
+ *
+ * @param t pointer to the timeouts struct.
+ * @param ch channel of the client.
+ * @param slack slack allowed after each deadline.
+ *
+ * @return 0 on success, -1 if the channel is invalid.
+ */
+static inline int timer_timeouts_set_slack(timer_timeouts_t *t, sddf_channel ch, uint64_t slack)
+{
+    if (ch >= SDDF_TIMER_MAX_CLIENTS) {
+        return -1;
+    }
+
+    t->slack[ch] = slack;
+    return 0;
+}
+
+/**
+ * Cancel a client's timeout. Does nothing if it is not armed.
+ *
+ * @param t pointer to the timeouts struct.
+ * @param ch channel of the client.
+ * @param id ID of the timeout.
+ *
+ * @return 0 on success, -1 if the channel or timeout ID is invalid.
+ */
+static inline int timer_timeouts_cancel(timer_timeouts_t *t, sddf_channel ch, uint64_t id)
+{
+    if (ch >= SDDF_TIMER_MAX_CLIENTS || id >= SDDF_TIMER_MAX_TIMEOUT_IDS) {
+        return -1;
+    }
+
+    uint32_t pos = t->heap_pos[ch][id];
+    if (pos != 0) {
+        timer_timeouts_remove_at(t, pos - 1);
+    }
+    t->period[ch][id] = 0;
+    t->fired[ch] &= ~(1ULL << id);
+    return 0;
+}
+
+/**
+ * @param t pointer to the timeouts struct.
+ *
+ * @return time by which the next timeout must expire, UINT64_MAX if none are armed.
+ */
+static inline uint64_t timer_timeouts_next(timer_timeouts_t *t)
+{
+    if (t->num_armed == 0) {
+        return UINT64_MAX;
+    }
+    return t->heap[0].latest;
+}
+
+/**
+ * Expire the timeouts with a deadline at or before the current time and
+ * notify the clients they belong to, once per client. Periodic timeouts are
+ * re-armed, skipping any periods that have already passed.
+ *
+ * @param t pointer to the timeouts struct.
+ * @param curr_time current time.
+ *
+ * @return time by which the next timeout must expire, UINT64_MAX if none are armed.
+ */
+static inline uint64_t timer_timeouts_process(timer_timeouts_t *t, uint64_t curr_time)
+{
+    uint64_t notify = 0;
+    while (t->num_armed > 0 && t->heap[0].deadline <= curr_time) {
+        timer_timeout_t expired = t->heap[0];
+        uint64_t period = t->period[expired.ch][expired.id];
+        if (period == 0) {
+            timer_timeouts_remove_at(t, 0);
+        } else {
+            uint64_t missed = (curr_time - expired.deadline) / period;
+            timer_timeouts_arm(t, expired.ch, expired.id, expired.deadline + (missed + 1) * period);
+        }
+        t->fired[expired.ch] |= 1ULL << expired.id;
+        notify |= 1ULL << expired.ch;
+    }
+
+    /* Not deferred, as this is also called while handling a client's PPC */
+    while (notify) {
+        sddf_channel ch = __builtin_ctzll(notify);
+        notify &= notify - 1;
+        sddf_notify(ch);
+    }
+
+    return timer_timeouts_next(t);
+}
+
+/**
+ * Take the set of a client's timeouts that have expired since it last asked.
+ *
+ * @param t pointer to the timeouts struct.
+ * @param ch channel of the client.
+ *
+ * @return bit mask of timeout IDs that have expired.
+ */
+static inline uint64_t timer_timeouts_take_fired(timer_timeouts_t *t, sddf_channel ch)
+{
+    if (ch >= SDDF_TIMER_MAX_CLIENTS) {
+        return 0;
+    }
+    uint64_t fired = t->fired[ch];
+    t->fired[ch] = 0;
+    return fired;
+}
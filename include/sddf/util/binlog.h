@@ -0,0 +1,108 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Binary logging with deferred formatting.
+ *
+ * Formatting log messages is expensive and the UART is slow, so log calls in
+ * hot paths are usually compiled out. With binary logging, a call site only
+ * records the address of its format string, a timestamp and its raw
+ * arguments into a ring buffer private to the component, costing a handful
+ * of stores. The format strings are placed in their own ELF section, so the
+ * host-side decoder (tools/binlog_decode.py) can reconstruct the messages
+ * from the component's ELF file.
+ *
+ * Arguments are recorded as 64-bit integers, so only integer and pointer
+ * conversions are supported, not floating point. A %s argument is recorded
+ * as a pointer, which the decoder resolves if it points to a constant string
+ * in the ELF file.
+ *
+ * The ring buffer keeps the most recent messages, overwriting the oldest once
+ * full. It can be dumped over serial with sddf_binlog_dump, or read from
+ * memory by a debugger, and fed to the decoder.
+ *
+ * Logging is opt-in per component. To enable it, create a memory region of
+ * SDDF_BINLOG_REGION_SIZE bytes and map it read-write into the component with
+ * setvar_vaddr="binlog_region". Components without the mapping skip all
+ * recording, so the calls can be left in unconditionally.
+ */
+
+#define SDDF_BINLOG_REGION_SIZE 0x10000
+
+#define SDDF_BINLOG_MAGIC 0x474f4c4e49424453ULL /* "SDBINLOG" */
+
+/* Maximum number of arguments of a message */
+#define SDDF_BINLOG_MAX_ARGS 8
+
+typedef struct sddf_binlog {
+    uint64_t magic;
+    /* Words ever written, the next word is written at head % capacity */
+    uint64_t head;
+    /* Word at which the oldest complete message starts */
+    uint64_t tail;
+    /* Number of words in the buffer */
+    uint64_t capacity;
+    uint64_t _reserved[4];
+    /*
+     * Each message is a header word holding the format string address in
+     * the low 56 bits and the number of arguments in the top 8 bits,
+     * followed by a timestamp and the arguments. A zero header marks the
+     * rest of the buffer until it wraps as unused.
+     */
+    uint64_t words[];
+} sddf_binlog_t;
+
+#define SDDF_BINLOG_ARGS_SHIFT 56
+
+/* Patched by Microkit, zero if this component does not have the log buffer mapped */
+extern uintptr_t binlog_region;
+
+/**
+ * Record a message. Use SDDF_BINLOG rather than calling this directly.
+ *
+ * @param fmt format string, in the format string section.
+ * @param num_args number of arguments.
+ * @param args arguments of the message.
+ */
+void sddf_binlog_write(const char *fmt, uint32_t num_args, const uint64_t *args);
+
+/**
+ * Print the log buffer over serial as hex, for tools/binlog_decode.py to
+ * decode from a console log.
+ */
+void sddf_binlog_dump(void);
+
+#define SDDF_BINLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define SDDF_BINLOG_NARGS(...) SDDF_BINLOG_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define SDDF_BINLOG_ARGS_0()
+#define SDDF_BINLOG_ARGS_1(a) , (uint64_t)(a)
+#define SDDF_BINLOG_ARGS_2(a, ...) , (uint64_t)(a) SDDF_BINLOG_ARGS_1(__VA_ARGS__)
+#define SDDF_BINLOG_ARGS_3(a, ...) , (uint64_t)(a) SDDF_BINLOG_ARGS_2(__VA_ARGS__)
+#define SDDF_BINLOG_ARGS_4(a, ...) , (uint64_t)(a) SDDF_BINLOG_ARGS_3(__VA_ARGS__)
+#define SDDF_BINLOG_ARGS_5(a, ...) , (uint64_t)(a) SDDF_BINLOG_ARGS_4(__VA_ARGS__)
+#define SDDF_BINLOG_ARGS_6(a, ...) , (uint64_t)(a) SDDF_BINLOG_ARGS_5(__VA_ARGS__)
+#define SDDF_BINLOG_ARGS_7(a, ...) , (uint64_t)(a) SDDF_BINLOG_ARGS_6(__VA_ARGS__)
+#define SDDF_BINLOG_ARGS_8(a, ...) , (uint64_t)(a) SDDF_BINLOG_ARGS_7(__VA_ARGS__)
+#define SDDF_BINLOG_ARGS__(n, ...) SDDF_BINLOG_ARGS_##n(__VA_ARGS__)
+#define SDDF_BINLOG_ARGS_(n, ...) SDDF_BINLOG_ARGS__(n, ##__VA_ARGS__)
+
+/**
+ * Record a message with printf-style format string and up to
+ * SDDF_BINLOG_MAX_ARGS integer or pointer arguments.
+ */
+#define SDDF_BINLOG(fmt, ...)                                                                                          \
+    do {                                                                                                               \
+        if (binlog_region) {                                                                                           \
+            static const char _binlog_fmt[] __attribute__((section(".sddf_binlog_fmt"), used)) = fmt;                \
+            const uint64_t _binlog_args[] = { 0 SDDF_BINLOG_ARGS_(SDDF_BINLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__) };    \
+            sddf_binlog_write(_binlog_fmt, SDDF_BINLOG_NARGS(__VA_ARGS__), &_binlog_args[1]);                          \
+        }                                                                                                              \
+    } while (0)
@@ -105,4 +105,48 @@ void bitarray_clear_region(bitarray_t *bitarr, bit_index_t start, bit_index_t le
  * @return true if the two regions are equal, false otherwise.
  */
 bool bitarray_cmp_region(bitarray_t *bitarr1, bit_index_t start1, bitarray_t *bitarr2, bit_index_t start2,
-                         bit_index_t len);
\ No newline at end of file
+                         bit_index_t len);
+
+/**
+ * Find the first set bit in a specific region of the bit array.
+ *
+ * @param bitarr pointer to the bitarray struct.
+ * @param start starting index of the region.
+ * @param len length of the region.
+ * @return index of the first set bit, start + len if no bit in the region is set.
+ */
+bit_index_t bitarray_find_first_set(bitarray_t *bitarr, bit_index_t start, bit_index_t len);
+
+/**
+ * Find the first clear bit in a specific region of the bit array.
+ *
+ * @param bitarr pointer to the bitarray struct.
+ * @param start starting index of the region.
+ * @param len length of the region.
+ * @return index of the first clear bit, start + len if no bit in the region is clear.
+ */
+bit_index_t bitarray_find_first_clear(bitarray_t *bitarr, bit_index_t start, bit_index_t len);
+
+/**
+ * Find the first run of count consecutive set bits lying entirely within a
+ * specific region of the bit array.
+ *
+ * @param bitarr pointer to the bitarray struct.
+ * @param start starting index of the region.
+ * @param len length of the region.
+ * @param count number of consecutive set bits to find.
+ * @param index pointer to the index of the first bit of the run.
+ * @return true if a run was found, false otherwise.
+ */
+bool bitarray_find_run(bitarray_t *bitarr, bit_index_t start, bit_index_t len, bit_index_t count,
+                       bit_index_t *index);
+
+/**
+ * Count the set bits in a specific region of the bit array.
+ *
+ * @param bitarr pointer to the bitarray struct.
+ * @param start starting index of the region.
+ * @param len length of the region.
+ * @return number of set bits in the region.
+ */
+bit_index_t bitarray_popcount(bitarray_t *bitarr, bit_index_t start, bit_index_t len);
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Boot-time profiling.
+ *
+ * Components record timestamped milestones of their initialisation into a
+ * trace buffer shared between all protection domains of the system. Once the
+ * system has booted, any component can print the trace as a waterfall,
+ * showing where boot time goes and which bring-up steps waited on each other.
+ *
+ * Tracing is opt-in per system. To enable it, create a memory region of
+ * BOOT_TRACE_REGION_SIZE bytes and map it read-write into each component that
+ * should be traced, with setvar_vaddr="boot_trace_region". Components without
+ * the mapping skip all recording, so the calls can be left in unconditionally.
+ *
+ * Timestamps come from the architectural counter, see sddf/util/timestamp.h.
+ */
+
+#define BOOT_TRACE_REGION_SIZE 0x4000
+
+#define BOOT_TRACE_PD_NAME_LEN 20
+#define BOOT_TRACE_NAME_LEN 28
+
+typedef enum boot_trace_kind {
+    /* A step of initialisation starts */
+    BOOT_TRACE_BEGIN = 1,
+    /* A step of initialisation finishes */
+    BOOT_TRACE_END,
+    /* A single point in time */
+    BOOT_TRACE_MARK,
+} boot_trace_kind_t;
+
+typedef struct boot_trace_event {
+    uint64_t timestamp;
+    /* Non-zero once the event has been completely written */
+    uint32_t valid;
+    uint32_t kind;
+    char pd[BOOT_TRACE_PD_NAME_LEN];
+    char name[BOOT_TRACE_NAME_LEN];
+} boot_trace_event_t;
+_Static_assert(sizeof(boot_trace_event_t) == 64, "boot trace events are expected to be 64 bytes");
+
+typedef struct boot_trace {
+    /* Number of event slots claimed, may exceed BOOT_TRACE_MAX_EVENTS if the buffer overflowed */
+    uint32_t num_events;
+    uint8_t _reserved[60];
+    boot_trace_event_t events[];
+} boot_trace_t;
+
+#define BOOT_TRACE_MAX_EVENTS ((BOOT_TRACE_REGION_SIZE - sizeof(boot_trace_t)) / sizeof(boot_trace_event_t))
+
+/* Patched by Microkit, zero if this component does not have the trace buffer mapped */
+extern uintptr_t boot_trace_region;
+
+/**
+ * Record an event into the boot trace buffer. Safe to call concurrently from
+ * components on different cores.
+ *
+ * @param kind kind of event.
+ * @param name name of the initialisation step, truncated to fit.
+ */
+void boot_trace_record(boot_trace_kind_t kind, const char *name);
+
+/**
+ * Record the start of a step of initialisation. Each step should be ended
+ * with boot_trace_end using the same name.
+ */
+static inline void boot_trace_begin(const char *name)
+{
+    boot_trace_record(BOOT_TRACE_BEGIN, name);
+}
+
+/**
+ * Record the end of a step of initialisation.
+ */
+static inline void boot_trace_end(const char *name)
+{
+    boot_trace_record(BOOT_TRACE_END, name);
+}
+
+/**
+ * Record a point in time, e.g. when a component was told a device is ready.
+ */
+static inline void boot_trace_mark(const char *name)
+{
+    boot_trace_record(BOOT_TRACE_MARK, name);
+}
+
+/**
+ * Print the boot trace as a waterfall, relative to the earliest event.
+ *
+ * Each step is printed with its start time, duration and a bar showing where
+ * it falls on the boot timeline. Steps that started within
+ * BOOT_TRACE_SERIAL_THRESHOLD_US of another component's step finishing are
+ * reported as serialised waits, these are the candidates for being
+ * parallelised or made asynchronous.
+ *
+ * Does nothing if this component does not have the trace buffer mapped.
+ */
+void boot_trace_report(void);
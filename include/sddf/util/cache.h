@@ -33,3 +33,15 @@ void cache_clean_and_invalidate(unsigned long start, unsigned long end);
  * On RISC-V, this is a no-op.
  */
 void cache_clean(unsigned long start, unsigned long end);
+
+/*
+ * Cleans num_rows rows of row_len bytes, the first starting at start and
+ * each following one stride bytes after the previous. Only the cache lines
+ * covering the rows are cleaned, with a single barrier at the end, so a
+ * rectangle within a larger image can be cleaned without cleaning the rest
+ * of the image.
+ *
+ * On ARM, this operation ultimately performs the 'dc cvac' instruction.
+ * On RISC-V, this is a no-op.
+ */
+void cache_clean_rows(unsigned long start, unsigned long row_len, unsigned long stride, unsigned long num_rows);
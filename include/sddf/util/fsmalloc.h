@@ -11,27 +11,29 @@
 
 /**
  * This file handles the allocation and freeing of fixed size data cells in a memory region.
- * The allocator uses a really simple algorithm, it stores a memory region offset that is incremented
- * on allocation of a cell. The allocator does not handle fragmentation, it will only check for
- * available cells from the offset. The allocator uses a bit array to keep track of available cells.
+ * The allocator uses a bit array to keep track of available cells. Allocations search for
+ * a run of available cells a word at a time, starting from where the previous allocation
+ * ended and wrapping around to the start of the region, so runs freed anywhere in the
+ * region can be reused. Typical allocations and frees only touch a few words.
  */
 
 /* Data struct that handles allocation and freeing of fixed size data cells in memory region */
 typedef struct fsmalloc {
-    uint64_t avail_bitpos; /* bit position of next available cell */
+    uint64_t avail_bitpos; /* bit position to start searching for available cells from */
     bitarray_t *avail_bitarr; /* bit array representing available data cells */
     uint64_t num_cells; /* number of cells in data region */
+    uint64_t num_free; /* number of available cells in data region */
     uint64_t cell_size; /* number of bytes in a cell */
     uintptr_t base_addr; /* base address of data region */
 } fsmalloc_t;
 
 /**
- * Check if the memory region can fit count more free cells.
+ * Check if the memory region can fit count more contiguous cells.
  *
  * @param fsmalloc pointer to the fsmalloc struct.
  * @param count number of cells to check.
  *
- * @return true indicates the data region is full, false otherwise.
+ * @return true indicates there is no run of count available cells, false otherwise.
  */
 bool fsmalloc_full(fsmalloc_t *fsmalloc, uint64_t count);
 
@@ -42,7 +44,7 @@ bool fsmalloc_full(fsmalloc_t *fsmalloc, uint64_t count);
  * @param addr pointer to base address of the resulting contiguous cell.
  * @param count number of free cells to get.
  *
- * @return -1 when data region is full, 0 on success.
+ * @return -1 when there is no run of count available cells, 0 on success.
  */
 int fsmalloc_alloc(fsmalloc_t *fsmalloc, uintptr_t *addr, uint64_t count);
 
@@ -13,6 +13,10 @@
  * This file provides an "index allocator" implementation that allocates
  * an ID to the caller which can later be to be retrieved and freed.
  * The implementation uses a fixed-size linked list to keep track of free indices.
+ *
+ * By default indices are handed out in FIFO order, so the least recently freed index
+ * is reused first. In LIFO mode the most recently freed index is reused first, which
+ * keeps the descriptors and bookkeeping entries indexed by it warm in the cache.
  */
 
 typedef struct ialloc {
@@ -22,6 +26,7 @@ typedef struct ialloc {
     uint32_t num_free; /* number of free indices */
     uint32_t offset; /* offset to add to the index */
     uint32_t size; /* total number of indices */
+    bool lifo; /* reuse the most recently freed index first */
 } ialloc_t;
 
 /**
@@ -102,6 +107,9 @@ static inline int ialloc_free(ialloc_t *ia, uint32_t id)
         // to stale indices, so we have to restore it here.
         ia->head = id - ia->offset;
         ia->tail = id - ia->offset;
+    } else if (ia->lifo) {
+        ia->idxlist[id - ia->offset] = ia->head;
+        ia->head = id - ia->offset;
     } else {
         ia->idxlist[ia->tail] = id - ia->offset;
         ia->tail = id - ia->offset;
@@ -110,6 +118,49 @@ static inline int ialloc_free(ialloc_t *ia, uint32_t id)
     return 0;
 }
 
+/**
+ * Allocate n free indices at once, e.g. for a chain of descriptors.
+ *
+ * @param ia pointer to the ialloc struct.
+ * @param ids array to store the n indices allocated.
+ * @param n number of indices to allocate.
+ *
+ * @return 0 on success, -1 if fewer than n indices are free, in which case none are allocated.
+ */
+static inline int ialloc_alloc_n(ialloc_t *ia, uint32_t *ids, uint32_t n)
+{
+    if (ia->num_free < n) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        ids[i] = ia->head + ia->offset;
+        ia->head = ia->idxlist[ia->head];
+        ia->idxlist[ids[i] - ia->offset] = -1;
+    }
+    ia->num_free -= n;
+    return 0;
+}
+
+/**
+ * Free n allocated indices at once.
+ *
+ * @param ia pointer to the ialloc struct.
+ * @param ids array of the n active indices to be freed.
+ * @param n number of indices to free.
+ *
+ * @return 0 on success, -1 if any index is invalid. The valid indices are still freed.
+ */
+static inline int ialloc_free_n(ialloc_t *ia, uint32_t *ids, uint32_t n)
+{
+    int err = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (ialloc_free(ia, ids[i])) {
+            err = -1;
+        }
+    }
+    return err;
+}
+
 /**
  * Initialise the index allocator. Allocates indices from 0 to size - 1 inclusive.
  *
@@ -126,6 +177,7 @@ static void ialloc_init(ialloc_t *ia, uint32_t *idxlist, uint32_t size)
     ia->num_free = size;
     ia->size = size;
     ia->offset = 0;
+    ia->lifo = false;
     for (uint32_t i = 0; i < size - 1; i++) {
         ia->idxlist[i] = i + 1;
     }
@@ -145,3 +197,17 @@ static void ialloc_init_with_offset(ialloc_t *ia, uint32_t *idxlist, uint32_t si
     ialloc_init(ia, idxlist, size);
     ia->offset = offset;
 }
+
+/**
+ * Initialise the index allocator in LIFO mode. Allocates indices from 0 to size - 1 inclusive,
+ * reusing the most recently freed index first.
+ *
+ * @param ia pointer to the ialloc struct.
+ * @param idxlist pointer to the linked list array storing the next free index.
+ * @param size number of indices that can be allocated.
+ */
+static void ialloc_init_lifo(ialloc_t *ia, uint32_t *idxlist, uint32_t size)
+{
+    ialloc_init(ia, idxlist, size);
+    ia->lifo = true;
+}
@@ -60,9 +60,15 @@ extern "C" {
  */
 void _sddf_putchar(char character);
 
+/**
+ * Called at the end of each printf, so that the output device can publish the characters of a
+ * printf call as one batch rather than one at a time.
+ */
+void _sddf_putchar_batch_end(void);
+
 /**
  * Transmits a character at a time to the serial tx virtualiser - in contrast to _sddf_putchar
- * which multiplexes on a flush character. Ensure to call serial_putchar_init before using this function
+ * which batches output. Ensure to call serial_putchar_init before using this function
  * @param character Character to output.
  */
 void sddf_putchar_unbuffered(char character);
@@ -76,6 +82,23 @@ void sddf_putchar_unbuffered(char character);
  */
 void serial_putchar_init(sddf_channel serial_tx_ch, serial_queue_handle_t *serial_tx_queue_handle);
 
+/**
+ * Make all buffered output visible to the serial tx virtualiser and notify it.
+ */
+void serial_putchar_flush(void);
+
+/**
+ * @brief Defer notifying the serial tx virtualiser of output by up to delay_ns, so that many
+ * lines printed close together cost one notification and partial lines are not held back
+ * indefinitely. Output is still flushed immediately once enough of it is buffered. The component
+ * must call serial_putchar_flush when notified by the timer.
+ *
+ * @param timer_ch Microkit channel of the timer driver.
+ * @param timeout_id ID of the timeout to use, not used by the component for anything else.
+ * @param delay_ns Longest time in nanoseconds a complete line is held back.
+ */
+void serial_putchar_set_flush_timer(sddf_channel timer_ch, uint64_t timeout_id, uint64_t delay_ns);
+
 /**
  * Tiny printf implementation
  * You have to implement _putchar if you use printf()
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Cheap, monotonic timestamps read directly from the architectural counter,
+ * for measuring how long things take without needing a timer driver.
+ *
+ * On AArch64 this is the generic timer's physical counter, which requires the
+ * kernel to export it to user-level (KernelArmExportPCNTUser, enabled by the
+ * Microkit SDK). On RISC-V this is the 'time' CSR.
+ *
+ * Timestamps are only comparable with each other on the same system, they
+ * have no relation to the time given by the timer driver.
+ */
+
+#if defined(__riscv)
+/* The timebase frequency is not discoverable from user-level, this is the value for QEMU virt */
+#ifndef SDDF_TIMESTAMP_RISCV_FREQ
+#define SDDF_TIMESTAMP_RISCV_FREQ 10000000ULL
+#endif
+#endif
+
+/**
+ * @return current value of the architectural counter.
+ */
+static inline uint64_t sddf_timestamp(void)
+{
+    uint64_t ticks;
+#if defined(__aarch64__)
+    asm volatile("isb; mrs %0, cntpct_el0" : "=r"(ticks) :: "memory");
+#elif defined(__riscv)
+    asm volatile("rdtime %0" : "=r"(ticks) :: "memory");
+#else
+    ticks = 0;
+#endif
+    return ticks;
+}
+
+/**
+ * @return frequency of the architectural counter in Hz, 0 if unknown.
+ */
+static inline uint64_t sddf_timestamp_freq(void)
+{
+#if defined(__aarch64__)
+    uint64_t freq;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    return freq;
+#elif defined(__riscv)
+    return SDDF_TIMESTAMP_RISCV_FREQ;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Convert a difference between two timestamps to microseconds.
+ *
+ * @param ticks number of counter ticks.
+ * @return ticks in microseconds, 0 if the counter frequency is unknown.
+ */
+static inline uint64_t sddf_timestamp_to_us(uint64_t ticks)
+{
+    uint64_t freq = sddf_timestamp_freq();
+    if (freq == 0) {
+        return 0;
+    }
+    /* Split to avoid overflow for large tick counts */
+    return (ticks / freq) * 1000000 + ((ticks % freq) * 1000000) / freq;
+}
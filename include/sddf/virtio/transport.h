@@ -0,0 +1,587 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sddf/util/util.h>
+#include <sddf/util/printf.h>
+#include <sddf/pci/pci.h>
+#include <sddf/resources/device.h>
+#include <sddf/virtio/virtio.h>
+
+/*
+ * This file provides a transport abstraction for the virtIO drivers, so that
+ * the same driver can be used with either of the following transports from
+ * the virtIO 1.2 specification:
+ *
+ *  - virtIO over MMIO (section 4.2), where the device registers are given
+ *    directly to the driver.
+ *  - virtIO over PCI (section 4.1), 'modern' (non-legacy) interface only. The
+ *    driver is given a mapping of the ECAM window of the PCI host bridge, as
+ *    well as memory to place the BAR containing the virtIO structures at.
+ *
+ * For PCI, the device's vendor specific capabilities are parsed to locate the
+ * common configuration, notification, ISR and device-specific configuration
+ * structures. All of these must live in the same BAR, which is the case for
+ * QEMU and other common device models.
+ *
+ * By default the driver is interrupted via legacy INTx and determines the cause
+ * via the ISR status, which mirrors the InterruptStatus register of MMIO. Each
+ * virtqueue can instead be assigned its own MSI-X vector, see
+ * virtio_transport_msix_enable and virtio_transport_queue_setup.
+ */
+
+/* Interrupt causes, the same for the MMIO InterruptStatus and the PCI ISR status */
+#define VIRTIO_IRQ_VQUEUE VIRTIO_MMIO_IRQ_VQUEUE
+#define VIRTIO_IRQ_CONFIG VIRTIO_MMIO_IRQ_CONFIG
+
+#define VIRTIO_PCI_VENDOR_ID 0x1af4
+/* Modern devices have a PCI device ID of 0x1040 + virtIO device ID */
+#define VIRTIO_PCI_MODERN_DEVICE_ID_BASE 0x1040
+
+/* Transitional PCI device IDs, 4.1.2.3 */
+#define VIRTIO_PCI_TRANSITIONAL_NET 0x1000
+#define VIRTIO_PCI_TRANSITIONAL_BLK 0x1001
+#define VIRTIO_PCI_TRANSITIONAL_CONSOLE 0x1003
+
+/* virtio_pci_cap cfg_type values, 4.1.4 */
+#define VIRTIO_PCI_CAP_COMMON_CFG 1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG 2
+#define VIRTIO_PCI_CAP_ISR_CFG 3
+#define VIRTIO_PCI_CAP_DEVICE_CFG 4
+
+/* Layout of struct virtio_pci_cap, relative to the start of the capability */
+#define VIRTIO_PCI_CAP_CFG_TYPE 3
+#define VIRTIO_PCI_CAP_BAR 4
+#define VIRTIO_PCI_CAP_OFFSET 8
+#define VIRTIO_PCI_CAP_LENGTH 12
+/* struct virtio_pci_notify_cap has the multiplier after the generic fields */
+#define VIRTIO_PCI_CAP_NOTIFY_OFF_MULTIPLIER 16
+
+/* Written to an MSI-X vector field to disable MSI-X for that event source */
+#define VIRTIO_MSI_NO_VECTOR 0xffff
+
+/* Maximum number of virtqueues a driver may set up through the transport */
+#define VIRTIO_TRANSPORT_MAX_QUEUES 32
+
+/* 4.1.4.3 Common configuration structure layout */
+typedef volatile struct virtio_pci_common_cfg {
+    uint32_t device_feature_select;
+    uint32_t device_feature;
+    uint32_t driver_feature_select;
+    uint32_t driver_feature;
+    uint16_t config_msix_vector;
+    uint16_t num_queues;
+    uint8_t device_status;
+    uint8_t config_generation;
+    uint16_t queue_select;
+    uint16_t queue_size;
+    uint16_t queue_msix_vector;
+    uint16_t queue_enable;
+    uint16_t queue_notify_off;
+    /* 64-bit fields are accessed as two 32-bit halves, as allowed in 4.1.3.1 */
+    uint32_t queue_desc_low;
+    uint32_t queue_desc_high;
+    uint32_t queue_driver_low;
+    uint32_t queue_driver_high;
+    uint32_t queue_device_low;
+    uint32_t queue_device_high;
+} virtio_pci_common_cfg_t;
+
+typedef enum {
+    VIRTIO_TRANSPORT_MMIO,
+    VIRTIO_TRANSPORT_PCI,
+} virtio_transport_type_t;
+
+typedef struct virtio_transport {
+    virtio_transport_type_t type;
+    /* MMIO transport */
+    volatile virtio_mmio_regs_t *mmio;
+    /* PCI transport */
+    pci_function_t pci;
+    uint8_t pci_bar;
+    uintptr_t pci_bar_vaddr;
+    virtio_pci_common_cfg_t *common;
+    volatile uint8_t *isr;
+    volatile void *device_cfg;
+    uintptr_t notify_base;
+    uint32_t notify_off_multiplier;
+    /* Offset of the MSI-X capability, 0 if the function does not have one */
+    uint8_t msix_cap;
+    pci_msix_entry_t *msix_table;
+    uint16_t msix_table_size;
+    /* Address to write the queue index to in order to notify each queue */
+    volatile uint16_t *queue_notify[VIRTIO_TRANSPORT_MAX_QUEUES];
+} virtio_transport_t;
+
+/**
+ * Initialise the MMIO transport and check that the device is a non-legacy
+ * device of the expected type.
+ *
+ * @param t transport to initialise.
+ * @param regs virtual address of the virtIO MMIO registers.
+ * @param id expected virtIO device ID.
+ *
+ * @return 0 on success, -1 if the device is not the expected device.
+ */
+static inline int virtio_transport_mmio_init(virtio_transport_t *t, uintptr_t regs, virtio_device_id_t id)
+{
+    t->type = VIRTIO_TRANSPORT_MMIO;
+    t->mmio = (volatile virtio_mmio_regs_t *)regs;
+
+    /* Do MMIO device init (section 4.2.3.1) */
+    if (!virtio_mmio_check_magic(t->mmio)) {
+        sddf_dprintf("VIRTIO TRANSPORT|ERROR: invalid virtIO magic value!\n");
+        return -1;
+    }
+
+    if (virtio_mmio_version(t->mmio) != VIRTIO_VERSION) {
+        sddf_dprintf("VIRTIO TRANSPORT|ERROR: not correct virtIO version: 0x%x\n", virtio_mmio_version(t->mmio));
+        return -1;
+    }
+
+    if (!virtio_mmio_check_device_id(t->mmio, id)) {
+        sddf_dprintf("VIRTIO TRANSPORT|ERROR: expected device ID 0x%x, got 0x%x\n", id, t->mmio->DeviceID);
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline bool virtio_pci_match(uint16_t vendor, uint16_t device, uint32_t class_code, void *arg)
+{
+    virtio_device_id_t id = *(virtio_device_id_t *)arg;
+    if (vendor != VIRTIO_PCI_VENDOR_ID) {
+        return false;
+    }
+    if (device == VIRTIO_PCI_MODERN_DEVICE_ID_BASE + id) {
+        return true;
+    }
+
+    /* Transitional devices also provide the modern interface */
+    switch (id) {
+    case VIRTIO_DEVICE_ID_NET:
+        return device == VIRTIO_PCI_TRANSITIONAL_NET;
+    case VIRTIO_DEVICE_ID_BLK:
+        return device == VIRTIO_PCI_TRANSITIONAL_BLK;
+    case VIRTIO_DEVICE_ID_CONSOLE:
+        return device == VIRTIO_PCI_TRANSITIONAL_CONSOLE;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Initialise the PCI transport. Finds the first virtIO PCI function of the
+ * expected type, places the BAR holding the virtIO structures at the given
+ * memory and enables the function with INTx interrupts.
+ *
+ * @param t transport to initialise.
+ * @param ecam_vaddr virtual address of the ECAM window.
+ * @param ecam_size size of the ECAM mapping.
+ * @param bar_vaddr virtual address the BAR is mapped at.
+ * @param bar_io_addr bus address to place the BAR at.
+ * @param bar_size size of the BAR mapping.
+ * @param id expected virtIO device ID.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static inline int virtio_transport_pci_init(virtio_transport_t *t, uintptr_t ecam_vaddr, uint64_t ecam_size,
+                                            uintptr_t bar_vaddr, uint64_t bar_io_addr, uint64_t bar_size,
+                                            virtio_device_id_t id)
+{
+    t->type = VIRTIO_TRANSPORT_PCI;
+
+    if (!pci_find_function(ecam_vaddr, ecam_size, virtio_pci_match, &id, &t->pci)) {
+        sddf_dprintf("VIRTIO TRANSPORT|ERROR: could not find virtIO PCI device with device ID 0x%x\n", id);
+        return -1;
+    }
+
+    /* Find the first capability of each type we need, 4.1.4 */
+    int32_t bar = -1;
+    uint32_t cfg_offsets[VIRTIO_PCI_CAP_DEVICE_CFG + 1] = { 0 };
+    bool found[VIRTIO_PCI_CAP_DEVICE_CFG + 1] = { false };
+    uint8_t notify_cap = 0;
+    for (uint8_t cap = pci_find_capability(&t->pci, PCI_CAP_ID_VENDOR, 0); cap != 0;
+         cap = pci_find_capability(&t->pci, PCI_CAP_ID_VENDOR, cap)) {
+        uint8_t cfg_type = pci_cfg_read8(&t->pci, cap + VIRTIO_PCI_CAP_CFG_TYPE);
+        if (cfg_type < VIRTIO_PCI_CAP_COMMON_CFG || cfg_type > VIRTIO_PCI_CAP_DEVICE_CFG || found[cfg_type]) {
+            continue;
+        }
+
+        uint8_t cap_bar = pci_cfg_read8(&t->pci, cap + VIRTIO_PCI_CAP_BAR);
+        if (bar != -1 && cap_bar != bar) {
+            sddf_dprintf("VIRTIO TRANSPORT|ERROR: virtIO structures spread across multiple BARs\n");
+            return -1;
+        }
+        bar = cap_bar;
+
+        found[cfg_type] = true;
+        cfg_offsets[cfg_type] = pci_cfg_read32(&t->pci, cap + VIRTIO_PCI_CAP_OFFSET);
+        if (cfg_type == VIRTIO_PCI_CAP_NOTIFY_CFG) {
+            notify_cap = cap;
+        }
+    }
+
+    if (!found[VIRTIO_PCI_CAP_COMMON_CFG] || !found[VIRTIO_PCI_CAP_NOTIFY_CFG] || !found[VIRTIO_PCI_CAP_ISR_CFG]) {
+        sddf_dprintf("VIRTIO TRANSPORT|ERROR: device is missing virtIO PCI capabilities\n");
+        return -1;
+    }
+
+    uint64_t size = pci_bar_assign(&t->pci, bar, bar_io_addr);
+    if (size == 0 || size > bar_size) {
+        sddf_dprintf("VIRTIO TRANSPORT|ERROR: BAR%d of size 0x%lx does not fit in mapping of size 0x%lx\n", bar, size,
+                     bar_size);
+        return -1;
+    }
+
+    t->pci_bar = bar;
+    t->pci_bar_vaddr = bar_vaddr;
+    t->common = (virtio_pci_common_cfg_t *)(bar_vaddr + cfg_offsets[VIRTIO_PCI_CAP_COMMON_CFG]);
+    t->isr = (volatile uint8_t *)(bar_vaddr + cfg_offsets[VIRTIO_PCI_CAP_ISR_CFG]);
+    t->notify_base = bar_vaddr + cfg_offsets[VIRTIO_PCI_CAP_NOTIFY_CFG];
+    t->notify_off_multiplier = pci_cfg_read32(&t->pci, notify_cap + VIRTIO_PCI_CAP_NOTIFY_OFF_MULTIPLIER);
+    if (found[VIRTIO_PCI_CAP_DEVICE_CFG]) {
+        t->device_cfg = (volatile void *)(bar_vaddr + cfg_offsets[VIRTIO_PCI_CAP_DEVICE_CFG]);
+    } else {
+        t->device_cfg = NULL;
+    }
+
+    t->msix_cap = pci_find_capability(&t->pci, PCI_CAP_ID_MSIX, 0);
+    t->msix_table = NULL;
+    t->msix_table_size = 0;
+
+    pci_enable(&t->pci, true);
+
+    return 0;
+}
+
+/**
+ * Initialise the transport from a driver's device resources. Region 0 holds
+ * either the virtIO MMIO registers or, if the driver has been given the extra
+ * region at index bar_region, the ECAM window of the PCI host bridge. In the
+ * latter case the BAR holding the virtIO structures is placed at bar_region.
+ *
+ * @param t transport to initialise.
+ * @param resources device resources of the driver.
+ * @param bar_region index of the region to place the BAR at when using PCI.
+ * @param id expected virtIO device ID.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static inline int virtio_transport_init(virtio_transport_t *t, device_resources_t *resources, uint8_t bar_region,
+                                        virtio_device_id_t id)
+{
+    device_region_resource_t *regs = &resources->regions[0];
+    if (resources->num_regions <= bar_region) {
+        return virtio_transport_mmio_init(t, (uintptr_t)regs->region.vaddr, id);
+    }
+
+    device_region_resource_t *bar = &resources->regions[bar_region];
+    return virtio_transport_pci_init(t, (uintptr_t)regs->region.vaddr, regs->region.size, (uintptr_t)bar->region.vaddr,
+                                     bar->io_addr, bar->region.size, id);
+}
+
+/**
+ * Switch the device from INTx to MSI-X interrupts. Every vector starts out
+ * masked until it is programmed with virtio_transport_msix_set_vector.
+ *
+ * The MSI-X table may live in a different BAR to the virtIO structures, in
+ * which case that BAR is placed at the given memory.
+ *
+ * @param t transport, must be PCI.
+ * @param table_bar_vaddr virtual address the MSI-X table BAR is mapped at.
+ * @param table_bar_io_addr bus address to place the MSI-X table BAR at.
+ * @param table_bar_size size of the MSI-X table BAR mapping.
+ *
+ * @return number of vectors available, 0 on failure.
+ */
+static inline uint16_t virtio_transport_msix_enable(virtio_transport_t *t, uintptr_t table_bar_vaddr,
+                                                    uint64_t table_bar_io_addr, uint64_t table_bar_size)
+{
+    if (t->type != VIRTIO_TRANSPORT_PCI || t->msix_cap == 0) {
+        return 0;
+    }
+
+    pci_function_t *fn = &t->pci;
+    uint32_t table = pci_cfg_read32(fn, t->msix_cap + PCI_MSIX_TABLE);
+    uint8_t bir = table & PCI_MSIX_BIR_MASK;
+    uint32_t table_offset = table & ~PCI_MSIX_BIR_MASK;
+    uint16_t ctrl = pci_cfg_read16(fn, t->msix_cap + PCI_MSIX_CTRL);
+    uint16_t num_vectors = (ctrl & PCI_MSIX_CTRL_TABLE_SIZE_MASK) + 1;
+
+    uintptr_t table_base;
+    if (bir == t->pci_bar) {
+        table_base = t->pci_bar_vaddr;
+    } else {
+        uint64_t size = pci_bar_assign(fn, bir, table_bar_io_addr);
+        if (size == 0 || size > table_bar_size) {
+            sddf_dprintf("VIRTIO TRANSPORT|ERROR: could not place MSI-X table BAR%u\n", bir);
+            return 0;
+        }
+        table_base = table_bar_vaddr;
+        pci_enable(fn, true);
+    }
+
+    t->msix_table = (pci_msix_entry_t *)(table_base + table_offset);
+    t->msix_table_size = num_vectors;
+    for (uint16_t i = 0; i < num_vectors; i++) {
+        t->msix_table[i].vector_ctrl = PCI_MSIX_VECTOR_CTRL_MASKED;
+    }
+
+    pci_cfg_write16(fn, t->msix_cap + PCI_MSIX_CTRL, (ctrl | PCI_MSIX_CTRL_ENABLE) & ~PCI_MSIX_CTRL_FUNCTION_MASK);
+    pci_enable(fn, false);
+
+    return num_vectors;
+}
+
+/**
+ * Program and unmask an MSI-X vector.
+ *
+ * @param t transport, must have MSI-X enabled.
+ * @param vector index of the vector in the MSI-X table.
+ * @param addr address the device writes to, e.g. the GICv2m/ITS doorbell.
+ * @param data value the device writes, identifying the interrupt.
+ */
+static inline void virtio_transport_msix_set_vector(virtio_transport_t *t, uint16_t vector, uint64_t addr,
+                                                    uint32_t data)
+{
+    assert(vector < t->msix_table_size);
+    pci_msix_entry_t *entry = &t->msix_table[vector];
+    entry->addr_low = (uint32_t)addr;
+    entry->addr_high = (uint32_t)(addr >> 32);
+    entry->data = data;
+    entry->vector_ctrl = 0;
+}
+
+static inline uint8_t virtio_transport_get_status(virtio_transport_t *t)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        return t->mmio->Status;
+    }
+    return t->common->device_status;
+}
+
+static inline void virtio_transport_set_status(virtio_transport_t *t, uint8_t status)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        t->mmio->Status = status;
+    } else {
+        t->common->device_status = status;
+    }
+}
+
+/**
+ * Reset the device and set the ACKNOWLEDGE and DRIVER status bits (section 3.1.1).
+ */
+static inline void virtio_transport_reset(virtio_transport_t *t)
+{
+    virtio_transport_set_status(t, 0);
+    /* A PCI device may take some time to reset, 4.1.4.3.2 */
+    while (virtio_transport_get_status(t) != 0);
+    /* Set the ACKNOWLEDGE bit to say we have noticed the device */
+    virtio_transport_set_status(t, VIRTIO_DEVICE_STATUS_ACKNOWLEDGE);
+    /* Set the DRIVER bit to say we know how to drive the device */
+    virtio_transport_set_status(t, VIRTIO_DEVICE_STATUS_ACKNOWLEDGE | VIRTIO_DEVICE_STATUS_DRIVER);
+}
+
+static inline uint64_t virtio_transport_device_features(virtio_transport_t *t)
+{
+    uint32_t low, high;
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        t->mmio->DeviceFeaturesSel = 0;
+        low = t->mmio->DeviceFeatures;
+        t->mmio->DeviceFeaturesSel = 1;
+        high = t->mmio->DeviceFeatures;
+    } else {
+        t->common->device_feature_select = 0;
+        low = t->common->device_feature;
+        t->common->device_feature_select = 1;
+        high = t->common->device_feature;
+    }
+
+    return low | ((uint64_t)high << 32);
+}
+
+/**
+ * Write the features the driver accepts and set FEATURES_OK (section 3.1.1).
+ *
+ * @return 0 if the device accepted the features, -1 otherwise.
+ */
+static inline int virtio_transport_set_driver_features(virtio_transport_t *t, uint64_t features)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        t->mmio->DriverFeaturesSel = 0;
+        t->mmio->DriverFeatures = (uint32_t)features;
+        t->mmio->DriverFeaturesSel = 1;
+        t->mmio->DriverFeatures = (uint32_t)(features >> 32);
+    } else {
+        t->common->driver_feature_select = 0;
+        t->common->driver_feature = (uint32_t)features;
+        t->common->driver_feature_select = 1;
+        t->common->driver_feature = (uint32_t)(features >> 32);
+    }
+
+    virtio_transport_set_status(t, virtio_transport_get_status(t) | VIRTIO_DEVICE_STATUS_FEATURES_OK);
+    if (!(virtio_transport_get_status(t) & VIRTIO_DEVICE_STATUS_FEATURES_OK)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Set DRIVER_OK, after which the device is live (section 3.1.1).
+ */
+static inline void virtio_transport_driver_ok(virtio_transport_t *t)
+{
+    virtio_transport_set_status(t, virtio_transport_get_status(t) | VIRTIO_DEVICE_STATUS_DRIVER_OK);
+}
+
+/**
+ * @return pointer to the device-specific configuration structure.
+ */
+static inline volatile void *virtio_transport_config(virtio_transport_t *t)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        return (volatile void *)t->mmio->Config;
+    }
+    return t->device_cfg;
+}
+
+/**
+ * @return maximum size of the given virtqueue supported by the device, 0 if
+ * the queue does not exist.
+ */
+static inline uint32_t virtio_transport_queue_max(virtio_transport_t *t, uint16_t queue)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        t->mmio->QueueSel = queue;
+        return t->mmio->QueueNumMax;
+    }
+
+    if (queue >= t->common->num_queues) {
+        return 0;
+    }
+    t->common->queue_select = queue;
+    /* Before the queue is set up, queue_size holds the maximum size */
+    return t->common->queue_size;
+}
+
+/**
+ * Give the device a virtqueue and enable it.
+ *
+ * @param t transport.
+ * @param queue index of the virtqueue.
+ * @param num number of entries in the virtqueue.
+ * @param desc_paddr physical address of the descriptor table.
+ * @param driver_paddr physical address of the available ring.
+ * @param device_paddr physical address of the used ring.
+ * @param msix_vector MSI-X vector to use for the virtqueue, VIRTIO_MSI_NO_VECTOR
+ *                    for none. Ignored for the MMIO transport.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static inline int virtio_transport_queue_setup(virtio_transport_t *t, uint16_t queue, uint16_t num,
+                                               uint64_t desc_paddr, uint64_t driver_paddr, uint64_t device_paddr,
+                                               uint16_t msix_vector)
+{
+    if (queue >= VIRTIO_TRANSPORT_MAX_QUEUES || virtio_transport_queue_max(t, queue) < num) {
+        return -1;
+    }
+
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        volatile virtio_mmio_regs_t *regs = t->mmio;
+        regs->QueueSel = queue;
+        regs->QueueNum = num;
+        regs->QueueDescLow = desc_paddr & 0xFFFFFFFF;
+        regs->QueueDescHigh = desc_paddr >> 32;
+        regs->QueueDriverLow = driver_paddr & 0xFFFFFFFF;
+        regs->QueueDriverHigh = driver_paddr >> 32;
+        regs->QueueDeviceLow = device_paddr & 0xFFFFFFFF;
+        regs->QueueDeviceHigh = device_paddr >> 32;
+        regs->QueueReady = 1;
+        return 0;
+    }
+
+    virtio_pci_common_cfg_t *common = t->common;
+    common->queue_select = queue;
+    common->queue_size = num;
+    common->queue_desc_low = desc_paddr & 0xFFFFFFFF;
+    common->queue_desc_high = desc_paddr >> 32;
+    common->queue_driver_low = driver_paddr & 0xFFFFFFFF;
+    common->queue_driver_high = driver_paddr >> 32;
+    common->queue_device_low = device_paddr & 0xFFFFFFFF;
+    common->queue_device_high = device_paddr >> 32;
+
+    common->queue_msix_vector = msix_vector;
+    /* The device reports a failure to allocate the vector by reading back NO_VECTOR, 4.1.5.1.2 */
+    if (common->queue_msix_vector != msix_vector) {
+        sddf_dprintf("VIRTIO TRANSPORT|ERROR: could not assign MSI-X vector %u to queue %u\n", msix_vector, queue);
+        return -1;
+    }
+
+    /* 4.1.4.4 Notification address is cap.offset + queue_notify_off * notify_off_multiplier */
+    t->queue_notify[queue] = (volatile uint16_t *)(t->notify_base
+                                                   + (uintptr_t)common->queue_notify_off * t->notify_off_multiplier);
+    common->queue_enable = 1;
+
+    return 0;
+}
+
+/**
+ * Use the given MSI-X vector for configuration change notifications.
+ *
+ * @return 0 on success, -1 if the device could not allocate the vector.
+ */
+static inline int virtio_transport_config_vector(virtio_transport_t *t, uint16_t msix_vector)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        return 0;
+    }
+    t->common->config_msix_vector = msix_vector;
+    return t->common->config_msix_vector == msix_vector ? 0 : -1;
+}
+
+/**
+ * Notify the device of new buffers in the given virtqueue.
+ * This assumes VIRTIO_F_NOTIFICATION_DATA has not been negotiated.
+ */
+static inline void virtio_transport_queue_notify(virtio_transport_t *t, uint16_t queue)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        t->mmio->QueueNotify = queue;
+    } else {
+        *t->queue_notify[queue] = queue;
+    }
+}
+
+/**
+ * Read the cause of an INTx interrupt. On PCI, reading the ISR status also
+ * de-asserts the interrupt.
+ *
+ * @return bitmask of VIRTIO_IRQ_VQUEUE and VIRTIO_IRQ_CONFIG.
+ */
+static inline uint32_t virtio_transport_irq_status(virtio_transport_t *t)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        return t->mmio->InterruptStatus;
+    }
+    return *t->isr;
+}
+
+/**
+ * Acknowledge the given interrupt causes once they have been handled.
+ */
+static inline void virtio_transport_irq_ack(virtio_transport_t *t, uint32_t status)
+{
+    if (t->type == VIRTIO_TRANSPORT_MMIO) {
+        t->mmio->InterruptACK = status;
+    }
+    /* Nothing to do for PCI, the read of the ISR status was the acknowledgement */
+}
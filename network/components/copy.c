@@ -7,16 +7,17 @@
 #include <os/sddf.h>
 #include <sddf/network/queue.h>
 #include <sddf/network/config.h>
+#include <sddf/network/copy.h>
 #include <sddf/util/string.h>
 #include <sddf/util/util.h>
 #include <sddf/util/printf.h>
 
-__attribute__((__section__(".net_copy_config"))) net_copy_config_t config;
+__attribute__((__section__(".net_copy_config"))) net_copy_config_t net_copy_config;
 
-net_queue_handle_t rx_queue_virt;
-net_queue_handle_t rx_queue_cli;
+static net_queue_handle_t rx_queue_virt;
+static net_queue_handle_t rx_queue_cli;
 
-void rx_return(void)
+bool net_copy_process(void)
 {
     bool enqueued = false;
     bool reprocess = true;
@@ -37,8 +38,8 @@ void rx_return(void)
             err = net_dequeue_active(&rx_queue_virt, &virt_buffer);
             assert(!err);
 
-            void *cli_addr = config.client_data.vaddr + cli_buffer.io_or_offset;
-            void *virt_addr = config.device_data.vaddr + virt_buffer.io_or_offset;
+            void *cli_addr = net_copy_config.client_data.vaddr + cli_buffer.io_or_offset;
+            void *virt_addr = net_copy_config.device_data.vaddr + virt_buffer.io_or_offset;
 
             sddf_memcpy(cli_addr, virt_addr, virt_buffer.len);
             cli_buffer.len = virt_buffer.len;
@@ -55,12 +56,14 @@ void rx_return(void)
 
         net_request_signal_active(&rx_queue_virt);
 
+#ifndef NET_COPY_FUSED
         /* Only request signal from client if incoming packets from multiplexer are awaiting free buffers */
         if (!net_queue_empty_active(&rx_queue_virt)) {
             net_request_signal_free(&rx_queue_cli);
         } else {
             net_cancel_signal_free(&rx_queue_cli);
         }
+#endif
 
         reprocess = false;
 
@@ -71,30 +74,57 @@ void rx_return(void)
         }
     }
 
+#ifndef NET_COPY_FUSED
     if (enqueued && net_require_signal_active(&rx_queue_cli)) {
         net_cancel_signal_active(&rx_queue_cli);
-        sddf_notify(config.client.id);
+        sddf_notify(net_copy_config.client.id);
     }
+#endif
 
     if (enqueued && net_require_signal_free(&rx_queue_virt)) {
         net_cancel_signal_free(&rx_queue_virt);
-        sddf_deferred_notify(config.virt_rx.id);
+        /* When fused, the client may already have a deferred notification pending */
+        sddf_channel curr = sddf_deferred_notify_curr();
+        if (curr == -1) {
+            sddf_deferred_notify(net_copy_config.virt_rx.id);
+        } else if (curr != net_copy_config.virt_rx.id) {
+            sddf_notify(net_copy_config.virt_rx.id);
+        }
     }
+
+    return enqueued;
 }
 
-void notified(sddf_channel ch)
+bool net_copy_notified(sddf_channel ch)
 {
-    rx_return();
+    if (ch != net_copy_config.virt_rx.id) {
+        return false;
+    }
+
+    net_copy_process();
+    return true;
 }
 
-void init(void)
+void net_copy_init(void)
 {
-    assert(net_config_check_magic(&config));
+    assert(net_config_check_magic(&net_copy_config));
     /* Set up the queues */
-    net_queue_init(&rx_queue_cli, config.client.free_queue.vaddr, config.client.active_queue.vaddr,
-                   config.client.num_buffers);
-    net_queue_init(&rx_queue_virt, config.virt_rx.free_queue.vaddr, config.virt_rx.active_queue.vaddr,
-                   config.virt_rx.num_buffers);
+    net_queue_init(&rx_queue_cli, net_copy_config.client.free_queue.vaddr, net_copy_config.client.active_queue.vaddr,
+                   net_copy_config.client.num_buffers);
+    net_queue_init(&rx_queue_virt, net_copy_config.virt_rx.free_queue.vaddr, net_copy_config.virt_rx.active_queue.vaddr,
+                   net_copy_config.virt_rx.num_buffers);
 
     net_buffers_init(&rx_queue_cli, 0);
 }
+
+#ifndef NET_COPY_FUSED
+void notified(sddf_channel ch)
+{
+    net_copy_process();
+}
+
+void init(void)
+{
+    net_copy_init();
+}
+#endif
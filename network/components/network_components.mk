@@ -9,6 +9,8 @@
 #
 # NOTES:
 # Generates network_virt_rx.elf network_virt_tx.elf network_arp.elf network_copy.elf
+# Also provides network/components/network_copy_fused.o, the copier built to be
+# linked into its client rather than run as its own PD (see sddf/network/copy.h)
 # Requires ${SDDF}/util/util.mk to build the utility library for debug output
 
 NETWORK_COMPONENTS_DIR := $(abspath $(dir $(lastword ${MAKEFILE_LIST})))
@@ -16,7 +18,8 @@ NETWORK_IMAGES:= network_virt_rx.elf network_virt_tx.elf network_arp.elf network
 network/components/%.o: ${SDDF}/network/components/%.c
 	${CC} ${CFLAGS} -c -o $@ $<
 
-NETWORK_COMPONENT_OBJ := $(addprefix network/components/, network_copy.o network_arp.o network_virt_tx.o network_virt_rx.o)
+NETWORK_COMPONENT_OBJ := $(addprefix network/components/, network_copy.o network_copy_fused.o network_arp.o \
+			  network_virt_tx.o network_virt_rx.o)
 
 CHECK_NETWORK_FLAGS_MD5:=.network_cflags-$(shell echo -- ${CFLAGS} ${CFLAGS_network} | shasum | sed 's/ *-//')
 
@@ -39,6 +42,9 @@ network/components/network_virt_%.o: ${SDDF}/network/components/virt_%.c
 network/components/network_copy.o: ${SDDF}/network/components/copy.c
 	${CC} ${CFLAGS} -c -o $@ $<
 
+network/components/network_copy_fused.o: ${SDDF}/network/components/copy.c
+	${CC} ${CFLAGS} -DNET_COPY_FUSED -c -o $@ $<
+
 network/components/network_arp.o: ${SDDF}/network/components/arp.c
 	${CC} ${CFLAGS} -c -o $@ $<
 
@@ -46,7 +52,7 @@ network/components/network_arp.o: ${SDDF}/network/components/arp.c
 	${LD} ${LDFLAGS} -o $@ $< ${LIBS}
 
 clean::
-	${RM} -f network_virt_[rt]x.[od] network_copy.[od] network_arp.[od]
+	${RM} -f network_virt_[rt]x.[od] network_copy.[od] network_copy_fused.[od] network_arp.[od]
 
 clobber::
 	${RM} -f ${NETWORK_IMAGES}
@@ -34,6 +34,8 @@ state_t state;
 
 /* Boolean to indicate whether a packet has been enqueued into the driver's free queue during notification handling */
 static bool notify_drv;
+/* Clients and driver to notify once the current event has been handled */
+static sddf_notify_set_t notify_set;
 
 /* Return the client ID if the Mac address is a match to a client, return the broadcast ID if MAC address
   is a broadcast address. */
@@ -129,7 +131,7 @@ void rx_return(void)
     for (int client = 0; client < config.num_clients; client++) {
         if (notify_clients[client] && net_require_signal_active(&state.rx_queue_clients[client])) {
             net_cancel_signal_active(&state.rx_queue_clients[client]);
-            sddf_notify(config.clients[client].conn.id);
+            sddf_notify_set_add(&notify_set, config.clients[client].conn.id);
         }
     }
 }
@@ -177,7 +179,7 @@ void rx_provide(void)
 
     if (notify_drv && net_require_signal_free(&state.rx_queue_drv)) {
         net_cancel_signal_free(&state.rx_queue_drv);
-        sddf_deferred_notify(config.driver.id);
+        sddf_notify_set_add(&notify_set, config.driver.id);
         notify_drv = false;
     }
 }
@@ -186,6 +188,7 @@ void notified(sddf_channel ch)
 {
     rx_return();
     rx_provide();
+    sddf_notify_set_flush(&notify_set);
 }
 
 void init(void)
@@ -19,6 +19,9 @@ typedef struct state {
 
 state_t state;
 
+/* Clients and driver to notify once the current event has been handled */
+static sddf_notify_set_t notify_set;
+
 int extract_offset(uintptr_t *phys)
 {
     for (int client = 0; client < config.num_clients; client++) {
@@ -73,7 +76,7 @@ void tx_provide(void)
 
     if (enqueued && net_require_signal_active(&state.tx_queue_drv)) {
         net_cancel_signal_active(&state.tx_queue_drv);
-        sddf_deferred_notify(config.driver.id);
+        sddf_notify_set_add(&notify_set, config.driver.id);
     }
 }
 
@@ -107,7 +110,7 @@ void tx_return(void)
     for (int client = 0; client < config.num_clients; client++) {
         if (notify_clients[client] && net_require_signal_free(&state.tx_queue_clients[client])) {
             net_cancel_signal_free(&state.tx_queue_clients[client]);
-            sddf_notify(config.clients[client].conn.id);
+            sddf_notify_set_add(&notify_set, config.clients[client].conn.id);
         }
     }
 }
@@ -116,6 +119,7 @@ void notified(sddf_channel ch)
 {
     tx_return();
     tx_provide();
+    sddf_notify_set_flush(&notify_set);
 }
 
 void init(void)
@@ -132,4 +136,5 @@ void init(void)
     }
 
     tx_provide();
+    sddf_notify_set_flush(&notify_set);
 }
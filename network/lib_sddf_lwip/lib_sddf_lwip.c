@@ -12,6 +12,9 @@
 #include <sddf/network/lib_sddf_lwip.h>
 #include <sddf/network/queue.h>
 #include <sddf/network/util.h>
+#ifdef NET_COPY_FUSED
+#include <sddf/network/copy.h>
+#endif
 #include <sddf/timer/client.h>
 #include "lwip/err.h"
 #include "lwip/init.h"
@@ -80,6 +83,9 @@ lwip_state_t lwip_state;
 sddf_state_t sddf_state;
 pbuf_pool_t pbuf_pool;
 
+/* Patched by Microkit, zero if the timer driver's clock page is not mapped */
+uintptr_t timer_clock_page;
+
 pbuf_pool_t pbuf_pool_init(void *mem, size_t mem_size, size_t pbuf_count)
 {
     assert(mem != NULL);
@@ -182,7 +188,7 @@ static net_sddf_err_t handle_empty_tx_free_default(struct pbuf *p)
  */
 uint32_t sys_now(void)
 {
-    return sddf_timer_time_now(sddf_state.timer_ch) / NS_IN_MS;
+    return sddf_timer_clock_now(sddf_state.timer_ch, (sddf_timer_clock_t *)timer_clock_page) / NS_IN_MS;
 }
 
 void sddf_lwip_process_timeout()
@@ -408,6 +414,15 @@ void sddf_lwip_init(lib_sddf_lwip_config_t *lib_sddf_lwip_config, net_client_con
 
 void sddf_lwip_maybe_notify()
 {
+#ifdef NET_COPY_FUSED
+    /* The copier is linked into this PD and has no channel to us, so hand it the freed buffers directly */
+    if (sddf_state.notify_rx) {
+        sddf_state.notify_rx = false;
+        while (net_copy_process()) {
+            sddf_lwip_process_rx();
+        }
+    }
+#else
     if (sddf_state.notify_rx && net_require_signal_free(&sddf_state.rx_queue)) {
         net_cancel_signal_free(&sddf_state.rx_queue);
         sddf_state.notify_rx = false;
@@ -418,6 +433,7 @@ void sddf_lwip_maybe_notify()
             sddf_notify(sddf_state.rx_ch);
         }
     }
+#endif
 
     if (sddf_state.notify_tx && net_require_signal_active(&sddf_state.tx_queue)) {
         net_cancel_signal_active(&sddf_state.tx_queue);
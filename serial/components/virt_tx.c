@@ -8,6 +8,8 @@
 #include <os/sddf.h>
 #include <sddf/serial/queue.h>
 #include <sddf/serial/config.h>
+#include <sddf/timer/config.h>
+#include <sddf/timer/client.h>
 #include <sddf/util/printf.h>
 
 #define NAME_MAX 128
@@ -15,6 +17,18 @@
 
 __attribute__((__section__(".serial_virt_tx_config"))) serial_virt_tx_config_t config;
 
+/*
+ * Optional. If the virtualiser is a client of a timer, the driver is notified
+ * of client output after a short hold-off rather than immediately, so that
+ * output from several notifications is handed over in one batch.
+ */
+__attribute__((__section__(".timer_client_config"))) timer_client_config_t timer_config;
+
+/* Time the driver notification is held off for if a timer is available */
+#ifndef SERIAL_VIRT_TX_HOLDOFF_NS
+#define SERIAL_VIRT_TX_HOLDOFF_NS (500 * NS_IN_US)
+#endif
+
 /* When we have more clients than colours, we re-use the colours. */
 const char *colours[] = {
     /* foreground red */
@@ -80,7 +94,20 @@ static void tx_pending_pop(uint32_t *client)
     tx_pending.head = (tx_pending.head + 1) % TX_PENDING_MAX;
 }
 
-bool process_tx_queue(uint32_t client)
+/* Clients and driver to notify once the current event has been handled */
+static sddf_notify_set_t notify_set;
+
+/* Tail of the driver queue when the driver was last notified */
+static uint32_t drv_notified_tail;
+
+static bool holdoff_enabled;
+static bool holdoff_armed;
+
+/*
+ * Copy the client's queue into the driver queue at the local tail. Returns
+ * true if anything was copied.
+ */
+bool process_tx_queue(uint32_t client, uint32_t *drv_tail)
 {
     serial_queue_handle_t *handle = &tx_queue_handle_cli[client];
 
@@ -96,7 +123,8 @@ bool process_tx_queue(uint32_t client)
     }
 
     /* Not enough space to transmit string to virtualiser. Continue later */
-    if (length > serial_queue_free(&tx_queue_handle_drv)) {
+    uint32_t drv_free = tx_queue_handle_drv.capacity - (*drv_tail - tx_queue_handle_drv.queue->head);
+    if (length > drv_free) {
         tx_pending_push(client);
 
         /* Request signal from the driver when data has been consumed */
@@ -106,15 +134,45 @@ bool process_tx_queue(uint32_t client)
 
     if (config.enable_colour) {
         const char *client_colour = colours[client % ARRAY_SIZE(colours)];
-        serial_transfer_all_colour(&tx_queue_handle_drv, handle, client_colour, COLOUR_BEGIN_LEN, COLOUR_END,
-                                   COLOUR_END_LEN);
+        serial_transfer_all_colour_local(&tx_queue_handle_drv, drv_tail, handle, client_colour, COLOUR_BEGIN_LEN,
+                                         COLOUR_END, COLOUR_END_LEN);
     } else {
-        serial_transfer_all(&tx_queue_handle_drv, handle);
+        serial_transfer_all_local(&tx_queue_handle_drv, drv_tail, handle);
+    }
+
+    if (serial_require_consumer_signal(handle)) {
+        serial_cancel_consumer_signal(handle);
+        sddf_notify_set_add(&notify_set, config.clients[client].conn.id);
     }
 
     return true;
 }
 
+static void notify_driver(void)
+{
+    if (tx_queue_handle_drv.queue->tail != drv_notified_tail) {
+        drv_notified_tail = tx_queue_handle_drv.queue->tail;
+        sddf_notify_set_add(&notify_set, config.driver.id);
+    }
+}
+
+/*
+ * Make the transferred output visible to the driver and notify it, or leave
+ * the notification to the hold-off timer if it is enabled and the driver
+ * queue is less than half full.
+ */
+static void publish(uint32_t drv_tail, bool holdoff)
+{
+    serial_update_shared_tail(&tx_queue_handle_drv, drv_tail);
+
+    if (!holdoff || !holdoff_enabled || serial_queue_length(&tx_queue_handle_drv) >= tx_queue_handle_drv.capacity / 2) {
+        notify_driver();
+    } else if (!holdoff_armed && drv_tail != drv_notified_tail) {
+        holdoff_armed = true;
+        sddf_timer_set_timeout(timer_config.driver_id, SERIAL_VIRT_TX_HOLDOFF_NS);
+    }
+}
+
 void tx_return(void)
 {
     uint32_t num_pending_tx = tx_pending_length();
@@ -123,28 +181,14 @@ void tx_return(void)
     }
 
     uint32_t client;
-    // TODO: `= {false};` gets optimised into memset
-    bool notify_client[SDDF_SERIAL_MAX_CLIENTS];
-    for (int i = 0; i < SDDF_SERIAL_MAX_CLIENTS; i++) {
-        notify_client[i] = false;
-    }
-    bool transferred = false;
+    uint32_t drv_tail = tx_queue_handle_drv.queue->tail;
     for (uint32_t req = 0; req < num_pending_tx; req++) {
         tx_pending_pop(&client);
-        notify_client[client] = process_tx_queue(client);
-        transferred |= notify_client[client];
-    }
-
-    if (transferred) {
-        sddf_notify(config.driver.id);
+        process_tx_queue(client, &drv_tail);
     }
 
-    for (uint32_t client = 0; client < config.num_clients; client++) {
-        if (notify_client[client] && serial_require_consumer_signal(&tx_queue_handle_cli[client])) {
-            serial_cancel_consumer_signal(&tx_queue_handle_cli[client]);
-            sddf_notify(config.clients[client].conn.id);
-        }
-    }
+    /* The driver is waiting for more output, so do not hold it off */
+    publish(drv_tail, false);
 }
 
 void tx_provide(sddf_channel ch)
@@ -162,15 +206,18 @@ void tx_provide(sddf_channel ch)
         return;
     }
 
-    bool transferred = process_tx_queue(active_client);
-    if (transferred) {
-        sddf_notify(config.driver.id);
+    /*
+     * Notifications from several clients are delivered one at a time, so
+     * collect the output of every client on the first of them. The output is
+     * copied into the driver queue back to back and published with a single
+     * tail update, and the rest of the notifications find nothing to do.
+     */
+    uint32_t drv_tail = tx_queue_handle_drv.queue->tail;
+    for (uint32_t i = 0; i < config.num_clients; i++) {
+        process_tx_queue((active_client + i) % config.num_clients, &drv_tail);
     }
 
-    if (transferred && serial_require_consumer_signal(&tx_queue_handle_cli[active_client])) {
-        serial_cancel_consumer_signal(&tx_queue_handle_cli[active_client]);
-        sddf_notify(ch);
-    }
+    publish(drv_tail, true);
 }
 
 void init(void)
@@ -191,6 +238,9 @@ void init(void)
         serial_update_shared_tail(&tx_queue_handle_drv, config.begin_str_len + 1);
         sddf_notify(config.driver.id);
     }
+    drv_notified_tail = tx_queue_handle_drv.queue->tail;
+
+    holdoff_enabled = timer_config_check_magic(&timer_config);
 
     if (config.enable_colour) {
         for (uint64_t i = 0; i < config.num_clients; i++) {
@@ -206,7 +256,12 @@ void notified(sddf_channel ch)
 {
     if (ch == config.driver.id) {
         tx_return();
+    } else if (holdoff_enabled && ch == timer_config.driver_id) {
+        holdoff_armed = false;
+        notify_driver();
     } else {
         tx_provide(ch);
     }
+
+    sddf_notify_set_flush(&notify_set);
 }
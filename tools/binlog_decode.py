@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+# Copyright 2025, UNSW
+# SPDX-License-Identifier: BSD-2-Clause
+"""
+Decode the binary log of an sDDF component, see include/sddf/util/binlog.h.
+
+The log is read either from a console log containing the output of
+sddf_binlog_dump, or from a raw dump of the log memory region. Format strings
+and constant string arguments are looked up in the component's ELF file.
+
+Examples:
+    binlog_decode.py --elf build/eth_driver.elf --console minicom.log --pd eth_driver
+    binlog_decode.py --elf build/eth_driver.elf --raw binlog_region.bin
+"""
+import argparse
+import re
+import struct
+import sys
+from typing import Dict, List, Optional, Tuple
+
+SDDF_BINLOG_MAGIC = 0x474f4c4e49424453
+SDDF_BINLOG_HEADER_WORDS = 8
+ARGS_SHIFT = 56
+ADDR_MASK = (1 << ARGS_SHIFT) - 1
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+
+class Elf:
+    """Just enough of an ELF64 little-endian reader to find strings by address."""
+
+    def __init__(self, path: str):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 2 or self.data[5] != 1:
+            raise ValueError(f"{path} is not a little-endian ELF64 file")
+
+        e_shoff, = struct.unpack_from("<Q", self.data, 0x28)
+        e_shentsize, e_shnum, e_shstrndx = struct.unpack_from("<HHH", self.data, 0x3a)
+        headers = []
+        for i in range(e_shnum):
+            headers.append(struct.unpack_from("<IIQQQQIIQQ", self.data, e_shoff + i * e_shentsize))
+
+        shstr_offset = headers[e_shstrndx][4]
+        # (name, addr, contents) of each allocated section with contents
+        self.sections: List[Tuple[str, int, bytes]] = []
+        for name, sh_type, flags, addr, offset, size, *_ in headers:
+            if not flags & SHF_ALLOC or sh_type == SHT_NOBITS:
+                continue
+            end = self.data.index(b"\0", shstr_offset + name)
+            section_name = self.data[shstr_offset + name:end].decode()
+            self.sections.append((section_name, addr, self.data[offset:offset + size]))
+
+    def string_at(self, addr: int) -> Optional[str]:
+        for _, base, contents in self.sections:
+            if base <= addr < base + len(contents):
+                end = contents.find(b"\0", addr - base)
+                if end < 0:
+                    end = len(contents)
+                return contents[addr - base:end].decode(errors="replace")
+        return None
+
+
+CONVERSION = re.compile(r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcspn%])")
+
+
+def format_message(elf: Elf, fmt: str, args: List[int]) -> str:
+    out = []
+    pos = 0
+    arg = 0
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if arg >= len(args):
+            out.append(m.group(0))
+            continue
+        value = args[arg]
+        arg += 1
+
+        bits = 64 if length in ("l", "ll", "z", "j", "t") or conv == "p" else 32
+        value &= (1 << bits) - 1
+        spec = "%" + flags + (width or "") + (f".{prec}" if prec is not None else "")
+        if conv in "di":
+            if value >> (bits - 1):
+                value -= 1 << bits
+            out.append((spec + "d") % value)
+        elif conv in "ouxX":
+            out.append((spec + conv) % value)
+        elif conv == "p":
+            out.append((spec + "s") % hex(value))
+        elif conv == "c":
+            out.append((spec + "c") % chr(value & 0xff))
+        elif conv == "s":
+            string = elf.string_at(value)
+            out.append((spec + "s") % (string if string is not None else f"<string at {value:#x}>"))
+        else:
+            out.append(m.group(0))
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode(elf: Elf, words: Dict[int, int], tail: int, head: int, capacity: int, freq: int):
+    idx = tail
+    while idx < head:
+        header = words.get(idx)
+        if header is None:
+            break
+        if header == 0:
+            idx += capacity - (idx % capacity)
+            continue
+
+        num_args = header >> ARGS_SHIFT
+        fmt_addr = header & ADDR_MASK
+        timestamp = words.get(idx + 1, 0)
+        args = [words.get(idx + 2 + i, 0) for i in range(num_args)]
+        idx += 2 + num_args
+
+        fmt = elf.string_at(fmt_addr)
+        if fmt is None:
+            text = f"<unknown format string at {fmt_addr:#x}> {' '.join(hex(a) for a in args)}"
+        else:
+            text = format_message(elf, fmt, args).rstrip("\n")
+        if freq:
+            print(f"[{timestamp / freq:14.6f}] {text}")
+        else:
+            print(f"[{timestamp:14}] {text}")
+
+
+def read_raw(path: str):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, head, tail, capacity = struct.unpack_from("<QQQQ", data, 0)
+    if magic != SDDF_BINLOG_MAGIC:
+        raise ValueError(f"{path} does not contain a binary log")
+    base = SDDF_BINLOG_HEADER_WORDS * 8
+    words = {}
+    for i in range(tail, head):
+        words[i], = struct.unpack_from("<Q", data, base + (i % capacity) * 8)
+    return words, tail, head, capacity
+
+
+def read_console(path: str, pd: Optional[str]):
+    prefix = re.compile(r"BINLOG\|([^|]*)\|(.*)")
+    logs = []
+    current = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = prefix.search(line)
+            if m is None or (pd is not None and m.group(1) != pd):
+                continue
+            body = m.group(2).split()
+            if body and body[0] == "BEGIN":
+                freq, tail, head, capacity = (int(v) for v in body[1:5])
+                current = (freq, tail, head, capacity, [])
+            elif body and body[0] == "END" and current is not None:
+                logs.append(current)
+                current = None
+            elif current is not None:
+                current[4].extend(int(w, 16) for w in body)
+    return logs
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode an sDDF binary log")
+    parser.add_argument("--elf", required=True, help="ELF file of the component that wrote the log")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--console", help="console log containing the output of sddf_binlog_dump")
+    source.add_argument("--raw", help="raw dump of the log memory region")
+    parser.add_argument("--pd", help="only decode dumps from the protection domain with this name")
+    parser.add_argument("--freq", type=int, default=0,
+                        help="timestamp frequency in Hz for raw dumps, timestamps are printed as ticks otherwise")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    if args.raw:
+        words, tail, head, capacity = read_raw(args.raw)
+        decode(elf, words, tail, head, capacity, args.freq)
+        return
+
+    logs = read_console(args.console, args.pd)
+    if not logs:
+        print("no binary log dumps found", file=sys.stderr)
+        sys.exit(1)
+    for freq, tail, head, capacity, dumped in logs:
+        words = {tail + i: w for i, w in enumerate(dumped)}
+        decode(elf, words, tail, head, capacity, freq)
+
+
+if __name__ == "__main__":
+    main()
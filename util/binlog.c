@@ -0,0 +1,99 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <os/sddf.h>
+#include <sddf/util/binlog.h>
+#include <sddf/util/timestamp.h>
+#include <sddf/util/printf.h>
+#include <sddf/util/util.h>
+
+/* Words of hex printed per line of a dump */
+#define BINLOG_DUMP_WORDS_PER_LINE 8
+
+uintptr_t binlog_region;
+
+static sddf_binlog_t *binlog_get(void)
+{
+    sddf_binlog_t *log = (sddf_binlog_t *)binlog_region;
+    if (log->magic != SDDF_BINLOG_MAGIC) {
+        log->head = 0;
+        log->tail = 0;
+        log->capacity = (SDDF_BINLOG_REGION_SIZE - sizeof(sddf_binlog_t)) / sizeof(uint64_t);
+        log->magic = SDDF_BINLOG_MAGIC;
+    }
+    return log;
+}
+
+/* Length in words of the message starting at word idx */
+static uint64_t message_len(sddf_binlog_t *log, uint64_t idx)
+{
+    uint64_t header = log->words[idx % log->capacity];
+    if (header == 0) {
+        /* Padding until the buffer wraps */
+        return log->capacity - (idx % log->capacity);
+    }
+    return 2 + (header >> SDDF_BINLOG_ARGS_SHIFT);
+}
+
+/* Make room for len words at the head by dropping the oldest messages */
+static void reserve(sddf_binlog_t *log, uint64_t len)
+{
+    while (log->head + len - log->tail > log->capacity) {
+        log->tail += message_len(log, log->tail);
+    }
+}
+
+void sddf_binlog_write(const char *fmt, uint32_t num_args, const uint64_t *args)
+{
+    if (!binlog_region) {
+        return;
+    }
+
+    uint64_t timestamp = sddf_timestamp();
+    sddf_binlog_t *log = binlog_get();
+    num_args = MIN(num_args, SDDF_BINLOG_MAX_ARGS);
+    uint64_t len = 2 + num_args;
+
+    /* Messages never wrap, so pad out the end of the buffer if needed */
+    uint64_t until_wrap = log->capacity - (log->head % log->capacity);
+    if (until_wrap < len) {
+        reserve(log, until_wrap);
+        log->words[log->head % log->capacity] = 0;
+        log->head += until_wrap;
+    }
+
+    reserve(log, len);
+    uint64_t *msg = &log->words[log->head % log->capacity];
+    uint64_t fmt_addr = (uintptr_t)fmt & ((1ULL << SDDF_BINLOG_ARGS_SHIFT) - 1);
+    msg[0] = ((uint64_t)num_args << SDDF_BINLOG_ARGS_SHIFT) | fmt_addr;
+    msg[1] = timestamp;
+    for (uint32_t i = 0; i < num_args; i++) {
+        msg[2 + i] = args[i];
+    }
+
+    __atomic_store_n(&log->head, log->head + len, __ATOMIC_RELEASE);
+}
+
+void sddf_binlog_dump(void)
+{
+    if (!binlog_region) {
+        return;
+    }
+
+    sddf_binlog_t *log = binlog_get();
+    uint64_t head = log->head;
+    uint64_t tail = log->tail;
+
+    sddf_printf("BINLOG|%s|BEGIN %lu %lu %lu %lu\n", sddf_get_pd_name(), sddf_timestamp_freq(), tail, head,
+                log->capacity);
+    for (uint64_t i = tail; i < head; i += BINLOG_DUMP_WORDS_PER_LINE) {
+        sddf_printf("BINLOG|%s|", sddf_get_pd_name());
+        for (uint64_t j = i; j < MIN(i + BINLOG_DUMP_WORDS_PER_LINE, head); j++) {
+            sddf_printf(" %016lx", log->words[j % log->capacity]);
+        }
+        sddf_printf("\n");
+    }
+    sddf_printf("BINLOG|%s|END\n", sddf_get_pd_name());
+}
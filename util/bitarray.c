@@ -203,3 +203,99 @@ bool bitarray_cmp_region(bitarray_t *bitarr1, bit_index_t start1,
     return true;
 }
 
+/**
+ * Find the first bit in a region with the given value, a word at a time.
+ *
+ * @param invert 0 to find a set bit, WORD_MAX to find a clear bit.
+ * @return index of the bit found, start + len if there is none.
+ */
+static inline bit_index_t _find_first(bitarray_t *bitarr, bit_index_t start, bit_index_t len, word_t invert)
+{
+    bit_index_t end = start + len;
+    if (len == 0) {
+        return end;
+    }
+
+    word_index_t word = bitset64_wrd(start);
+    word_index_t last_word = bitset64_wrd(end - 1);
+    word_t bits = (bitarr->words[word] ^ invert) & ~bitmask64(bitset64_idx(start));
+    while (bits == 0) {
+        if (word == last_word) {
+            return end;
+        }
+        bits = bitarr->words[++word] ^ invert;
+    }
+
+    return MIN(word * 64 + __builtin_ctzll(bits), end);
+}
+
+bit_index_t bitarray_find_first_set(bitarray_t *bitarr, bit_index_t start, bit_index_t len)
+{
+    assert(start + len <= bitarr->num_of_bits);
+    return _find_first(bitarr, start, len, 0);
+}
+
+bit_index_t bitarray_find_first_clear(bitarray_t *bitarr, bit_index_t start, bit_index_t len)
+{
+    assert(start + len <= bitarr->num_of_bits);
+    return _find_first(bitarr, start, len, WORD_MAX);
+}
+
+bool bitarray_find_run(bitarray_t *bitarr, bit_index_t start, bit_index_t len, bit_index_t count,
+                       bit_index_t *index)
+{
+    assert(start + len <= bitarr->num_of_bits);
+
+    bit_index_t end = start + len;
+    bit_index_t pos = start;
+    while (pos + count <= end) {
+        pos = _find_first(bitarr, pos, end - pos, 0);
+        if (pos + count > end) {
+            return false;
+        }
+
+        // Only need to look as far as the end of the run we want
+        bit_index_t run_end = _find_first(bitarr, pos, count, WORD_MAX);
+        if (run_end == pos + count) {
+            *index = pos;
+            return true;
+        }
+        pos = run_end;
+    }
+
+    return false;
+}
+
+bit_index_t bitarray_popcount(bitarray_t *bitarr, bit_index_t start, bit_index_t len)
+{
+    assert(start + len <= bitarr->num_of_bits);
+
+    if (len == 0) {
+        return 0;
+    }
+
+    word_index_t first_word = bitset64_wrd(start);
+    word_index_t last_word = bitset64_wrd(start + len - 1);
+    word_offset_t foffset = bitset64_idx(start);
+    word_offset_t loffset = bitset64_idx(start + len - 1);
+
+    if (first_word == last_word) {
+        return __builtin_popcountll(bitarr->words[first_word] & (bitmask64(len) << foffset));
+    }
+
+    bit_index_t count = __builtin_popcountll(bitarr->words[first_word] & ~bitmask64(foffset));
+    // Two independent accumulators so that consecutive counts can overlap
+    bit_index_t count_even = 0, count_odd = 0;
+    word_index_t i = first_word + 1;
+    for (; i + 1 < last_word; i += 2) {
+        count_even += __builtin_popcountll(bitarr->words[i]);
+        count_odd += __builtin_popcountll(bitarr->words[i + 1]);
+    }
+    if (i < last_word) {
+        count_even += __builtin_popcountll(bitarr->words[i]);
+    }
+    count += count_even + count_odd;
+    count += __builtin_popcountll(bitarr->words[last_word] & bitmask64(loffset + 1));
+
+    return count;
+}
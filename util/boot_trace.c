@@ -0,0 +1,188 @@
+/*
+ * Copyright 2025, UNSW
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <os/sddf.h>
+#include <sddf/util/boot_trace.h>
+#include <sddf/util/timestamp.h>
+#include <sddf/util/printf.h>
+#include <sddf/util/util.h>
+
+/* Steps starting within this long of another component's step finishing are reported as serialised */
+#ifndef BOOT_TRACE_SERIAL_THRESHOLD_US
+#define BOOT_TRACE_SERIAL_THRESHOLD_US 1000
+#endif
+
+/* Width in characters of the waterfall timeline */
+#define BOOT_TRACE_BAR_WIDTH 40
+
+uintptr_t boot_trace_region;
+
+static void copy_name(char *dst, const char *src, int len)
+{
+    int i = 0;
+    for (; i < len - 1 && src[i] != '\0'; i++) {
+        dst[i] = src[i];
+    }
+    for (; i < len; i++) {
+        dst[i] = '\0';
+    }
+}
+
+static bool names_equal(const char *a, const char *b, int len)
+{
+    for (int i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+        if (a[i] == '\0') {
+            return true;
+        }
+    }
+    return true;
+}
+
+void boot_trace_record(boot_trace_kind_t kind, const char *name)
+{
+    if (!boot_trace_region) {
+        return;
+    }
+
+    uint64_t now = sddf_timestamp();
+    boot_trace_t *trace = (boot_trace_t *)boot_trace_region;
+    uint32_t idx = __atomic_fetch_add(&trace->num_events, 1, __ATOMIC_RELAXED);
+    if (idx >= BOOT_TRACE_MAX_EVENTS) {
+        return;
+    }
+
+    boot_trace_event_t *event = &trace->events[idx];
+    event->timestamp = now;
+    event->kind = kind;
+    copy_name(event->pd, sddf_get_pd_name(), BOOT_TRACE_PD_NAME_LEN);
+    copy_name(event->name, name, BOOT_TRACE_NAME_LEN);
+    __atomic_store_n(&event->valid, 1, __ATOMIC_RELEASE);
+}
+
+/* A step of initialisation, marks are steps with the same begin and end event */
+typedef struct span {
+    uint16_t begin;
+    uint16_t end;
+} span_t;
+
+static span_t spans[BOOT_TRACE_MAX_EVENTS];
+
+static void print_bar(uint64_t begin, uint64_t end, uint64_t first, uint64_t total)
+{
+    uint64_t from = ((begin - first) * BOOT_TRACE_BAR_WIDTH) / total;
+    uint64_t to = ((end - first) * BOOT_TRACE_BAR_WIDTH) / total;
+    sddf_printf("|");
+    for (uint64_t i = 0; i < BOOT_TRACE_BAR_WIDTH; i++) {
+        if (i == from && begin == end) {
+            sddf_printf("*");
+        } else if (i >= from && i <= to && begin != end) {
+            sddf_printf("#");
+        } else {
+            sddf_printf(" ");
+        }
+    }
+    sddf_printf("|\n");
+}
+
+void boot_trace_report(void)
+{
+    if (!boot_trace_region) {
+        return;
+    }
+
+    boot_trace_t *trace = (boot_trace_t *)boot_trace_region;
+    uint32_t num_events = MIN(__atomic_load_n(&trace->num_events, __ATOMIC_RELAXED), BOOT_TRACE_MAX_EVENTS);
+    boot_trace_event_t *events = trace->events;
+
+    /* Pair up begin and end events into spans, marks become zero-length spans */
+    uint32_t num_spans = 0;
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    for (uint32_t i = 0; i < num_events; i++) {
+        if (!__atomic_load_n(&events[i].valid, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        first = MIN(first, events[i].timestamp);
+        last = MAX(last, events[i].timestamp);
+
+        if (events[i].kind == BOOT_TRACE_MARK) {
+            spans[num_spans++] = (span_t) { i, i };
+        } else if (events[i].kind == BOOT_TRACE_BEGIN) {
+            /* Steps that never end are shown as marks at their start */
+            spans[num_spans] = (span_t) { i, i };
+            for (uint32_t j = i + 1; j < num_events; j++) {
+                if (__atomic_load_n(&events[j].valid, __ATOMIC_ACQUIRE) && events[j].kind == BOOT_TRACE_END
+                    && names_equal(events[i].pd, events[j].pd, BOOT_TRACE_PD_NAME_LEN)
+                    && names_equal(events[i].name, events[j].name, BOOT_TRACE_NAME_LEN)) {
+                    spans[num_spans].end = j;
+                    break;
+                }
+            }
+            num_spans++;
+        }
+    }
+
+    if (num_spans == 0) {
+        sddf_printf("BOOT TRACE|INFO: no events recorded\n");
+        return;
+    }
+
+    /* Order by start time, the buffer is only ordered per component */
+    for (uint32_t i = 1; i < num_spans; i++) {
+        span_t span = spans[i];
+        uint32_t j = i;
+        while (j > 0 && events[spans[j - 1].begin].timestamp > events[span.begin].timestamp) {
+            spans[j] = spans[j - 1];
+            j--;
+        }
+        spans[j] = span;
+    }
+
+    uint64_t total = MAX(last - first, 1);
+    sddf_printf("BOOT TRACE|INFO: %u steps over %luus", num_spans, sddf_timestamp_to_us(total));
+    if (__atomic_load_n(&trace->num_events, __ATOMIC_RELAXED) > BOOT_TRACE_MAX_EVENTS) {
+        sddf_printf(", trace buffer overflowed, later events were dropped");
+    }
+    sddf_printf("\n");
+    sddf_printf("%10s %10s  %-*s %-*s\n", "start(us)", "took(us)", BOOT_TRACE_PD_NAME_LEN, "pd", BOOT_TRACE_NAME_LEN,
+                "step");
+    for (uint32_t i = 0; i < num_spans; i++) {
+        boot_trace_event_t *begin = &events[spans[i].begin];
+        boot_trace_event_t *end = &events[spans[i].end];
+        sddf_printf("%10lu %10lu  %-*s %-*s ", sddf_timestamp_to_us(begin->timestamp - first),
+                    sddf_timestamp_to_us(end->timestamp - begin->timestamp), BOOT_TRACE_PD_NAME_LEN, begin->pd,
+                    BOOT_TRACE_NAME_LEN, begin->name);
+        print_bar(begin->timestamp, end->timestamp, first, total);
+    }
+
+    /*
+     * A step that starts right after a step of another component finishes was
+     * most likely waiting on it, e.g. a virtualiser waiting for its driver.
+     */
+    uint64_t threshold = (BOOT_TRACE_SERIAL_THRESHOLD_US * sddf_timestamp_freq()) / 1000000;
+    for (uint32_t i = 0; i < num_spans; i++) {
+        boot_trace_event_t *begin = &events[spans[i].begin];
+        boot_trace_event_t *waited_on = NULL;
+        for (uint32_t j = 0; j < num_spans; j++) {
+            boot_trace_event_t *end = &events[spans[j].end];
+            if (spans[j].begin == spans[j].end || names_equal(begin->pd, end->pd, BOOT_TRACE_PD_NAME_LEN)
+                || end->timestamp > begin->timestamp || begin->timestamp - end->timestamp > threshold) {
+                continue;
+            }
+            if (waited_on == NULL || end->timestamp > waited_on->timestamp) {
+                waited_on = end;
+            }
+        }
+
+        if (waited_on != NULL) {
+            sddf_printf("BOOT TRACE|INFO: serialised: %s '%s' started %luus after %s '%s' finished\n", begin->pd,
+                        begin->name, sddf_timestamp_to_us(begin->timestamp - waited_on->timestamp), waited_on->pd,
+                        waited_on->name);
+        }
+    }
+}
@@ -76,3 +76,33 @@ void cache_clean(unsigned long start, unsigned long end)
 #error "Unknown architecture for cache_clean"
 #endif
 }
+
+void cache_clean_rows(unsigned long start, unsigned long row_len, unsigned long stride, unsigned long num_rows)
+{
+#if defined(CONFIG_ARCH_AARCH64)
+    unsigned long vaddr;
+    unsigned long index;
+    /* Rows closer together than a cache line share lines, which only need cleaning once */
+    unsigned long next_index = 0;
+
+    if (row_len == 0 || num_rows == 0) {
+        return;
+    }
+
+    for (unsigned long row = 0; row < num_rows; row++) {
+        unsigned long row_start = start + row * stride;
+        unsigned long end_rounded = ROUND_UP(row_start + row_len, 1 << CONFIG_L1_CACHE_LINE_SIZE_BITS);
+        for (index = MAX(LINE_INDEX(row_start), next_index); index < LINE_INDEX(end_rounded); index++) {
+            vaddr = index << CONFIG_L1_CACHE_LINE_SIZE_BITS;
+            asm volatile("dc cvac, %0" : : "r"(vaddr));
+        }
+        next_index = LINE_INDEX(end_rounded);
+    }
+    asm volatile("dmb sy" ::: "memory");
+#elif defined(CONFIG_ARCH_RISCV)
+    /* While not all RISC-V platforms are DMA cache-coherent,
+     * we assume we are targeting one that is and so there is nothing to do. */
+#else
+#error "Unknown architecture for cache_clean_rows"
+#endif
+}
@@ -31,72 +31,68 @@ static inline uint64_t addr_to_bitpos(fsmalloc_t *fsmalloc, uintptr_t addr)
 }
 
 /**
- * Check if count number of cells will overflow the end of the data region.
+ * Find count contiguous available cells, searching from where the last
+ * allocation ended and then wrapping around to the start of the data region.
  *
- * @param count number of cells to check
- * @return true if count number of cells will overflow the end of the data region, false otherwise
+ * @param count number of cells to find
+ * @param bitpos bit position of the first cell found
+ * @return true if the cells were found, false otherwise
  */
-static inline bool fsmalloc_overflow(fsmalloc_t *fsmalloc, uint64_t count)
+static bool fsmalloc_find(fsmalloc_t *fsmalloc, uint64_t count, uint64_t *bitpos)
 {
-    return (fsmalloc->avail_bitpos + count > fsmalloc->num_cells);
-}
-
-bool fsmalloc_full(fsmalloc_t *fsmalloc, uint64_t count)
-{
-    if (count > fsmalloc->num_cells) {
+    if (count == 0) {
+        *bitpos = fsmalloc->avail_bitpos;
         return true;
     }
-
-    if (count == 0) {
+    if (count > fsmalloc->num_free) {
         return false;
     }
 
-    unsigned int start_bitpos = fsmalloc->avail_bitpos;
-    if (fsmalloc_overflow(fsmalloc, count)) {
-        start_bitpos = 0;
+    uint64_t start = fsmalloc->avail_bitpos;
+    if (bitarray_find_run(fsmalloc->avail_bitarr, start, fsmalloc->num_cells - start, count, bitpos)) {
+        return true;
     }
 
-    // Create a bit mask with count many 1's
-    bitarray_t bitarr_mask;
-    word_t words[roundup_bits2words64(count)];
-    bitarray_init(&bitarr_mask, words, roundup_bits2words64(count));
-    bitarray_set_region(&bitarr_mask, 0, count);
-
-    if (bitarray_cmp_region(fsmalloc->avail_bitarr, start_bitpos, &bitarr_mask, 0, count)) {
-        return false;
-    }
+    /* Runs may straddle where the first search started */
+    uint64_t limit = MIN(start + count - 1, fsmalloc->num_cells);
+    return bitarray_find_run(fsmalloc->avail_bitarr, 0, limit, count, bitpos);
+}
 
-    return true;
+bool fsmalloc_full(fsmalloc_t *fsmalloc, uint64_t count)
+{
+    uint64_t bitpos;
+    return !fsmalloc_find(fsmalloc, count, &bitpos);
 }
 
 void fsmalloc_free(fsmalloc_t *fsmalloc, uintptr_t addr, uint64_t count)
 {
-    unsigned int start_bitpos = addr_to_bitpos(fsmalloc, addr);
+    uint64_t start_bitpos = addr_to_bitpos(fsmalloc, addr);
 
     // Assert here in case we try to free cells that overflow the data region
     assert(start_bitpos + count <= fsmalloc->num_cells);
+    // Assert here in case we try to free cells that are already free
+    assert(bitarray_popcount(fsmalloc->avail_bitarr, start_bitpos, count) == 0);
 
     // Set the next count many bits as available
     bitarray_set_region(fsmalloc->avail_bitarr, start_bitpos, count);
+    fsmalloc->num_free += count;
 }
 
 int fsmalloc_alloc(fsmalloc_t *fsmalloc, uintptr_t *addr, uint64_t count)
 {
-    if (fsmalloc_full(fsmalloc, count)) {
+    uint64_t bitpos;
+    if (!fsmalloc_find(fsmalloc, count, &bitpos)) {
         return -1;
     }
 
-    if (fsmalloc_overflow(fsmalloc, count)) {
-        fsmalloc->avail_bitpos = 0;
-    }
-
-    *addr = bitpos_to_addr(fsmalloc, fsmalloc->avail_bitpos);
+    *addr = bitpos_to_addr(fsmalloc, bitpos);
 
     // Set the next count many bits as unavailable
-    bitarray_clear_region(fsmalloc->avail_bitarr, fsmalloc->avail_bitpos, count);
+    bitarray_clear_region(fsmalloc->avail_bitarr, bitpos, count);
+    fsmalloc->num_free -= count;
 
-    // Update the bitpos
-    uint64_t new_bitpos = fsmalloc->avail_bitpos + count;
+    // Continue searching from the end of this allocation next time
+    uint64_t new_bitpos = bitpos + count;
     if (new_bitpos == fsmalloc->num_cells) {
         new_bitpos = 0;
     }
@@ -108,6 +104,7 @@ int fsmalloc_alloc(fsmalloc_t *fsmalloc, uintptr_t *addr, uint64_t count)
 void fsmalloc_init(fsmalloc_t *fsmalloc, uintptr_t base_addr, uint64_t cell_size, uint64_t num_cells,
                    bitarray_t *bitarr, word_t *words, word_index_t num_words)
 {
+    assert(num_cells <= num_words * 64);
     bitarray_init(bitarr, words, num_words);
 
     fsmalloc->avail_bitpos = 0;
@@ -115,6 +112,7 @@ void fsmalloc_init(fsmalloc_t *fsmalloc, uintptr_t base_addr, uint64_t cell_size
     fsmalloc->base_addr = base_addr;
     fsmalloc->cell_size = cell_size;
     fsmalloc->num_cells = num_cells;
+    fsmalloc->num_free = num_cells;
 
     /* Set all available bits to 1 to indicate all cells are available */
     bitarray_set_region(bitarr, 0, num_cells);
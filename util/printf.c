@@ -870,6 +870,7 @@ int sddf_printf_(const char* format, ...)
   char buffer[1];
   const int ret = _vsnprintf(_out_char, buffer, (size_t)-1, format, va);
   va_end(va);
+  _sddf_putchar_batch_end();
   return ret;
 }
 
@@ -897,7 +898,9 @@ int sddf_snprintf_(char* buffer, size_t count, const char* format, ...)
 int sddf_vprintf_(const char* format, va_list va)
 {
   char buffer[1];
-  return _vsnprintf(_out_char, buffer, (size_t)-1, format, va);
+  const int ret = _vsnprintf(_out_char, buffer, (size_t)-1, format, va);
+  _sddf_putchar_batch_end();
+  return ret;
 }
 
 
@@ -33,4 +33,9 @@ void _sddf_putchar(char character)
         _sddf_dbg_puts(string_buffer);
         local_tail = 0;
     }
-}
\ No newline at end of file
+}
+
+void _sddf_putchar_batch_end(void)
+{
+    /* Output is already flushed a line at a time */
+}
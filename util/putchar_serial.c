@@ -3,46 +3,137 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <stdbool.h>
 #include <os/sddf.h>
 #include <sddf/serial/queue.h>
+#include <sddf/timer/client.h>
 #include <sddf/util/printf.h>
+#include <sddf/util/util.h>
+
+/*
+ * Output is rendered into a local buffer and copied into the serial queue a
+ * buffer at a time. The virtualiser is notified once the unnotified output
+ * reaches the watermark, and otherwise at the end of each sddf_printf that
+ * completed a line. If a flush timer is set, it is notified when the timer
+ * expires instead, which also flushes partial lines.
+ */
 
 #define FLUSH_CHAR '\n'
 
+/* Size of the local buffer characters are rendered into */
+#ifndef SERIAL_PUTCHAR_BUF_SIZE
+#define SERIAL_PUTCHAR_BUF_SIZE 256
+#endif
+
+/* Number of unnotified bytes in the queue at which the virtualiser is notified, capped at half the queue */
+#ifndef SERIAL_PUTCHAR_WATERMARK
+#define SERIAL_PUTCHAR_WATERMARK 1024
+#endif
+
 static sddf_channel tx_ch;
 static serial_queue_handle_t *tx_queue_handle;
 
-static uint32_t local_tail;
+static char buf[SERIAL_PUTCHAR_BUF_SIZE];
+static uint32_t buf_len;
 
-/* Ensure to call serial_putchar_init during initialisation. Multiplexes output based on \n or when buffer is full. */
-void _sddf_putchar(char character)
+/* Tail of the queue when the virtualiser was last notified */
+static uint32_t notified_tail;
+/* A complete line has been output since the virtualiser was last notified */
+static bool line_pending;
+
+static bool flush_timer_set;
+static sddf_channel flush_timer_ch;
+static uint64_t flush_timer_id;
+static uint64_t flush_timer_delay;
+static bool flush_timer_armed;
+
+/* Copy the local buffer into the queue, dropping what does not fit */
+static void drain(void)
 {
-    if (serial_queue_full(tx_queue_handle, local_tail) || serial_queue_full(tx_queue_handle, local_tail + 1)) {
-        return;
+    if (buf_len) {
+        serial_enqueue_batch(tx_queue_handle, buf_len, buf);
+        buf_len = 0;
     }
+}
 
-    if (character == '\n') {
-        serial_enqueue_local(tx_queue_handle, &local_tail, '\r');
+static void notify(void)
+{
+    uint32_t tail = tx_queue_handle->queue->tail;
+    if (tail != notified_tail) {
+        notified_tail = tail;
+        sddf_notify(tx_ch);
     }
-    serial_enqueue_local(tx_queue_handle, &local_tail, character);
+    line_pending = false;
+}
 
-    /* Make changes visible to virtualiser if character is flush or if queue is now filled */
-    if (serial_queue_full(tx_queue_handle, local_tail) || serial_queue_full(tx_queue_handle, local_tail + 1)
-        || character == FLUSH_CHAR) {
-        serial_update_shared_tail(tx_queue_handle, local_tail);
-        sddf_notify(tx_ch);
+static bool above_watermark(void)
+{
+    uint32_t watermark = MIN(SERIAL_PUTCHAR_WATERMARK, tx_queue_handle->capacity / 2);
+    return tx_queue_handle->queue->tail - notified_tail >= watermark
+        || serial_queue_free(tx_queue_handle) == 0;
+}
+
+static void put(char character)
+{
+    if (buf_len == SERIAL_PUTCHAR_BUF_SIZE) {
+        drain();
+        if (above_watermark()) {
+            notify();
+        }
+    }
+    buf[buf_len++] = character;
+}
+
+/* Ensure to call serial_putchar_init during initialisation. */
+void _sddf_putchar(char character)
+{
+    if (character == FLUSH_CHAR) {
+        put('\r');
+        line_pending = true;
+    }
+    put(character);
+}
+
+void _sddf_putchar_batch_end(void)
+{
+    drain();
+    if (above_watermark()) {
+        notify();
+    } else if (!flush_timer_set) {
+        if (line_pending) {
+            notify();
+        }
+    } else if (!flush_timer_armed && tx_queue_handle->queue->tail != notified_tail) {
+        /* Partial lines are flushed by the timer too */
+        flush_timer_armed = true;
+        sddf_timer_set_timeout_id(flush_timer_ch, flush_timer_id, flush_timer_delay);
     }
 }
 
 void sddf_putchar_unbuffered(char character)
 {
-    if (serial_queue_full(tx_queue_handle, local_tail)) {
+    drain();
+    if (serial_queue_full(tx_queue_handle, tx_queue_handle->queue->tail)) {
         return;
     }
 
-    serial_enqueue_local(tx_queue_handle, &local_tail, character);
-    serial_update_shared_tail(tx_queue_handle, local_tail);
-    sddf_notify(tx_ch);
+    serial_enqueue(tx_queue_handle, character);
+    notify();
+}
+
+void serial_putchar_flush(void)
+{
+    flush_timer_armed = false;
+    drain();
+    notify();
+}
+
+void serial_putchar_set_flush_timer(sddf_channel timer_ch, uint64_t timeout_id, uint64_t delay_ns)
+{
+    flush_timer_set = true;
+    flush_timer_ch = timer_ch;
+    flush_timer_id = timeout_id;
+    flush_timer_delay = delay_ns;
 }
 
 /* Initialise the serial putchar library. */
@@ -50,5 +141,5 @@ void serial_putchar_init(sddf_channel serial_tx_ch, serial_queue_handle_t *seria
 {
     tx_ch = serial_tx_ch;
     tx_queue_handle = serial_tx_queue_handle;
-    local_tail = serial_tx_queue_handle->queue->tail;
+    notified_tail = serial_tx_queue_handle->queue->tail;
 }
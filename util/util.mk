@@ -8,10 +8,11 @@
 # sddf_libutil.a and sddf_libutil_debug.a
 # sddf_libutil.a needs the component to have channels and queues
 # with the the serial_tx_virt and for putchar to be initialised.
-# sddf_libutil_debug.a uses the microkit_dbg_putc function.
-# Both are character at a time polling (i.e., slow, and only for debugging)
+# sddf_libutil_debug.a uses the microkit_dbg_putc function, which is
+# character at a time polling (i.e., slow, and only for debugging).
+# sddf_libutil.a batches output into the serial tx queue.
 
-OBJS_LIBUTIL := cache.o sddf_printf.o newlibc.o assert.o bitarray.o fsmalloc.o
+OBJS_LIBUTIL := cache.o sddf_printf.o newlibc.o assert.o bitarray.o fsmalloc.o boot_trace.o binlog.o
 
 ALL_OBJS_LIBUTIL := $(addprefix util/, ${OBJS_LIBUTIL} putchar_debug.o putchar_serial.o)
 